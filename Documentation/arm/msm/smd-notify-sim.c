@@ -0,0 +1,243 @@
+/*
+ * smd-notify-sim: count the interrupts a reader of an SMD FIFO sends the
+ * writer, with and without a read notification threshold.
+ *
+ * Two processes share a FIFO with head and tail indexes laid out like an
+ * SMD half channel.  The "modem" writes packets behind a 20 byte header
+ * and interrupts the "apps" side after each one; when the FIFO is full it
+ * asks for read interrupts and waits for one.  The "apps" side polls up
+ * to 64 packets at a time, as rmnet does, and after each packet tells the
+ * modem about the freed space the way smd.c does: on every read, or with
+ * a threshold once that many bytes were read, the FIFO ran empty, or the
+ * poll ended.  Interrupts are bytes written to a pipe.
+ *
+ * Every threshold is run twice: with a modem that blocks read interrupts
+ * unless it waits for space, and with one that takes them all.  Reported
+ * are the interrupts each side took per MB moved.
+ *
+ * Usage: smd-notify-sim [MB [packet-bytes [fifo-bytes]]]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HEADER_SIZE	20
+#define BUDGET		64
+
+struct fifo {
+	volatile unsigned head;
+	volatile unsigned tail;
+	volatile int block_read_intr;	/* fBLOCKREADINTR of the modem */
+	volatile int done;
+	unsigned long read_intrs;	/* apps -> modem */
+	unsigned long write_intrs;	/* modem -> apps */
+	unsigned size;
+	unsigned char data[];
+};
+
+static struct fifo *fifo;
+static int to_modem[2], to_apps[2];
+
+static unsigned fifo_used(void)
+{
+	return (fifo->head - fifo->tail) & (fifo->size - 1);
+}
+
+static void intr(int fd)
+{
+	char c = 0;
+
+	/* a full pipe is an interrupt already pending */
+	if (write(fd, &c, 1) < 0 && errno != EAGAIN)
+		perror("write");
+}
+
+static void wait_intr(int fd)
+{
+	char buf[4096];
+
+	if (read(fd, buf, sizeof(buf)) < 0 && errno != EINTR)
+		perror("read");
+}
+
+static void fifo_copy_in(unsigned off, const void *src, unsigned len)
+{
+	unsigned n = fifo->size - off;
+
+	if (n > len)
+		n = len;
+	memcpy(fifo->data + off, src, n);
+	memcpy(fifo->data, (const char *)src + n, len - n);
+}
+
+static void fifo_copy_out(unsigned off, void *dst, unsigned len)
+{
+	unsigned n = fifo->size - off;
+
+	if (n > len)
+		n = len;
+	memcpy(dst, fifo->data + off, n);
+	memcpy((char *)dst + n, fifo->data, len - n);
+}
+
+static void modem(unsigned long long total, unsigned pkt, int blocks)
+{
+	unsigned char *buf = calloc(1, pkt);
+	unsigned hdr[5] = { pkt, 0, 0, 0, 0 };
+	unsigned long long sent;
+	unsigned head;
+
+	fifo->block_read_intr = blocks;
+	for (sent = 0; sent < total; sent += pkt) {
+		while (fifo->size - 1 - fifo_used() < HEADER_SIZE + pkt) {
+			fifo->block_read_intr = 0;
+			__sync_synchronize();
+			if (fifo->size - 1 - fifo_used() < HEADER_SIZE + pkt)
+				wait_intr(to_modem[0]);
+			fifo->block_read_intr = blocks;
+		}
+		head = fifo->head;
+		fifo_copy_in(head, hdr, HEADER_SIZE);
+		fifo_copy_in((head + HEADER_SIZE) & (fifo->size - 1), buf, pkt);
+		__sync_synchronize();
+		fifo->head = (head + HEADER_SIZE + pkt) & (fifo->size - 1);
+		fifo->write_intrs++;
+		intr(to_apps[1]);
+	}
+	fifo->done = 1;
+	intr(to_apps[1]);
+	free(buf);
+}
+
+static void apps(unsigned threshold)
+{
+	static unsigned char buf[65536];
+	unsigned pending = 0, hdr[5];
+	int n;
+
+	for (;;) {
+		wait_intr(to_apps[0]);
+		for (n = 0; n < BUDGET && fifo_used() >= HEADER_SIZE; n++) {
+			__sync_synchronize();
+			fifo_copy_out(fifo->tail, hdr, HEADER_SIZE);
+			fifo_copy_out((fifo->tail + HEADER_SIZE) &
+				      (fifo->size - 1), buf, hdr[0]);
+			__sync_synchronize();
+			fifo->tail = (fifo->tail + HEADER_SIZE + hdr[0]) &
+				     (fifo->size - 1);
+			/* against the modem asking for read interrupts */
+			__sync_synchronize();
+
+			/* ch_read_notify() */
+			if (fifo->block_read_intr) {
+				pending = 0;
+				continue;
+			}
+			pending += HEADER_SIZE + hdr[0];
+			if (pending < threshold && fifo_used())
+				continue;
+			pending = 0;
+			fifo->read_intrs++;
+			intr(to_modem[1]);
+		}
+		/* end of the poll: smd_read_notify_flush() */
+		if (pending && !fifo->block_read_intr) {
+			fifo->read_intrs++;
+			intr(to_modem[1]);
+		}
+		pending = 0;
+		if (n == BUDGET)
+			intr(to_apps[1]);	/* stay scheduled */
+		else if (fifo->done && !fifo_used())
+			break;
+	}
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int run(unsigned long long total, unsigned pkt, unsigned size,
+	       unsigned threshold, int blocks)
+{
+	double t, mb = total / 1048576.0;
+	pid_t pid;
+
+	memset(fifo, 0, sizeof(*fifo));
+	fifo->size = size;
+	if (pipe2(to_modem, O_NONBLOCK) || pipe2(to_apps, O_NONBLOCK)) {
+		perror("pipe");
+		return -1;
+	}
+	/* the receiving ends block, the sending ones must not */
+	fcntl(to_modem[0], F_SETFL, 0);
+	fcntl(to_apps[0], F_SETFL, 0);
+
+	t = now();
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		apps(threshold);
+		_exit(0);
+	}
+	modem(total, pkt, blocks);
+	waitpid(pid, NULL, 0);
+	t = now() - t;
+
+	printf("%-6s %9u %10.1f %10.1f %9.1f\n", blocks ? "blocks" : "takes",
+	       threshold, fifo->read_intrs / mb, fifo->write_intrs / mb,
+	       mb / t);
+	close(to_modem[0]);
+	close(to_modem[1]);
+	close(to_apps[0]);
+	close(to_apps[1]);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long total = (unsigned long long)
+		(argc > 1 ? atoi(argv[1]) : 64) << 20;
+	unsigned pkt = argc > 2 ? atoi(argv[2]) : 1400;
+	unsigned size = argc > 3 ? atoi(argv[3]) : 8192;
+	unsigned thresholds[] = { 0, size / 16, size / 8, size / 4, size / 2 };
+	int i, blocks;
+
+	if (!total || !pkt || size & (size - 1) ||
+	    pkt + HEADER_SIZE >= size || pkt > 65536) {
+		fprintf(stderr, "usage: %s [MB [packet-bytes [fifo-bytes]]]\n"
+			"fifo-bytes is a power of two above packet-bytes\n",
+			argv[0]);
+		return 1;
+	}
+	fifo = mmap(NULL, sizeof(*fifo) + size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (fifo == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	printf("%llu MB in %u byte packets through a %u byte fifo\n",
+	       total >> 20, pkt, size);
+	printf("modem  threshold  read-intr  write-intr      MB/s\n"
+	       "                     per MB      per MB\n");
+	for (blocks = 1; blocks >= 0; blocks--)
+		for (i = 0; i < 5; i++)
+			if (run(total, pkt, size, thresholds[i], blocks))
+				return 1;
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * ext4-boot-reads: report the read requests a disk has served since boot
+ * and, given a command, the requests and wall time that command costs.
+ *
+ * Run right after boot completes, once without and once with a prefetch
+ * list written to /proc/fs/ext4/<dev>/prefetch, to compare the number of
+ * reads boot took; with "am start -W <activity>" as the command it also
+ * times the first application launch.
+ *
+ * Usage: ext4-boot-reads <disk> [command [args...]]
+ *
+ * <disk> is the name under /sys/block, e.g. mmcblk0.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct reads {
+	unsigned long long ios, merges, sectors, ticks;
+};
+
+static int read_stat(const char *disk, struct reads *r)
+{
+	char path[256];
+	FILE *f;
+	int n;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/stat", disk);
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	n = fscanf(f, "%llu %llu %llu %llu", &r->ios, &r->merges,
+		   &r->sectors, &r->ticks);
+	fclose(f);
+	return n == 4 ? 0 : -1;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+	struct reads before, after;
+	double uptime = 0, t;
+	FILE *f;
+	int status;
+	pid_t pid;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <disk> [command [args...]]\n",
+			argv[0]);
+		return 1;
+	}
+	if (read_stat(argv[1], &before))
+		return 1;
+	f = fopen("/proc/uptime", "r");
+	if (f) {
+		if (fscanf(f, "%lf", &uptime) != 1)
+			uptime = 0;
+		fclose(f);
+	}
+	printf("%s since boot (%.1fs): %llu reads, %llu merged, "
+	       "%llu KB, %llu ms\n", argv[1], uptime, before.ios,
+	       before.merges, before.sectors / 2, before.ticks);
+	if (argc < 3)
+		return 0;
+
+	t = now();
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		execvp(argv[2], argv + 2);
+		perror(argv[2]);
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+	t = now() - t;
+	if (read_stat(argv[1], &after))
+		return 1;
+	printf("%s: %.3fs, %llu reads, %llu merged, %llu KB\n", argv[2], t,
+	       after.ios - before.ios, after.merges - before.merges,
+	       (after.sectors - before.sectors) / 2);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,124 @@
+/*
+ * ext4-fsync-bench: time the fsync pattern of an SQLite database in WAL
+ * mode - overwrite a few pages of an existing file, then fsync() - and
+ * report operations per second together with the journal commits, fast
+ * commits and cache flushes it cost.
+ *
+ * Usage: ext4-fsync-bench <file> [ops [pages-per-op [jbd2-dir]]]
+ *
+ * <file> is created and preallocated first, so the timed loop only ever
+ * overwrites.  jbd2-dir is the journal's directory under /proc/fs/jbd2,
+ * e.g. mmcblk0p12-8; without it only the rate is reported.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define PAGE		4096
+#define FILE_PAGES	256
+
+struct jstats {
+	unsigned long commits, fc, fc_failed, flushes;
+};
+
+static int read_jstats(const char *dir, struct jstats *js)
+{
+	char path[256], line[256];
+	FILE *f;
+
+	memset(js, 0, sizeof(*js));
+	if (!dir)
+		return -1;
+	snprintf(path, sizeof(path), "/proc/fs/jbd2/%s/info", dir);
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (strstr(line, " transaction, "))
+			sscanf(line, "%lu", &js->commits);
+		else if (strstr(line, " fast commits, "))
+			sscanf(line, "%lu fast commits, %lu",
+			       &js->fc, &js->fc_failed);
+		else if (strstr(line, " cache flushes"))
+			sscanf(line, "%lu", &js->flushes);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *jdir = argc > 4 ? argv[4] : NULL;
+	int ops = argc > 2 ? atoi(argv[2]) : 1000;
+	int pages = argc > 3 ? atoi(argv[3]) : 2;
+	struct jstats before, after;
+	struct timeval start, end;
+	char buf[PAGE];
+	double secs;
+	int fd, i, j;
+
+	if (argc < 2 || ops <= 0 || pages <= 0 || pages > FILE_PAGES) {
+		fprintf(stderr, "usage: %s <file> [ops [pages-per-op "
+			"[jbd2-dir]]]\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+	memset(buf, 0x5a, sizeof(buf));
+	for (i = 0; i < FILE_PAGES; i++)
+		if (pwrite(fd, buf, PAGE, (off_t)i * PAGE) != PAGE) {
+			perror("pwrite");
+			return 1;
+		}
+	if (fsync(fd)) {
+		perror("fsync");
+		return 1;
+	}
+	/* Let the allocating transaction commit before we start timing. */
+	sync();
+	sleep(6);
+
+	read_jstats(jdir, &before);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < ops; i++) {
+		for (j = 0; j < pages; j++) {
+			off_t off = (off_t)((i * pages + j) % FILE_PAGES) * PAGE;
+
+			buf[0] = i;
+			if (pwrite(fd, buf, PAGE, off) != PAGE) {
+				perror("pwrite");
+				return 1;
+			}
+		}
+		if (fsync(fd)) {
+			perror("fsync");
+			return 1;
+		}
+	}
+	gettimeofday(&end, NULL);
+	close(fd);
+
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1e6;
+	printf("%d fsyncs of %d pages in %.2fs: %.1f ops/s\n",
+	       ops, pages, secs, ops / secs);
+	if (read_jstats(jdir, &after))
+		return 0;
+	printf("commits %lu, fast commits %lu, fallbacks %lu, flushes %lu\n",
+	       after.commits - before.commits, after.fc - before.fc,
+	       after.fc_failed - before.fc_failed,
+	       after.flushes - before.flushes);
+	printf("%.2f flushes per fsync\n",
+	       (double)(after.flushes - before.flushes) / ops);
+	return 0;
+}
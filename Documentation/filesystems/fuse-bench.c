@@ -0,0 +1,131 @@
+/*
+ * fuse-bench: compare file throughput through a FUSE passthrough mount
+ * (e.g. the sdcard daemon's /mnt/sdcard) with the directory backing it
+ * (e.g. /data/media).  For each directory it times a sequential write
+ * in large chunks, a sequential read of the same file after dropping
+ * the page cache, and a stream of small appends, and reports MB/s.
+ *
+ * Usage: fuse-bench <dir> [<dir>...] [-s size-MB] [-c chunk-KB] [-a append-B]
+ *
+ * Dropping caches needs root; without it the read figure includes
+ * page cache hits.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+
+	sync();
+	if (fd < 0)
+		return;
+	if (write(fd, "3", 1) != 1)
+		perror("drop_caches");
+	close(fd);
+}
+
+static int bench_dir(const char *dir, size_t size, size_t chunk,
+		     size_t append)
+{
+	char path[4096];
+	size_t done;
+	double t, seq_w, seq_r, small_w;
+	char *buf;
+	int fd;
+
+	buf = malloc(chunk);
+	if (!buf)
+		return -1;
+	memset(buf, 0xa5, chunk);
+	snprintf(path, sizeof(path), "%s/fuse-bench.tmp", dir);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto err;
+	t = now();
+	for (done = 0; done < size; done += chunk)
+		if (write(fd, buf, chunk) != (ssize_t)chunk)
+			goto err_close;
+	if (fsync(fd))
+		goto err_close;
+	seq_w = size / (now() - t);
+	close(fd);
+
+	drop_caches();
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		goto err;
+	t = now();
+	for (done = 0; done < size; done += chunk)
+		if (read(fd, buf, chunk) != (ssize_t)chunk)
+			goto err_close;
+	seq_r = size / (now() - t);
+	close(fd);
+
+	/* Small appends are where the writeback cache matters most */
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		goto err;
+	t = now();
+	for (done = 0; done < size / 16; done += append)
+		if (write(fd, buf, append) != (ssize_t)append)
+			goto err_close;
+	if (fsync(fd))
+		goto err_close;
+	small_w = (size / 16) / (now() - t);
+	close(fd);
+
+	unlink(path);
+	free(buf);
+	printf("%-24s seq write %8.2f  seq read %8.2f  %zuB appends %8.2f MB/s\n",
+	       dir, seq_w / 1e6, seq_r / 1e6, append, small_w / 1e6);
+	return 0;
+
+err_close:
+	close(fd);
+err:
+	perror(path);
+	free(buf);
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size = 64 << 20, chunk = 1 << 20, append = 512;
+	int i, ret = 0, ndirs = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			size = (size_t)atoi(argv[++i]) << 20;
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+			chunk = (size_t)atoi(argv[++i]) << 10;
+		else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+			append = atoi(argv[++i]);
+		else
+			argv[++ndirs] = argv[i];
+	}
+	if (!ndirs || !size || !chunk || !append || size % chunk) {
+		fprintf(stderr, "usage: %s <dir> [<dir>...] [-s size-MB] "
+			"[-c chunk-KB] [-a append-B]\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 1; i <= ndirs; i++)
+		if (bench_dir(argv[i], size, chunk, append))
+			ret = 1;
+	return ret;
+}
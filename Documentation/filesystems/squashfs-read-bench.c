@@ -0,0 +1,157 @@
+/*
+ * squashfs-read-bench: cold-cache read benchmark for a system partition,
+ * to compare a squashfs /system against the same tree on ext4.
+ *
+ * All regular files under <dir> are read with <jobs> processes after
+ * dropping the page cache, either sequentially with read() ("boot" mode:
+ * every file, front to back, the way init and zygote preload touch
+ * /system) or by faulting in a random quarter of the pages of an mmap()
+ * ("launch" mode: what dlopen and dex/apk loading do at app start).
+ * With several jobs, reads on different CPUs compete for decompression.
+ *
+ * Usage: squashfs-read-bench <dir> [boot|launch [jobs]]
+ *
+ * Dropping caches needs root.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PAGE		4096
+#define MAX_FILES	65536
+
+static char *files[MAX_FILES];
+static int nr_files;
+
+static int add_file(const char *path, const struct stat *st, int type,
+		    struct FTW *ftw)
+{
+	if (type == FTW_F && S_ISREG(st->st_mode) && st->st_size &&
+	    nr_files < MAX_FILES)
+		files[nr_files++] = strdup(path);
+	return 0;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+
+	sync();
+	if (fd < 0) {
+		perror("drop_caches");
+		return;
+	}
+	if (write(fd, "3", 1) != 1)
+		perror("drop_caches");
+	close(fd);
+}
+
+static unsigned long long read_file(const char *path)
+{
+	static char buf[128 * 1024];
+	unsigned long long total = 0;
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		total += n;
+	close(fd);
+	return total;
+}
+
+static unsigned long long fault_file(const char *path, unsigned int *seed)
+{
+	unsigned long long total = 0;
+	volatile char *map;
+	struct stat st;
+	size_t pages, i;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) == 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			pages = (st.st_size + PAGE - 1) / PAGE;
+			for (i = 0; i < (pages + 3) / 4; i++) {
+				(void)map[(rand_r(seed) % pages) * PAGE];
+				total += PAGE;
+			}
+			munmap((void *)map, st.st_size);
+		}
+	}
+	close(fd);
+	return total;
+}
+
+int main(int argc, char *argv[])
+{
+	int launch = argc > 2 && !strcmp(argv[2], "launch");
+	int jobs = argc > 3 ? atoi(argv[3]) : 1;
+	unsigned long long total = 0;
+	int pipefd[2], i, j;
+	double t;
+
+	if (argc < 2 || jobs <= 0 ||
+	    (argc > 2 && strcmp(argv[2], "boot") && !launch)) {
+		fprintf(stderr, "usage: %s <dir> [boot|launch [jobs]]\n",
+			argv[0]);
+		return 1;
+	}
+	if (nftw(argv[1], add_file, 64, FTW_PHYS)) {
+		perror(argv[1]);
+		return 1;
+	}
+	if (pipe(pipefd)) {
+		perror("pipe");
+		return 1;
+	}
+
+	drop_caches();
+	t = now();
+	for (j = 0; j < jobs; j++) {
+		if (fork() == 0) {
+			unsigned long long bytes = 0;
+			unsigned int seed = j + 1;
+
+			for (i = j; i < nr_files; i += jobs)
+				bytes += launch ? fault_file(files[i], &seed) :
+					read_file(files[i]);
+			if (write(pipefd[1], &bytes, sizeof(bytes)) < 0)
+				_exit(1);
+			_exit(0);
+		}
+	}
+	for (j = 0; j < jobs; j++) {
+		unsigned long long bytes;
+
+		wait(NULL);
+		if (read(pipefd[0], &bytes, sizeof(bytes)) == sizeof(bytes))
+			total += bytes;
+	}
+	t = now() - t;
+
+	printf("%s: %d files, %s, %d jobs: %.2fs, %.1f MB/s\n", argv[1],
+	       nr_files, launch ? "launch" : "boot", jobs, t, total / t / 1e6);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * vfat-lookup-bench: time lookups against directory size on a vfat mount,
+ * the pattern of a media scan over a large camera folder.
+ *
+ * For each directory size it fills <dir>/bench-N with files named like
+ * camera pictures (IMG_20100101_000123.jpg), drops the dentry and inode
+ * caches, and then times stat() of every file in random order and of as
+ * many names that do not exist.  Dropping caches needs root; without it
+ * the figures are dcache hits.
+ *
+ * Usage: vfat-lookup-bench <dir> [files...]
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+
+	sync();
+	if (fd < 0)
+		return;
+	if (write(fd, "2", 1) != 1)
+		perror("drop_caches");
+	close(fd);
+}
+
+static double time_stats(const char *dir, int *order, int n, int missing)
+{
+	char path[4096];
+	struct stat st;
+	double t = now();
+	int i, found;
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/%s_20100101_%06d.jpg", dir,
+			 missing ? "MISSING" : "IMG", order[i]);
+		found = !stat(path, &st);
+		if (found == missing)
+			fprintf(stderr, "unexpected result for %s\n", path);
+	}
+	return (now() - t) * 1e6 / n;
+}
+
+static int bench(const char *base, int n)
+{
+	char dir[2048], path[4096];
+	double hit, miss;
+	int *order;
+	int i, fd;
+
+	snprintf(dir, sizeof(dir), "%s/bench-%d", base, n);
+	if (mkdir(dir, 0755) && access(dir, F_OK)) {
+		perror(dir);
+		return -1;
+	}
+	order = malloc(n * sizeof(*order));
+	if (!order)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/IMG_20100101_%06d.jpg", dir, i);
+		fd = open(path, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) {
+			perror(path);
+			free(order);
+			return -1;
+		}
+		close(fd);
+		order[i] = i;
+	}
+	for (i = n - 1; i > 0; i--) {
+		int j = rand() % (i + 1), tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	drop_caches();
+	hit = time_stats(dir, order, n, 0);
+	drop_caches();
+	miss = time_stats(dir, order, n, 1);
+	printf("%6d files: %8.1f us/lookup existing, %8.1f us/lookup missing\n",
+	       n, hit, miss);
+
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "%s/IMG_20100101_%06d.jpg", dir, i);
+		unlink(path);
+	}
+	rmdir(dir);
+	free(order);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 100, 500, 1000, 2000, 5000, 10000 };
+	int i, ret = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <dir> [files...]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	if (argc > 2) {
+		for (i = 2; i < argc; i++)
+			if (bench(argv[1], atoi(argv[i])))
+				ret = 1;
+	} else {
+		for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+			if (bench(argv[1], sizes[i]))
+				ret = 1;
+	}
+	return ret;
+}
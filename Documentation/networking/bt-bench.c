@@ -0,0 +1,309 @@
+/*
+ * bt-bench: L2CAP and RFCOMM bulk throughput between two Bluetooth
+ * adapters, real ones or virtual controllers on /dev/vhci.
+ *
+ * Usage: bt-bench sink [-p l2cap|rfcomm] [-e] [-t secs]
+ *        bt-bench send [-p l2cap|rfcomm] [-e] [-s size] [-t secs] BDADDR
+ *
+ * sink: listens on PSM 0x1001 or RFCOMM channel 1 of every adapter,
+ *       accepts one connection and counts what it receives, from the
+ *       first byte and for <secs> seconds (default 5).
+ * send: connects to the sink on BDADDR and writes <size> byte buffers
+ *       (default 4096) for <secs> seconds; on L2CAP each is one SDU.
+ *
+ * -e asks for an L2CAP channel in enhanced retransmission mode, on both
+ * ends; it needs the enable_ertm parameter of the l2cap module.  Both
+ * sides print what they moved, in bytes and kbit/s.
+ *
+ * See Documentation/networking/bluetooth-tx.txt.
+ */
+#include <endian.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/types.h>
+
+#ifndef AF_BLUETOOTH
+#define AF_BLUETOOTH	31
+#endif
+
+#define BTPROTO_L2CAP	0
+#define BTPROTO_RFCOMM	3
+#define SOL_L2CAP	6
+#define L2CAP_OPTIONS	0x01
+#define L2CAP_MODE_ERTM	0x03
+
+#define BENCH_PSM	0x1001
+#define BENCH_CHANNEL	1
+#define MAX_SIZE	65536
+
+typedef struct {
+	__u8	b[6];
+} __attribute__((packed)) bdaddr_t;
+
+struct sockaddr_l2 {
+	sa_family_t	l2_family;
+	__le16		l2_psm;
+	bdaddr_t	l2_bdaddr;
+	__le16		l2_cid;
+};
+
+struct sockaddr_rc {
+	sa_family_t	rc_family;
+	bdaddr_t	rc_bdaddr;
+	__u8		rc_channel;
+};
+
+struct l2cap_options {
+	__u16	omtu;
+	__u16	imtu;
+	__u16	flush_to;
+	__u8	mode;
+	__u8	fcs;
+	__u8	max_tx;
+	__u16	txwin_size;
+};
+
+static volatile sig_atomic_t done;
+
+static void alarm_handler(int sig)
+{
+	done = 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+/* Stop after secs; let the signal interrupt blocking calls. */
+static void set_alarm(int secs)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = alarm_handler;
+	sigaction(SIGALRM, &sa, NULL);
+	alarm(secs);
+}
+
+/* "00:11:22:33:44:55", most significant byte first, as hciconfig shows */
+static int str2ba(const char *str, bdaddr_t *ba)
+{
+	unsigned int b[6];
+	int i;
+
+	if (sscanf(str, "%2x:%2x:%2x:%2x:%2x:%2x",
+		   &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6)
+		return -1;
+	for (i = 0; i < 6; i++)
+		ba->b[5 - i] = b[i];
+	return 0;
+}
+
+/* Address of the local or remote adapter; zero means any. */
+static socklen_t bt_addr(struct sockaddr_storage *ss, int rfcomm,
+			 const bdaddr_t *ba)
+{
+	memset(ss, 0, sizeof(*ss));
+	if (rfcomm) {
+		struct sockaddr_rc *rc = (struct sockaddr_rc *)ss;
+
+		rc->rc_family = AF_BLUETOOTH;
+		rc->rc_bdaddr = *ba;
+		rc->rc_channel = BENCH_CHANNEL;
+		return sizeof(*rc);
+	} else {
+		struct sockaddr_l2 *l2 = (struct sockaddr_l2 *)ss;
+
+		l2->l2_family = AF_BLUETOOTH;
+		l2->l2_bdaddr = *ba;
+		l2->l2_psm = htole16(BENCH_PSM);
+		return sizeof(*l2);
+	}
+}
+
+static int bt_socket(int rfcomm, int ertm)
+{
+	struct l2cap_options opts;
+	socklen_t len = sizeof(opts);
+	int fd;
+
+	if (rfcomm)
+		return socket(AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+
+	fd = socket(AF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
+	if (fd < 0)
+		return fd;
+	if (getsockopt(fd, SOL_L2CAP, L2CAP_OPTIONS, &opts, &len))
+		die("L2CAP_OPTIONS");
+	/* Room for the largest SDU the sender writes */
+	opts.imtu = opts.omtu = MAX_SIZE - 1;
+	if (ertm)
+		opts.mode = L2CAP_MODE_ERTM;
+	if (setsockopt(fd, SOL_L2CAP, L2CAP_OPTIONS, &opts, len))
+		die(ertm ? "L2CAP_OPTIONS (is enable_ertm set?)" :
+		    "L2CAP_OPTIONS");
+	return fd;
+}
+
+static void report(const char *what, unsigned long long bytes,
+		   double elapsed)
+{
+	printf("%s %llu bytes in %.2f s, %.0f kbit/s\n",
+	       what, bytes, elapsed, bytes * 8 / elapsed / 1000);
+}
+
+static int sink(int rfcomm, int ertm, int secs)
+{
+	static char buf[MAX_SIZE];
+	unsigned long long received = 0;
+	struct sockaddr_storage ss;
+	bdaddr_t any;
+	double start, elapsed;
+	socklen_t len;
+	int lfd, fd;
+	ssize_t n;
+
+	memset(&any, 0, sizeof(any));
+	len = bt_addr(&ss, rfcomm, &any);
+	lfd = bt_socket(rfcomm, ertm);
+	if (lfd < 0)
+		die("socket");
+	if (bind(lfd, (struct sockaddr *)&ss, len) || listen(lfd, 1))
+		die("bind");
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0)
+		die("accept");
+	close(lfd);
+
+	n = recv(fd, buf, sizeof(buf), 0);
+	if (n <= 0)
+		die("recv");
+	set_alarm(secs);
+	start = now();
+	while (!done) {
+		n = recv(fd, buf, sizeof(buf), 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			die("recv");
+		}
+		if (n == 0)
+			break;
+		received += n;
+	}
+	elapsed = now() - start;
+	report("received", received, elapsed);
+	return 0;
+}
+
+static int send_bulk(int rfcomm, int ertm, int size, int secs,
+		     const bdaddr_t *dst)
+{
+	unsigned long long sent = 0;
+	struct sockaddr_storage ss;
+	double start, elapsed;
+	socklen_t len;
+	char *buf;
+	ssize_t n;
+	int fd;
+
+	len = bt_addr(&ss, rfcomm, dst);
+	fd = bt_socket(rfcomm, ertm);
+	if (fd < 0)
+		die("socket");
+	if (connect(fd, (struct sockaddr *)&ss, len))
+		die("connect");
+	buf = calloc(1, size);
+	if (!buf)
+		return 1;
+
+	set_alarm(secs);
+	start = now();
+	while (!done) {
+		n = send(fd, buf, size, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			die("send");
+		}
+		sent += n;
+	}
+	elapsed = now() - start;
+	report("sent", sent, elapsed);
+	close(fd);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: bt-bench sink [-p l2cap|rfcomm] [-e] [-t secs]\n"
+		"       bt-bench send [-p l2cap|rfcomm] [-e] [-s size] [-t secs] BDADDR\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int rfcomm = 0, ertm = 0, size = 4096, secs = 5, opt;
+	const char *mode;
+	bdaddr_t dst;
+
+	if (argc < 2)
+		usage();
+	mode = argv[1];
+	argv++;
+	argc--;
+
+	while ((opt = getopt(argc, argv, "ep:s:t:")) != -1) {
+		switch (opt) {
+		case 'e':
+			ertm = 1;
+			break;
+		case 'p':
+			if (!strcmp(optarg, "rfcomm"))
+				rfcomm = 1;
+			else if (strcmp(optarg, "l2cap"))
+				usage();
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (secs < 1 || size < 1 || size >= MAX_SIZE || (rfcomm && ertm))
+		usage();
+
+	if (!strcmp(mode, "sink")) {
+		if (optind != argc)
+			usage();
+		return sink(rfcomm, ertm, secs);
+	}
+	if (!strcmp(mode, "send")) {
+		if (optind + 1 != argc || str2ba(argv[optind], &dst))
+			usage();
+		return send_bulk(rfcomm, ertm, size, secs, &dst);
+	}
+	usage();
+	return 1;
+}
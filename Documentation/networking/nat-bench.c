@@ -0,0 +1,298 @@
+/*
+ * nat-bench: connection tracking memory per flow and NAT forwarding rate,
+ * measured through a router namespace over veth pairs.
+ *
+ * Usage: nat-bench flows [-n flows] [-p first_port] ADDR PORT
+ *        nat-bench send [-f flows] [-s size] [-t secs] ADDR PORT
+ *        nat-bench sink [-t secs] PORT
+ *
+ * flows: sends one UDP datagram to ADDR:PORT from each of <flows> source
+ *        ports (default 10000, starting at 20000), so that every one is a
+ *        new connection, then shows what slab memory grew by: the
+ *        nf_conntrack caches, and all of the slab, which includes the
+ *        extensions.
+ * send:  sends <size> byte datagrams (default 64) round robin from
+ *        <flows> sockets (default 1) for <secs> seconds (default 5).
+ * sink:  counts the datagrams received on PORT, from the first one and
+ *        for <secs> seconds (default 5).
+ *
+ * See Documentation/networking/nf_conntrack-compact.txt for the setup.
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_FLOWS	40000
+#define MAX_SIZE	1472
+
+struct slab_use {
+	long	conntracks;	/* objects in the nf_conntrack caches */
+	long	conntrack_kb;	/* and their size */
+	long	slab_kb;	/* Slab: of /proc/meminfo */
+};
+
+static volatile sig_atomic_t done;
+
+static void alarm_handler(int sig)
+{
+	done = 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+/* Stop after secs; let the signal interrupt blocking calls. */
+static void set_alarm(int secs)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = alarm_handler;
+	sigaction(SIGALRM, &sa, NULL);
+	alarm(secs);
+}
+
+static void slab_use(struct slab_use *u)
+{
+	char line[512], name[128];
+	long active, objsize;
+	FILE *f;
+
+	memset(u, 0, sizeof(*u));
+	f = fopen("/proc/slabinfo", "r");
+	if (!f)
+		die("/proc/slabinfo");
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%127s %ld %*d %ld", name, &active,
+			   &objsize) != 3)
+			continue;
+		/* one cache per namespace, nf_conntrack_<address> */
+		if (strncmp(name, "nf_conntrack_", 13) ||
+		    !strncmp(name, "nf_conntrack_expect", 19))
+			continue;
+		u->conntracks += active;
+		u->conntrack_kb += active * objsize / 1024;
+	}
+	fclose(f);
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		die("/proc/meminfo");
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "Slab: %ld kB", &u->slab_kb) == 1)
+			break;
+	fclose(f);
+}
+
+static int udp_socket(int port)
+{
+	struct sockaddr_in sin;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		die("socket");
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int flows(struct sockaddr_in *dst, int n, int first_port)
+{
+	struct slab_use before, after;
+	double start, elapsed;
+	long conntracks;
+	int i, fd, sent = 0;
+	char c = 0;
+
+	slab_use(&before);
+	start = now();
+	for (i = 0; i < n; i++) {
+		fd = udp_socket(first_port + i);
+		if (fd < 0)
+			continue;
+		if (sendto(fd, &c, 1, 0, (struct sockaddr *)dst,
+			   sizeof(*dst)) == 1)
+			sent++;
+		close(fd);
+	}
+	elapsed = now() - start;
+	/* Let the sockets and the datagrams be freed */
+	sleep(2);
+	slab_use(&after);
+
+	conntracks = after.conntracks - before.conntracks;
+	printf("%d flows in %.2f s, %.0f flows/s\n",
+	       sent, elapsed, sent / elapsed);
+	printf("nf_conntrack caches: +%ld entries, +%ld kB\n",
+	       conntracks, after.conntrack_kb - before.conntrack_kb);
+	if (conntracks > 0)
+		printf("slab: +%ld kB, %.0f kB per 10k entries\n",
+		       after.slab_kb - before.slab_kb,
+		       (after.slab_kb - before.slab_kb) * 10000.0 /
+		       conntracks);
+	return 0;
+}
+
+static int send_flows(struct sockaddr_in *dst, int n, int size, int secs)
+{
+	unsigned long long sent = 0;
+	double start, elapsed;
+	char buf[MAX_SIZE];
+	int fd[64], i;
+
+	for (i = 0; i < n; i++) {
+		fd[i] = udp_socket(0);
+		if (fd[i] < 0)
+			die("bind");
+		if (connect(fd[i], (struct sockaddr *)dst, sizeof(*dst)))
+			die("connect");
+	}
+	memset(buf, 0, size);
+
+	set_alarm(secs);
+	start = now();
+	for (i = 0; !done; i = (i + 1) % n) {
+		if (send(fd[i], buf, size, 0) < 0) {
+			if (errno == EINTR || errno == ENOBUFS ||
+			    errno == EAGAIN || errno == ECONNREFUSED)
+				continue;
+			die("send");
+		}
+		sent++;
+	}
+	elapsed = now() - start;
+	printf("sent %llu datagrams of %d bytes on %d flows, %.0f pps\n",
+	       sent, size, n, sent / elapsed);
+	return 0;
+}
+
+static int sink(int port, int secs)
+{
+	unsigned long long received = 0;
+	double start, elapsed;
+	char buf[MAX_SIZE];
+	int fd, opt = 1 << 20;
+
+	fd = udp_socket(port);
+	if (fd < 0)
+		die("bind");
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt));
+
+	if (recv(fd, buf, sizeof(buf), 0) < 0)
+		die("recv");
+	set_alarm(secs);
+	start = now();
+	while (!done) {
+		if (recv(fd, buf, sizeof(buf), 0) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("recv");
+		}
+		received++;
+	}
+	elapsed = now() - start;
+	printf("received %llu datagrams, %.0f pps\n",
+	       received, received / elapsed);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: nat-bench flows [-n flows] [-p first_port] ADDR PORT\n"
+		"       nat-bench send [-f flows] [-s size] [-t secs] ADDR PORT\n"
+		"       nat-bench sink [-t secs] PORT\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int n = 0, first_port = 20000, size = 64, secs = 5, opt;
+	struct sockaddr_in dst;
+	const char *mode;
+
+	if (argc < 2)
+		usage();
+	mode = argv[1];
+	argv++;
+	argc--;
+
+	while ((opt = getopt(argc, argv, "f:n:p:s:t:")) != -1) {
+		switch (opt) {
+		case 'f':
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'p':
+			first_port = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (secs < 1 || size < 1 || size > MAX_SIZE)
+		usage();
+
+	if (!strcmp(mode, "sink")) {
+		if (optind + 1 != argc)
+			usage();
+		return sink(atoi(argv[optind]), secs);
+	}
+
+	if (optind + 2 != argc)
+		usage();
+	memset(&dst, 0, sizeof(dst));
+	dst.sin_family = AF_INET;
+	dst.sin_port = htons(atoi(argv[optind + 1]));
+	if (inet_pton(AF_INET, argv[optind], &dst.sin_addr) != 1)
+		usage();
+
+	if (!strcmp(mode, "flows")) {
+		if (!n)
+			n = 10000;
+		if (n < 1 || n > MAX_FLOWS || first_port < 1 ||
+		    first_port + n > 65536)
+			usage();
+		return flows(&dst, n, first_port);
+	}
+	if (!strcmp(mode, "send")) {
+		if (!n)
+			n = 1;
+		if (n < 1 || n > 64)
+			usage();
+		return send_flows(&dst, n, size, secs);
+	}
+	usage();
+	return 1;
+}
@@ -0,0 +1,282 @@
+/*
+ * pace-qdisc: set up the "pace" qdisc and show its statistics, for
+ * versions of tc that don't know it.
+ *
+ * Usage: pace-qdisc add|change|replace DEV [parent ID] [handle ID]
+ *                   [limit PKTS] [flow_limit PKTS] [quantum BYTES]
+ *                   [initial_quantum BYTES] [maxrate BYTES_PER_SEC]
+ *                   [buckets_log N]
+ *        pace-qdisc show DEV
+ *
+ * IDs are given as in tc, e.g. "1:" or "1:1"; the default parent is
+ * the root.  "show" prints the options and counters of every pace qdisc
+ * on DEV; tc -s shows the packet and drop counts as for any qdisc.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/types.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/gen_stats.h>
+
+#ifndef TCA_PACE_MAX
+enum {
+	TCA_PACE_UNSPEC,
+	TCA_PACE_PLIMIT,
+	TCA_PACE_FLOW_PLIMIT,
+	TCA_PACE_QUANTUM,
+	TCA_PACE_INITIAL_QUANTUM,
+	TCA_PACE_FLOW_MAX_RATE,
+	TCA_PACE_BUCKETS_LOG,
+	__TCA_PACE_MAX
+};
+#define TCA_PACE_MAX	(__TCA_PACE_MAX - 1)
+
+struct tc_pace_qd_stats {
+	__u64	gc_flows;
+	__u64	highprio_packets;
+	__u64	throttled;
+	__u64	flows_plimit;
+	__u64	allocation_errors;
+	__u32	flows;
+	__u32	inactive_flows;
+	__u32	throttled_flows;
+	__u32	pad;
+};
+#endif
+
+static const char *const opt_names[TCA_PACE_MAX + 1] = {
+	[TCA_PACE_PLIMIT]		= "limit",
+	[TCA_PACE_FLOW_PLIMIT]		= "flow_limit",
+	[TCA_PACE_QUANTUM]		= "quantum",
+	[TCA_PACE_INITIAL_QUANTUM]	= "initial_quantum",
+	[TCA_PACE_FLOW_MAX_RATE]	= "maxrate",
+	[TCA_PACE_BUCKETS_LOG]		= "buckets_log",
+};
+
+struct req {
+	struct nlmsghdr	n;
+	struct tcmsg	t;
+	char		buf[512];
+};
+
+static struct rtattr *add_attr(struct nlmsghdr *n, int type,
+			       const void *data, int len)
+{
+	struct rtattr *rta = (struct rtattr *)((char *)n +
+					       NLMSG_ALIGN(n->nlmsg_len));
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+	return rta;
+}
+
+static int parse_handle(const char *s, __u32 *h)
+{
+	unsigned long maj, min = 0;
+	char *end;
+
+	maj = strtoul(s, &end, 16);
+	if (*end != ':')
+		return -1;
+	if (end[1]) {
+		min = strtoul(end + 1, &end, 16);
+		if (*end)
+			return -1;
+	}
+	if (maj > 0xffff || min > 0xffff)
+		return -1;
+	*h = (maj << 16) | min;
+	return 0;
+}
+
+static int talk(int fd, struct nlmsghdr *n, void (*cb)(struct nlmsghdr *))
+{
+	struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+	static char buf[16384];
+	struct nlmsghdr *h;
+	int len;
+
+	n->nlmsg_flags |= NLM_F_ACK;
+	if (sendto(fd, n, n->nlmsg_len, 0, (struct sockaddr *)&sa,
+		   sizeof(sa)) < 0) {
+		perror("sendto");
+		return -1;
+	}
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			perror("recv");
+			return -1;
+		}
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+		     h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_type == NLMSG_DONE)
+				return 0;
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = NLMSG_DATA(h);
+
+				if (e->error) {
+					errno = -e->error;
+					perror("pace-qdisc");
+					return -1;
+				}
+				return 0;
+			}
+			if (cb)
+				cb(h);
+		}
+	}
+}
+
+static void show_qdisc(struct nlmsghdr *h)
+{
+	struct tcmsg *t = NLMSG_DATA(h);
+	int len = h->nlmsg_len - NLMSG_LENGTH(sizeof(*t));
+	struct rtattr *tb[TCA_MAX + 1] = { NULL };
+	struct rtattr *rta;
+	int i;
+
+	if (h->nlmsg_type != RTM_NEWQDISC)
+		return;
+	for (rta = TCA_RTA(t); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+		if (rta->rta_type <= TCA_MAX)
+			tb[rta->rta_type] = rta;
+	if (!tb[TCA_KIND] || strcmp(RTA_DATA(tb[TCA_KIND]), "pace"))
+		return;
+
+	printf("qdisc pace %x: parent ", t->tcm_handle >> 16);
+	if (t->tcm_parent == TC_H_ROOT)
+		printf("root");
+	else
+		printf("%x:%x", t->tcm_parent >> 16, t->tcm_parent & 0xffff);
+
+	if (tb[TCA_OPTIONS]) {
+		struct rtattr *opt = tb[TCA_OPTIONS];
+
+		len = RTA_PAYLOAD(opt);
+		for (rta = RTA_DATA(opt); RTA_OK(rta, len);
+		     rta = RTA_NEXT(rta, len)) {
+			i = rta->rta_type;
+			if (i > 0 && i <= TCA_PACE_MAX &&
+			    RTA_PAYLOAD(rta) >= sizeof(__u32))
+				printf(" %s %u", opt_names[i],
+				       *(__u32 *)RTA_DATA(rta));
+		}
+	}
+	printf("\n");
+
+	if (tb[TCA_STATS2]) {
+		struct rtattr *st = tb[TCA_STATS2];
+
+		len = RTA_PAYLOAD(st);
+		for (rta = RTA_DATA(st); RTA_OK(rta, len);
+		     rta = RTA_NEXT(rta, len)) {
+			struct tc_pace_qd_stats s;
+
+			if (rta->rta_type != TCA_STATS_APP ||
+			    RTA_PAYLOAD(rta) < sizeof(s))
+				continue;
+			memcpy(&s, RTA_DATA(rta), sizeof(s));
+			printf("  %u flows (%u inactive, %u throttled)\n"
+			       "  %llu gc, %llu highprio, %llu throttled,"
+			       " %llu flows_plimit, %llu alloc_errors\n",
+			       s.flows, s.inactive_flows, s.throttled_flows,
+			       (unsigned long long)s.gc_flows,
+			       (unsigned long long)s.highprio_packets,
+			       (unsigned long long)s.throttled,
+			       (unsigned long long)s.flows_plimit,
+			       (unsigned long long)s.allocation_errors);
+		}
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: pace-qdisc add|change|replace DEV [parent ID] [handle ID]\n"
+		"                  [limit PKTS] [flow_limit PKTS] [quantum BYTES]\n"
+		"                  [initial_quantum BYTES] [maxrate BYTES_PER_SEC]\n"
+		"                  [buckets_log N]\n"
+		"       pace-qdisc show DEV\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct req req;
+	struct rtattr *opts;
+	int fd, ifindex, i, j;
+	__u32 val;
+
+	if (argc < 3)
+		usage();
+	ifindex = if_nametoindex(argv[2]);
+	if (!ifindex) {
+		fprintf(stderr, "%s: no such device\n", argv[2]);
+		return 1;
+	}
+
+	fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if (fd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.n.nlmsg_flags = NLM_F_REQUEST;
+	req.t.tcm_family = AF_UNSPEC;
+	req.t.tcm_ifindex = ifindex;
+
+	if (!strcmp(argv[1], "show")) {
+		req.n.nlmsg_type = RTM_GETQDISC;
+		req.n.nlmsg_flags |= NLM_F_DUMP;
+		return talk(fd, &req.n, show_qdisc) ? 1 : 0;
+	}
+
+	req.n.nlmsg_type = RTM_NEWQDISC;
+	if (!strcmp(argv[1], "add"))
+		req.n.nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+	else if (!strcmp(argv[1], "replace"))
+		req.n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+	else if (strcmp(argv[1], "change"))
+		usage();
+	req.t.tcm_parent = TC_H_ROOT;
+	add_attr(&req.n, TCA_KIND, "pace", 5);
+	opts = add_attr(&req.n, TCA_OPTIONS, NULL, 0);
+
+	for (i = 3; i < argc; i += 2) {
+		if (i + 1 >= argc)
+			usage();
+		if (!strcmp(argv[i], "parent")) {
+			if (parse_handle(argv[i + 1], &req.t.tcm_parent))
+				usage();
+			continue;
+		}
+		if (!strcmp(argv[i], "handle")) {
+			if (parse_handle(argv[i + 1], &req.t.tcm_handle))
+				usage();
+			continue;
+		}
+		for (j = 1; j <= TCA_PACE_MAX; j++)
+			if (!strcmp(argv[i], opt_names[j]))
+				break;
+		if (j > TCA_PACE_MAX)
+			usage();
+		val = strtoul(argv[i + 1], NULL, 0);
+		add_attr(&req.n, j, &val, sizeof(val));
+	}
+	opts->rta_len = (char *)&req.n + req.n.nlmsg_len - (char *)opts;
+
+	return talk(fd, &req.n, NULL) ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * ppp-vpn-bench: PPP over L2TP (PPPoLAC) or PPTP (PPPoPNS) throughput over
+ * loopback, without pppd or a VPN server.
+ *
+ * Two sessions are connected back to back over 127.0.0.1, each attached to
+ * a new ppp unit.  UDP datagrams sent out of the first unit are carried
+ * over the tunnel and received by the second; the receive counters of the
+ * second unit give the rate.  The datagrams are addressed to the peer of
+ * the first unit, which is not a local address, so the second unit drops
+ * them after counting: what is measured is the PPP and tunnel path, in
+ * both directions of the encapsulation.
+ *
+ * Usage: ppp-vpn-bench [-p l2tp|pptp] [-s size] [-t secs]
+ *
+ *   -p  tunnel protocol (default l2tp)
+ *   -s  UDP payload bytes per datagram (default 1372, the largest that
+ *       fits the MTU of the units)
+ *   -t  seconds to run (default 5)
+ *
+ * Needs root, /dev/ppp and CONFIG_PPPOLAC or CONFIG_PPPOPNS.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/types.h>
+#include <linux/ppp_defs.h>
+#include <linux/if_ppp.h>
+
+#ifndef AF_PPPOX
+#define AF_PPPOX	24
+#endif
+
+#define PX_PROTO_OLAC	2
+#define PX_PROTO_OPNS	3
+
+struct sockaddr_pppolac {
+	sa_family_t	sa_family;
+	unsigned int	sa_protocol;
+	int		udp_socket;
+	struct __attribute__((packed)) {
+		__u16	tunnel, session;
+	} local, remote;
+} __attribute__((packed));
+
+struct sockaddr_pppopns {
+	sa_family_t	sa_family;
+	unsigned int	sa_protocol;
+	int		tcp_socket;
+	__u16		local;
+	__u16		remote;
+} __attribute__((packed));
+
+#define UNIT_MTU	1400
+
+struct unit {
+	int	pppox;		/* the PPPoLAC/PPPoPNS socket */
+	int	chan;		/* /dev/ppp attached to its channel */
+	int	fd;		/* /dev/ppp attached to the unit */
+	int	index;
+	char	name[IFNAMSIZ];
+};
+
+static volatile sig_atomic_t done;
+
+static void alarm_handler(int sig)
+{
+	done = 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+/* The PPPoX addresses are packed; connect() with an aligned copy. */
+static int pppox_connect(int fd, const void *addr, socklen_t len)
+{
+	struct sockaddr_storage ss;
+
+	memcpy(&ss, addr, len);
+	return connect(fd, (struct sockaddr *)&ss, len);
+}
+
+static void loopback(struct sockaddr_in *sin)
+{
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+/* Two UDP sockets connected to each other, carrying sessions 1/1 and 2/2. */
+static void l2tp_sessions(int *pppox)
+{
+	struct sockaddr_in sin[2];
+	socklen_t len = sizeof(sin[0]);
+	int udp[2], i;
+
+	for (i = 0; i < 2; i++) {
+		udp[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if (udp[i] < 0)
+			die("socket");
+		loopback(&sin[i]);
+		if (bind(udp[i], (struct sockaddr *)&sin[i], sizeof(sin[i])) ||
+		    getsockname(udp[i], (struct sockaddr *)&sin[i], &len))
+			die("bind");
+	}
+	for (i = 0; i < 2; i++) {
+		struct sockaddr_pppolac sa;
+
+		if (connect(udp[i], (struct sockaddr *)&sin[!i],
+			    sizeof(sin[!i])))
+			die("connect");
+		pppox[i] = socket(AF_PPPOX, SOCK_DGRAM, PX_PROTO_OLAC);
+		if (pppox[i] < 0)
+			die("PPPoLAC socket");
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_family = AF_PPPOX;
+		sa.sa_protocol = PX_PROTO_OLAC;
+		sa.udp_socket = udp[i];
+		sa.local.tunnel = sa.local.session = htons(i + 1);
+		sa.remote.tunnel = sa.remote.session = htons(2 - i);
+		if (pppox_connect(pppox[i], &sa, sizeof(sa)))
+			die("PPPoLAC connect");
+	}
+}
+
+/* Both ends of one TCP connection, carrying calls 1 and 2. */
+static void pptp_sessions(int *pppox)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int tcp[2], lfd, i;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	tcp[0] = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 || tcp[0] < 0)
+		die("socket");
+	loopback(&sin);
+	if (bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) ||
+	    getsockname(lfd, (struct sockaddr *)&sin, &len) ||
+	    listen(lfd, 1))
+		die("bind");
+	if (connect(tcp[0], (struct sockaddr *)&sin, sizeof(sin)))
+		die("connect");
+	tcp[1] = accept(lfd, NULL, NULL);
+	if (tcp[1] < 0)
+		die("accept");
+	close(lfd);
+
+	for (i = 0; i < 2; i++) {
+		struct sockaddr_pppopns sa;
+
+		pppox[i] = socket(AF_PPPOX, SOCK_DGRAM, PX_PROTO_OPNS);
+		if (pppox[i] < 0)
+			die("PPPoPNS socket");
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_family = AF_PPPOX;
+		sa.sa_protocol = PX_PROTO_OPNS;
+		sa.tcp_socket = tcp[i];
+		sa.local = htons(i + 1);
+		sa.remote = htons(2 - i);
+		if (pppox_connect(pppox[i], &sa, sizeof(sa)))
+			die("PPPoPNS connect");
+	}
+}
+
+static void set_addr(int fd, const char *name, unsigned long req,
+		     const char *addr)
+{
+	struct ifreq ifr;
+	struct sockaddr_in *sin = (struct sockaddr_in *)&ifr.ifr_addr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", name);
+	sin->sin_family = AF_INET;
+	inet_pton(AF_INET, addr, &sin->sin_addr);
+	if (ioctl(fd, req, &ifr))
+		die(name);
+}
+
+/* Attach a new ppp unit to the session and bring it up. */
+static void unit_up(struct unit *u, const char *local, const char *peer)
+{
+	struct ifreq ifr;
+	int chan, fd;
+
+	if (ioctl(u->pppox, PPPIOCGCHAN, &chan))
+		die("PPPIOCGCHAN");
+	u->chan = open("/dev/ppp", O_RDWR);
+	u->fd = open("/dev/ppp", O_RDWR);
+	if (u->chan < 0 || u->fd < 0)
+		die("/dev/ppp");
+	if (ioctl(u->chan, PPPIOCATTCHAN, &chan))
+		die("PPPIOCATTCHAN");
+	u->index = -1;
+	if (ioctl(u->fd, PPPIOCNEWUNIT, &u->index))
+		die("PPPIOCNEWUNIT");
+	if (ioctl(u->chan, PPPIOCCONNECT, &u->index))
+		die("PPPIOCCONNECT");
+	snprintf(u->name, sizeof(u->name), "ppp%d", u->index);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		die("socket");
+	set_addr(fd, u->name, SIOCSIFADDR, local);
+	set_addr(fd, u->name, SIOCSIFDSTADDR, peer);
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", u->name);
+	ifr.ifr_mtu = UNIT_MTU;
+	if (ioctl(fd, SIOCSIFMTU, &ifr))
+		die("SIOCSIFMTU");
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr))
+		die("SIOCGIFFLAGS");
+	ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr))
+		die("SIOCSIFFLAGS");
+	close(fd);
+}
+
+static void unit_stats(int fd, struct unit *u, struct ppp_stats *st)
+{
+	struct ifreq ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", u->name);
+	ifr.ifr_data = (void *)st;
+	if (ioctl(fd, SIOCGPPPSTATS, &ifr))
+		die("SIOCGPPPSTATS");
+}
+
+int main(int argc, char *argv[])
+{
+	struct ppp_stats before, after;
+	struct sockaddr_in peer;
+	struct unit unit[2];
+	const char *proto = "l2tp";
+	int size = UNIT_MTU - 28, secs = 5;
+	unsigned long long sent = 0;
+	unsigned int packets, bytes;
+	int pppox[2], fd, opt, i;
+	double start, elapsed;
+	char *buf;
+
+	while ((opt = getopt(argc, argv, "p:s:t:")) != -1) {
+		switch (opt) {
+		case 'p':
+			proto = optarg;
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (size < 1 || size > UNIT_MTU - 28 || secs < 1)
+		goto usage;
+
+	if (!strcmp(proto, "l2tp"))
+		l2tp_sessions(pppox);
+	else if (!strcmp(proto, "pptp"))
+		pptp_sessions(pppox);
+	else
+		goto usage;
+
+	memset(unit, 0, sizeof(unit));
+	for (i = 0; i < 2; i++)
+		unit[i].pppox = pppox[i];
+	unit_up(&unit[0], "10.77.0.1", "10.77.0.2");
+	unit_up(&unit[1], "10.77.1.1", "10.77.1.2");
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		die("socket");
+	memset(&peer, 0, sizeof(peer));
+	peer.sin_family = AF_INET;
+	peer.sin_port = htons(9);
+	inet_pton(AF_INET, "10.77.0.2", &peer.sin_addr);
+	if (connect(fd, (struct sockaddr *)&peer, sizeof(peer)))
+		die("connect");
+	/* Never let a forwarding receiver send them around again */
+	opt = 1;
+	setsockopt(fd, IPPROTO_IP, IP_TTL, &opt, sizeof(opt));
+	buf = calloc(1, size);
+	if (!buf)
+		return 1;
+
+	signal(SIGALRM, alarm_handler);
+	unit_stats(fd, &unit[1], &before);
+	alarm(secs);
+	start = now();
+	while (!done) {
+		if (send(fd, buf, size, 0) < 0) {
+			if (errno == EINTR || errno == ENOBUFS ||
+			    errno == EAGAIN)
+				continue;
+			die("send");
+		}
+		sent++;
+	}
+	/* Let the last datagrams through the tunnel */
+	usleep(100000);
+	elapsed = now() - start;
+	unit_stats(fd, &unit[1], &after);
+
+	packets = after.p.ppp_ipackets - before.p.ppp_ipackets;
+	bytes = after.p.ppp_ibytes - before.p.ppp_ibytes;
+	printf("%s: sent %llu datagrams of %d bytes on %s\n",
+	       proto, sent, size, unit[0].name);
+	printf("%s: received %u packets, %.0f pps, %.1f Mbit/s\n",
+	       unit[1].name, packets, packets / elapsed,
+	       bytes * 8 / elapsed / 1e6);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-p l2tp|pptp] [-s size] [-t secs]\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,213 @@
+/*
+ * rmnet-bench: receive path benchmark for an rmnet interface built with
+ * CONFIG_MSM_RMNET_LOOPBACK, where every frame sent on the interface is
+ * received on it again.
+ *
+ * A child process sends UDP datagrams through a packet socket on <if>,
+ * addressed to the interface's own address, as fast as the interface
+ * takes them; they come back through the driver's receive path and are
+ * counted on a UDP socket.  Reported are the packets and Mbit/s that
+ * reached the socket, the packets the interface received, and the CPU
+ * time all CPUs spent per Mbit (sender included).
+ *
+ * Usage: rmnet-bench <if> [seconds [payload-bytes [source-ip]]]
+ *
+ * The source address defaults to the interface address with the lowest
+ * bit flipped; with rp_filter on it has to be routed via <if>.  Needs
+ * root for the packet socket.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PORT		5001
+
+static unsigned long long cpu_busy(void)
+{
+	unsigned long long v[8] = { 0 };
+	FILE *f = fopen("/proc/stat", "r");
+
+	if (!f)
+		return 0;
+	if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0],
+		   &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) != 8)
+		v[0] = v[1] = v[2] = v[5] = v[6] = v[7] = 0;
+	fclose(f);
+	/* everything but idle and iowait */
+	return v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+}
+
+static unsigned long long if_rx_packets(const char *ifname)
+{
+	char path[128];
+	unsigned long long n = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/rx_packets",
+		 ifname);
+	f = fopen(path, "r");
+	if (f) {
+		if (fscanf(f, "%llu", &n) != 1)
+			n = 0;
+		fclose(f);
+	}
+	return n;
+}
+
+static unsigned short ip_csum(const void *data, int len)
+{
+	const unsigned short *p = data;
+	unsigned long sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *p++;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void send_loop(const char *ifname, struct in_addr src,
+		      struct in_addr dst, int payload)
+{
+	struct sockaddr_ll sll;
+	struct ifreq ifr;
+	struct iphdr *iph;
+	struct udphdr *udph;
+	int len = sizeof(*iph) + sizeof(*udph) + payload;
+	char *pkt = calloc(1, len);
+	int fd;
+
+	fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+	if (fd < 0 || !pkt) {
+		perror("packet socket");
+		_exit(1);
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_IP);
+	sll.sll_ifindex = if_nametoindex(ifname);
+	/* in Ethernet mode, address the frames to ourselves */
+	if (!ioctl(fd, SIOCGIFHWADDR, &ifr) &&
+	    ifr.ifr_hwaddr.sa_family == ARPHRD_ETHER) {
+		sll.sll_halen = ETH_ALEN;
+		memcpy(sll.sll_addr, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+	}
+
+	iph = (struct iphdr *)pkt;
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->tot_len = htons(len);
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_UDP;
+	iph->saddr = src.s_addr;
+	iph->daddr = dst.s_addr;
+	udph = (struct udphdr *)(iph + 1);
+	udph->source = htons(PORT);
+	udph->dest = htons(PORT);
+	udph->len = htons(sizeof(*udph) + payload);
+
+	for (;;) {
+		iph->id++;
+		iph->check = 0;
+		iph->check = ip_csum(iph, sizeof(*iph));
+		sendto(fd, pkt, len, 0, (struct sockaddr *)&sll, sizeof(sll));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = argc > 2 ? atoi(argv[2]) : 10;
+	int payload = argc > 3 ? atoi(argv[3]) : 1400;
+	unsigned long long pkts = 0, bytes = 0, busy, rx;
+	struct sockaddr_in sin;
+	struct in_addr src;
+	struct ifreq ifr;
+	struct timeval tv = { 0, 100000 };
+	double t, end, mbit;
+	static char buf[65536];
+	int fd, size = 4 << 20;
+	long hz = sysconf(_SC_CLK_TCK);
+	ssize_t n;
+	pid_t pid;
+
+	if (argc < 2 || seconds <= 0 || payload <= 0 || payload > 8192) {
+		fprintf(stderr, "usage: %s <if> [seconds [payload-bytes "
+			"[source-ip]]]\n", argv[0]);
+		return 1;
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, argv[1], IFNAMSIZ - 1);
+	if (fd < 0 || ioctl(fd, SIOCGIFADDR, &ifr)) {
+		perror(argv[1]);
+		return 1;
+	}
+	memcpy(&sin, &ifr.ifr_addr, sizeof(sin));
+	src = sin.sin_addr;
+	src.s_addr ^= htonl(1);
+	if (argc > 4 && !inet_aton(argv[4], &src)) {
+		fprintf(stderr, "bad source address %s\n", argv[4]);
+		return 1;
+	}
+	sin.sin_port = htons(PORT);
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin))) {
+		perror("bind");
+		return 1;
+	}
+
+	pid = fork();
+	if (pid == 0)
+		send_loop(argv[1], src, sin.sin_addr, payload);
+
+	busy = cpu_busy();
+	rx = if_rx_packets(argv[1]);
+	t = now();
+	end = t + seconds;
+	while (now() < end) {
+		n = recv(fd, buf, sizeof(buf), 0);
+		if (n > 0) {
+			pkts++;
+			bytes += n;
+		}
+	}
+	t = now() - t;
+	busy = cpu_busy() - busy;
+	rx = if_rx_packets(argv[1]) - rx;
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+
+	mbit = bytes * 8 / 1e6;
+	printf("%s: %.0f pps, %.1f Mbit/s received, %.0f pps on the interface\n",
+	       argv[1], pkts / t, mbit / t, rx / t);
+	printf("cpu: %.1f%% of one cpu, %.2f ms per Mbit\n",
+	       busy * 100.0 / hz / t, mbit ? busy * 1000.0 / hz / mbit : 0);
+	return 0;
+}
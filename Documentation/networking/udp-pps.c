@@ -0,0 +1,269 @@
+/*
+ * udp-pps: UDP datagram rate over loopback, one datagram per sendmsg()
+ * call, batched with sendmmsg(), or split by the kernel with UDP_SEGMENT.
+ *
+ * A child process drains the receiving socket with recvmmsg() while the
+ * parent sends for the given time; both report datagrams per second.
+ *
+ * Usage: udp-pps [-m send|mmsg|seg] [-b batch] [-s size] [-t secs] [-c] [-6]
+ *
+ *   -m  send:  sendmsg() per datagram (the baseline)
+ *       mmsg:  sendmmsg() of <batch> datagrams per call
+ *       seg:   one sendmsg() of <batch> * <size> bytes, UDP_SEGMENT <size>
+ *   -b  datagrams per call (default 32, at most 64)
+ *   -s  payload bytes per datagram (default 64)
+ *   -t  seconds to run (default 5)
+ *   -c  connect() the sending socket instead of passing the address
+ *   -6  run over ::1; UDP_SEGMENT is IPv4 only here, so seg fails EOPNOTSUPP
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+#ifndef __NR_sendmmsg
+#if defined(__arm__)
+#define __NR_sendmmsg	(__NR_SYSCALL_BASE + 374)
+#elif defined(__x86_64__)
+#define __NR_sendmmsg	307
+#elif defined(__i386__)
+#define __NR_sendmmsg	345
+#endif
+#endif
+
+#define MAX_BATCH	64
+#define MAX_SIZE	65507
+
+struct mmsg {
+	struct msghdr	hdr;
+	unsigned int	len;
+};
+
+static volatile sig_atomic_t done;
+
+static void alarm_handler(int sig)
+{
+	done = 1;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int do_sendmmsg(int fd, struct mmsg *vec, unsigned int vlen)
+{
+	return syscall(__NR_sendmmsg, fd, vec, vlen, 0);
+}
+
+static void receiver(int fd)
+{
+	static char buf[MAX_BATCH][2048];
+	struct iovec iov[MAX_BATCH];
+	struct mmsg vec[MAX_BATCH];
+	struct timeval tv = { 0, 100000 };
+	unsigned long long count = 0;
+	double start = 0, last = 0;
+	int i, n;
+
+	/* Don't depend on the alarm catching us inside recvmmsg() */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	for (i = 0; i < MAX_BATCH; i++) {
+		iov[i].iov_base = buf[i];
+		iov[i].iov_len = sizeof(buf[i]);
+		memset(&vec[i], 0, sizeof(vec[i]));
+		vec[i].hdr.msg_iov = &iov[i];
+		vec[i].hdr.msg_iovlen = 1;
+	}
+
+	while (!done) {
+		n = recvmmsg(fd, (struct mmsghdr *)vec, MAX_BATCH, 0, NULL);
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("recvmmsg");
+			break;
+		}
+		if (!count)
+			start = now();
+		count += n;
+		last = now();
+	}
+	if (count && last > start)
+		printf("received %llu datagrams, %.0f pps\n",
+		       count, count / (last - start));
+	else
+		printf("received %llu datagrams\n", count);
+}
+
+int main(int argc, char *argv[])
+{
+	union {
+		struct sockaddr_in	v4;
+		struct sockaddr_in6	v6;
+	} addr;
+	socklen_t alen;
+	struct iovec iov[MAX_BATCH];
+	struct mmsg vec[MAX_BATCH];
+	const char *mode = "send";
+	int batch = 32, size = 64, secs = 5, conn = 0, family = AF_INET;
+	unsigned long long calls = 0, sent = 0;
+	int rfd, sfd, opt, i, n;
+	char *buf;
+	double start;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "m:b:s:t:c6")) != -1) {
+		switch (opt) {
+		case 'm':
+			mode = optarg;
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		case 'c':
+			conn = 1;
+			break;
+		case '6':
+			family = AF_INET6;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (batch < 1 || batch > MAX_BATCH || size < 1 ||
+	    size > (family == AF_INET6 ? 1452 : 1472) ||
+	    secs < 1 ||
+	    (strcmp(mode, "send") && strcmp(mode, "mmsg") &&
+	     strcmp(mode, "seg")))
+		goto usage;
+	if (!strcmp(mode, "seg") && batch * size > MAX_SIZE) {
+		fprintf(stderr, "batch * size must be at most %d for seg\n",
+			MAX_SIZE);
+		return 1;
+	}
+
+	rfd = socket(family, SOCK_DGRAM, 0);
+	sfd = socket(family, SOCK_DGRAM, 0);
+	if (rfd < 0 || sfd < 0) {
+		perror("socket");
+		return 1;
+	}
+	opt = 4 << 20;
+	setsockopt(rfd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt));
+	memset(&addr, 0, sizeof(addr));
+	if (family == AF_INET6) {
+		addr.v6.sin6_family = AF_INET6;
+		addr.v6.sin6_addr = in6addr_loopback;
+		alen = sizeof(addr.v6);
+	} else {
+		addr.v4.sin_family = AF_INET;
+		addr.v4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		alen = sizeof(addr.v4);
+	}
+	if (bind(rfd, (struct sockaddr *)&addr, alen) ||
+	    getsockname(rfd, (struct sockaddr *)&addr, &alen)) {
+		perror("bind");
+		return 1;
+	}
+	if (conn && connect(sfd, (struct sockaddr *)&addr, alen)) {
+		perror("connect");
+		return 1;
+	}
+
+	signal(SIGALRM, alarm_handler);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		/* Outlive the sender a little to drain the queue */
+		alarm(secs + 1);
+		receiver(rfd);
+		return 0;
+	}
+	close(rfd);
+
+	buf = calloc(batch, size);
+	if (!buf)
+		return 1;
+	for (i = 0; i < batch; i++) {
+		iov[i].iov_base = buf + i * size;
+		iov[i].iov_len = size;
+		memset(&vec[i], 0, sizeof(vec[i]));
+		if (!conn) {
+			vec[i].hdr.msg_name = &addr;
+			vec[i].hdr.msg_namelen = alen;
+		}
+		vec[i].hdr.msg_iov = &iov[i];
+		vec[i].hdr.msg_iovlen = 1;
+	}
+	if (!strcmp(mode, "seg")) {
+		iov[0].iov_len = batch * size;
+		if (setsockopt(sfd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size))) {
+			perror("UDP_SEGMENT");
+			kill(pid, SIGALRM);
+			goto out;
+		}
+	}
+
+	alarm(secs);
+	start = now();
+	while (!done) {
+		if (!strcmp(mode, "mmsg")) {
+			n = do_sendmmsg(sfd, vec, batch);
+		} else {
+			n = sendmsg(sfd, &vec[0].hdr, 0);
+			if (n > 0)
+				n = (n + size - 1) / size;
+		}
+		if (n < 0) {
+			if (errno == EINTR || errno == ENOBUFS ||
+			    errno == EAGAIN)
+				continue;
+			perror(mode);
+			break;
+		}
+		calls++;
+		sent += n;
+	}
+	printf("%s: sent %llu datagrams in %llu calls, %.0f pps\n",
+	       mode, sent, calls, sent / (now() - start));
+out:
+	waitpid(pid, NULL, 0);
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: %s [-m send|mmsg|seg] [-b batch] [-s size] [-t secs] [-c] [-6]\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,168 @@
+/*
+ * gadget-xfer-stat: show how many frames go into each USB transfer of a
+ * gadget ethernet link (u_ether: RNDIS, NCM, ECM ...).
+ *
+ * Every interval the frame counters of the interface are compared with
+ * the tx_xfers and rx_xfers counters u_ether reports through ethtool.
+ * With one frame per transfer both ratios stay at 1.0; with multi-frame
+ * RNDIS messages or NCM transfer blocks they go up, and so the transfer
+ * rate, which is what the UDC takes interrupts for, goes down.
+ *
+ * Usage: gadget-xfer-stat [interface [seconds]]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+
+struct sample {
+	unsigned long long tx_packets, rx_packets;
+	unsigned long long tx_xfers, rx_xfers;
+};
+
+static const char *ifname = "usb0";
+static int sock;
+static int xfer_idx[2] = { -1, -1 };	/* tx_xfers, rx_xfers */
+static unsigned n_stats;
+
+static int ethtool(void *cmd)
+{
+	struct ifreq ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	ifr.ifr_data = cmd;
+	return ioctl(sock, SIOCETHTOOL, &ifr);
+}
+
+static int find_stats(void)
+{
+	struct ethtool_drvinfo info = { .cmd = ETHTOOL_GDRVINFO };
+	struct ethtool_gstrings *strings;
+	unsigned i;
+
+	if (ethtool(&info) < 0) {
+		perror(ifname);
+		return -1;
+	}
+	n_stats = info.n_stats;
+	strings = calloc(1, sizeof(*strings) + n_stats * ETH_GSTRING_LEN);
+	if (!strings)
+		return -1;
+	strings->cmd = ETHTOOL_GSTRINGS;
+	strings->string_set = ETH_SS_STATS;
+	strings->len = n_stats;
+	if (n_stats && ethtool(strings) < 0) {
+		perror("ETHTOOL_GSTRINGS");
+		free(strings);
+		return -1;
+	}
+	for (i = 0; i < n_stats; i++) {
+		const char *name = (char *)strings->data + i * ETH_GSTRING_LEN;
+
+		if (!strcmp(name, "tx_xfers"))
+			xfer_idx[0] = i;
+		else if (!strcmp(name, "rx_xfers"))
+			xfer_idx[1] = i;
+	}
+	free(strings);
+	if (xfer_idx[0] < 0 || xfer_idx[1] < 0) {
+		fprintf(stderr, "%s: no tx_xfers/rx_xfers, not a gadget link?\n",
+			ifname);
+		return -1;
+	}
+	return 0;
+}
+
+static unsigned long long read_counter(const char *name)
+{
+	char path[128];
+	unsigned long long val = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s",
+		 ifname, name);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%llu", &val) != 1)
+		val = 0;
+	fclose(f);
+	return val;
+}
+
+static int sample(struct sample *s)
+{
+	struct ethtool_stats *stats;
+
+	stats = calloc(1, sizeof(*stats) + n_stats * sizeof(__u64));
+	if (!stats)
+		return -1;
+	stats->cmd = ETHTOOL_GSTATS;
+	stats->n_stats = n_stats;
+	if (ethtool(stats) < 0) {
+		perror("ETHTOOL_GSTATS");
+		free(stats);
+		return -1;
+	}
+	s->tx_xfers = stats->data[xfer_idx[0]];
+	s->rx_xfers = stats->data[xfer_idx[1]];
+	free(stats);
+
+	s->tx_packets = read_counter("tx_packets");
+	s->rx_packets = read_counter("rx_packets");
+	return 0;
+}
+
+static double ratio(unsigned long long a, unsigned long long b)
+{
+	return b ? (double)a / b : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct sample old, cur;
+	int secs = 1;
+
+	if (argc > 1)
+		ifname = argv[1];
+	if (argc > 2)
+		secs = atoi(argv[2]);
+	if (secs <= 0) {
+		fprintf(stderr, "usage: %s [interface [seconds]]\n", argv[0]);
+		return 1;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0) {
+		perror("socket");
+		return 1;
+	}
+	if (find_stats() || sample(&old))
+		return 1;
+
+	printf("  tx pkt/s  tx xfer/s  pkt/xfer    rx pkt/s  rx xfer/s  pkt/xfer\n");
+	for (;;) {
+		sleep(secs);
+		if (sample(&cur))
+			return 1;
+		printf("%10.0f %10.0f %9.2f  %10.0f %10.0f %9.2f\n",
+		       (double)(cur.tx_packets - old.tx_packets) / secs,
+		       (double)(cur.tx_xfers - old.tx_xfers) / secs,
+		       ratio(cur.tx_packets - old.tx_packets,
+			     cur.tx_xfers - old.tx_xfers),
+		       (double)(cur.rx_packets - old.rx_packets) / secs,
+		       (double)(cur.rx_xfers - old.rx_xfers) / secs,
+		       ratio(cur.rx_packets - old.rx_packets,
+			     cur.rx_xfers - old.rx_xfers));
+		fflush(stdout);
+		old = cur;
+	}
+	return 0;
+}
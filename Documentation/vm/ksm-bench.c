@@ -0,0 +1,259 @@
+/*
+ * ksm-bench: how many pages ksmd merges per second of its own cpu time.
+ *
+ * Usage: ksm-bench [-n procs] [-m MB] [-d percent] [-t secs] [-u]
+ *
+ * Maps <MB> megabytes of anonymous memory (default 64), advises it
+ * MADV_MERGEABLE and forks <procs> children (default 4), which inherit
+ * the advice the way apps forked from zygote do, unless -u is given:
+ * then each child maps and advises its own area.  Every child fills its
+ * area so that <percent> of the pages (default 50) hold one of 16
+ * patterns shared by all of them, and the rest are unique.
+ *
+ * ksmd is started, and every second for <secs> seconds (default 30)
+ * pages_sharing, full_scans and ksmd's utime+stime are printed; at the
+ * end, the pages merged per cpu-second of ksmd.  Needs root, and
+ * restores the previous "run" setting on exit.  The other ksm sysfs
+ * knobs (pages_to_scan, sleep_millisecs, idle_percent,
+ * uninherited_scan_ratio) are left as they are, so set them first.
+ *
+ * See Documentation/vm/ksm.txt.
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifndef MADV_MERGEABLE
+#define MADV_MERGEABLE	12
+#endif
+
+#define KSM_DIR		"/sys/kernel/mm/ksm/"
+#define PATTERNS	16
+#define MAX_PROCS	64
+
+static long page_size;
+static pid_t children[MAX_PROCS];
+static int nr_children;
+static char old_run[16];
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static long read_ksm(const char *name)
+{
+	char path[128];
+	long val = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), KSM_DIR "%s", name);
+	f = fopen(path, "r");
+	if (!f || fscanf(f, "%ld", &val) != 1)
+		die(path);
+	fclose(f);
+	return val;
+}
+
+static void write_ksm(const char *name, const char *val)
+{
+	char path[128];
+	FILE *f;
+
+	snprintf(path, sizeof(path), KSM_DIR "%s", name);
+	f = fopen(path, "w");
+	if (!f || fputs(val, f) < 0 || fclose(f))
+		die(path);
+}
+
+/* pid of the ksmd kernel thread, found by name */
+static pid_t find_ksmd(void)
+{
+	struct dirent *de;
+	char path[PATH_MAX], comm[32];
+	pid_t pid = 0;
+	DIR *proc;
+	FILE *f;
+
+	proc = opendir("/proc");
+	if (!proc)
+		die("/proc");
+	while (!pid && (de = readdir(proc))) {
+		if (de->d_name[0] < '0' || de->d_name[0] > '9')
+			continue;
+		snprintf(path, sizeof(path), "/proc/%s/stat", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%*d (%31[^)])", comm) == 1 &&
+		    !strcmp(comm, "ksmd"))
+			pid = atoi(de->d_name);
+		fclose(f);
+	}
+	closedir(proc);
+	if (!pid) {
+		fprintf(stderr, "ksmd not found: is CONFIG_KSM set?\n");
+		exit(1);
+	}
+	return pid;
+}
+
+/* utime + stime of a task, in seconds */
+static double cpu_time(pid_t pid)
+{
+	unsigned long utime, stime;
+	char path[64];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	f = fopen(path, "r");
+	if (!f || fscanf(f, "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u "
+			 "%*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		die(path);
+	fclose(f);
+	return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static void fill(char *area, size_t len, int dup_percent)
+{
+	size_t i, pages = len / page_size;
+	unsigned long *p;
+
+	for (i = 0; i < pages; i++) {
+		p = (unsigned long *)(area + i * page_size);
+		if (i * 100 < pages * dup_percent) {
+			memset(p, 'a' + i % PATTERNS, page_size);
+		} else {
+			/* Unique to this child and page */
+			memset(p, 0, page_size);
+			p[0] = getpid();
+			p[1] = i + 1;
+		}
+	}
+}
+
+static char *map_mergeable(size_t len)
+{
+	char *area = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (area == MAP_FAILED)
+		die("mmap");
+	if (madvise(area, len, MADV_MERGEABLE))
+		die("madvise(MADV_MERGEABLE)");
+	return area;
+}
+
+static void cleanup(void)
+{
+	int i;
+
+	for (i = 0; i < nr_children; i++)
+		kill(children[i], SIGKILL);
+	while (wait(NULL) > 0)
+		;
+	if (old_run[0])
+		write_ksm("run", old_run);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: ksm-bench [-n procs] [-m MB] [-d percent] "
+		"[-t secs] [-u]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int procs = 4, mb = 64, dup_percent = 50, secs = 30, inherit = 1;
+	long sharing0, sharing, scans0;
+	double cpu0, cpu;
+	char *area = NULL;
+	size_t len;
+	pid_t ksmd;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "n:m:d:t:u")) != -1) {
+		switch (opt) {
+		case 'n':
+			procs = atoi(optarg);
+			break;
+		case 'm':
+			mb = atoi(optarg);
+			break;
+		case 'd':
+			dup_percent = atoi(optarg);
+			break;
+		case 't':
+			secs = atoi(optarg);
+			break;
+		case 'u':
+			inherit = 0;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || procs < 1 || procs > MAX_PROCS || mb < 1 ||
+	    dup_percent < 0 || dup_percent > 100 || secs < 1)
+		usage();
+
+	page_size = sysconf(_SC_PAGESIZE);
+	len = (size_t)mb << 20;
+	ksmd = find_ksmd();
+
+	if (inherit)
+		area = map_mergeable(len);
+	for (i = 0; i < procs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			cleanup();
+			die("fork");
+		}
+		if (pid == 0) {
+			if (!inherit)
+				area = map_mergeable(len);
+			fill(area, len, dup_percent);
+			for (;;)
+				pause();
+		}
+		children[nr_children++] = pid;
+	}
+	/* Let the children fault their areas in before ksmd starts */
+	sleep(1);
+
+	snprintf(old_run, sizeof(old_run), "%ld", read_ksm("run"));
+	sharing0 = read_ksm("pages_sharing");
+	scans0 = read_ksm("full_scans");
+	cpu0 = cpu_time(ksmd);
+	write_ksm("run", "1");
+
+	printf("%4s %14s %10s %10s\n", "secs", "pages_sharing", "full_scans",
+	       "ksmd_cpu");
+	for (i = 1; i <= secs; i++) {
+		sleep(1);
+		printf("%4d %14ld %10ld %10.2f\n", i,
+		       read_ksm("pages_sharing") - sharing0,
+		       read_ksm("full_scans") - scans0, cpu_time(ksmd) - cpu0);
+		fflush(stdout);
+	}
+	sharing = read_ksm("pages_sharing") - sharing0;
+	cpu = cpu_time(ksmd) - cpu0;
+	cleanup();
+
+	printf("%ld pages merged in %.2f cpu seconds of ksmd", sharing, cpu);
+	if (cpu > 0)
+		printf(", %.0f pages per cpu-second", sharing / cpu);
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * ra-history-bench: cold-start page cache misses with and without a
+ * readahead history (CONFIG_READAHEAD_HISTORY).
+ *
+ * Usage: ra-history-bench [-p percent] [-s seed] FILE...
+ *
+ * A "launch" opens every FILE, maps it and faults in the same scattered
+ * <percent> of its pages (default 25), in a shuffled order, the way
+ * dlopen and dex/apk loading touch their files at app start.  <seed>
+ * picks the pages; the same seed gives the same launch.
+ *
+ * The files are dropped from the page cache with POSIX_FADV_DONTNEED
+ * before each launch.  A first launch records the pages it reads
+ * (POSIX_FADV_RECORD_ACCESS) and fetches them with FS_IOC_GET_RA_HISTORY.
+ * Then one launch runs cold, and one after handing the history back with
+ * FS_IOC_SET_RA_HISTORY, so that the open of each file reads it in.  For
+ * both the major faults (page cache misses) and the time are printed.
+ *
+ * Needs to own the files (or CAP_FOWNER).  Files with pages mapped or
+ * dirty elsewhere can't be dropped; use copies.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <linux/types.h>
+
+#define POSIX_FADV_RECORD_ACCESS	8
+
+struct ra_history_extent {
+	__u64 start;
+	__u64 len;
+};
+
+struct ra_history_args {
+	__u32 nr_extents;
+	__u32 flags;
+	__u64 extents;
+};
+
+#define RA_HISTORY_STOP		0x00000001
+/* Most extents FS_IOC_SET_RA_HISTORY takes */
+#define RA_HISTORY_MAX_EXTENTS	1024
+
+#define FS_IOC_GET_RA_HISTORY	_IOWR('X', 124, struct ra_history_args)
+#define FS_IOC_SET_RA_HISTORY	_IOW('X', 125, struct ra_history_args)
+
+struct bench_file {
+	const char *path;
+	size_t size;
+	unsigned long *pages;		/* the launch touches these */
+	unsigned long nr_pages;
+	struct ra_history_args hist;
+};
+
+static long page_size;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static long major_faults(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static unsigned int rand_next(unsigned int *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return *state >> 8;
+}
+
+/* Pick the pages a launch touches, and shuffle them */
+static void pick_pages(struct bench_file *f, int percent, unsigned int seed)
+{
+	unsigned long total = (f->size + page_size - 1) / page_size;
+	unsigned long i, j, tmp;
+
+	f->pages = malloc(total * sizeof(*f->pages));
+	if (!f->pages)
+		die("malloc");
+	for (i = 0; i < total; i++)
+		if (rand_next(&seed) % 100 < (unsigned int)percent)
+			f->pages[f->nr_pages++] = i;
+	for (i = f->nr_pages; i > 1; i--) {
+		j = rand_next(&seed) % i;
+		tmp = f->pages[i - 1];
+		f->pages[i - 1] = f->pages[j];
+		f->pages[j] = tmp;
+	}
+}
+
+static void drop(struct bench_file *f)
+{
+	int fd = open(f->path, O_RDONLY);
+
+	if (fd < 0)
+		die(f->path);
+	errno = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	if (errno)
+		die("POSIX_FADV_DONTNEED");
+	close(fd);
+}
+
+/* Open, map and fault in the launch set; record the pages read if asked */
+static void launch(struct bench_file *f, int record)
+{
+	volatile char *map;
+	unsigned long i;
+	char sum = 0;
+	int fd;
+
+	fd = open(f->path, O_RDONLY);
+	if (fd < 0)
+		die(f->path);
+	if (record) {
+		errno = posix_fadvise(fd, 0, 0, POSIX_FADV_RECORD_ACCESS);
+		if (errno)
+			die("POSIX_FADV_RECORD_ACCESS (is "
+			    "CONFIG_READAHEAD_HISTORY set?)");
+	}
+	map = mmap(NULL, f->size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		die("mmap");
+	/* Fault-around would blur what is measured */
+	madvise((void *)map, f->size, MADV_RANDOM);
+	for (i = 0; i < f->nr_pages; i++)
+		sum += map[f->pages[i] * page_size];
+	munmap((void *)map, f->size);
+
+	if (record) {
+		f->hist.nr_extents = 0;
+		f->hist.flags = 0;
+		f->hist.extents = 0;
+		if (ioctl(fd, FS_IOC_GET_RA_HISTORY, &f->hist))
+			die("FS_IOC_GET_RA_HISTORY");
+		f->hist.extents = (unsigned long)calloc(f->hist.nr_extents + 1,
+					sizeof(struct ra_history_extent));
+		if (!f->hist.extents)
+			die("calloc");
+		f->hist.flags = RA_HISTORY_STOP;
+		if (ioctl(fd, FS_IOC_GET_RA_HISTORY, &f->hist))
+			die("FS_IOC_GET_RA_HISTORY");
+	}
+	close(fd);
+	(void)sum;
+}
+
+static void set_history(struct bench_file *f)
+{
+	int fd;
+
+	if (!f->hist.nr_extents)
+		return;
+	fd = open(f->path, O_RDONLY);
+	if (fd < 0)
+		die(f->path);
+	f->hist.flags = 0;
+	if (f->hist.nr_extents > RA_HISTORY_MAX_EXTENTS)
+		f->hist.nr_extents = RA_HISTORY_MAX_EXTENTS;
+	if (ioctl(fd, FS_IOC_SET_RA_HISTORY, &f->hist))
+		die("FS_IOC_SET_RA_HISTORY");
+	close(fd);
+}
+
+static void run(const char *what, struct bench_file *files, int nr,
+		int record, int history)
+{
+	long faults;
+	double start;
+	int i;
+
+	for (i = 0; i < nr; i++)
+		drop(&files[i]);
+	if (history)
+		for (i = 0; i < nr; i++)
+			set_history(&files[i]);
+
+	faults = major_faults();
+	start = now();
+	for (i = 0; i < nr; i++)
+		launch(&files[i], record);
+	printf("%-10s %12ld %10.1f\n", what, major_faults() - faults,
+	       (now() - start) * 1000);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: ra-history-bench [-p percent] [-s seed] "
+		"FILE...\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_file *files;
+	unsigned int seed = 1;
+	unsigned long pages = 0, extents = 0;
+	int percent = 25, opt, nr, i;
+	struct stat st;
+
+	while ((opt = getopt(argc, argv, "p:s:")) != -1) {
+		switch (opt) {
+		case 'p':
+			percent = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	nr = argc - optind;
+	if (nr < 1 || percent < 1 || percent > 100)
+		usage();
+
+	page_size = sysconf(_SC_PAGESIZE);
+	files = calloc(nr, sizeof(*files));
+	if (!files)
+		die("calloc");
+	for (i = 0; i < nr; i++) {
+		files[i].path = argv[optind + i];
+		if (stat(files[i].path, &st))
+			die(files[i].path);
+		if (!S_ISREG(st.st_mode) || !st.st_size) {
+			fprintf(stderr, "%s: not a regular file with data\n",
+				files[i].path);
+			return 1;
+		}
+		files[i].size = st.st_size;
+		pick_pages(&files[i], percent, seed + i);
+		pages += files[i].nr_pages;
+	}
+
+	printf("%-10s %12s %10s\n", "launch", "major_faults", "msecs");
+	run("record", files, nr, 1, 0);
+	for (i = 0; i < nr; i++)
+		extents += files[i].hist.nr_extents;
+	run("cold", files, nr, 0, 0);
+	run("history", files, nr, 0, 1);
+	printf("%lu pages touched in %d files, history of %lu extents\n",
+	       pages, nr, extents);
+	return 0;
+}
@@ -31,6 +31,7 @@
 #include <linux/ctype.h>
 #include <linux/remote_spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/math64.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
@@ -360,6 +361,12 @@ struct smd_channel {
 	int pending_pkt_sz;
 
 	char is_pkt_ch;
+
+	/* deferred read notification, see ch_read_notify() */
+	unsigned read_notify_threshold;
+	unsigned read_notify_pending;
+	unsigned long read_bytes;
+	unsigned long read_notifies;
 };
 
 static struct platform_device loopback_tty_pdev = {.name = "LOOPBACK_TTY"};
@@ -546,6 +553,27 @@ static void ch_read_done(struct smd_channel *ch, unsigned count)
 	ch->send->fTAIL = 1;
 }
 
+/* interrupt the other side for the space freed by reading count bytes,
+ * unless it blocked read interrupts.  With a threshold, wait until that
+ * many bytes were read or the fifo is empty; fTAIL is already set and is
+ * also seen with any other interrupt in the meantime.
+ */
+static void ch_read_notify(struct smd_channel *ch, unsigned count)
+{
+	ch->read_bytes += count;
+	if (read_intr_blocked(ch)) {
+		ch->read_notify_pending = 0;
+		return;
+	}
+	ch->read_notify_pending += count;
+	if (ch->read_notify_pending < ch->read_notify_threshold &&
+	    smd_stream_read_avail(ch))
+		return;
+	ch->read_notify_pending = 0;
+	ch->read_notifies++;
+	ch->notify_other_cpu();
+}
+
 /* basic read interface to ch_read_{buffer,done} used
  * by smd_*_read() and update_packet_state()
  * will read-and-discard if the _data pointer is null
@@ -962,8 +990,7 @@ static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
-		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+		ch_read_notify(ch, r);
 
 	return r;
 }
@@ -981,8 +1008,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
-		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+		ch_read_notify(ch, r);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -1005,8 +1031,7 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
-		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+		ch_read_notify(ch, r);
 
 	ch->current_packet -= r;
 	update_packet_state(ch);
@@ -1265,6 +1290,10 @@ int smd_named_open_on_edge(const char *name, uint32_t edge,
 	ch->current_packet = 0;
 	ch->last_state = SMD_SS_CLOSED;
 	ch->priv = priv;
+	ch->read_notify_threshold = 0;
+	ch->read_notify_pending = 0;
+	ch->read_bytes = 0;
+	ch->read_notifies = 0;
 
 	if (edge == SMD_LOOPBACK_TYPE) {
 		ch->last_state = SMD_SS_OPENED;
@@ -1499,6 +1528,104 @@ void smd_disable_read_intr(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_disable_read_intr);
 
+int smd_read_peek(smd_channel_t *ch, struct smd_read_vec vec[2])
+{
+	unsigned tail;
+	int n;
+
+	if (!ch)
+		return -ENODEV;
+
+	n = ch->read_avail(ch);
+	/* don't look at the data before the head index that covers it */
+	rmb();
+	tail = ch->recv->tail;
+	vec[0].data = ch->recv_data + tail;
+	vec[0].len = min_t(int, n, ch->fifo_size - tail);
+	vec[1].data = ch->recv_data;
+	vec[1].len = n - vec[0].len;
+	return n;
+}
+EXPORT_SYMBOL(smd_read_peek);
+
+int smd_read_commit(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+
+	if (!ch)
+		return -ENODEV;
+	if (len < 0 || len > ch->read_avail(ch))
+		return -EINVAL;
+	if (len == 0)
+		return 0;
+
+	ch_read_done(ch, len);
+	ch_read_notify(ch, len);
+
+	if (ch->is_pkt_ch) {
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+	return len;
+}
+EXPORT_SYMBOL(smd_read_commit);
+
+int smd_set_read_notify_threshold(smd_channel_t *ch, int bytes)
+{
+	if (!ch)
+		return -ENODEV;
+	if (bytes < 0)
+		return -EINVAL;
+
+	ch->read_notify_threshold = min_t(unsigned, bytes, ch->fifo_size / 2);
+	return 0;
+}
+EXPORT_SYMBOL(smd_set_read_notify_threshold);
+
+void smd_read_notify_flush(smd_channel_t *ch)
+{
+	if (!ch || !ch->read_notify_pending)
+		return;
+
+	ch->read_notify_pending = 0;
+	if (!read_intr_blocked(ch)) {
+		ch->read_notifies++;
+		ch->notify_other_cpu();
+	}
+}
+EXPORT_SYMBOL(smd_read_notify_flush);
+
+/* bytes read and read notifications sent on the open channels */
+int smd_read_notify_stats(char *buf, int max)
+{
+	struct list_head *lists[] = {
+		&smd_ch_list_modem, &smd_ch_list_dsp, &smd_ch_list_dsps,
+		&smd_ch_list_wcnss, &smd_ch_list_loopback,
+	};
+	struct smd_channel *ch;
+	unsigned long flags;
+	int n, i = 0;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	for (n = 0; n < ARRAY_SIZE(lists); n++) {
+		list_for_each_entry(ch, lists[n], ch_list) {
+			i += scnprintf(buf + i, max - i,
+				       "%-20s %10lu KB %10lu notify"
+				       " %6llu/MB threshold %u\n",
+				       ch->name, ch->read_bytes >> 10,
+				       ch->read_notifies,
+				       ch->read_bytes ?
+				       div_u64((u64)ch->read_notifies << 20,
+					       ch->read_bytes) : 0,
+				       ch->read_notify_threshold);
+		}
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+	return i;
+}
+
 int smd_wait_until_readable(smd_channel_t *ch, int bytes)
 {
 	return -1;
@@ -472,6 +472,7 @@ static int __init smd_debugfs_init(void)
 		return PTR_ERR(dent);
 
 	debug_create("ch", 0444, dent, debug_read_ch);
+	debug_create("read_notify", 0444, dent, smd_read_notify_stats);
 	debug_create("diag", 0444, dent, debug_read_diag_msg);
 	debug_create("mem", 0444, dent, debug_read_mem);
 	debug_create("version", 0444, dent, debug_read_smd_version);
@@ -173,6 +173,7 @@ void smsm_print_sleep_info(uint32_t sleep_delay, uint32_t sleep_limit,
 void smsm_reset_modem(unsigned mode);
 void smsm_reset_modem_cont(void);
 void smd_sleep_exit(void);
+int smd_read_notify_stats(char *buf, int max);
 
 #define SMEM_NUM_SMD_STREAM_CHANNELS        64
 #define SMEM_NUM_SMD_BLOCK_CHANNELS         64
@@ -1355,12 +1355,19 @@ static struct resource resources_sdc5[] = {
 	},
 };
 
+/*
+ * The data mover reaches all of memory, so let the block layer hand
+ * highmem pages straight to the controller instead of bouncing them.
+ */
+static u64 msm_sdcc_dma_mask = DMA_BIT_MASK(32);
+
 struct platform_device msm_device_sdc1 = {
 	.name		= "msm_sdcc",
 	.id		= 1,
 	.num_resources	= ARRAY_SIZE(resources_sdc1),
 	.resource	= resources_sdc1,
 	.dev		= {
+		.dma_mask		= &msm_sdcc_dma_mask,
 		.coherent_dma_mask	= 0xffffffff,
 	},
 };
@@ -1371,6 +1378,7 @@ struct platform_device msm_device_sdc2 = {
 	.num_resources	= ARRAY_SIZE(resources_sdc2),
 	.resource	= resources_sdc2,
 	.dev		= {
+		.dma_mask		= &msm_sdcc_dma_mask,
 		.coherent_dma_mask	= 0xffffffff,
 	},
 };
@@ -1381,6 +1389,7 @@ struct platform_device msm_device_sdc3 = {
 	.num_resources	= ARRAY_SIZE(resources_sdc3),
 	.resource	= resources_sdc3,
 	.dev		= {
+		.dma_mask		= &msm_sdcc_dma_mask,
 		.coherent_dma_mask	= 0xffffffff,
 	},
 };
@@ -1391,6 +1400,7 @@ struct platform_device msm_device_sdc4 = {
 	.num_resources	= ARRAY_SIZE(resources_sdc4),
 	.resource	= resources_sdc4,
 	.dev		= {
+		.dma_mask		= &msm_sdcc_dma_mask,
 		.coherent_dma_mask	= 0xffffffff,
 	},
 };
@@ -1401,6 +1411,7 @@ struct platform_device msm_device_sdc5 = {
 	.num_resources	= ARRAY_SIZE(resources_sdc5),
 	.resource	= resources_sdc5,
 	.dev		= {
+		.dma_mask		= &msm_sdcc_dma_mask,
 		.coherent_dma_mask	= 0xffffffff,
 	},
 };
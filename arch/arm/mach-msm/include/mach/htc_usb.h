@@ -364,6 +364,9 @@ static char *usb_functions_all[] = {
 #ifdef CONFIG_USB_ANDROID_ECM
 	"cdc_ethernet",
 #endif
+#ifdef CONFIG_USB_ANDROID_NCM
+	"ncm",
+#endif
 #if defined(CONFIG_USB_ANDROID_DIAG) || defined(CONFIG_USB_ANDROID_QCT_DIAG)
 	"diag",
 #endif
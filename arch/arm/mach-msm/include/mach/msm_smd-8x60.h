@@ -155,4 +155,49 @@ int smd_write_segment(smd_channel_t *ch, void *data, int len, int user_buf);
  */
 int smd_write_end(smd_channel_t *ch);
 
+/* A contiguous piece of the receive FIFO, see smd_read_peek() */
+struct smd_read_vec {
+	void *data;
+	int len;
+};
+
+/* Exposes the data that smd_read() would return next, in place in the
+ * receive FIFO, without consuming it.  The data is described by up to two
+ * pieces, the second one used when it wraps around the end of the FIFO.
+ * On a packet channel only the rest of the current packet is exposed.
+ * The pieces stay valid until smd_read_commit() or smd_close().
+ *
+ * @ch: channel to read from
+ * @vec: filled in with the pieces, vec[1].len is 0 if there is one
+ *
+ * Returns:
+ *      number of bytes exposed, 0 if there are none
+ *      -ENODEV - invalid smd channel
+ */
+int smd_read_peek(smd_channel_t *ch, struct smd_read_vec vec[2]);
+
+/* Consumes data exposed by smd_read_peek(), as smd_read() would have.
+ * Like smd_read(), not to be called from the notify callback.
+ *
+ * @ch: channel to consume from
+ * @len: number of bytes to consume, from the start of vec[0]
+ *
+ * Returns:
+ *      number of bytes consumed
+ *      -ENODEV - invalid smd channel
+ *      -EINVAL - more bytes than smd_read_peek() can expose
+ */
+int smd_read_commit(smd_channel_t *ch, int len);
+
+/* Every read tells the other side that FIFO space was freed, which costs
+ * it an interrupt.  With a threshold, the notification is held back until
+ * that many bytes have been read or the FIFO is empty.  A reader that
+ * stops with data left in the FIFO, e.g. to wait for the rest of a packet,
+ * must call smd_read_notify_flush() so that a writer waiting for space is
+ * not kept waiting.  The threshold is limited to half the FIFO; 0, the
+ * default, notifies on every read.
+ */
+int smd_set_read_notify_threshold(smd_channel_t *ch, int bytes);
+void smd_read_notify_flush(smd_channel_t *ch);
+
 #endif
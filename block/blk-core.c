@@ -1151,6 +1151,8 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 
 	if (bio_rw_flagged(bio, BIO_RW_DISCARD))
 		req->cmd_flags |= REQ_DISCARD;
+	if (bio_rw_flagged(bio, BIO_RW_SECURE))
+		req->cmd_flags |= REQ_SECURE;
 	if (bio_rw_flagged(bio, BIO_RW_BARRIER))
 		req->cmd_flags |= REQ_HARDBARRIER;
 	if (bio_rw_flagged(bio, BIO_RW_SYNCIO))
@@ -1503,6 +1505,12 @@ static inline void __generic_make_request(struct bio *bio)
 			goto end_io;
 		}
 
+		if (bio_rw_flagged(bio, BIO_RW_SECURE) &&
+		    !blk_queue_secdiscard(q)) {
+			err = -EOPNOTSUPP;
+			goto end_io;
+		}
+
 		trace_block_bio_queue(q, bio);
 
 		ret = q->make_request_fn(q, bio);
@@ -83,6 +83,13 @@ int elv_rq_merge_ok(struct request *rq, struct bio *bio)
 	    bio_rw_flagged(rq->bio, BIO_RW_DISCARD))
 		return 0;
 
+	/*
+	 * Don't merge discard requests and secure discard requests
+	 */
+	if (bio_rw_flagged(bio, BIO_RW_SECURE) !=
+	    bio_rw_flagged(rq->bio, BIO_RW_SECURE))
+		return 0;
+
 	/*
 	 * different data direction or already started, don't merge
 	 */
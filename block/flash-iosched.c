@@ -0,0 +1,614 @@
+/*
+ *  Flash i/o scheduler, for eMMC and SD storage.
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/sched.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int sync_expire = HZ / 4;	/* max time before a sync rq is served */
+static const int async_expire = 5 * HZ;	/* ditto for async writes */
+static const int idle_expire = 2 * HZ;	/* ditto for the idle class */
+static const int writes_starved = 16;	/* max sync rqs served ahead of writes */
+static const int write_batch = 16;	/* max rqs in one erase block run */
+static const unsigned int default_erase_sectors = 1024;	/* 512KB */
+
+/*
+ * ioprio classes, in service order
+ */
+enum {
+	FLASH_CLASS_RT,
+	FLASH_CLASS_BE,
+	FLASH_CLASS_IDLE,
+	FLASH_CLASS_NR,
+};
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are sorted by sector per sync/async, and kept in
+	 * arrival order per ioprio class and sync/async
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[FLASH_CLASS_NR][2];
+
+	/*
+	 * next async request in sort order, while running a write batch
+	 */
+	struct request *next_rq;
+	sector_t batch_end;		/* end of the erase block being written */
+	unsigned int batching;		/* number of requests in this batch */
+	unsigned int starved;		/* times sync rqs have starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int idle_expire;
+	int writes_starved;
+	int write_batch;
+	int erase_block_kb;		/* 0: use the queue discard granularity */
+	int front_merges;
+};
+
+static inline int flash_bio_sync(struct bio *bio)
+{
+	return bio_data_dir(bio) == READ || bio_rw_flagged(bio, BIO_RW_SYNCIO);
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_is_sync(rq)];
+}
+
+/*
+ * the ioprio class is recorded in ->elevator_private when the request is
+ * allocated (or added, if its bio carried one), see flash_set_request()
+ */
+static inline int flash_rq_class(struct request *rq)
+{
+	int ioprio_class = (unsigned long) rq->elevator_private;
+
+	if (ioprio_class == IOPRIO_CLASS_NONE)
+		ioprio_class = IOPRIO_CLASS_BE;
+
+	return ioprio_class - IOPRIO_CLASS_RT;
+}
+
+static inline int flash_class_empty(struct flash_data *fd, int class)
+{
+	return list_empty(&fd->fifo_list[class][BLK_RW_SYNC])
+		&& list_empty(&fd->fifo_list[class][BLK_RW_ASYNC]);
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static inline void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq);
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_to_dispatch(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_rq == rq)
+		fd->next_rq = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+	int class, expire;
+
+	if (ioprio_valid(rq->ioprio))
+		rq->elevator_private =
+			(void *) (unsigned long) IOPRIO_PRIO_CLASS(rq->ioprio);
+	class = flash_rq_class(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	if (class == FLASH_CLASS_IDLE)
+		expire = fd->idle_expire;
+	else
+		expire = fd->fifo_expire[sync];
+
+	rq_set_fifo_time(rq, jiffies + expire);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[class][sync]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+/*
+ * Remember the ioprio class of the allocating task. rq->ioprio is only
+ * filled in from the bio after this, flash_add_request() prefers it.
+ */
+static int
+flash_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct io_context *ioc = current->io_context;
+	int ioprio_class;
+
+	if (ioc && ioprio_valid(ioc->ioprio))
+		ioprio_class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		ioprio_class = task_nice_ioclass(current);
+
+	rq->elevator_private = (void *) (unsigned long) ioprio_class;
+	return 0;
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+	int ret;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[flash_bio_sync(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				ret = ELEVATOR_FRONT_MERGE;
+				goto out;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+out:
+	*req = __rq;
+	return ret;
+}
+
+/*
+ * a sync bio must not be hidden in an async request, it would lose its
+ * place ahead of the writes
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	return rq_is_sync(rq) == flash_bio_sync(bio);
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo,
+	 * as long as both sit on the same fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    rq_is_sync(req) == rq_is_sync(next) &&
+	    flash_rq_class(req) == flash_rq_class(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static inline void
+flash_move_to_dispatch(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * move an entry to dispatch queue, remembering where a write batch
+ * continues
+ */
+static void
+flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	if (rq_is_sync(rq))
+		fd->next_rq = NULL;
+	else
+		fd->next_rq = flash_latter_request(rq);
+
+	flash_move_to_dispatch(fd, rq);
+}
+
+/*
+ * returns 1 if the oldest request of this class and direction has
+ * expired, 0 otherwise (or if there is none)
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int class, int sync)
+{
+	struct list_head *fifo = &fd->fifo_list[class][sync];
+
+	if (list_empty(fifo))
+		return 0;
+
+	return time_after(jiffies, rq_fifo_time(rq_entry_fifo(fifo->next)));
+}
+
+/*
+ * pick the ioprio class to serve. RT always goes first, an expired idle
+ * request is allowed ahead of BE so that the idle class cannot starve
+ * forever.
+ */
+static int flash_choose_class(struct flash_data *fd)
+{
+	if (!flash_class_empty(fd, FLASH_CLASS_RT))
+		return FLASH_CLASS_RT;
+
+	if (flash_check_fifo(fd, FLASH_CLASS_IDLE, BLK_RW_SYNC) ||
+	    flash_check_fifo(fd, FLASH_CLASS_IDLE, BLK_RW_ASYNC))
+		return FLASH_CLASS_IDLE;
+
+	if (!flash_class_empty(fd, FLASH_CLASS_BE))
+		return FLASH_CLASS_BE;
+
+	if (!flash_class_empty(fd, FLASH_CLASS_IDLE))
+		return FLASH_CLASS_IDLE;
+
+	return -1;
+}
+
+/*
+ * Erase block size in sectors. The mmc block driver advertises the
+ * erase group size as discard granularity when it cannot trim, which is
+ * only known after the elevator has been set up, so look it up late.
+ */
+static unsigned int flash_erase_sectors(struct flash_data *fd,
+					struct request_queue *q)
+{
+	if (fd->erase_block_kb)
+		return fd->erase_block_kb << 1;
+
+	if (q->limits.discard_granularity)
+		return q->limits.discard_granularity >> 9;
+
+	return default_erase_sectors;
+}
+
+/*
+ * Start a write batch on the erase block holding `rq'. The batch begins
+ * at the lowest queued write inside that block, whatever its class, so
+ * the block is programmed in ascending order in one run.
+ */
+static struct request *
+flash_start_batch(struct flash_data *fd, struct request *rq)
+{
+	unsigned int erase = flash_erase_sectors(fd, rq->q);
+	sector_t start = blk_rq_pos(rq);
+	struct rb_node *node;
+
+	sector_div(start, erase);
+	start *= erase;
+	fd->batch_end = start + erase;
+
+	while ((node = rb_prev(&rq->rb_node)) != NULL) {
+		struct request *prev = rb_entry_rq(node);
+
+		if (blk_rq_pos(prev) < start)
+			break;
+		rq = prev;
+	}
+
+	return rq;
+}
+
+/*
+ * flash_dispatch_requests serves sync requests in fifo order ahead of
+ * writes, and writes in erase block sized batches, according to the
+ * ioprio class, expire times and writes_starved
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq = fd->next_rq;
+	int class, sync, async;
+
+	/*
+	 * keep writing the current erase block, unless a sync request
+	 * has been waiting too long
+	 */
+	if (rq && fd->batching < fd->write_batch &&
+	    blk_rq_pos(rq) < fd->batch_end &&
+	    !flash_check_fifo(fd, FLASH_CLASS_RT, BLK_RW_SYNC) &&
+	    !flash_check_fifo(fd, FLASH_CLASS_BE, BLK_RW_SYNC))
+		goto dispatch_request;
+
+	class = flash_choose_class(fd);
+	if (class < 0)
+		return 0;
+
+	sync = !list_empty(&fd->fifo_list[class][BLK_RW_SYNC]);
+	async = !list_empty(&fd->fifo_list[class][BLK_RW_ASYNC]);
+
+	if (sync) {
+		if (async && (fd->starved >= fd->writes_starved ||
+			      flash_check_fifo(fd, class, BLK_RW_ASYNC)))
+			goto dispatch_writes;
+
+		if (async)
+			fd->starved++;
+
+		/*
+		 * no seek penalty on flash, so sync requests are simply
+		 * served oldest first
+		 */
+		rq = rq_entry_fifo(fd->fifo_list[class][BLK_RW_SYNC].next);
+		fd->batching = 0;
+		flash_move_request(fd, rq);
+		return 1;
+	}
+
+	/*
+	 * there are either no sync requests or writes have been starved
+	 */
+dispatch_writes:
+	BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[BLK_RW_ASYNC]));
+
+	fd->starved = 0;
+	rq = rq_entry_fifo(fd->fifo_list[class][BLK_RW_ASYNC].next);
+	rq = flash_start_batch(fd, rq);
+	fd->batching = 0;
+
+dispatch_request:
+	/*
+	 * rq is the selected appropriate request.
+	 */
+	fd->batching++;
+	flash_move_request(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	int class;
+
+	for (class = 0; class < FLASH_CLASS_NR; class++)
+		if (!flash_class_empty(fd, class))
+			return 0;
+
+	return 1;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!RB_EMPTY_ROOT(&fd->sort_list[BLK_RW_SYNC]));
+	BUG_ON(!RB_EMPTY_ROOT(&fd->sort_list[BLK_RW_ASYNC]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int class;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (class = 0; class < FLASH_CLASS_NR; class++) {
+		INIT_LIST_HEAD(&fd->fifo_list[class][BLK_RW_SYNC]);
+		INIT_LIST_HEAD(&fd->fifo_list[class][BLK_RW_ASYNC]);
+	}
+	fd->sort_list[BLK_RW_SYNC] = RB_ROOT;
+	fd->sort_list[BLK_RW_ASYNC] = RB_ROOT;
+	fd->fifo_expire[BLK_RW_SYNC] = sync_expire;
+	fd->fifo_expire[BLK_RW_ASYNC] = async_expire;
+	fd->idle_expire = idle_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_expire_show, fd->fifo_expire[BLK_RW_SYNC], 1);
+SHOW_FUNCTION(flash_async_expire_show, fd->fifo_expire[BLK_RW_ASYNC], 1);
+SHOW_FUNCTION(flash_idle_expire_show, fd->idle_expire, 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block_kb, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_expire_store, &fd->fifo_expire[BLK_RW_SYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_expire_store, &fd->fifo_expire[BLK_RW_ASYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_idle_expire_store, &fd->idle_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_erase_block_kb_store, &fd->erase_block_kb, 0, 64 * 1024, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(sync_expire),
+	FD_ATTR(async_expire),
+	FD_ATTR(idle_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR(erase_block_kb),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_set_req_fn =		flash_set_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -149,13 +149,6 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
-};
-
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
 {
 	int err;
@@ -291,217 +284,226 @@ static void remove_card(struct mmc_host *host)
 	mmc_schedule_card_removal_work(&host->remove, 0);
 }
 
-static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+enum mmc_blk_status {
+	MMC_BLK_SUCCESS = 0,
+	MMC_BLK_PARTIAL,
+	MMC_BLK_ERR,
+};
+
+/*
+ * Wait for a card to leave the programming state after a write.  Only
+ * used on the pipelined path: anything but a quick, clean answer makes
+ * the request go through mmc_blk_issue_rq_sync(), which knows how to
+ * recover the card.
+ */
+static int mmc_blk_wait_ready(struct mmc_card *card, struct request *req)
 {
-	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	ktime_t start,diff;
-	int ret = 1, disable_multi = 0, card_no_ready = 0;
-	int err = 0;
-	int try_recovery = 1, do_reinit = 0;
+	struct mmc_command cmd;
+	unsigned long delay = jiffies + HZ;
+	int err;
 
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
-	int retries = 3;
-	if (mmc_bus_needs_resume(card->host)) {
-		do {
-			err = mmc_resume_bus(card->host);
-			retries--;
-		} while (err && retries);
+	for (;;) {
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		err = mmc_wait_for_cmd(card->host, &cmd, 5);
 		if (err) {
-			spin_lock_irq(&md->lock);
-			__blk_end_request_all(req, -EIO);
-			spin_unlock_irq(&md->lock);
-			return 0;
-		}
-		retries = 3;
-		mmc_blk_set_blksize(md, card);
-
-		if (mmc_card_mmc(card)) {
-			struct mmc_command cmd;
-
-			unsigned long delay = jiffies + HZ;
-			int j = 0;
-			do {
-				int err;
-				cmd.opcode = MMC_SEND_STATUS;
-				cmd.arg = mq->card->rca << 16;
-				cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
-
-				mmc_claim_host(mq->card->host);
-				err = mmc_wait_for_cmd(mq->card->host, &cmd, 5);
-				mmc_release_host(mq->card->host);
-
-				if (err) {
-				printk(KERN_ERR "failed to get status(%d)!!\n"
-						, err);
-					msleep(5);
-					retries--;
-					continue;
-				}
-				if (time_after(jiffies, delay) && (fls(j) > 10)) {
-					if ((cmd.resp[0] & R1_READY_FOR_DATA) &&
-						(R1_CURRENT_STATE(cmd.resp[0]) == 4)) {
-						printk(KERN_ERR "Timeout but get card ready j = %d\n", j);
-						break;
-					}
-					card_no_ready++;
-					printk(KERN_ERR
-						"Failed to get card ready %d\n",
-						card_no_ready);
-					break;
-				}
-				j++;
-			} while (retries &&
-				(!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-				(R1_CURRENT_STATE(cmd.resp[0]) == 7)));
+			printk(KERN_ERR "%s: error %d requesting status\n",
+			       req->rq_disk->disk_name, err);
+			return -EIO;
 		}
+		/*
+		 * Some cards mishandle the status bits,
+		 * so make sure to check both the busy
+		 * indication and the card state.
+		 */
+		if ((cmd.resp[0] & R1_READY_FOR_DATA) &&
+		    (R1_CURRENT_STATE(cmd.resp[0]) != 7))
+			return 0;
+		if (time_after(jiffies, delay))
+			return -ETIMEDOUT;
 	}
+}
 
-	if (mmc_bus_fails_resume(card->host) || card_no_ready ||
-		!retries) {
-		spin_lock_irq(&md->lock);
-		__blk_end_request_all(req, -EIO);
-		spin_unlock_irq(&md->lock);
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
 
-		return 0;
-	}
-#endif
+	if (brq->cmd.error || brq->data.error || brq->stop.error)
+		return MMC_BLK_ERR;
 
-	mmc_claim_host(card->host);
+	if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ &&
+	    mmc_blk_wait_ready(card, req))
+		return MMC_BLK_ERR;
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
+	if (blk_rq_bytes(req) != brq->data.bytes_xfered)
+		return MMC_BLK_PARTIAL;
 
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
+	return MMC_BLK_SUCCESS;
+}
 
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = blk_rq_sectors(req);
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
+	if (brq->data.blocks > 1) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
+		 */
+		if (!mmc_host_is_spi(card->host)
+				|| rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
 
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
 
 #if defined(CONFIG_ARCH_MSM7X30)
-		if (board_emmc_boot())
-			if (mmc_card_mmc(card)) {
-				if (brq.cmd.arg < 131073) {/* should not write any value before 131073 */
-					pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
-						(unsigned)(current->pid), (unsigned)(current->tgid),
-						current->comm);
-					pr_err("ERROR! Attemp to write radio partition start %d size %d\n"
-						, brq.cmd.arg, blk_rq_sectors(req));
-					BUG();
-
-					return 0;
-				}
+	if (board_emmc_boot())
+		if (mmc_card_mmc(card)) {
+			if (brq->cmd.arg < 131073) {/* should not write any value before 131073 */
+				pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
+					(unsigned)(current->pid), (unsigned)(current->tgid),
+					current->comm);
+				pr_err("ERROR! Attemp to write radio partition start %d size %d\n"
+					, brq->cmd.arg, blk_rq_sectors(req));
+				BUG();
+			}
 #if defined(CONFIG_ARCH_MSM7230)
-				if ((brq.cmd.arg > 143361) && (brq.cmd.arg < 163328)) {
-
-					pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
-						(unsigned)(current->pid), (unsigned)(current->tgid),
-						current->comm);
-					pr_err("ERROR! Attemp to write radio partition start %d size %d\n"
-						, brq.cmd.arg, blk_rq_sectors(req));
-					BUG();
-
-
-					return 0;
-				}
-#endif
+			if ((brq->cmd.arg > 143361) && (brq->cmd.arg < 163328)) {
+
+				pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
+					(unsigned)(current->pid), (unsigned)(current->tgid),
+					current->comm);
+				pr_err("ERROR! Attemp to write radio partition start %d size %d\n"
+					, brq->cmd.arg, blk_rq_sectors(req));
+				BUG();
 			}
+#endif
+		}
 #endif
 #if defined(CONFIG_ARCH_MSM8X60)
-		if (board_emmc_boot())
-			if (mmc_card_mmc(card)) {
-				if ((brq.cmd.arg >= 65504) && (brq.cmd.arg < 65536)) {
-					pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
-						(unsigned)(current->pid), (unsigned)(current->tgid),
-						current->comm);
-					pr_err("ERROR! Attemp to write restricted partition start %d size %d\n"
-						, brq.cmd.arg, blk_rq_sectors(req));
+	if (board_emmc_boot())
+		if (mmc_card_mmc(card)) {
+			if ((brq->cmd.arg >= 65504) && (brq->cmd.arg < 65536)) {
+				pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
+					(unsigned)(current->pid), (unsigned)(current->tgid),
+					current->comm);
+				pr_err("ERROR! Attemp to write restricted partition start %d size %d\n"
+					, brq->cmd.arg, blk_rq_sectors(req));
+
+				BUG();
+			}
+		}
+#endif
+	}
 
-					BUG();
+	mmc_set_data_timeout(&brq->data, card);
 
-					return 0;
-				}
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != blk_rq_sectors(req)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-#endif
 		}
+		brq->data.sg_len = i;
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	mmc_queue_bounce_pre(mqrq);
+}
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
+/*
+ * Issue whatever is left of the request in @mqrq and wait for it, one
+ * chunk at a time, with the full error handling and card recovery.
+ * Called with the host claimed and nothing else on the bus.
+ */
+static int mmc_blk_issue_rq_sync(struct mmc_queue *mq,
+				 struct mmc_queue_req *mqrq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	ktime_t start,diff;
+	int ret = 1, disable_multi = 0, card_no_ready = 0;
+	int err = 0;
+	int try_recovery = 1, do_reinit = 0;
 
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
-			}
-			brq.data.sg_len = i;
-		}
+	do {
+		struct mmc_command cmd;
+		u32 status = 0;
 
-		mmc_queue_bounce_pre(mq);
+		mmc_blk_rw_rq_prep(mqrq, card, disable_multi, mq);
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+		mmc_wait_for_req(card->host, &brq->mrq);
 
-		mmc_queue_bounce_post(mq);
+		mmc_queue_bounce_post(mqrq);
 
 
 		/*
@@ -509,13 +511,13 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * until later as we need to wait for the card to leave
 		 * programming mode even when things go wrong.
 		 */
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
-				if (brq.cmd.error) {
+		if (brq->cmd.error || brq->data.error || brq->stop.error) {
+			if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
+				if (brq->cmd.error) {
 					printk(KERN_ERR "%s: error %d sending read "
 						"command, response %#x\n",
-						req->rq_disk->disk_name, brq.cmd.error,
-						brq.cmd.resp[0]);
+						req->rq_disk->disk_name, brq->cmd.error,
+						brq->cmd.resp[0]);
 				}
 				/* Redo read one sector at a time */
 				printk(KERN_WARNING "%s: retrying using single "
@@ -528,29 +530,29 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			disable_multi = 0;
 		}
 
-		if (brq.cmd.error) {
+		if (brq->cmd.error) {
 			printk(KERN_ERR "%s: error %d sending read/write "
 			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
+			       req->rq_disk->disk_name, brq->cmd.error,
+			       brq->cmd.resp[0], status);
 		}
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
+		if (brq->data.error) {
+			if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
 				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
+				status = brq->mrq.stop->resp[0];
 			printk(KERN_ERR "%s: error %d transferring data,"
 			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
+			       req->rq_disk->disk_name, brq->data.error,
 			       (unsigned)blk_rq_pos(req),
 			       (unsigned)blk_rq_sectors(req), status);
 		}
 
-		if (brq.stop.error) {
+		if (brq->stop.error) {
 			printk(KERN_ERR "%s: error %d sending stop command, "
 			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
+			       req->rq_disk->disk_name, brq->stop.error,
+			       brq->stop.resp[0], status);
 		}
 
 		if (!mmc_host_is_spi(card->host) && rq_data_dir(req) != READ) {
@@ -629,8 +631,8 @@ mmc_recovery:
 				goto mmc_cmd_err;
 		}
 
-		if (brq.cmd.error || brq.stop.error ||
-			brq.data.error || card_no_ready) {
+		if (brq->cmd.error || brq->stop.error ||
+			brq->data.error || card_no_ready) {
 			if (try_recovery == 1)
 				do_reinit = 1;
 			try_recovery++;
@@ -643,7 +645,7 @@ mmc_recovery:
 				 * read a single sector.
 				 */
 				spin_lock_irq(&md->lock);
-				ret = __blk_end_request(req, -EIO, brq.data.blksz);
+				ret = __blk_end_request(req, -EIO, brq->data.blksz);
 				spin_unlock_irq(&md->lock);
 				continue;
 			}
@@ -654,12 +656,10 @@ mmc_recovery:
 		 * A block was successfully transferred.
 		 */
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	} while (ret);
 
-	mmc_release_host(card->host);
-
 	return 1;
 
  mmc_cmd_err:
@@ -673,11 +673,9 @@ mmc_recovery:
 	 */
 
 	spin_lock_irq(&md->lock);
-	ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+	ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 	spin_unlock_irq(&md->lock);
 
-	mmc_release_host(card->host);
-
 	spin_lock_irq(&md->lock);
 	start = ktime_get();
 	while (ret) {
@@ -693,6 +691,298 @@ mmc_recovery:
 	return 0;
 }
 
+/*
+ * Start @rqc (if any) as soon as the request already on the bus has
+ * completed, and complete the latter.  The block layer only sees the
+ * fast path here: a request which failed or came back short is not
+ * overlapped with the next one, but finished by mmc_blk_issue_rq_sync()
+ * on an idle bus before @rqc is started.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq;
+	struct mmc_queue_req *mq_rq;
+	struct mmc_async_req *areq = NULL;
+	struct request *req;
+	int ret = 1, status;
+
+	if (rqc) {
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		areq = &mq->mqrq_cur->mmc_active;
+	}
+
+	areq = mmc_start_req(card->host, areq, &status);
+	if (!areq)
+		return 1;
+
+	mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+	brq = &mq_rq->brq;
+	req = mq_rq->req;
+	mmc_queue_bounce_post(mq_rq);
+
+	switch (status) {
+	case MMC_BLK_SUCCESS:
+		spin_lock_irq(&md->lock);
+		__blk_end_request(req, 0, brq->data.bytes_xfered);
+		spin_unlock_irq(&md->lock);
+		return 1;
+	case MMC_BLK_PARTIAL:
+		spin_lock_irq(&md->lock);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
+		spin_unlock_irq(&md->lock);
+		if (ret)
+			ret = mmc_blk_issue_rq_sync(mq, mq_rq);
+		break;
+	default:
+		ret = mmc_blk_issue_rq_sync(mq, mq_rq);
+		break;
+	}
+
+	/* The bus is idle again: rqc was not started. */
+	if (rqc) {
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		areq = mmc_start_req(card->host, &mq->mqrq_cur->mmc_active,
+				     &status);
+		WARN_ON(areq);
+		/*
+		 * If something on the bus failed after all, rqc was left
+		 * unstarted: finish it here, with the error handling.
+		 */
+		if (status) {
+			if (!mmc_blk_issue_rq_sync(mq, mq->mqrq_cur))
+				ret = 0;
+			mq->mqrq_cur->req = NULL;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Filesystems discard freed extents one request at a time, and the
+ * elevator will not merge discards beyond max_sectors.  Pull any
+ * discards queued right behind @req which continue its range, so that
+ * they go to the card as a single erase, up to max_discard_sectors.
+ */
+static unsigned int mmc_blk_gather_discards(struct mmc_queue *mq,
+					    struct request *req,
+					    struct list_head *batch)
+{
+	struct mmc_blk_data *md = mq->data;
+	unsigned int secure = req->cmd_flags & REQ_SECURE;
+	unsigned int max = mq->queue->limits.max_discard_sectors;
+	unsigned int nr = blk_rq_sectors(req);
+	struct request *next;
+
+	spin_lock_irq(&md->lock);
+	while ((next = blk_peek_request(mq->queue)) != NULL) {
+		if (!blk_discard_rq(next) ||
+		    (next->cmd_flags & REQ_SECURE) != secure ||
+		    blk_rq_pos(next) != blk_rq_pos(req) + nr ||
+		    nr >= max || blk_rq_sectors(next) > max - nr)
+			break;
+		blk_start_request(next);
+		list_add_tail(&next->queuelist, batch);
+		nr += blk_rq_sectors(next);
+	}
+	spin_unlock_irq(&md->lock);
+
+	return nr;
+}
+
+/*
+ * Whether the @nr sectors at @from reach into an area the write path
+ * (mmc_blk_rw_rq_prep) refuses to write.  Its limits are command
+ * arguments: sectors on block addressed cards, bytes on the others.
+ */
+static int mmc_blk_discard_restricted(struct mmc_card *card,
+				      unsigned int from, unsigned int nr)
+{
+#if defined(CONFIG_ARCH_MSM7X30) || defined(CONFIG_ARCH_MSM8X60)
+	u64 start = from, end = (u64)from + nr;
+
+	if (!board_emmc_boot() || !mmc_card_mmc(card))
+		return 0;
+	if (!mmc_card_blockaddr(card)) {
+		start <<= 9;
+		end <<= 9;
+	}
+#if defined(CONFIG_ARCH_MSM7X30)
+	/* radio partition */
+	if (start < 131073)
+		return 1;
+#if defined(CONFIG_ARCH_MSM7230)
+	if (start < 163328 && end > 143362)
+		return 1;
+#endif
+#endif
+#if defined(CONFIG_ARCH_MSM8X60)
+	/* restricted partition */
+	if (start < 65536 && end > 65504)
+		return 1;
+#endif
+#endif
+	return 0;
+}
+
+static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned int from, nr, arg;
+	struct request *next, *tmp;
+	LIST_HEAD(batch);
+	int err;
+
+	from = blk_rq_pos(req);
+	nr = mmc_blk_gather_discards(mq, req, &batch);
+
+	if (mmc_blk_discard_restricted(card, from, nr)) {
+		pr_err("%s: pid %d(tgid %d)(%s)\n", __func__,
+			(unsigned)(current->pid), (unsigned)(current->tgid),
+			current->comm);
+		pr_err("ERROR! Attempt to discard restricted partition "
+			"start %u size %u\n", from, nr);
+		err = -EIO;
+	} else if (req->cmd_flags & REQ_SECURE) {
+		if (!mmc_can_secure_erase_trim(card))
+			err = -EOPNOTSUPP;
+		else {
+			if (mmc_can_trim(card) &&
+			    !mmc_erase_group_aligned(card, from, nr))
+				arg = MMC_SECURE_TRIM1_ARG;
+			else
+				arg = MMC_SECURE_ERASE_ARG;
+			err = mmc_erase(card, from, nr, arg);
+			if (!err && arg == MMC_SECURE_TRIM1_ARG)
+				err = mmc_erase(card, from, nr,
+						MMC_SECURE_TRIM2_ARG);
+		}
+	} else {
+		if (mmc_can_trim(card))
+			arg = MMC_TRIM_ARG;
+		else
+			arg = MMC_ERASE_ARG;
+		err = mmc_erase(card, from, nr, arg);
+	}
+
+	spin_lock_irq(&md->lock);
+	__blk_end_request(req, err, blk_rq_bytes(req));
+	list_for_each_entry_safe(next, tmp, &batch, queuelist) {
+		list_del_init(&next->queuelist);
+		__blk_end_request(next, err, blk_rq_bytes(next));
+	}
+	spin_unlock_irq(&md->lock);
+
+	/* a card that can't discard isn't a failure of the queue */
+	return err && err != -EOPNOTSUPP ? 0 : 1;
+}
+
+static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
+
+	if (req && !mq->mqrq_prev->req) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		int err = 0, card_no_ready = 0;
+		int retries = 3;
+		if (mmc_bus_needs_resume(card->host)) {
+			do {
+				err = mmc_resume_bus(card->host);
+				retries--;
+			} while (err && retries);
+			if (err) {
+				spin_lock_irq(&md->lock);
+				__blk_end_request_all(req, -EIO);
+				spin_unlock_irq(&md->lock);
+				mq->mqrq_cur->req = NULL;
+				return 0;
+			}
+			retries = 3;
+			mmc_blk_set_blksize(md, card);
+
+			if (mmc_card_mmc(card)) {
+				struct mmc_command cmd;
+
+				unsigned long delay = jiffies + HZ;
+				int j = 0;
+				do {
+					int err;
+					cmd.opcode = MMC_SEND_STATUS;
+					cmd.arg = mq->card->rca << 16;
+					cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+					mmc_claim_host(mq->card->host);
+					err = mmc_wait_for_cmd(mq->card->host, &cmd, 5);
+					mmc_release_host(mq->card->host);
+
+					if (err) {
+					printk(KERN_ERR "failed to get status(%d)!!\n"
+							, err);
+						msleep(5);
+						retries--;
+						continue;
+					}
+					if (time_after(jiffies, delay) && (fls(j) > 10)) {
+						if ((cmd.resp[0] & R1_READY_FOR_DATA) &&
+							(R1_CURRENT_STATE(cmd.resp[0]) == 4)) {
+							printk(KERN_ERR "Timeout but get card ready j = %d\n", j);
+							break;
+						}
+						card_no_ready++;
+						printk(KERN_ERR
+							"Failed to get card ready %d\n",
+							card_no_ready);
+						break;
+					}
+					j++;
+				} while (retries &&
+					(!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+					(R1_CURRENT_STATE(cmd.resp[0]) == 7)));
+			}
+		}
+
+		if (mmc_bus_fails_resume(card->host) || card_no_ready ||
+			!retries) {
+			spin_lock_irq(&md->lock);
+			__blk_end_request_all(req, -EIO);
+			spin_unlock_irq(&md->lock);
+			mq->mqrq_cur->req = NULL;
+
+			return 0;
+		}
+#endif
+		/* claim host only for the first request */
+		mmc_claim_host(card->host);
+	}
+
+	if (req && blk_discard_rq(req)) {
+		/* complete the transfer still on the bus first */
+		if (card->host->areq)
+			mmc_blk_issue_rw_rq(mq, NULL);
+		ret = mmc_blk_issue_discard_rq(mq, req);
+		/*
+		 * The discard is done, not on the bus: don't let the queue
+		 * thread take it for the previous request, and release the
+		 * host as when the queue runs empty.
+		 */
+		mq->mqrq_cur->req = NULL;
+		mmc_release_host(card->host);
+		return ret;
+	} else
+		ret = mmc_blk_issue_rw_rq(mq, req);
+
+	/* release host only when there are no more requests */
+	if (!req)
+		mmc_release_host(card->host);
+
+	return ret;
+}
+
 static int sd_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -865,8 +1155,8 @@ static int sd_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 		mmc_set_data_timeout(&brq.data, card);
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+		brq.data.sg = mq->mqrq_cur->sg;
+		brq.data.sg_len = mmc_queue_map_sg(mq, mq->mqrq_cur);
 
 		/*
 		 * Adjust the sg list so it is the same size as the
@@ -890,11 +1180,11 @@ static int sd_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			start = ktime_get();
 		}
 #endif
-		mmc_queue_bounce_pre(mq);
+		mmc_queue_bounce_pre(mq->mqrq_cur);
 
 		mmc_wait_for_req(card->host, &brq.mrq);
 
-		mmc_queue_bounce_post(mq);
+		mmc_queue_bounce_post(mq->mqrq_cur);
 
 #ifdef CONFIG_MMC_PERF_PROFILING
 		if (mmc_card_sd(card)) {
@@ -16,6 +16,9 @@
 #include <linux/slab.h>
 
 #include <linux/scatterlist.h>
+#include <linux/random.h>
+#include <linux/time.h>
+#include <linux/kernel_stat.h>
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -25,6 +28,35 @@
 #define BUFFER_ORDER		2
 #define BUFFER_SIZE		(PAGE_SIZE << BUFFER_ORDER)
 
+#define PERF_COUNT		512
+
+/*
+ * The performance tests work in a test area of TEST_AREA_SIZE bytes in
+ * the middle of the card, whose contents they destroy, and the large
+ * transfer tests move LARGE_PERF_SIZE bytes through it.
+ */
+#define TEST_AREA_SIZE		(4 * 1024 * 1024)
+#define TEST_AREA_SECTORS	(TEST_AREA_SIZE / 512)
+#define LARGE_PERF_SIZE		(64 * 1024 * 1024)
+
+struct mmc_test_pages {
+	struct page	*page;
+	unsigned int	order;
+};
+
+/*
+ * Memory for one request of up to TEST_AREA_SIZE bytes, in as few
+ * chunks of pages as could be allocated, mapped as the host allows.
+ */
+struct mmc_test_area {
+	unsigned int		dev_addr;	/* first sector, 0 if no room */
+	struct mmc_test_pages	*pages;
+	unsigned int		cnt;
+	struct scatterlist	*sg;
+	unsigned int		sg_len;
+	unsigned int		tfr_size;	/* bytes the sg list holds */
+};
+
 struct mmc_test_card {
 	struct mmc_card	*card;
 
@@ -33,6 +65,7 @@ struct mmc_test_card {
 #ifdef CONFIG_HIGHMEM
 	struct page	*highmem;
 #endif
+	struct mmc_test_area	area;
 };
 
 /*******************************************************************/
@@ -895,6 +928,361 @@ static int mmc_test_multi_read_high(struct mmc_test_card *test)
 
 #endif /* CONFIG_HIGHMEM */
 
+/*******************************************************************/
+/*  Performance tests                                              */
+/*******************************************************************/
+
+struct mmc_test_async_req {
+	struct mmc_async_req	areq;
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_command	stop;
+	struct mmc_data		data;
+	struct scatterlist	sg;
+	struct mmc_test_card	*test;
+};
+
+static int mmc_test_check_result_async(struct mmc_card *card,
+	struct mmc_async_req *areq)
+{
+	struct mmc_test_async_req *req =
+		container_of(areq, struct mmc_test_async_req, areq);
+	int ret;
+
+	ret = mmc_test_check_result(req->test, &req->mrq);
+	if (!ret && (req->data.flags & MMC_DATA_WRITE))
+		ret = mmc_test_wait_busy(req->test);
+
+	return ret;
+}
+
+/*
+ * Issue PERF_COUNT transfers of 'size' bytes from the test area, either
+ * one after the other with mmc_wait_for_req(), or through
+ * mmc_start_req() so that the host can prepare each request while the
+ * previous one is on the bus, and report the throughput.
+ */
+static int mmc_test_perf_transfer(struct mmc_test_card *test,
+	unsigned size, int write, int random, int nonblock)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_async_req rq[2];
+	struct mmc_test_async_req *cur;
+	struct timespec ts1, ts2, ts;
+	unsigned blocks = size / 512;
+	unsigned area = TEST_AREA_SECTORS;
+	unsigned dev_addr = 0;
+	u64 ns, rate;
+	int i, ret = 0;
+
+	getnstimeofday(&ts1);
+
+	for (i = 0; i < PERF_COUNT; i++) {
+		cur = &rq[nonblock ? (i & 1) : 0];
+
+		memset(cur, 0, sizeof(struct mmc_test_async_req));
+		cur->mrq.cmd = &cur->cmd;
+		cur->mrq.data = &cur->data;
+		cur->mrq.stop = &cur->stop;
+		cur->test = test;
+
+		if (random)
+			dev_addr = random32() % (area - blocks + 1);
+		else
+			dev_addr = (dev_addr + blocks) % (area - blocks + 1);
+
+		sg_init_one(&cur->sg, test->buffer, size);
+		mmc_test_prepare_mrq(test, &cur->mrq, &cur->sg, 1,
+			test->area.dev_addr + dev_addr, blocks, 512, write);
+
+		if (nonblock) {
+			cur->areq.mrq = &cur->mrq;
+			cur->areq.err_check = mmc_test_check_result_async;
+			mmc_start_req(host, &cur->areq, &ret);
+		} else {
+			mmc_wait_for_req(host, &cur->mrq);
+			ret = mmc_test_check_result(test, &cur->mrq);
+			if (!ret && write)
+				ret = mmc_test_wait_busy(test);
+		}
+		if (ret)
+			break;
+	}
+
+	if (nonblock && !ret)
+		mmc_start_req(host, NULL, &ret);
+	if (ret)
+		return ret;
+
+	getnstimeofday(&ts2);
+
+	ts = timespec_sub(ts2, ts1);
+	ns = timespec_to_ns(&ts);
+	rate = (u64)size * PERF_COUNT * NSEC_PER_SEC;
+	if (ns)
+		rate = div64_u64(rate, ns);
+
+	printk(KERN_INFO "%s: %s %s of %u x %u bytes in %lu.%09lu s: "
+		"%llu KiB/s\n", mmc_hostname(host),
+		nonblock ? "non-blocking" : "blocking",
+		write ? "write" : "read", PERF_COUNT, size,
+		(unsigned long)ts.tv_sec, (unsigned long)ts.tv_nsec,
+		rate >> 10);
+
+	return 0;
+}
+
+static int mmc_test_perf(struct mmc_test_card *test, int write, int random)
+{
+	unsigned int size;
+	int ret;
+
+	/* Small requests for random access, the whole area otherwise */
+	size = random ? 4096 : BUFFER_SIZE;
+	size = min(size, test->card->host->max_req_size);
+	size = min(size, test->card->host->max_seg_size);
+	size = min(size, test->card->host->max_blk_count * 512);
+
+	if (size < 512)
+		return RESULT_UNSUP_HOST;
+	if (!test->area.dev_addr)
+		return RESULT_UNSUP_CARD;
+
+	ret = mmc_test_perf_transfer(test, size, write, random, 0);
+	if (ret)
+		return ret;
+
+	return mmc_test_perf_transfer(test, size, write, random, 1);
+}
+
+static int mmc_test_perf_seq_write(struct mmc_test_card *test)
+{
+	return mmc_test_perf(test, 1, 0);
+}
+
+static int mmc_test_perf_seq_read(struct mmc_test_card *test)
+{
+	return mmc_test_perf(test, 0, 0);
+}
+
+static int mmc_test_perf_rnd_write(struct mmc_test_card *test)
+{
+	return mmc_test_perf(test, 1, 1);
+}
+
+static int mmc_test_perf_rnd_read(struct mmc_test_card *test)
+{
+	return mmc_test_perf(test, 0, 1);
+}
+
+static unsigned int mmc_test_capacity(struct mmc_card *card)
+{
+	if (!mmc_card_sd(card) && mmc_card_blockaddr(card))
+		return card->ext_csd.sectors;
+	else
+		return card->csd.capacity << (card->csd.read_blkbits - 9);
+}
+
+static int mmc_test_area_cleanup(struct mmc_test_card *test)
+{
+	struct mmc_test_area *t = &test->area;
+
+	while (t->cnt--)
+		__free_pages(t->pages[t->cnt].page, t->pages[t->cnt].order);
+	kfree(t->pages);
+	kfree(t->sg);
+	memset(t, 0, sizeof(struct mmc_test_area));
+
+	return 0;
+}
+
+/*
+ * Place the test area in the middle of the card and allocate the memory
+ * for the largest request the host takes, up to TEST_AREA_SIZE: chunks
+ * as large as a segment while that works, smaller ones after, and an sg
+ * list over them within the host's segment count and size.  A host that
+ * can't take a whole block leaves tfr_size at 0.
+ */
+static int mmc_test_area_prepare(struct mmc_test_card *test)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_area *t = &test->area;
+	unsigned int max_tfr, max_segs, max_pages, order, size, off, len;
+	unsigned int capacity, i;
+	struct scatterlist *sg;
+	struct page *page;
+
+	memset(t, 0, sizeof(struct mmc_test_area));
+
+	capacity = mmc_test_capacity(test->card);
+	if (capacity >= 2 * TEST_AREA_SECTORS)
+		t->dev_addr = (capacity / 2) & ~(TEST_AREA_SECTORS - 1);
+
+	max_tfr = min(host->max_req_size, host->max_blk_count * 512);
+	max_tfr = min(max_tfr, (unsigned int)TEST_AREA_SIZE) & ~511;
+	max_segs = min(host->max_hw_segs, host->max_phys_segs);
+	max_pages = DIV_ROUND_UP(max_tfr, PAGE_SIZE);
+	if (!max_tfr || !max_segs || !host->max_seg_size)
+		return 0;
+
+	t->pages = kcalloc(max_pages, sizeof(struct mmc_test_pages),
+		GFP_KERNEL);
+	t->sg = kcalloc(max_segs, sizeof(struct scatterlist), GFP_KERNEL);
+	if (!t->pages || !t->sg)
+		goto out_free;
+
+	order = get_order(min(host->max_seg_size, max_tfr));
+	for (size = 0; size < max_tfr && t->cnt < max_pages;) {
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+			order);
+		if (!page) {
+			if (!order)
+				break;
+			order--;
+			continue;
+		}
+		t->pages[t->cnt].page = page;
+		t->pages[t->cnt++].order = order;
+		size += PAGE_SIZE << order;
+	}
+	if (!t->cnt)
+		goto out_free;
+
+	sg_init_table(t->sg, max_segs);
+	for (i = 0; i < t->cnt; i++) {
+		size = PAGE_SIZE << t->pages[i].order;
+		for (off = 0; off < size; off += len) {
+			if (t->sg_len == max_segs || t->tfr_size == max_tfr)
+				goto mapped;
+			len = min(size - off, host->max_seg_size);
+			len = min(len, max_tfr - t->tfr_size);
+			sg_set_page(&t->sg[t->sg_len++],
+				nth_page(t->pages[i].page, off >> PAGE_SHIFT),
+				len, off & ~PAGE_MASK);
+			t->tfr_size += len;
+		}
+	}
+mapped:
+	/* Whole blocks only */
+	while (t->tfr_size & 511) {
+		sg = &t->sg[t->sg_len - 1];
+		len = min(sg->length, t->tfr_size & 511);
+		sg->length -= len;
+		t->tfr_size -= len;
+		if (!sg->length)
+			t->sg_len--;
+	}
+	if (t->sg_len)
+		sg_mark_end(&t->sg[t->sg_len - 1]);
+
+	return 0;
+
+out_free:
+	mmc_test_area_cleanup(test);
+	return -ENOMEM;
+}
+
+/* Busy time of all online cpus, whatever they were busy with */
+static cputime64_t mmc_test_cpu_busy(void)
+{
+	cputime64_t busy = cputime64_zero;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.user);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.nice);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.system);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.irq);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.softirq);
+	}
+
+	return busy;
+}
+
+/*
+ * Move LARGE_PERF_SIZE bytes through the test area in requests as large
+ * as the host takes, each over the whole multi-segment sg list, and
+ * report the throughput and the cpu time spent per MiB meanwhile.
+ */
+static int mmc_test_large_perf(struct mmc_test_card *test, int write)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_area *t = &test->area;
+	struct mmc_request mrq;
+	struct mmc_command cmd;
+	struct mmc_command stop;
+	struct mmc_data data;
+	struct timespec ts1, ts2, ts;
+	cputime64_t cpu;
+	unsigned int blocks, dev_addr = 0, count, cpu_ms, mib, i;
+	u64 ns, rate;
+	int ret;
+
+	if (!t->tfr_size)
+		return RESULT_UNSUP_HOST;
+	if (!t->dev_addr)
+		return RESULT_UNSUP_CARD;
+
+	blocks = t->tfr_size / 512;
+	count = DIV_ROUND_UP(LARGE_PERF_SIZE, t->tfr_size);
+
+	cpu = mmc_test_cpu_busy();
+	getnstimeofday(&ts1);
+
+	for (i = 0; i < count; i++) {
+		memset(&mrq, 0, sizeof(struct mmc_request));
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		memset(&stop, 0, sizeof(struct mmc_command));
+		memset(&data, 0, sizeof(struct mmc_data));
+		mrq.cmd = &cmd;
+		mrq.data = &data;
+		mrq.stop = &stop;
+
+		mmc_test_prepare_mrq(test, &mrq, t->sg, t->sg_len,
+			t->dev_addr + dev_addr, blocks, 512, write);
+		mmc_wait_for_req(host, &mrq);
+
+		ret = mmc_test_check_result(test, &mrq);
+		if (!ret && write)
+			ret = mmc_test_wait_busy(test);
+		if (ret)
+			return ret;
+
+		dev_addr = (dev_addr + blocks) % (TEST_AREA_SECTORS - blocks + 1);
+	}
+
+	getnstimeofday(&ts2);
+	cpu_ms = jiffies_to_msecs((unsigned long)cputime64_to_jiffies64(
+		cputime64_sub(mmc_test_cpu_busy(), cpu)));
+
+	ts = timespec_sub(ts2, ts1);
+	ns = timespec_to_ns(&ts);
+	rate = (u64)t->tfr_size * count * NSEC_PER_SEC;
+	if (ns)
+		rate = div64_u64(rate, ns);
+	mib = ((u64)t->tfr_size * count) >> 20;
+
+	printk(KERN_INFO "%s: %s of %u MiB in %u x %u bytes (%u segments) "
+		"in %lu.%09lu s: %llu.%02llu MiB/s, cpu %u ms (%u us/MiB)\n",
+		mmc_hostname(host), write ? "write" : "read", mib, count,
+		t->tfr_size, t->sg_len,
+		(unsigned long)ts.tv_sec, (unsigned long)ts.tv_nsec,
+		rate >> 20, ((rate & ((1 << 20) - 1)) * 100) >> 20,
+		cpu_ms, mib ? cpu_ms * 1000 / mib : 0);
+
+	return 0;
+}
+
+static int mmc_test_large_perf_write(struct mmc_test_card *test)
+{
+	return mmc_test_large_perf(test, 1);
+}
+
+static int mmc_test_large_perf_read(struct mmc_test_card *test)
+{
+	return mmc_test_large_perf(test, 0);
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -1042,6 +1430,48 @@ static const struct mmc_test_case mmc_test_cases[] = {
 
 #endif /* CONFIG_HIGHMEM */
 
+	{
+		.name = "Sequential write performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Sequential read performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_seq_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random write performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Random read performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_perf_rnd_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Large multi-segment write performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_large_perf_write,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
+	{
+		.name = "Large multi-segment read performance",
+		.prepare = mmc_test_area_prepare,
+		.run = mmc_test_large_perf_read,
+		.cleanup = mmc_test_area_cleanup,
+	},
+
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
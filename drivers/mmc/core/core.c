@@ -240,16 +240,17 @@ void msmsdcc_request_end(struct msmsdcc_host *host, struct mmc_request *mrq);
 void msmsdcc_stop_data(struct msmsdcc_host *host);
 void msmsdcc_reset_and_restore(struct msmsdcc_host *host);
 
-/**
- *	mmc_wait_for_req - start a request and wait for completion
- *	@host: MMC host to start command
- *	@mrq: MMC request to start
- *
- *	Start a new MMC custom command request for a host, and wait
- *	for the command to complete. Does not attempt to parse the
- *	response.
- */
-void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	init_completion(&mrq->completion);
+	mrq->done_data = &mrq->completion;
+	mrq->done = mmc_wait_done;
+
+	mmc_start_request(host, mrq);
+}
+
+static void mmc_wait_for_req_done(struct mmc_host *host,
+				  struct mmc_request *mrq)
 {
 #ifdef CONFIG_WIMAX
 #ifdef CONFIG_WIMAX_MMC_TIMEOUT
@@ -258,13 +259,7 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 	int timeout = 0;
 #endif
 #endif
-
-	DECLARE_COMPLETION_ONSTACK(complete);
-
-	mrq->done_data = &complete;
-	mrq->done = mmc_wait_done;
-
-	mmc_start_request(host, mrq);
+	struct completion *complete = &mrq->completion;
 
 #ifdef CONFIG_WIMAX
 #ifdef CONFIG_WIMAX_MMC
@@ -272,10 +267,10 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 	if ( !(strcmp(mmc_hostname(host), CONFIG_WIMAX_MMC))) {
 
 #ifdef CONFIG_WIMAX_REQ_TIMEOUT
-		ret = wait_for_completion_timeout(&complete, msecs_to_jiffies(CONFIG_WIMAX_REQ_TIMEOUT));
+		ret = wait_for_completion_timeout(complete, msecs_to_jiffies(CONFIG_WIMAX_REQ_TIMEOUT));
 		timeout = CONFIG_WIMAX_REQ_TIMEOUT;
 #else
-		ret = wait_for_completion_timeout(&complete, msecs_to_jiffies(5000));
+		ret = wait_for_completion_timeout(complete, msecs_to_jiffies(5000));
 		timeout = 5000;
 #endif
 		if (ret <= 0) {
@@ -291,10 +286,115 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 #endif
 #endif
 #endif
-		wait_for_completion_io(&complete);
+		wait_for_completion_io(complete);
 
 }
 
+/**
+ *	mmc_pre_req - Prepare for a new request
+ *	@host: MMC host to prepare command
+ *	@mrq: MMC request to prepare for
+ *	@is_first_req: true if there is no previous started request
+ *                     that may run in parallel to this call, otherwise false
+ *
+ *	mmc_pre_req() is called prior to mmc_start_req() to let
+ *	host prepare for the new request. Preparation of a request may be
+ *	performed while another request is running on the host.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+		 bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+/**
+ *	mmc_post_req - Post process a completed request
+ *	@host: MMC host to post process command
+ *	@mrq: MMC request to post process for
+ *	@err: Error, if non zero, clean up any resources made in pre_req
+ *
+ *	Let the host post process a completed request. Post processing of
+ *	a request may be performed while another request is running.
+ */
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start
+ *	@error: out parameter returns 0 for success, otherwise non zero
+ *
+ *	Start a new MMC custom command request for a host.
+ *	If there is an ongoing async request, wait for completion
+ *	of that request, start the new one and return.
+ *	Does not wait for the new request to complete.
+ *
+ *	Returns the completed request, or NULL if there was no ongoing
+ *	request, in which case it returns without waiting.  NULL is not
+ *	an error condition.
+ *
+ *	If the completed request failed its err_check, the new request is
+ *	not started: it is post processed with an error, and the caller
+ *	must handle both requests itself.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	int err = 0;
+	struct mmc_async_req *data = host->areq;
+
+	/* Prepare a new request */
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		mmc_wait_for_req_done(host, host->areq->mrq);
+		err = host->areq->err_check(host->card, host->areq);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq)
+		__mmc_start_req(host, areq->mrq);
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
+/**
+ *	mmc_wait_for_req - start a request and wait for completion
+ *	@host: MMC host to start command
+ *	@mrq: MMC request to start
+ *
+ *	Start a new MMC custom command request for a host, and wait
+ *	for the command to complete. Does not attempt to parse the
+ *	response.
+ */
+void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	__mmc_start_req(host, mrq);
+	mmc_wait_for_req_done(host, mrq);
+}
+
 EXPORT_SYMBOL(mmc_wait_for_req);
 
 /**
@@ -437,6 +537,284 @@ unsigned int mmc_align_data_size(struct mmc_card *card, unsigned int sz)
 }
 EXPORT_SYMBOL(mmc_align_data_size);
 
+/*
+ * Work out the erase unit and a preferred erase size for the card.  The
+ * preferred size is a multiple of the erase unit which a filesystem can
+ * use to lay out discards: the high capacity erase group when the card
+ * has one, and otherwise a figure scaled to the card size.
+ */
+void mmc_init_erase(struct mmc_card *card)
+{
+	unsigned int sz;
+
+	if (is_power_of_2(card->erase_size))
+		card->erase_shift = ffs(card->erase_size) - 1;
+	else
+		card->erase_shift = 0;
+
+	if (card->ext_csd.hc_erase_size) {
+		card->pref_erase = card->ext_csd.hc_erase_size;
+	} else if (card->erase_size) {
+		sz = (card->csd.capacity << (card->csd.read_blkbits - 9)) >> 11;
+		if (sz < 128)
+			card->pref_erase = 512 * 1024 / 512;
+		else if (sz < 512)
+			card->pref_erase = 1024 * 1024 / 512;
+		else if (sz < 1024)
+			card->pref_erase = 2 * 1024 * 1024 / 512;
+		else
+			card->pref_erase = 4 * 1024 * 1024 / 512;
+		if (card->pref_erase < card->erase_size)
+			card->pref_erase = card->erase_size;
+		else {
+			sz = card->pref_erase % card->erase_size;
+			if (sz)
+				card->pref_erase += card->erase_size - sz;
+		}
+	} else
+		card->pref_erase = 0;
+}
+
+static unsigned int mmc_erase_timeout(struct mmc_card *card,
+				      unsigned int arg, unsigned int qty)
+{
+	unsigned int erase_timeout;
+
+	if (card->ext_csd.erase_group_def & 1) {
+		/* High Capacity Erase Group Size uses HC timeouts */
+		if (arg == MMC_TRIM_ARG)
+			erase_timeout = card->ext_csd.trim_timeout;
+		else
+			erase_timeout = card->ext_csd.hc_erase_timeout;
+	} else {
+		/* CSD Erase Group Size uses write timeout */
+		unsigned int mult = (10 << card->csd.r2w_factor);
+		unsigned int timeout_clks = card->csd.tacc_clks * mult;
+		unsigned int timeout_us;
+
+		/* Avoid overflow: e.g. tacc_ns=80000000 mult=1280 */
+		if (card->csd.tacc_ns < 1000000)
+			timeout_us = (card->csd.tacc_ns * mult) / 1000;
+		else
+			timeout_us = (card->csd.tacc_ns / 1000) * mult;
+
+		/*
+		 * ios.clock is only a target.  The real clock rate might be
+		 * less but not that much less, so fudge it by multiplying by 2.
+		 */
+		timeout_clks <<= 1;
+		timeout_us += (timeout_clks * 1000) /
+			      (card->host->ios.clock / 1000);
+
+		erase_timeout = timeout_us / 1000;
+	}
+
+	/* Round up to 1ms, in particular when the card leaves it blank */
+	if (!erase_timeout)
+		erase_timeout = 1;
+
+	/* Multiplier for secure operations */
+	if (arg & MMC_SECURE_ARGS) {
+		if (arg == MMC_SECURE_ERASE_ARG)
+			erase_timeout *= card->ext_csd.sec_erase_mult;
+		else
+			erase_timeout *= card->ext_csd.sec_trim_mult;
+	}
+
+	return erase_timeout * qty;
+}
+
+static int mmc_do_erase(struct mmc_card *card, unsigned int from,
+			unsigned int to, unsigned int arg)
+{
+	struct mmc_command cmd;
+	unsigned int qty;
+	unsigned long deadline;
+	int err;
+
+	/*
+	 * qty is used to calculate the erase timeout which depends on how
+	 * many erase groups are affected.  We count erasing part of an
+	 * erase group as one erase group.
+	 */
+	if (card->erase_shift)
+		qty = ((to >> card->erase_shift) -
+		       (from >> card->erase_shift)) + 1;
+	else
+		qty = ((to / card->erase_size) -
+		       (from / card->erase_size)) + 1;
+
+	if (!mmc_card_blockaddr(card)) {
+		from <<= 9;
+		to <<= 9;
+	}
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_ERASE_GROUP_START;
+	cmd.arg = from;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err) {
+		printk(KERN_ERR "%s: erase group start error %d, "
+		       "status %#x\n", mmc_hostname(card->host), err,
+		       cmd.resp[0]);
+		return -EINVAL;
+	}
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_ERASE_GROUP_END;
+	cmd.arg = to;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err) {
+		printk(KERN_ERR "%s: erase group end error %d, "
+		       "status %#x\n", mmc_hostname(card->host), err,
+		       cmd.resp[0]);
+		return -EIO;
+	}
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = MMC_ERASE;
+	cmd.arg = arg;
+	cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err) {
+		printk(KERN_ERR "%s: erase error %d, status %#x\n",
+		       mmc_hostname(card->host), err, cmd.resp[0]);
+		return -EIO;
+	}
+
+	if (mmc_host_is_spi(card->host))
+		return 0;
+
+	/*
+	 * The card signals busy until the erase is done.  Give it the
+	 * time it advertises for the number of groups involved, and a
+	 * second on top for slow clocks, before calling it stuck.
+	 */
+	deadline = jiffies + msecs_to_jiffies(
+			mmc_erase_timeout(card, arg, qty)) + HZ;
+	do {
+		memset(&cmd, 0, sizeof(struct mmc_command));
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		/* Do not retry else we can't see errors */
+		err = mmc_wait_for_cmd(card->host, &cmd, 0);
+		if (err || (cmd.resp[0] & 0xFDF92000)) {
+			printk(KERN_ERR "%s: error %d requesting status %#x\n",
+			       mmc_hostname(card->host), err, cmd.resp[0]);
+			return -EIO;
+		}
+		if (time_after(jiffies, deadline)) {
+			printk(KERN_ERR "%s: erase of %u groups timed out\n",
+			       mmc_hostname(card->host), qty);
+			return -ETIMEDOUT;
+		}
+	} while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+		 R1_CURRENT_STATE(cmd.resp[0]) == 7);
+
+	return 0;
+}
+
+/**
+ *	mmc_erase - erase sectors.
+ *	@card: card to erase
+ *	@from: first sector to erase
+ *	@nr: number of sectors to erase
+ *	@arg: erase command argument (SD supports only %MMC_ERASE_ARG)
+ *
+ *	Caller must claim host before calling this function.
+ *
+ *	A plain erase works on whole erase groups: the range is shrunk to
+ *	the groups it fully covers.  Trims work on write blocks and need
+ *	no alignment, secure erases need an aligned range.
+ */
+int mmc_erase(struct mmc_card *card, unsigned int from, unsigned int nr,
+	      unsigned int arg)
+{
+	unsigned int rem, to = from + nr;
+
+	if (!mmc_can_erase(card))
+		return -EOPNOTSUPP;
+
+	if ((arg & MMC_SECURE_ARGS) && !mmc_can_secure_erase_trim(card))
+		return -EOPNOTSUPP;
+
+	if ((arg & MMC_TRIM_ARGS) && !mmc_can_trim(card))
+		return -EOPNOTSUPP;
+
+	if (arg == MMC_SECURE_ERASE_ARG) {
+		if (from % card->erase_size || nr % card->erase_size)
+			return -EINVAL;
+	}
+
+	if (arg == MMC_ERASE_ARG) {
+		rem = from % card->erase_size;
+		if (rem) {
+			rem = card->erase_size - rem;
+			from += rem;
+			if (nr > rem)
+				nr -= rem;
+			else
+				return 0;
+		}
+		rem = nr % card->erase_size;
+		if (rem)
+			nr -= rem;
+	}
+
+	if (nr == 0)
+		return 0;
+
+	to = from + nr;
+
+	if (to <= from)
+		return -EINVAL;
+
+	/* 'from' and 'to' are inclusive */
+	to -= 1;
+
+	return mmc_do_erase(card, from, to, arg);
+}
+EXPORT_SYMBOL(mmc_erase);
+
+int mmc_can_erase(struct mmc_card *card)
+{
+	if (mmc_card_mmc(card) && (card->host->caps & MMC_CAP_ERASE) &&
+	    (card->csd.cmdclass & CCC_ERASE) && card->erase_size)
+		return 1;
+	return 0;
+}
+EXPORT_SYMBOL(mmc_can_erase);
+
+int mmc_can_trim(struct mmc_card *card)
+{
+	if (card->ext_csd.sec_feature_support & EXT_CSD_SEC_GB_CL_EN)
+		return 1;
+	return 0;
+}
+EXPORT_SYMBOL(mmc_can_trim);
+
+int mmc_can_secure_erase_trim(struct mmc_card *card)
+{
+	if (card->ext_csd.sec_feature_support & EXT_CSD_SEC_ER_EN)
+		return 1;
+	return 0;
+}
+EXPORT_SYMBOL(mmc_can_secure_erase_trim);
+
+int mmc_erase_group_aligned(struct mmc_card *card, unsigned int from,
+			    unsigned int nr)
+{
+	if (!card->erase_size)
+		return 0;
+	if (from % card->erase_size || nr % card->erase_size)
+		return 0;
+	return 1;
+}
+EXPORT_SYMBOL(mmc_erase_group_aligned);
+
 /**
  *	mmc_host_enable - enable a host.
  *	@host: mmc host to enable
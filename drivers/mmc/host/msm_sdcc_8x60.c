@@ -465,8 +465,10 @@ msmsdcc_dma_complete_tlet(unsigned long data)
 		if (!mrq->data->error)
 			mrq->data->error = -EIO;
 	}
-	dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg, host->dma.num_ents,
-		     host->dma.dir);
+	/* Buffers mapped by msmsdcc_pre_req() are unmapped in post_req */
+	if (!mrq->data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), host->dma.sg,
+			     host->dma.num_ents, host->dma.dir);
 
 	if (host->curr.user_pages) {
 		struct scatterlist *sg = host->dma.sg;
@@ -537,6 +539,23 @@ static int validate_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	return 0;
 }
 
+static int msmsdcc_get_crci(struct msmsdcc_host *host)
+{
+	if (host->pdev_id == 1)
+		return DMOV_SDC1_CRCI;
+	else if (host->pdev_id == 2)
+		return DMOV_SDC2_CRCI;
+	else if (host->pdev_id == 3)
+		return DMOV_SDC3_CRCI;
+	else if (host->pdev_id == 4)
+		return DMOV_SDC4_CRCI;
+#ifdef DMOV_SDC5_CRCI
+	else if (host->pdev_id == 5)
+		return DMOV_SDC5_CRCI;
+#endif
+	return -ENOENT;
+}
+
 static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 {
 	struct msmsdcc_nc_dmadata *nc;
@@ -551,6 +570,11 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	if (rc)
 		return rc;
 
+	rc = msmsdcc_get_crci(host);
+	if (rc < 0)
+		return rc;
+	crci = rc;
+
 	host->dma.sg = data->sg;
 	host->dma.num_ents = data->sg_len;
 
@@ -558,24 +582,6 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 
 	nc = host->dma.nc;
 
-	if (host->pdev_id == 1)
-		crci = DMOV_SDC1_CRCI;
-	else if (host->pdev_id == 2)
-		crci = DMOV_SDC2_CRCI;
-	else if (host->pdev_id == 3)
-		crci = DMOV_SDC3_CRCI;
-	else if (host->pdev_id == 4)
-		crci = DMOV_SDC4_CRCI;
-#ifdef DMOV_SDC5_CRCI
-	else if (host->pdev_id == 5)
-		crci = DMOV_SDC5_CRCI;
-#endif
-	else {
-		host->dma.sg = NULL;
-		host->dma.num_ents = 0;
-		return -ENOENT;
-	}
-
 	if (data->flags & MMC_DATA_READ)
 		host->dma.dir = DMA_FROM_DEVICE;
 	else
@@ -631,6 +637,12 @@ static int msmsdcc_config_dma(struct msmsdcc_host *host, struct mmc_data *data)
 	host->dma.hdr.complete_func = msmsdcc_dma_complete_func;
 	host->dma.hdr.crci_mask = msm_dmov_build_crci_mask(1, crci);
 
+	if (data->host_cookie) {
+		/* Mapped in pre_req: just make sure nc has hit memory */
+		wmb();
+		return 0;
+	}
+
 	n = dma_map_sg(mmc_dev(host->mmc), host->dma.sg,
 			host->dma.num_ents, host->dma.dir);
 	/* dsb inside dma_map_sg will write nc out to mem as well */
@@ -1769,9 +1781,57 @@ static int msmsdcc_disable(struct mmc_host *mmc, int lazy)
 #define msmsdcc_disable NULL
 #endif
 
+/*
+ * Do the cache maintenance for the next request's buffers while the
+ * current one is still being transferred.  Only requests which are
+ * certain to go through the data mover are mapped here: a PIO transfer
+ * into a buffer mapped for DMA would be thrown away by the unmap.
+ */
+static void msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			    bool is_first_req)
+{
+	struct msmsdcc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	enum dma_data_direction dir;
+	int n;
+
+	if (!data)
+		return;
+
+	data->host_cookie = 0;
+	if (validate_dma(host, data) || msmsdcc_get_crci(host) < 0 ||
+	    data->sg_len > NR_SG)
+		return;
+
+	dir = (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	n = dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len, dir);
+	if (n != data->sg_len) {
+		if (n)
+			dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len, dir);
+		return;
+	}
+	data->host_cookie = 1;
+}
+
+static void msmsdcc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			     int err)
+{
+	struct mmc_data *data = mrq->data;
+	enum dma_data_direction dir;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dir = (data->flags & MMC_DATA_READ) ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len, dir);
+	data->host_cookie = 0;
+}
+
 static const struct mmc_host_ops msmsdcc_ops = {
 	.enable		= msmsdcc_enable,
 	.disable	= msmsdcc_disable,
+	.pre_req	= msmsdcc_pre_req,
+	.post_req	= msmsdcc_post_req,
 	.request	= msmsdcc_request,
 	.set_ios	= msmsdcc_set_ios,
 	.get_ro		= msmsdcc_get_ro,
@@ -1787,6 +1847,8 @@ static int msmsdcc_sdc_get_status(struct mmc_host *mmc) {
 static const struct mmc_host_ops msmsdcc_ops_sd = {
 	.enable		= msmsdcc_enable,
 	.disable	= msmsdcc_disable,
+	.pre_req	= msmsdcc_pre_req,
+	.post_req	= msmsdcc_post_req,
 	.request	= msmsdcc_request,
 	.set_ios	= msmsdcc_set_ios,
 	.get_ro		= msmsdcc_get_ro,
@@ -2229,6 +2291,7 @@ msmsdcc_probe(struct platform_device *pdev)
 	mmc->caps |= plat->mmc_bus_width;
 
 	mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED;
+	mmc->caps |= MMC_CAP_ERASE;
 
 	if (plat->nonremovable)
 		mmc->caps |= MMC_CAP_NONREMOVABLE;
@@ -2242,7 +2305,8 @@ msmsdcc_probe(struct platform_device *pdev)
 	mmc->max_blk_count = 65535;
 
 	mmc->max_req_size = 33554432;	/* MCI_DATA_LENGTH is 25 bits */
-	mmc->max_seg_size = mmc->max_req_size;
+	/* A box moves at most 0xffff rows of one FIFO each */
+	mmc->max_seg_size = 0xffff * MCI_FIFOSIZE;
 
 	writel_relaxed(0, host->base + MMCIMASK0);
 	writel_relaxed(MCI_CLEAR_STATIC_MASK, host->base + MMCICLEAR);
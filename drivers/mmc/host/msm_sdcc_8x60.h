@@ -166,7 +166,11 @@
 
 #define MCI_FIFOHALFSIZE (MCI_FIFOSIZE / 2)
 
-#define NR_SG		32
+/*
+ * Entries in the data mover box list, i.e. scatterlist segments per
+ * request: enough for a 512KB request made of scattered pages.
+ */
+#define NR_SG		128
 
 #define MSM_MMC_IDLE_TIMEOUT	250 /* msecs */
 #define MSM_EMMC_IDLE_TIMEOUT	20 /* msecs */
@@ -30,7 +30,11 @@
 #include <linux/wakelock.h>
 #include <linux/platform_device.h>
 #include <linux/if_arp.h>
+#include <linux/ip.h>
+#include <linux/kfifo.h>
+#include <linux/dynamic_queue_limits.h>
 #include <linux/msm_rmnet-8x60.h>
+#include <net/checksum.h>
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
@@ -141,6 +145,19 @@ static const char *ch_name[RMNET_DEVICE_COUNT] = {
 
 #define HEADROOM_FOR_QOS    8
 
+/* Receive packets handled per NAPI poll */
+#define RMNET_NAPI_WEIGHT 64
+
+/*
+ * Receive buffers are sized for a standard Ethernet frame so that they
+ * can be recycled; larger packets get a buffer of their own.  The pool
+ * holds about as many buffers as the receive FIFO holds packets.
+ */
+#define RMNET_RX_BUF_SIZE (ETH_FRAME_LEN + NET_IP_ALIGN)
+#define RMNET_RX_POOL_MIN 16
+#define RMNET_RX_POOL_MAX 256
+#define RMNET_RX_POOL_PKT 512	/* assumed average packet size */
+
 static struct completion *port_complete[RMNET_DEVICE_COUNT];
 
 struct rmnet_private
@@ -158,6 +175,15 @@ struct rmnet_private
 	struct sk_buff *skb;
 	spinlock_t lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_pool;	/* recycled receive buffers */
+	unsigned int rx_pool_max;
+	struct dql dql;			/* bytes in the transmit FIFO */
+	unsigned int tx_fifo_size;	/* write space of the empty FIFO */
+	int tx_limited;			/* queue stopped by the dql limit */
+#ifdef CONFIG_MSM_RMNET_LOOPBACK
+	struct kfifo lb_fifo;
+#endif
 	u32 operation_mode;    /* IOCTL specified mode (protocol, QoS header) */
 	struct platform_driver pdrv;
 	struct completion complete;
@@ -169,9 +195,115 @@ static uint msm_rmnet_modem_wait;
 module_param_named(modem_wait, msm_rmnet_modem_wait,
 		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Limit the bytes waiting in the transmit FIFO (0: fill it, as before) */
+static int msm_rmnet_tx_bql = 1;
+module_param_named(tx_bql, msm_rmnet_tx_bql,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 /* Forward declaration */
 static int rmnet_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd);
 
+#ifdef CONFIG_MSM_RMNET_LOOPBACK
+/*
+ * Loopback stand-in for the SMD channel, for benchmarking without a
+ * modem.  Transmitted frames are copied into a FIFO the size of an SMD
+ * data channel, each behind a length word as in an SMD packet channel,
+ * and received from it again by the NAPI poll with the same copy, so
+ * packets per second and CPU time per Mbit of the receive path can be
+ * measured on any MSM8x60 board.
+ */
+#define RMNET_LB_FIFO_SIZE (64 * 1024)
+
+static int rmnet_ch_cur_packet_size(struct rmnet_private *p)
+{
+	u32 len;
+
+	if (kfifo_len(&p->lb_fifo) < sizeof(len) ||
+	    kfifo_out_peek(&p->lb_fifo, &len, sizeof(len), 0) != sizeof(len))
+		return 0;
+	return len;
+}
+
+static int rmnet_ch_read_avail(struct rmnet_private *p)
+{
+	int len = kfifo_len(&p->lb_fifo) - sizeof(u32);
+
+	return len > 0 ? len : 0;
+}
+
+static int rmnet_ch_peek(struct rmnet_private *p, struct smd_read_vec vec[2])
+{
+	struct kfifo *fifo = &p->lb_fifo;
+	unsigned int off = __kfifo_off(fifo, fifo->out + sizeof(u32));
+	int len = min(rmnet_ch_cur_packet_size(p), rmnet_ch_read_avail(p));
+
+	vec[0].data = fifo->buffer + off;
+	vec[0].len = min_t(int, len, fifo->size - off);
+	vec[1].data = fifo->buffer;
+	vec[1].len = len - vec[0].len;
+	return len;
+}
+
+static int rmnet_ch_commit(struct rmnet_private *p, int len)
+{
+	kfifo_skip(&p->lb_fifo, sizeof(u32) + len);
+	/* the "remote" has read: let a blocked transmit through */
+	if (p->skb || p->tx_limited)
+		tasklet_hi_schedule(&p->tsklt);
+	return len;
+}
+
+static int rmnet_ch_write_avail(struct rmnet_private *p)
+{
+	int len = kfifo_avail(&p->lb_fifo) - sizeof(u32);
+
+	return len > 0 ? len : 0;
+}
+
+static int rmnet_ch_write(struct rmnet_private *p, const void *data, int len)
+{
+	u32 hdr = len;
+
+	if (rmnet_ch_write_avail(p) < len)
+		return -ENOMEM;
+	kfifo_in(&p->lb_fifo, &hdr, sizeof(hdr));
+	kfifo_in(&p->lb_fifo, data, len);
+	napi_schedule(&p->napi);
+	return len;
+}
+
+static void rmnet_ch_enable_read_intr(struct rmnet_private *p)
+{
+}
+
+static void rmnet_ch_disable_read_intr(struct rmnet_private *p)
+{
+}
+
+static void rmnet_ch_read_notify_flush(struct rmnet_private *p)
+{
+}
+#else
+#define rmnet_ch_cur_packet_size(p)	smd_cur_packet_size((p)->ch)
+#define rmnet_ch_read_avail(p)		smd_read_avail((p)->ch)
+#define rmnet_ch_peek(p, vec)		smd_read_peek((p)->ch, vec)
+#define rmnet_ch_commit(p, len)		smd_read_commit((p)->ch, len)
+#define rmnet_ch_read_notify_flush(p)	smd_read_notify_flush((p)->ch)
+#define rmnet_ch_write_avail(p)		smd_write_avail((p)->ch)
+#define rmnet_ch_write(p, data, len)	smd_write((p)->ch, data, len)
+#define rmnet_ch_enable_read_intr(p)	smd_enable_read_intr((p)->ch)
+#define rmnet_ch_disable_read_intr(p)	smd_disable_read_intr((p)->ch)
+#endif
+
+static inline int rmnet_ch_opened(struct rmnet_private *p)
+{
+#ifdef CONFIG_MSM_RMNET_LOOPBACK
+	return kfifo_initialized(&p->lb_fifo);
+#else
+	return p->ch != NULL;
+#endif
+}
+
 static int count_this_packet(void *_hdr, int len)
 {
 	struct ethhdr *hdr = _hdr;
@@ -296,6 +428,15 @@ static ssize_t timeout_show(struct device *d, struct device_attribute *attr,
 }
 
 DEVICE_ATTR(timeout, 0664, timeout_show, timeout_store);
+
+static ssize_t tx_limit_show(struct device *d, struct device_attribute *attr,
+			     char *buf)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	return sprintf(buf, "%u\n", p->dql.limit);
+}
+
+DEVICE_ATTR(tx_limit, 0444, tx_limit_show, NULL);
 #endif
 
 static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
@@ -303,6 +444,8 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	__be16 protocol = 0;
 
 	skb->dev = dev;
+	/* no link header: GRO and taps expect the mac header at the data */
+	skb_reset_mac_header(skb);
 
 	/* Determine L3 protocol */
 	switch (skb->data[0] & 0xf0) {
@@ -320,98 +463,267 @@ static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
 	return protocol;
 }
 
-static void smd_net_data_handler(unsigned long arg);
-static DECLARE_TASKLET(smd_net_data_tasklet, smd_net_data_handler, 0);
+/* Take a receive buffer from the pool if the packet fits one */
+static struct sk_buff *rmnet_alloc_rx_skb(struct net_device *dev, int sz)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+	struct sk_buff *skb;
+
+	if (sz + NET_IP_ALIGN <= RMNET_RX_BUF_SIZE) {
+		skb = skb_dequeue(&p->rx_pool);
+		if (!skb)
+			skb = dev_alloc_skb(RMNET_RX_BUF_SIZE);
+	} else
+		skb = dev_alloc_skb(sz + NET_IP_ALIGN);
+	if (skb) {
+		skb->dev = dev;
+		skb_reserve(skb, NET_IP_ALIGN);
+	}
+	return skb;
+}
+
+/* Keep a buffer we are done with for reception, if it qualifies */
+static void rmnet_recycle_skb(struct rmnet_private *p, struct sk_buff *skb)
+{
+	if (skb_queue_len(&p->rx_pool) < p->rx_pool_max &&
+	    skb_recycle_check(skb, RMNET_RX_BUF_SIZE))
+		skb_queue_head(&p->rx_pool, skb);
+	else
+		dev_kfree_skb_any(skb);
+}
+
+static void rmnet_fill_rx_pool(struct rmnet_private *p)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&p->rx_pool) < p->rx_pool_max) {
+		skb = dev_alloc_skb(RMNET_RX_BUF_SIZE);
+		if (!skb)
+			break;
+		skb_queue_head(&p->rx_pool, skb);
+	}
+}
+
+/* Size the pool for a full FIFO of average sized packets */
+static void rmnet_size_rx_pool(struct rmnet_private *p, int fifo_size)
+{
+	p->rx_pool_max = clamp(fifo_size / RMNET_RX_POOL_PKT,
+			       RMNET_RX_POOL_MIN, RMNET_RX_POOL_MAX);
+}
+
+/*
+ * Let GRO merge TCP over IPv4: the stack would checksum the packet
+ * anyway, so do it now while the data is still in cache.  A valid IPv4
+ * header sums to zero, so the sum over the whole packet is the sum
+ * over the TCP segment.
+ */
+static void rmnet_rx_csum(struct sk_buff *skb)
+{
+	struct iphdr *iph = (struct iphdr *)skb->data;
+
+	if (skb->protocol != htons(ETH_P_IP) || skb->len < sizeof(*iph) ||
+	    iph->protocol != IPPROTO_TCP)
+		return;
+	skb->csum = csum_partial(skb->data, skb->len, 0);
+	skb->ip_summed = CHECKSUM_COMPLETE;
+}
+
+/*
+ * Copy a packet out of the channel's FIFO.  In IP mode the packet starts
+ * with the IP header, which can be looked at in place: for TCP over IPv4
+ * the checksum is then computed during the copy, as rmnet_rx_csum()
+ * would have right after it.  Returns whether it did.
+ */
+static int rmnet_rx_copy(struct sk_buff *skb, struct smd_read_vec *vec,
+			 int sz, u32 opmode)
+{
+	const struct iphdr *iph = vec[0].data;
+	void *ptr = skb_put(skb, sz);
+	int len = min(sz, vec[0].len);
+	__wsum csum;
+
+	if (!RMNET_IS_MODE_IP(opmode) || len < sizeof(*iph) ||
+	    iph->version != 4 || iph->protocol != IPPROTO_TCP) {
+		memcpy(ptr, vec[0].data, len);
+		if (sz > len)
+			memcpy(ptr + len, vec[1].data, sz - len);
+		return 0;
+	}
+	csum = csum_partial_copy_nocheck(vec[0].data, ptr, len, 0);
+	if (sz > len)
+		csum = csum_block_add(csum,
+				      csum_partial_copy_nocheck(vec[1].data,
+								ptr + len,
+								sz - len, 0),
+				      len);
+	skb->csum = csum;
+	skb->ip_summed = CHECKSUM_COMPLETE;
+	return 1;
+}
 
 /* Called in soft-irq context */
-static void smd_net_data_handler(unsigned long arg)
+static int rmnet_poll(struct napi_struct *napi, int budget)
 {
-	struct net_device *dev = (struct net_device *) arg;
+	struct net_device *dev = napi->dev;
 	struct rmnet_private *p = netdev_priv(dev);
+	unsigned long rx_packets = 0, rx_bytes = 0;
 	struct sk_buff *skb;
-	void *ptr = 0;
-	int sz;
-	u32 opmode = p->operation_mode;
-	unsigned long flags;
+	struct smd_read_vec vec[2];
+	void *ptr;
+	int sz, csum, work = 0;
+	/* writers hold p->lock; one consistent value per poll is enough */
+	u32 opmode = ACCESS_ONCE(p->operation_mode);
+
+	if (!rmnet_ch_opened(p)) {
+		napi_complete(napi);
+		return 0;
+	}
 
-	for (;;) {
-		sz = smd_cur_packet_size(p->ch);
-		if (sz == 0) break;
-		if (smd_read_avail(p->ch) < sz) break;
+	while (work < budget) {
+		sz = rmnet_ch_cur_packet_size(p);
+		if (sz == 0)
+			break;
+		if (rmnet_ch_peek(p, vec) < sz)
+			break;
 
-		skb = dev_alloc_skb(sz + NET_IP_ALIGN);
+		skb = rmnet_alloc_rx_skb(dev, sz);
 		if (skb == NULL) {
 			pr_err("[%s] rmnet_recv() cannot allocate skb\n",
 			       dev->name);
-			/* out of memory, reschedule a later attempt */
-			smd_net_data_tasklet.data = (unsigned long)dev;
-			tasklet_schedule(&smd_net_data_tasklet);
+			/* out of memory, stay scheduled and try again */
+			work = budget;
 			break;
+		}
+		ptr = skb->data;
+		csum = rmnet_rx_copy(skb, vec, sz, opmode);
+		if (rmnet_ch_commit(p, sz) != sz) {
+			pr_err("[%s] rmnet_recv() smd lied about avail?!",
+				dev->name);
+			rmnet_recycle_skb(p, skb);
+			continue;
+		}
+		work++;
+
+		/* Handle Rx frame format */
+		if (RMNET_IS_MODE_IP(opmode)) {
+			/* Driver in IP mode */
+			skb->protocol = rmnet_ip_type_trans(skb, dev);
 		} else {
-			skb->dev = dev;
-			skb_reserve(skb, NET_IP_ALIGN);
-			ptr = skb_put(skb, sz);
-			wake_lock_timeout(&p->wake_lock, HZ / 2);
-			if (smd_read(p->ch, ptr, sz) != sz) {
-				pr_err("[%s] rmnet_recv() smd lied about avail?!",
-					dev->name);
-				ptr = 0;
-				dev_kfree_skb_irq(skb);
-			} else {
-				/* Handle Rx frame format */
-				spin_lock_irqsave(&p->lock, flags);
-				opmode = p->operation_mode;
-				spin_unlock_irqrestore(&p->lock, flags);
-
-				if (RMNET_IS_MODE_IP(opmode)) {
-					/* Driver in IP mode */
-					skb->protocol =
-					  rmnet_ip_type_trans(skb, dev);
-				} else {
-					/* Driver in Ethernet mode */
-					skb->protocol =
-					  eth_type_trans(skb, dev);
-				}
+			/* Driver in Ethernet mode */
+			skb->protocol = eth_type_trans(skb, dev);
+		}
 #if DATA_DEBUG
-				print_data_msg("RX", (unsigned char *)ptr, MAX_DUMP_BYTES);
+		print_data_msg("RX", (unsigned char *)ptr, MAX_DUMP_BYTES);
 #endif
-				if (RMNET_IS_MODE_IP(opmode) ||
-				    count_this_packet(ptr, skb->len)) {
+		if (RMNET_IS_MODE_IP(opmode) ||
+		    count_this_packet(ptr, skb->len)) {
 #ifdef CONFIG_MSM_RMNET_DEBUG
-					p->wakeups_rcv +=
-					rmnet_cause_wakeup(p);
+			p->wakeups_rcv += rmnet_cause_wakeup(p);
 #endif
-					p->stats.rx_packets++;
-					p->stats.rx_bytes += skb->len;
-				}
-				DBG1("[%s] Rx packet #%lu len=%d\n",
-					dev->name, p->stats.rx_packets,
-					skb->len);
-
-				/* Deliver to network stack */
-				netif_rx(skb);
-			}
-			continue;
+			rx_packets++;
+			rx_bytes += skb->len;
 		}
-		if (smd_read(p->ch, ptr, sz) != sz)
-			pr_err(MODULE_NAME "[%s] rmnet_recv() smd lied about avail?!",
-				dev->name);
+		DBG1("[%s] Rx packet #%lu len=%d\n",
+			dev->name, p->stats.rx_packets + rx_packets,
+			skb->len);
+
+		/* Deliver to network stack */
+		if (!csum)
+			rmnet_rx_csum(skb);
+		napi_gro_receive(napi, skb);
+	}
+
+	if (work) {
+		wake_lock_timeout(&p->wake_lock, HZ / 2);
+		p->stats.rx_packets += rx_packets;
+		p->stats.rx_bytes += rx_bytes;
+	}
+
+	if (work < budget) {
+		/* the modem hears about the space freed at the latest now */
+		rmnet_ch_read_notify_flush(p);
+		napi_complete(napi);
+		/*
+		 * SMD cannot mask its data interrupt, and one that came in
+		 * while we were polling found NAPI still scheduled.
+		 */
+		sz = rmnet_ch_cur_packet_size(p);
+		if (sz && rmnet_ch_read_avail(p) >= sz)
+			napi_schedule(napi);
 	}
+	return work;
 }
 
-static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
+/*
+ * Byte queue limit on the transmit FIFO.  Whatever we write sits in the
+ * FIFO until the modem gets to it, and with the FIFO full a packet waits
+ * behind it for as long as the radio needs to send it all.  So the queue
+ * is stopped once more bytes than needed to keep the modem busy wait
+ * there, and the rest stays in the qdisc, where it can be scheduled.
+ *
+ * SMD has no transmit completion: bytes count as completed once the
+ * modem has read them, which shows as the FIFO's free space growing back.
+ * Called with p->lock held.
+ */
+static void rmnet_tx_completed(struct rmnet_private *p)
+{
+	unsigned int outstanding, inflight;
+
+	if (!p->tx_fifo_size)
+		return;
+	outstanding = p->dql.num_queued - p->dql.num_completed;
+	inflight = p->tx_fifo_size - rmnet_ch_write_avail(p);
+	if (outstanding > inflight)
+		dql_completed(&p->dql, outstanding - inflight);
+}
+
+/* Restart a queue stopped by the limit.  Called with p->lock held. */
+static void rmnet_tx_unlimit(struct net_device *dev, struct rmnet_private *p)
+{
+	if (!p->tx_limited)
+		return;
+	rmnet_tx_completed(p);
+	if (dql_avail(&p->dql) < 0 && msm_rmnet_tx_bql)
+		return;
+	p->tx_limited = 0;
+	rmnet_ch_disable_read_intr(p);
+	netif_wake_queue(dev);
+}
+
+/* After a write: stop the queue if over the limit.  Returns whether it did. */
+static int rmnet_tx_over_limit(struct net_device *dev)
 {
 	struct rmnet_private *p = netdev_priv(dev);
-	smd_channel_t *ch = p->ch;
-	int smd_ret;
-	struct QMI_QOS_HDR_S *qmih;
-	u32 opmode;
 	unsigned long flags;
+	int limited = 0;
+
+	/* nothing completes before the channel is open and measured */
+	if (likely(dql_avail(&p->dql) >= 0) || !msm_rmnet_tx_bql ||
+	    !p->tx_fifo_size)
+		return 0;
 
-	/* For QoS mode, prepend QMI header and assign flow ID from skb->mark */
 	spin_lock_irqsave(&p->lock, flags);
-	opmode = p->operation_mode;
+	/* the modem reading after the check below must still notify us */
+	rmnet_ch_enable_read_intr(p);
+	rmnet_tx_completed(p);
+	if (dql_avail(&p->dql) < 0) {
+		netif_stop_queue(dev);
+		p->tx_limited = 1;
+		limited = 1;
+	} else
+		rmnet_ch_disable_read_intr(p);
 	spin_unlock_irqrestore(&p->lock, flags);
+	return limited;
+}
+
+static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+	int smd_ret, avail;
+	struct QMI_QOS_HDR_S *qmih;
+	u32 opmode = ACCESS_ONCE(p->operation_mode);
+
+	/* For QoS mode, prepend QMI header and assign flow ID from skb->mark */
 
 	if (RMNET_IS_MODE_QOS(opmode)) {
 		qmih = (struct QMI_QOS_HDR_S *)
@@ -425,13 +737,17 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	print_data_msg("TX", (unsigned char *)skb->data, MAX_DUMP_BYTES);
 #endif
 	dev->trans_start = jiffies;
-	smd_ret = smd_write(ch, skb->data, skb->len);
+	avail = rmnet_ch_write_avail(p);
+	smd_ret = rmnet_ch_write(p, skb->data, skb->len);
 	if (smd_ret != skb->len) {
 		pr_err(MODULE_NAME "[%s] %s: smd_write returned error %d",
 			dev->name, __func__, smd_ret);
 		p->stats.tx_errors++;
 		goto xmit_out;
 	}
+	/* FIFO space taken, with the packet header; the modem may read meanwhile */
+	dql_queued(&p->dql, max_t(int, avail - rmnet_ch_write_avail(p),
+				  skb->len));
 
 	if (RMNET_IS_MODE_IP(opmode) ||
 	    count_this_packet(skb->data, skb->len)) {
@@ -445,8 +761,8 @@ static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	    dev->name, p->stats.tx_packets, skb->len, skb->mark);
 
 xmit_out:
-	/* data xmited, safe to release skb */
-	dev_kfree_skb_irq(skb);
+	/* data xmited, the skb can serve as a receive buffer */
+	rmnet_recycle_skb(p, skb);
 	return 0;
 }
 
@@ -460,16 +776,41 @@ static void _rmnet_resume_flow(unsigned long param)
 	/* xmit and enable the flow only once even if
 	   multiple tasklets were scheduled by smd_net_notify */
 	spin_lock_irqsave(&p->lock, flags);
-	if (p->skb && (smd_write_avail(p->ch) >= p->skb->len)) {
+	if (p->skb && (rmnet_ch_write_avail(p) >= p->skb->len)) {
 		skb = p->skb;
 		p->skb = NULL;
 		spin_unlock_irqrestore(&p->lock, flags);
 		_rmnet_xmit(skb, dev);
-		netif_wake_queue(dev);
-	} else
+		if (!rmnet_tx_over_limit(dev))
+			netif_wake_queue(dev);
+	} else {
+		rmnet_tx_unlimit(dev, p);
 		spin_unlock_irqrestore(&p->lock, flags);
+	}
 }
 
+#ifdef CONFIG_MSM_RMNET_LOOPBACK
+static int __rmnet_open(struct net_device *dev)
+{
+	struct rmnet_private *p = netdev_priv(dev);
+
+	if (!kfifo_initialized(&p->lb_fifo)) {
+		if (kfifo_alloc(&p->lb_fifo, RMNET_LB_FIFO_SIZE, GFP_KERNEL))
+			return -ENOMEM;
+		rmnet_size_rx_pool(p, RMNET_LB_FIFO_SIZE);
+		p->tx_fifo_size = rmnet_ch_write_avail(p);
+	}
+	netif_carrier_on(dev);
+	return 0;
+}
+
+static int __rmnet_close(struct net_device *dev)
+{
+	/* the FIFO stays: NAPI may still be draining it */
+	netif_carrier_off(dev);
+	return 0;
+}
+#else
 static void msm_rmnet_unload_modem(void *pil)
 {
 	if (pil)
@@ -513,19 +854,23 @@ static void smd_net_notify(void *_dev, unsigned event)
 		if (p->skb && (smd_write_avail(p->ch) >= p->skb->len)) {
 			smd_disable_read_intr(p->ch);
 			tasklet_hi_schedule(&p->tsklt);
-		}
+		} else
+			rmnet_tx_unlimit(_dev, p);
 
 		spin_unlock(&p->lock);
 
 		if (smd_read_avail(p->ch) &&
-			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch))) {
-			smd_net_data_tasklet.data = (unsigned long) _dev;
-			tasklet_schedule(&smd_net_data_tasklet);
-		}
+			(smd_read_avail(p->ch) >= smd_cur_packet_size(p->ch)))
+			napi_schedule(&p->napi);
 		break;
 
 	case SMD_EVENT_OPEN:
 		DBG0("%s: opening SMD port\n", __func__);
+		/* both FIFOs of a data channel have the same size */
+		rmnet_size_rx_pool(p, smd_write_avail(p->ch));
+		p->tx_fifo_size = smd_write_avail(p->ch);
+		/* interrupt the modem for freed space every quarter FIFO */
+		smd_set_read_notify_threshold(p->ch, smd_write_avail(p->ch) / 4);
 		netif_carrier_on(_dev);
 		if (netif_queue_stopped(_dev)) {
 			DBG0("%s: re-starting if queue\n", __func__);
@@ -583,16 +928,25 @@ static int __rmnet_close(struct net_device *dev)
 	} else
 		return -EBADF;
 }
+#endif
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
-	if (rc == 0)
+	if (rc == 0) {
+		rmnet_fill_rx_pool(p);
+		dql_reset(&p->dql);
+		p->tx_limited = 0;
+		napi_enable(&p->napi);
+		/* pick up whatever arrived while the interface was down */
+		napi_schedule(&p->napi);
 		netif_start_queue(dev);
+	}
 
 	return rc;
 }
@@ -604,7 +958,9 @@ static int rmnet_stop(struct net_device *dev)
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
 	tasklet_kill(&p->tsklt);
+	skb_queue_purge(&p->rx_pool);
 
 	/* TODO: unload modem safely,
 	   currently, this causes unnecessary unloads */
@@ -633,7 +989,6 @@ static int rmnet_change_mtu(struct net_device *dev, int new_mtu)
 static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct rmnet_private *p = netdev_priv(dev);
-	smd_channel_t *ch = p->ch;
 	unsigned long flags;
 
 	if (netif_queue_stopped(dev)) {
@@ -643,17 +998,18 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	spin_lock_irqsave(&p->lock, flags);
-	smd_enable_read_intr(ch);
-	if (smd_write_avail(ch) < skb->len) {
+	rmnet_ch_enable_read_intr(p);
+	if (rmnet_ch_write_avail(p) < skb->len) {
 		netif_stop_queue(dev);
 		p->skb = skb;
 		spin_unlock_irqrestore(&p->lock, flags);
 		return 0;
 	}
-	smd_disable_read_intr(ch);
+	rmnet_ch_disable_read_intr(p);
 	spin_unlock_irqrestore(&p->lock, flags);
 
 	_rmnet_xmit(skb, dev);
+	rmnet_tx_over_limit(dev);
 
 	return 0;
 }
@@ -815,6 +1171,7 @@ static void __init rmnet_setup(struct net_device *dev)
 	/* set this after calling ether_setup */
 	dev->mtu = RMNET_DATA_LEN;
 	dev->needed_headroom = HEADROOM_FOR_QOS;
+	dev->features |= NETIF_F_GRO;
 
 	random_ether_addr(dev->dev_addr);
 
@@ -867,6 +1224,10 @@ static int __init rmnet_init(void)
 		spin_lock_init(&p->lock);
 		tasklet_init(&p->tsklt, _rmnet_resume_flow,
 				(unsigned long)dev);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+		skb_queue_head_init(&p->rx_pool);
+		p->rx_pool_max = RMNET_RX_POOL_MIN;
+		dql_init(&p->dql, HZ);
 		wake_lock_init(&p->wake_lock, WAKE_LOCK_SUSPEND, ch_name[n]);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
@@ -900,6 +1261,8 @@ static int __init rmnet_init(void)
 			continue;
 		if (device_create_file(d, &dev_attr_wakeups_rcv))
 			continue;
+		if (device_create_file(d, &dev_attr_tx_limit))
+			continue;
 #ifdef CONFIG_HAS_EARLYSUSPEND
 		if (device_create_file(d, &dev_attr_timeout_suspend))
 			continue;
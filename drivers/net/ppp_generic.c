@@ -100,6 +100,15 @@ struct ppp_file {
 	int		dead;		/* unit/channel has been shut down */
 };
 
+/*
+ * Receive counters, kept per cpu so that frames taking the fast path
+ * in ppp_input() don't have to share a cache line.
+ */
+struct ppp_rx_stats {
+	unsigned long	rx_packets;
+	unsigned long	rx_bytes;
+};
+
 #define PF_TO_X(pf, X)		container_of(pf, X, file)
 
 #define PF_TO_PPP(pf)		PF_TO_X(pf, struct ppp)
@@ -134,6 +143,7 @@ struct ppp {
 	unsigned long	last_recv;	/* jiffies when last pkt rcvd a0 */
 	struct net_device *dev;		/* network interface device a4 */
 	int		closing;	/* is device closing down? a8 */
+	struct ppp_rx_stats __percpu *rx_stats; /* per-cpu receive counters */
 #ifdef CONFIG_PPP_MULTILINK
 	int		nxchan;		/* next channel to send something on */
 	u32		nxseq;		/* next sequence number to send */
@@ -254,6 +264,7 @@ static void ppp_receive_frame(struct ppp *ppp, struct sk_buff *skb,
 			      struct channel *pch);
 static void ppp_receive_error(struct ppp *ppp);
 static void ppp_receive_nonmp_frame(struct ppp *ppp, struct sk_buff *skb);
+static int ppp_receive_fast(struct ppp *ppp, struct sk_buff *skb);
 static struct sk_buff *ppp_decompress_frame(struct ppp *ppp,
 					    struct sk_buff *skb);
 #ifdef CONFIG_PPP_MULTILINK
@@ -268,6 +279,8 @@ static void ppp_ccp_peek(struct ppp *ppp, struct sk_buff *skb, int inbound);
 static void ppp_ccp_closed(struct ppp *ppp);
 static struct compressor *find_compressor(int type);
 static void ppp_get_stats(struct ppp *ppp, struct ppp_stats *st);
+static void ppp_sum_rx_stats(struct ppp *ppp, unsigned long *packets,
+			     unsigned long *bytes);
 static struct ppp *ppp_create_interface(struct net *net, int unit, int *retp);
 static void init_ppp_file(struct ppp_file *pf, int kind);
 static void ppp_shutdown_interface(struct ppp *ppp);
@@ -1013,7 +1026,6 @@ ppp_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	pp[0] = proto >> 8;
 	pp[1] = proto;
 
-	netif_stop_queue(dev);
 	skb_queue_tail(&ppp->file.xq, skb);
 	ppp_xmit_process(ppp);
 	return NETDEV_TX_OK;
@@ -1067,9 +1079,19 @@ ppp_net_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 	return err;
 }
 
+static struct net_device_stats *
+ppp_net_get_stats(struct net_device *dev)
+{
+	struct ppp *ppp = netdev_priv(dev);
+
+	ppp_sum_rx_stats(ppp, &dev->stats.rx_packets, &dev->stats.rx_bytes);
+	return &dev->stats;
+}
+
 static const struct net_device_ops ppp_netdev_ops = {
 	.ndo_start_xmit = ppp_start_xmit,
 	.ndo_do_ioctl   = ppp_net_ioctl,
+	.ndo_get_stats  = ppp_net_get_stats,
 };
 
 static void ppp_setup(struct net_device *dev)
@@ -1096,18 +1118,41 @@ static void ppp_setup(struct net_device *dev)
 static void
 ppp_xmit_process(struct ppp *ppp)
 {
+	struct sk_buff_head list;
 	struct sk_buff *skb;
+	unsigned long flags;
+
+	__skb_queue_head_init(&list);
 
 	ppp_xmit_lock(ppp);
 	if (!ppp->closing) {
 		ppp_push(ppp);
+		/* Take everything queued so far in one go, rather than
+		   taking the queue lock for every frame. */
+		if (!ppp->xmit_pending) {
+			spin_lock_irqsave(&ppp->file.xq.lock, flags);
+			skb_queue_splice_init(&ppp->file.xq, &list);
+			spin_unlock_irqrestore(&ppp->file.xq.lock, flags);
+		}
 		while (!ppp->xmit_pending &&
-		       (skb = skb_dequeue(&ppp->file.xq)))
+		       (skb = __skb_dequeue(&list)))
 			ppp_send_frame(ppp, skb);
+		/* The channel is full: put back what is left, ahead of
+		   anything queued meanwhile. */
+		if (!skb_queue_empty(&list)) {
+			spin_lock_irqsave(&ppp->file.xq.lock, flags);
+			skb_queue_splice(&list, &ppp->file.xq);
+			spin_unlock_irqrestore(&ppp->file.xq.lock, flags);
+		}
 		/* If there's no work left to do, tell the core net
-		   code that we can accept some more. */
+		   code that we can accept some more.  Otherwise stop
+		   it until the channel calls ppp_output_wakeup(); as
+		   that runs ppp_xmit_process() too, under the same
+		   lock, the queue can't be left stopped. */
 		if (!ppp->xmit_pending && !skb_peek(&ppp->file.xq))
 			netif_wake_queue(ppp->dev);
+		else
+			netif_stop_queue(ppp->dev);
 	}
 	ppp_xmit_unlock(ppp);
 }
@@ -1634,7 +1679,7 @@ ppp_input(struct ppp_channel *chan, struct sk_buff *skb)
 		       (skb = skb_dequeue(&pch->file.rq)))
 			kfree_skb(skb);
 		wake_up_interruptible(&pch->file.rwait);
-	} else {
+	} else if (!ppp_receive_fast(pch->ppp, skb)) {
 		ppp_do_recv(pch->ppp, skb, pch);
 	}
 
@@ -1694,9 +1739,65 @@ ppp_receive_error(struct ppp *ppp)
 		slhc_toss(ppp->vj);
 }
 
+/*
+ * Deliver an IP or IPv6 frame without taking the receive lock of the
+ * unit, when nothing it goes through needs the receive state: no
+ * decompressor running, no filters.  Channels on different cpus (and
+ * the one cpu each channel receives on) then don't serialize on the
+ * unit.  The frame is handed to the network stack as in
+ * ppp_receive_nonmp_frame().  Returns 0, leaving the frame alone, if it
+ * has to take the locked path.  Called with the channel's upl held,
+ * which keeps ppp around.
+ */
+static int
+ppp_receive_fast(struct ppp *ppp, struct sk_buff *skb)
+{
+	struct ppp_rx_stats *stats;
+	int npi;
+
+	switch (PPP_PROTO(skb)) {
+	case PPP_IP:
+		npi = NP_IP;
+		break;
+	case PPP_IPV6:
+		npi = NP_IPV6;
+		break;
+	default:
+		return 0;
+	}
+
+	/* Decompressors want to see the uncompressed frames too */
+	if ((ppp->rstate & SC_DECOMP_RUN) || (ppp->flags & SC_MUST_COMP) ||
+	    ppp->closing)
+		return 0;
+#ifdef CONFIG_PPP_FILTER
+	if (ppp->pass_filter || ppp->active_filter)
+		return 0;
+#endif /* CONFIG_PPP_FILTER */
+
+	stats = this_cpu_ptr(ppp->rx_stats);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len - 2;
+	ppp->last_recv = jiffies;
+
+	if ((ppp->dev->flags & IFF_UP) == 0 ||
+	    ppp->npmode[npi] != NPMODE_PASS) {
+		kfree_skb(skb);
+	} else {
+		/* chop off protocol */
+		skb_pull_rcsum(skb, 2);
+		skb->dev = ppp->dev;
+		skb->protocol = htons(npindex_to_ethertype[npi]);
+		skb_reset_mac_header(skb);
+		netif_rx(skb);
+	}
+	return 1;
+}
+
 static void
 ppp_receive_nonmp_frame(struct ppp *ppp, struct sk_buff *skb)
 {
+	struct ppp_rx_stats *stats;
 	struct sk_buff *ns;
 	int proto, len, npi;
 
@@ -1719,6 +1820,10 @@ ppp_receive_nonmp_frame(struct ppp *ppp, struct sk_buff *skb)
 		if (!ppp->vj || (ppp->flags & SC_REJ_COMP_TCP))
 			goto err;
 
+		/* slhc_uncompress() needs the data portion linear too */
+		if (!pskb_may_pull(skb, skb->len))
+			goto err;
+
 		if (skb_tailroom(skb) < 124 || skb_cloned(skb)) {
 			/* copy to a new sk_buff with more tailroom */
 			ns = dev_alloc_skb(skb->len + 128);
@@ -1769,8 +1874,9 @@ ppp_receive_nonmp_frame(struct ppp *ppp, struct sk_buff *skb)
 		break;
 	}
 
-	++ppp->dev->stats.rx_packets;
-	ppp->dev->stats.rx_bytes += skb->len - 2;
+	stats = this_cpu_ptr(ppp->rx_stats);
+	stats->rx_packets++;
+	stats->rx_bytes += skb->len - 2;
 
 	npi = proto_to_npindex(proto);
 	if (npi < 0) {
@@ -2556,10 +2662,13 @@ ppp_get_stats(struct ppp *ppp, struct ppp_stats *st)
 {
 	struct slcompress *vj = ppp->vj;
 
+	unsigned long packets, bytes;
+
 	memset(st, 0, sizeof(*st));
-	st->p.ppp_ipackets = ppp->dev->stats.rx_packets;
+	ppp_sum_rx_stats(ppp, &packets, &bytes);
+	st->p.ppp_ipackets = packets;
 	st->p.ppp_ierrors = ppp->dev->stats.rx_errors;
-	st->p.ppp_ibytes = ppp->dev->stats.rx_bytes;
+	st->p.ppp_ibytes = bytes;
 	st->p.ppp_opackets = ppp->dev->stats.tx_packets;
 	st->p.ppp_oerrors = ppp->dev->stats.tx_errors;
 	st->p.ppp_obytes = ppp->dev->stats.tx_bytes;
@@ -2575,6 +2684,23 @@ ppp_get_stats(struct ppp *ppp, struct ppp_stats *st)
 	st->vj.vjs_compressedin = vj->sls_i_compressed;
 }
 
+static void
+ppp_sum_rx_stats(struct ppp *ppp, unsigned long *packets,
+		 unsigned long *bytes)
+{
+	int cpu;
+
+	*packets = 0;
+	*bytes = 0;
+	for_each_possible_cpu(cpu) {
+		const struct ppp_rx_stats *stats;
+
+		stats = per_cpu_ptr(ppp->rx_stats, cpu);
+		*packets += stats->rx_packets;
+		*bytes += stats->rx_bytes;
+	}
+}
+
 /*
  * Stuff for handling the lists of ppp units and channels
  * and for initialization.
@@ -2602,6 +2728,9 @@ ppp_create_interface(struct net *net, int unit, int *retp)
 
 	ppp = netdev_priv(dev);
 	ppp->dev = dev;
+	ppp->rx_stats = alloc_percpu(struct ppp_rx_stats);
+	if (!ppp->rx_stats)
+		goto out2;
 	ppp->mru = PPP_MRU;
 	init_ppp_file(&ppp->file, INTERFACE);
 	ppp->file.hdrlen = PPP_HDRLEN - 2;	/* don't count proto bytes */
@@ -2628,11 +2757,11 @@ ppp_create_interface(struct net *net, int unit, int *retp)
 		unit = unit_get(&pn->units_idr, ppp);
 		if (unit < 0) {
 			*retp = unit;
-			goto out2;
+			goto out3;
 		}
 	} else {
 		if (unit_find(&pn->units_idr, unit))
-			goto out2; /* unit already exists */
+			goto out3; /* unit already exists */
 		/*
 		 * if caller need a specified unit number
 		 * lets try to satisfy him, otherwise --
@@ -2644,7 +2773,7 @@ ppp_create_interface(struct net *net, int unit, int *retp)
 		 */
 		unit = unit_set(&pn->units_idr, ppp, unit);
 		if (unit < 0)
-			goto out2;
+			goto out3;
 	}
 
 	/* Initialize the new ppp unit */
@@ -2656,7 +2785,7 @@ ppp_create_interface(struct net *net, int unit, int *retp)
 		unit_put(&pn->units_idr, unit);
 		printk(KERN_ERR "PPP: couldn't register device %s (%d)\n",
 		       dev->name, ret);
-		goto out2;
+		goto out3;
 	}
 
 	ppp->ppp_net = net;
@@ -2667,8 +2796,10 @@ ppp_create_interface(struct net *net, int unit, int *retp)
 	*retp = 0;
 	return ppp;
 
-out2:
+out3:
 	mutex_unlock(&pn->all_ppp_mutex);
+	free_percpu(ppp->rx_stats);
+out2:
 	free_netdev(dev);
 out1:
 	*retp = ret;
@@ -2752,6 +2883,7 @@ static void ppp_destroy_interface(struct ppp *ppp)
 
 	kfree_skb(ppp->xmit_pending);
 
+	free_percpu(ppp->rx_stats);
 	free_netdev(ppp->dev);
 }
 
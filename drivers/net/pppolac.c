@@ -16,9 +16,10 @@
 
 /* This driver handles L2TP data packets between a UDP socket and a PPP channel.
  * To keep things simple, only one session per socket is permitted. Packets are
- * sent via the socket, so it must keep connected to the same address. One must
- * not set sequencing in ICCN but let LNS controll it. Currently this driver
- * only works on IPv4 due to the lack of UDP encapsulation support in IPv6. */
+ * sent on the route of the socket, so it must keep connected to the same
+ * address. One must not set sequencing in ICCN but let LNS controll it.
+ * Currently this driver only works on IPv4 due to the lack of UDP encapsulation
+ * support in IPv6. */
 
 #include <linux/module.h>
 #include <linux/workqueue.h>
@@ -31,6 +32,9 @@
 #include <linux/if_ppp.h>
 #include <linux/if_pppox.h>
 #include <linux/ppp_channel.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/udp.h>
 #include <net/tcp_states.h>
 #include <asm/uaccess.h>
 
@@ -57,11 +61,13 @@ static int pppolac_recv_core(struct sock *sk_udp, struct sk_buff *skb)
 {
 	struct sock *sk = (struct sock *)sk_udp->sk_user_data;
 	struct pppolac_opt *opt = &pppox_sk(sk)->proto.lac;
+	int length;
 	__u8 bits;
 	__u8 *ptr;
 
-	/* Drop the packet if it is too short. */
-	if (skb->len < sizeof(struct udphdr) + 6)
+	/* Drop the packet if it is too short. Only the headers are pulled into
+	 * the linear part; the payload may stay in page fragments. */
+	if (!pskb_may_pull(skb, sizeof(struct udphdr) + 6))
 		goto drop;
 
 	/* Put it back if it is a control packet. */
@@ -75,6 +81,11 @@ static int pppolac_recv_core(struct sock *sk_udp, struct sk_buff *skb)
 	if ((skb->data[1] & L2TP_VERSION_MASK) != L2TP_VERSION)
 		goto drop;
 	bits = skb->data[0];
+	length = 6 + (bits & L2TP_SEQUENCE_BIT ? 4 : 0) +
+			(bits & L2TP_LENGTH_BIT ? 2 : 0) +
+			(bits & L2TP_OFFSET_BIT ? 2 : 0);
+	if (!pskb_may_pull(skb, length))
+		goto drop;
 	ptr = &skb->data[2];
 
 	/* Check the length if it is present. */
@@ -84,19 +95,16 @@ static int pppolac_recv_core(struct sock *sk_udp, struct sk_buff *skb)
 		ptr += 2;
 	}
 
-	/* Skip all fields including optional ones. */
-	if (!skb_pull(skb, 6 + (bits & L2TP_SEQUENCE_BIT ? 4 : 0) +
-			(bits & L2TP_LENGTH_BIT ? 2 : 0) +
-			(bits & L2TP_OFFSET_BIT ? 2 : 0)))
+	/* Check the tunnel and the session. */
+	if (unaligned(ptr)->u32 != opt->local)
 		goto drop;
 
+	/* Skip all fields including optional ones. */
+	__skb_pull(skb, length);
+
 	/* Skip the offset padding if it is present. */
 	if (bits & L2TP_OFFSET_BIT &&
-			!skb_pull(skb, skb->data[-2] << 8 | skb->data[-1]))
-		goto drop;
-
-	/* Check the tunnel and the session. */
-	if (unaligned(ptr)->u32 != opt->local)
+			!pskb_pull(skb, skb->data[-2] << 8 | skb->data[-1]))
 		goto drop;
 
 	/* Check the sequence if it is present. According to RFC 2661 section
@@ -104,13 +112,16 @@ static int pppolac_recv_core(struct sock *sk_udp, struct sk_buff *skb)
 	opt->sequencing = bits & L2TP_SEQUENCE_BIT;
 
 	/* Skip PPP address and control if they are present. */
-	if (skb->len >= 2 && skb->data[0] == PPP_ADDR &&
+	if (pskb_may_pull(skb, 2) && skb->data[0] == PPP_ADDR &&
 			skb->data[1] == PPP_CTRL)
 		skb_pull(skb, 2);
 
 	/* Fix PPP protocol if it is compressed. */
-	if (skb->len >= 1 && skb->data[0] & 1)
+	if (pskb_may_pull(skb, 1) && skb->data[0] & 1) {
+		if (skb_cow_head(skb, 1))
+			goto drop;
 		skb_push(skb, 1)[0] = 0;
+	}
 
 	/* Finally, deliver the packet to PPP channel. */
 	skb_orphan(skb);
@@ -130,6 +141,10 @@ static int pppolac_recv(struct sock *sk_udp, struct sk_buff *skb)
 
 static struct sk_buff_head delivery_queue;
 
+/* Packets queued and not yet sent. While there are any, the following ones
+ * are queued too, so that they don't get ahead. */
+static atomic_t delivery_pending = ATOMIC_INIT(0);
+
 static void pppolac_xmit_core(struct work_struct *delivery_work)
 {
 	mm_segment_t old_fs = get_fs();
@@ -146,17 +161,86 @@ static void pppolac_xmit_core(struct work_struct *delivery_work)
 		};
 		sk_udp->sk_prot->sendmsg(NULL, sk_udp, &msg, skb->len);
 		kfree_skb(skb);
+		atomic_dec(&delivery_pending);
 	}
 	set_fs(old_fs);
 }
 
 static DECLARE_WORK(delivery_work, pppolac_xmit_core);
 
+/* Sends the packet on the cached route of the UDP socket, building the UDP
+ * header in front of it as udp_sendmsg() would, without copying it. Returns
+ * -EAGAIN if the socket has no valid route, leaving the packet alone. */
+static int pppolac_xmit_direct(struct sock *sk_udp, struct sk_buff *skb)
+{
+	struct inet_sock *inet = inet_sk(sk_udp);
+	struct ip_options *ip_opt = inet->opt;
+	struct dst_entry *dst;
+	struct rtable *rt;
+	struct udphdr *uh;
+
+	dst = sk_dst_check(sk_udp, 0);
+	if (!dst)
+		return -EAGAIN;
+	rt = (struct rtable *)dst;
+
+	if (skb_cow_head(skb, sizeof(struct udphdr) + sizeof(struct iphdr) +
+			(ip_opt ? ip_opt->optlen : 0) + dst->header_len +
+			LL_RESERVED_SPACE(dst->dev))) {
+		dst_release(dst);
+		kfree_skb(skb);
+		return 0;
+	}
+
+	memset(IPCB(skb), 0, sizeof(*IPCB(skb)));
+	nf_reset(skb);
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst);
+
+	uh = (struct udphdr *)skb_push(skb, sizeof(struct udphdr));
+	skb_reset_transport_header(skb);
+	uh->source = inet->inet_sport;
+	uh->dest = inet->inet_dport;
+	uh->len = htons(skb->len);
+	uh->check = 0;
+
+	if (sk_udp->sk_no_check == UDP_CSUM_NOXMIT) {
+		skb->ip_summed = CHECKSUM_NONE;
+	} else if ((dst->dev->features & NETIF_F_V4_CSUM) &&
+			skb->len + sizeof(struct iphdr) +
+			(ip_opt ? ip_opt->optlen : 0) <= dst_mtu(dst)) {
+		/* Only when it won't be fragmented: ip_fragment() leaves a
+		 * partial checksum unresolved. */
+		skb->ip_summed = CHECKSUM_PARTIAL;
+		skb->csum_start = skb_transport_header(skb) - skb->head;
+		skb->csum_offset = offsetof(struct udphdr, check);
+		uh->check = ~csum_tcpudp_magic(rt->rt_src, rt->rt_dst,
+				skb->len, IPPROTO_UDP, 0);
+	} else {
+		skb->ip_summed = CHECKSUM_NONE;
+		uh->check = csum_tcpudp_magic(rt->rt_src, rt->rt_dst, skb->len,
+				IPPROTO_UDP, skb_checksum(skb, 0, skb->len, 0));
+		if (!uh->check)
+			uh->check = CSUM_MANGLED_0;
+	}
+
+	skb->local_df = 1;
+	skb_set_owner_w(skb, sk_udp);
+	ip_queue_xmit(skb);
+	return 0;
+}
+
 static int pppolac_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 {
 	struct sock *sk_udp = (struct sock *)chan->private;
 	struct pppolac_opt *opt = &pppox_sk(sk_udp->sk_user_data)->proto.lac;
 
+	/* The headers below are written in place. */
+	if (skb_cow_head(skb, chan->hdrlen)) {
+		kfree_skb(skb);
+		return 1;
+	}
+
 	/* Install PPP address and control. */
 	skb_push(skb, 2);
 	skb->data[0] = PPP_ADDR;
@@ -178,10 +262,15 @@ static int pppolac_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 	skb->data[1] = L2TP_VERSION;
 	unaligned(&skb->data[2])->u32 = opt->remote;
 
-	/* Now send the packet via the delivery queue. */
-	skb_set_owner_w(skb, sk_udp);
-	skb_queue_tail(&delivery_queue, skb);
-	schedule_work(&delivery_work);
+	/* Now send the packet, or leave it to sendmsg() via the delivery queue
+	 * if the route has to be looked up again or packets are queued. */
+	if (atomic_read(&delivery_pending) ||
+			pppolac_xmit_direct(sk_udp, skb)) {
+		skb_set_owner_w(skb, sk_udp);
+		atomic_inc(&delivery_pending);
+		skb_queue_tail(&delivery_queue, skb);
+		schedule_work(&delivery_work);
+	}
 	return 1;
 }
 
@@ -198,6 +287,7 @@ static int pppolac_connect(struct socket *sock, struct sockaddr *useraddr,
 	struct pppox_sock *po = pppox_sk(sk);
 	struct sockaddr_pppolac *addr = (struct sockaddr_pppolac *)useraddr;
 	struct socket *sock_udp = NULL;
+	struct dst_entry *dst;
 	struct sock *sk_udp;
 	int error;
 
@@ -231,16 +321,20 @@ static int pppolac_connect(struct socket *sock, struct sockaddr *useraddr,
 	error = -EBUSY;
 	if (udp_sk(sk_udp)->encap_type || sk_udp->sk_user_data)
 		goto out;
+	dst = sk_dst_get(sk_udp);
 	if (!sk_udp->sk_bound_dev_if) {
-		struct dst_entry *dst = sk_dst_get(sk_udp);
 		error = -ENODEV;
 		if (!dst)
 			goto out;
 		sk_udp->sk_bound_dev_if = dst->dev->ifindex;
-		dst_release(dst);
 	}
 
-	po->chan.hdrlen = 12;
+	/* Leave room for L2TP, UDP, IP and the link layer header below, so
+	 * packets can be sent without reallocation. */
+	po->chan.hdrlen = 12 + sizeof(struct udphdr) + sizeof(struct iphdr) +
+		(dst ? dst->header_len + LL_RESERVED_SPACE(dst->dev) :
+		LL_MAX_HEADER);
+	dst_release(dst);
 	po->chan.private = sk_udp;
 	po->chan.ops = &pppolac_channel_ops;
 	po->chan.mtu = PPP_MTU - 80;
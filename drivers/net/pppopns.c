@@ -28,9 +28,12 @@
 #include <linux/net.h>
 #include <linux/ppp_defs.h>
 #include <linux/if.h>
+#include <linux/ipv6.h>
 #include <linux/if_ppp.h>
 #include <linux/if_pppox.h>
 #include <linux/ppp_channel.h>
+#include <net/ip.h>
+#include <net/route.h>
 #include <asm/uaccess.h>
 
 #define GRE_HEADER_SIZE		8
@@ -57,12 +60,14 @@ static int pppopns_recv_core(struct sock *sk_raw, struct sk_buff *skb)
 	struct sock *sk = (struct sock *)sk_raw->sk_user_data;
 	struct pppopns_opt *opt = &pppox_sk(sk)->proto.pns;
 	struct header *hdr;
+	int length;
 
 	/* Skip transport header */
 	skb_pull(skb, skb_transport_header(skb) - skb->data);
 
-	/* Drop the packet if it is too short. */
-	if (skb->len < GRE_HEADER_SIZE)
+	/* Drop the packet if it is too short. Only the headers are pulled into
+	 * the linear part; the payload may stay in page fragments. */
+	if (!pskb_may_pull(skb, GRE_HEADER_SIZE))
 		goto drop;
 
 	/* Check the header. */
@@ -72,23 +77,28 @@ static int pppopns_recv_core(struct sock *sk_raw, struct sk_buff *skb)
 		goto drop;
 
 	/* Skip all fields including optional ones. */
-	if (!skb_pull(skb, GRE_HEADER_SIZE +
-			(hdr->bits & PPTP_GRE_SEQ_BIT ? 4 : 0) +
-			(hdr->bits & PPTP_GRE_ACK_BIT ? 4 : 0)))
+	length = GRE_HEADER_SIZE + (hdr->bits & PPTP_GRE_SEQ_BIT ? 4 : 0) +
+			(hdr->bits & PPTP_GRE_ACK_BIT ? 4 : 0);
+	if (!pskb_may_pull(skb, length))
 		goto drop;
+	hdr = (struct header *)skb->data;
+	__skb_pull(skb, length);
 
 	/* Check the length. */
 	if (skb->len != ntohs(hdr->length))
 		goto drop;
 
 	/* Skip PPP address and control if they are present. */
-	if (skb->len >= 2 && skb->data[0] == PPP_ADDR &&
+	if (pskb_may_pull(skb, 2) && skb->data[0] == PPP_ADDR &&
 			skb->data[1] == PPP_CTRL)
 		skb_pull(skb, 2);
 
 	/* Fix PPP protocol if it is compressed. */
-	if (skb->len >= 1 && skb->data[0] & 1)
+	if (pskb_may_pull(skb, 1) && skb->data[0] & 1) {
+		if (skb_cow_head(skb, 1))
+			goto drop;
 		skb_push(skb, 1)[0] = 0;
+	}
 
 	/* Finally, deliver the packet to PPP channel. */
 	skb_orphan(skb);
@@ -110,6 +120,32 @@ static void pppopns_recv(struct sock *sk_raw, int length)
 
 static struct sk_buff_head delivery_queue;
 
+/* Packets queued and not yet sent. While there are any, the following ones
+ * are queued too, so that they don't get ahead. */
+static atomic_t delivery_pending = ATOMIC_INIT(0);
+
+/* raw_sendmsg() doesn't cache the route it looks up. Do it here once the
+ * cached one has gone stale, so that packets can be sent directly again. */
+static void pppopns_cache_route(struct sock *sk_raw)
+{
+	struct inet_sock *inet = inet_sk(sk_raw);
+	struct dst_entry *dst;
+	struct rtable *rt;
+
+	dst = sk_dst_check(sk_raw, 0);
+	if (dst) {
+		dst_release(dst);
+		return;
+	}
+	if (ip_route_connect(&rt, inet->inet_daddr, inet->inet_saddr,
+			RT_CONN_FLAGS(sk_raw), sk_raw->sk_bound_dev_if,
+			sk_raw->sk_protocol, 0, 0, sk_raw, 0))
+		return;
+	local_bh_disable();
+	sk_dst_set(sk_raw, &rt->u.dst);
+	local_bh_enable();
+}
+
 static void pppopns_xmit_core(struct work_struct *delivery_work)
 {
 	mm_segment_t old_fs = get_fs();
@@ -125,13 +161,49 @@ static void pppopns_xmit_core(struct work_struct *delivery_work)
 			.msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT,
 		};
 		sk_raw->sk_prot->sendmsg(NULL, sk_raw, &msg, skb->len);
+		if (sk_raw->sk_family == AF_INET)
+			pppopns_cache_route(sk_raw);
 		kfree_skb(skb);
+		atomic_dec(&delivery_pending);
 	}
 	set_fs(old_fs);
 }
 
 static DECLARE_WORK(delivery_work, pppopns_xmit_core);
 
+/* Sends the packet on the cached route of an IPv4 RAW socket, as raw_sendmsg()
+ * would, without copying it. Returns -EAGAIN if the socket has no valid route,
+ * leaving the packet alone. */
+static int pppopns_xmit_direct(struct sock *sk_raw, struct sk_buff *skb)
+{
+	struct ip_options *ip_opt = inet_sk(sk_raw)->opt;
+	struct dst_entry *dst;
+
+	dst = sk_dst_check(sk_raw, 0);
+	if (!dst)
+		return -EAGAIN;
+
+	if (skb_cow_head(skb, sizeof(struct iphdr) +
+			(ip_opt ? ip_opt->optlen : 0) + dst->header_len +
+			LL_RESERVED_SPACE(dst->dev))) {
+		dst_release(dst);
+		kfree_skb(skb);
+		return 0;
+	}
+
+	memset(IPCB(skb), 0, sizeof(*IPCB(skb)));
+	nf_reset(skb);
+	skb_dst_drop(skb);
+	skb_dst_set(skb, dst);
+	skb_reset_transport_header(skb);
+	skb->ip_summed = CHECKSUM_NONE;
+	skb->local_df = 1;
+
+	skb_set_owner_w(skb, sk_raw);
+	ip_queue_xmit(skb);
+	return 0;
+}
+
 static int pppopns_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 {
 	struct sock *sk_raw = (struct sock *)chan->private;
@@ -139,6 +211,12 @@ static int pppopns_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 	struct header *hdr;
 	__u16 length;
 
+	/* The headers below are written in place. */
+	if (skb_cow_head(skb, chan->hdrlen)) {
+		kfree_skb(skb);
+		return 1;
+	}
+
 	/* Install PPP address and control. */
 	skb_push(skb, 2);
 	skb->data[0] = PPP_ADDR;
@@ -154,10 +232,16 @@ static int pppopns_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 	hdr->sequence = htonl(opt->sequence);
 	opt->sequence++;
 
-	/* Now send the packet via the delivery queue. */
-	skb_set_owner_w(skb, sk_raw);
-	skb_queue_tail(&delivery_queue, skb);
-	schedule_work(&delivery_work);
+	/* Now send the packet, or leave it to sendmsg() via the delivery queue
+	 * for IPv6, if the route has to be looked up again or if packets are
+	 * queued. */
+	if (sk_raw->sk_family != AF_INET || atomic_read(&delivery_pending) ||
+			pppopns_xmit_direct(sk_raw, skb)) {
+		skb_set_owner_w(skb, sk_raw);
+		atomic_inc(&delivery_pending);
+		skb_queue_tail(&delivery_queue, skb);
+		schedule_work(&delivery_work);
+	}
 	return 1;
 }
 
@@ -176,6 +260,7 @@ static int pppopns_connect(struct socket *sock, struct sockaddr *useraddr,
 	struct sockaddr_storage ss;
 	struct socket *sock_tcp = NULL;
 	struct socket *sock_raw = NULL;
+	struct dst_entry *dst;
 	struct sock *sk_tcp;
 	struct sock *sk_raw;
 	int error;
@@ -217,7 +302,14 @@ static int pppopns_connect(struct socket *sock, struct sockaddr *useraddr,
 	if (error)
 		goto out;
 
-	po->chan.hdrlen = 14;
+	/* Leave room for GRE, IP and the link layer header below, so packets
+	 * can be sent without reallocation. */
+	dst = sk_dst_get(sk_raw);
+	po->chan.hdrlen = 14 + (ss.ss_family == AF_INET6 ?
+		sizeof(struct ipv6hdr) : sizeof(struct iphdr)) +
+		(dst ? dst->header_len + LL_RESERVED_SPACE(dst->dev) :
+		LL_MAX_HEADER);
+	dst_release(dst);
 	po->chan.private = sk_raw;
 	po->chan.ops = &pppopns_channel_ops;
 	po->chan.mtu = PPP_MTU - 80;
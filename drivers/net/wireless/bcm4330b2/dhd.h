@@ -136,6 +136,7 @@ typedef struct dhd_pub {
 	ulong rx_dropped;	/* Packets dropped locally (no memory) */
 	ulong rx_flushed;  /* Packets flushed due to unscheduled sendup thread */
 	ulong wd_dpc_sched;   /* Number of times dhd dpc scheduled by watchdog timer */
+	ulong rx_polls;		/* NAPI polls that delivered rx packets */
 
 	ulong rx_readahead_cnt;	/* Number of packets where header read-ahead was used. */
 	ulong tx_realloc;	/* Number of tx packets we had to realloc for headroom */
@@ -335,6 +336,9 @@ extern bool dhd_prec_enq(dhd_pub_t *dhdp, struct pktq *q, void *pkt, int prec);
 /* Receive frame for delivery to OS.  Callee disposes of rxp. */
 extern void dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *rxp, int numpkt, uint8 chan);
 
+/* Push frames queued by dhd_rx_frame() to the network stack */
+extern void dhd_os_rx_flush(dhd_pub_t *dhdp);
+
 /* Return pointer to interface name */
 extern char *dhd_ifname(dhd_pub_t *dhdp, int idx);
 
@@ -512,6 +516,12 @@ extern uint dhd_pktgen;
 /* Echo packet len (0 => sawtooth, max 1800) */
 extern uint dhd_pktgen_len;
 #define MAX_PKTGEN_LEN 1800
+
+/* pcap file the rx bus stub replays, empty for the SDIO bus */
+extern char dhd_rxstub[];
+
+/* Busy time of all online cpus, msecs */
+extern uint32 dhd_os_cpu_busy_ms(void);
 #endif
 
 
@@ -80,6 +80,9 @@ extern void dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf);
 /* Clear any bus counters */
 extern void dhd_bus_clearcounts(dhd_pub_t *dhdp);
 
+/* Rx glom superframes, packets in them and glom failures so far */
+extern void dhd_bus_rxglom_stats(struct dhd_bus *bus, uint *frames, uint *pkts, uint *fails);
+
 /* return the dongle chipid */
 extern uint dhd_bus_chip(struct dhd_bus *bus);
 
@@ -90,4 +93,9 @@ extern void *dhd_bus_pub(struct dhd_bus *bus);
 extern void *dhd_bus_txq(struct dhd_bus *bus);
 extern uint dhd_bus_hdrlen(struct dhd_bus *bus);
 
+#ifdef SDTEST
+/* Replay the rx bus stub frames, when attached with dhd_rxstub */
+extern int dhd_bus_rxstub_run(uint rounds);
+#endif /* SDTEST */
+
 #endif /* _dhd_bus_h_ */
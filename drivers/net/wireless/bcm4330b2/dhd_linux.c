@@ -45,6 +45,7 @@
 #include <linux/fs.h>
 //HTC_CSP_START
 #include <linux/ioprio.h>
+#include <linux/kernel_stat.h>
 #include <mach/perflock.h>
 //HTC_CSP_END
 
@@ -406,6 +407,19 @@ typedef struct dhd_info {
 	bool set_multicast;
 	bool set_macaddress;
 	struct ether_addr macvalue;
+	bool set_rxglom;
+	bool rxglom_on;			/* Glom last asked of the dongle */
+	ulong rxglom_stamp;		/* jiffies of the last rate sample */
+	ulong rxglom_rx_packets;	/* rx_packets at the last sample */
+	uint rxglom_fails;		/* bus rxglomfail at the last sample */
+	uint rxglom_holdoff;		/* Seconds to leave glom off after failures */
+	uint rxglom_backoff;		/* Next holdoff, doubled on each failure */
+#ifdef DHD_RX_NAPI
+	struct napi_struct rx_napi;
+	struct sk_buff_head rx_napi_queue;	/* Filled by dhd_rx_frame(), under its lock */
+	struct sk_buff_head rx_napi_work;	/* Owned by the poll routine */
+	bool rx_napi_enabled;
+#endif /* DHD_RX_NAPI */
 	wait_queue_head_t ctrl_wait;
 	atomic_t pend_8021x_cnt;
 	dhd_attach_states_t dhd_state;
@@ -551,6 +565,32 @@ module_param(dhd_rxbound, uint, 0);
 extern uint dhd_deferred_tx;
 module_param(dhd_deferred_tx, uint, 0);
 
+#ifdef DHD_RX_NAPI
+/* Packets per NAPI poll, and the most waiting for one before we drop */
+uint dhd_napi_weight = 64;
+module_param(dhd_napi_weight, uint, 0);
+
+uint dhd_rx_napi_qlimit = 1000;
+module_param(dhd_rx_napi_qlimit, uint, 0);
+#endif /* DHD_RX_NAPI */
+
+#ifdef DHD_PKTPOOL
+/* Receive buffers kept ready in the OSL packet pool */
+uint dhd_rxpool_size = 64;
+module_param(dhd_rxpool_size, uint, 0);
+#endif /* DHD_PKTPOOL */
+
+/* Rx glomming in the dongle: 0 off, 1 on, 2 on only at high receive rates */
+uint dhd_rxglom_mode = 2;
+module_param(dhd_rxglom_mode, uint, 0644);
+
+/* Receive rates (pkts/s) at which adaptive mode turns glomming on and off */
+uint dhd_rxglom_on_pps = 2000;
+module_param(dhd_rxglom_on_pps, uint, 0644);
+
+uint dhd_rxglom_off_pps = 500;
+module_param(dhd_rxglom_off_pps, uint, 0644);
+
 #ifdef BCMDBGFS
 extern void dhd_dbg_init(dhd_pub_t *dhdp);
 extern void dhd_dbg_remove(void);
@@ -566,6 +606,41 @@ module_param(dhd_pktgen, uint, 0);
 /* Echo packet len (0 => sawtooth, max 2040) */
 uint dhd_pktgen_len = 0;
 module_param(dhd_pktgen_len, uint, 0);
+
+/* pcap file to attach the rx bus stub with, instead of the SDIO bus */
+char dhd_rxstub[MOD_PARAM_PATHLEN];
+module_param_string(dhd_rxstub, dhd_rxstub, MOD_PARAM_PATHLEN, 0);
+
+/* Write N to replay the rx bus stub frames N times, results in the log */
+static uint dhd_rxstub_rounds = 0;
+
+static int
+dhd_rxstub_rounds_set(const char *val, struct kernel_param *kp)
+{
+	int ret;
+
+	if ((ret = param_set_uint(val, kp)) != 0)
+		return ret;
+	return OSL_ERROR(dhd_bus_rxstub_run(dhd_rxstub_rounds));
+}
+module_param_call(dhd_rxstub_rounds, dhd_rxstub_rounds_set, param_get_uint,
+                  &dhd_rxstub_rounds, 0644);
+
+uint32
+dhd_os_cpu_busy_ms(void)
+{
+	cputime64_t busy = cputime64_zero;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.user);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.nice);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.system);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.irq);
+		busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.softirq);
+	}
+	return jiffies_to_msecs((unsigned long)cputime64_to_jiffies64(busy));
+}
 #endif /* SDTEST */
 
 /* Version string to report */
@@ -1012,6 +1087,97 @@ _dhd_set_mac_address(dhd_info_t *dhd, int ifidx, struct ether_addr *addr)
 	return ret;
 }
 
+static int
+_dhd_set_rxglom(dhd_info_t *dhd, bool on)
+{
+	char buf[32];
+	uint32 glom = on;
+	wl_ioctl_t ioc;
+	int ret;
+
+	if (!bcm_mkiovar("bus:txglom", (char *)&glom, 4, buf, sizeof(buf))) {
+		DHD_ERROR(("%s: mkiovar failed for bus:txglom\n", dhd_ifname(&dhd->pub, 0)));
+		return -1;
+	}
+	memset(&ioc, 0, sizeof(ioc));
+	ioc.cmd = WLC_SET_VAR;
+	ioc.buf = buf;
+	ioc.len = sizeof(buf);
+	ioc.set = TRUE;
+
+	ret = dhd_wl_ioctl(&dhd->pub, 0, &ioc, ioc.buf, ioc.len);
+	if (ret < 0)
+		DHD_ERROR(("%s: set bus:txglom %d failed\n", dhd_ifname(&dhd->pub, 0), glom));
+	else
+		DHD_INFO(("%s: rx glom %s\n", dhd_ifname(&dhd->pub, 0), on ? "on" : "off"));
+
+	return ret;
+}
+
+/*
+ * Once a second, decide whether the dongle should glom frames for us.
+ * Glomming saves SDIO transactions when data streams in, but costs
+ * latency and memory at low rates, and some access points make the
+ * dongle fail superframes; then leave it off for a while, longer each
+ * time it fails again.
+ */
+static void
+dhd_rxglom_watchdog(dhd_info_t *dhd)
+{
+	uint frames, pkts, fails;
+	ulong pps;
+	bool on;
+
+	if (!dhd->pub.up || dhd->pub.busstate != DHD_BUS_DATA) {
+		/* The dongle starts with glomming off */
+		dhd->rxglom_on = FALSE;
+		dhd->rxglom_stamp = 0;
+		return;
+	}
+
+	if (dhd->rxglom_stamp && time_before(jiffies, dhd->rxglom_stamp + HZ))
+		return;
+
+	dhd_bus_rxglom_stats(dhd->pub.bus, &frames, &pkts, &fails);
+	if (!dhd->rxglom_stamp || dhd->pub.rx_packets < dhd->rxglom_rx_packets ||
+	    fails < dhd->rxglom_fails) {
+		/* First sample, or the counters were cleared */
+		pps = 0;
+	} else {
+		pps = (dhd->pub.rx_packets - dhd->rxglom_rx_packets) * HZ /
+		      MAX(jiffies - dhd->rxglom_stamp, 1);
+	}
+
+	on = dhd->rxglom_on;
+	if (dhd_rxglom_mode != 2) {
+		on = (dhd_rxglom_mode != 0);
+	} else if (fails > dhd->rxglom_fails && dhd->rxglom_stamp) {
+		dhd->rxglom_backoff = MIN(MAX(dhd->rxglom_backoff * 2, 1), 64);
+		dhd->rxglom_holdoff = dhd->rxglom_backoff;
+		on = FALSE;
+	} else if (dhd->rxglom_holdoff) {
+		dhd->rxglom_holdoff--;
+	} else if (pps > dhd_rxglom_on_pps) {
+		on = TRUE;
+	} else if (pps < dhd_rxglom_off_pps) {
+		on = FALSE;
+		/* A quiet spell forgives earlier failures */
+		dhd->rxglom_backoff = 0;
+	}
+
+	dhd->rxglom_stamp = jiffies;
+	dhd->rxglom_rx_packets = dhd->pub.rx_packets;
+	dhd->rxglom_fails = fails;
+
+	if (on != dhd->rxglom_on && dhd->thr_sysioc_ctl.thr_pid >= 0) {
+		dhd->rxglom_on = on;
+		dhd->set_rxglom = TRUE;
+		/* Released by the sysioc thread once it has run */
+		DHD_OS_WAKE_LOCK(&dhd->pub);
+		up(&dhd->thr_sysioc_ctl.sema);
+	}
+}
+
 #ifdef SOFTAP
 extern struct net_device *ap_net_dev;
 extern tsk_ctl_t ap_eth_ctl; /* ap netdev heper thread ctl */
@@ -1172,6 +1338,10 @@ _dhd_sysioc_thread(void *data)
 				}
 			}
 		}
+		if (dhd->set_rxglom) {
+			dhd->set_rxglom = FALSE;
+			_dhd_set_rxglom(dhd, dhd->rxglom_on);
+		}
 		DHD_OS_WAKE_UNLOCK(&dhd->pub);
 	}
 	DHD_TRACE(("%s: stopped\n", __FUNCTION__));
@@ -1492,11 +1662,95 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 	}
 }
 
+#ifdef DHD_RX_NAPI
+static void
+dhd_rx_napi_schedule(dhd_info_t *dhd)
+{
+	if (in_interrupt()) {
+		napi_schedule(&dhd->rx_napi);
+	} else {
+		/* Let the softirq run as soon as we are done here */
+		local_bh_disable();
+		napi_schedule(&dhd->rx_napi);
+		local_bh_enable();
+	}
+}
+
+/* Queue up frames for the poll routine; the bus calls dhd_os_rx_flush()
+ * once it has read what the dongle had for us.
+ */
+static void
+dhd_rx_napi_queue(dhd_info_t *dhd, struct sk_buff_head *rxq)
+{
+	ulong flags;
+	uint qlen;
+
+	spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+	if (!dhd->rx_napi_enabled ||
+	    skb_queue_len(&dhd->rx_napi_queue) >= dhd_rx_napi_qlimit) {
+		spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+		dhd->pub.rx_dropped += skb_queue_len(rxq);
+		__skb_queue_purge(rxq);
+		return;
+	}
+	skb_queue_splice_tail_init(rxq, &dhd->rx_napi_queue);
+	qlen = skb_queue_len(&dhd->rx_napi_queue);
+	spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+
+	if (qlen >= dhd_napi_weight)
+		dhd_rx_napi_schedule(dhd);
+}
+
+static int
+dhd_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	if (skb_queue_empty(&dhd->rx_napi_work)) {
+		spin_lock_irq(&dhd->rx_napi_queue.lock);
+		skb_queue_splice_tail_init(&dhd->rx_napi_queue, &dhd->rx_napi_work);
+		spin_unlock_irq(&dhd->rx_napi_queue.lock);
+	}
+
+	while (work < budget && (skb = __skb_dequeue(&dhd->rx_napi_work)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+	if (work)
+		dhd->pub.rx_polls++;
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* Frames queued after the splice would wait for the next flush */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+#endif /* DHD_RX_NAPI */
+
+void
+dhd_os_rx_flush(dhd_pub_t *dhdp)
+{
+#ifdef DHD_RX_NAPI
+	dhd_info_t *dhd = (dhd_info_t *)dhdp->info;
+
+	if (!skb_queue_empty(&dhd->rx_napi_queue))
+		dhd_rx_napi_schedule(dhd);
+#endif /* DHD_RX_NAPI */
+}
+
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 {
 	dhd_info_t *dhd = (dhd_info_t *)dhdp->info;
 	struct sk_buff *skb;
+#ifdef DHD_RX_NAPI
+	struct sk_buff_head rxq;
+#endif
 	uchar *eth;
 	uint len;
 	void *data = NULL, *pnext, *save_pktbuf;
@@ -1525,6 +1779,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 //HTC_CSP_END
 
 	save_pktbuf = pktbuf;
+#ifdef DHD_RX_NAPI
+	__skb_queue_head_init(&rxq);
+#endif
 
 	for (i = 0; pktbuf && i < numpkt; i++, pktbuf = pnext) {
 		struct ether_header *eh;
@@ -1625,6 +1882,11 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		dhdp->dstats.rx_bytes += skb->len;
 		dhdp->rx_packets++; /* Local count */
 
+#ifdef DHD_RX_NAPI
+		if (dhd->rx_napi_enabled) {
+			__skb_queue_tail(&rxq, skb);
+		} else
+#endif /* DHD_RX_NAPI */
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1645,6 +1907,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) */
 		}
 	}
+#ifdef DHD_RX_NAPI
+	if (!skb_queue_empty(&rxq))
+		dhd_rx_napi_queue(dhd, &rxq);
+#endif /* DHD_RX_NAPI */
 	DHD_OS_WAKE_LOCK_TIMEOUT_ENABLE(dhdp);
 }
 
@@ -1764,6 +2030,7 @@ dhd_watchdog_thread(void *data)
 
 				/* Call the bus module watchdog */
 				dhd_bus_watchdog(&dhd->pub);
+				dhd_rxglom_watchdog(dhd);
 
 				/* Count the tick for reference */
 				dhd->pub.tickcnt++;
@@ -1798,6 +2065,7 @@ static void dhd_watchdog(ulong data)
 	dhd_os_sdlock(&dhd->pub); 
 	/* Call the bus module watchdog */
 	dhd_bus_watchdog(&dhd->pub);
+	dhd_rxglom_watchdog(dhd);
 
 	/* Count the tick for reference */
 	dhd->pub.tickcnt++;
@@ -2345,6 +2613,16 @@ dhd_stop(struct net_device *net)
 #ifdef WL_CFG80211
 	wl_cfg80211_down();
 #endif
+#ifdef DHD_RX_NAPI
+	if (dhd->iflist[0] && net == dhd->iflist[0]->net && dhd->rx_napi_enabled) {
+		spin_lock_irq(&dhd->rx_napi_queue.lock);
+		dhd->rx_napi_enabled = FALSE;
+		spin_unlock_irq(&dhd->rx_napi_queue.lock);
+		napi_disable(&dhd->rx_napi);
+		skb_queue_purge(&dhd->rx_napi_queue);
+		__skb_queue_purge(&dhd->rx_napi_work);
+	}
+#endif /* DHD_RX_NAPI */
 	if (dhd->pub.up == 0) {
 		return 0;
 	}
@@ -2414,6 +2692,12 @@ dhd_open(struct net_device *net)
 	else
 		dhd->iflist[ifidx]->net->features &= ~NETIF_F_IP_CSUM;
 #endif
+#ifdef DHD_RX_NAPI
+	if (!dhd->rx_napi_enabled) {
+		napi_enable(&dhd->rx_napi);
+		dhd->rx_napi_enabled = TRUE;
+	}
+#endif /* DHD_RX_NAPI */
 	}
 	/* Allow transmit calls */
 	netif_start_queue(net);
@@ -2436,7 +2720,15 @@ dhd_open(struct net_device *net)
 osl_t *
 dhd_osl_attach(void *pdev, uint bustype)
 {
-	return osl_attach(pdev, bustype, TRUE);
+	osl_t *osh = osl_attach(pdev, bustype, TRUE);
+
+#ifdef DHD_PKTPOOL
+	/* Room for a full-size data frame with its SDPCM and BDC headers */
+	if (osh && PKTPOOL_INIT(osh, dhd_rxpool_size, 1600 + DHD_SDALIGN))
+		DHD_ERROR(("%s: rx packet pool short of %d packets\n", __FUNCTION__,
+		           dhd_rxpool_size));
+#endif /* DHD_PKTPOOL */
+	return osh;
 }
 
 void
@@ -2596,6 +2888,14 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 		goto fail;
 	dhd_state |= DHD_ATTACH_STATE_ADD_IF;
 
+#ifdef DHD_RX_NAPI
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	__skb_queue_head_init(&dhd->rx_napi_work);
+	netif_napi_add(net, &dhd->rx_napi, dhd_rx_napi_poll, dhd_napi_weight);
+	/* Without it napi_gro_receive() only passes frames up */
+	net->features |= NETIF_F_GRO;
+#endif /* DHD_RX_NAPI */
+
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 31))
 	net->open = NULL;
 #else
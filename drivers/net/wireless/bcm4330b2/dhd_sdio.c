@@ -64,6 +64,9 @@
 #include <dhd_dbg.h>
 #include <dhdioctl.h>
 #include <sdiovar.h>
+#ifdef SDTEST
+#include <bcmcdc.h>
+#endif
 
 #ifndef DHDSDIO_MEM_DUMP_FNAME
 #define DHDSDIO_MEM_DUMP_FNAME         "mem_dump"
@@ -123,6 +126,11 @@
 
 #define MAX_RX_DATASZ	2048
 
+#ifdef SDTEST
+/* Most data frames the rx replay test keeps */
+#define DHD_RXCAP_MAX	32
+#endif
+
 /* Maximum milliseconds to wait for F2 to come up */
 #define DHD_WAIT_F2RDY	3000
 
@@ -284,6 +292,15 @@ typedef struct dhd_bus {
 #define PKTGEN_RCV_ONGOING  (1)
 	uint16		pktgen_rcv_state;		/* receive state */
 	uint		pktgen_rcvd_rcvsession;	/* test pkts rcvd per rcv session. */
+
+	/* rx replay: data frames captured off the bus, fed back without SDIO */
+	uint8		*rxcap_buf;		/* DHD_RXCAP_MAX frames of MAX_RX_DATASZ */
+	uint16		rxcap_len[DHD_RXCAP_MAX];
+	uint		rxcap_want;		/* Frames still to capture */
+	uint		rxcap_count;		/* Frames captured */
+	uint		rxreplay_frames;	/* Frames sent up by the last replay */
+	uint32		rxreplay_ms;		/* and how long it took */
+	uint32		rxreplay_cpu_ms;	/* and the cpu time of all cpus */
 #endif /* SDTEST */
 
 	/* Some additional counters */
@@ -462,6 +479,7 @@ do { \
 #ifdef SDTEST
 static void dhdsdio_testrcv(dhd_bus_t *bus, void *pkt, uint seq);
 static void dhdsdio_sdtest_set(dhd_bus_t *bus, uint8 count);
+static void dhdsdio_rxcap(dhd_bus_t *bus, void *pkt);
 #endif
 
 #ifdef DHD_DEBUG
@@ -1576,6 +1594,8 @@ enum {
 #ifdef SDTEST
 	IOV_PKTGEN,
 	IOV_EXTLOOP,
+	IOV_RXCAP,
+	IOV_RXREPLAY,
 #endif /* SDTEST */
 	IOV_SPROM,
 	IOV_TXBOUND,
@@ -1626,6 +1646,8 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 #ifdef SDTEST
 	{"extloop",	IOV_EXTLOOP,	0,	IOVT_BOOL,	0 },
 	{"pktgen",	IOV_PKTGEN,	0,	IOVT_BUFFER,	sizeof(dhd_pktgen_t) },
+	{"rxcap",	IOV_RXCAP,	0,	IOVT_UINT32,	0 },
+	{"rxreplay",	IOV_RXREPLAY,	0,	IOVT_UINT32,	0 },
 #endif /* SDTEST */
 	{"dngl_isolation", IOV_DONGLEISOLATION,	0,	IOVT_UINT32,	0 },
 #ifdef SOFTAP
@@ -1720,6 +1742,15 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		bcm_bprintf(strbuf, "send attempts %d rcvd %d fail %d\n",
 		            bus->pktgen_sent, bus->pktgen_rcvd, bus->pktgen_fail);
 	}
+	if (bus->rxcap_count || bus->rxcap_want) {
+		bcm_bprintf(strbuf, "rxcap %d/%d rxreplay frames %d msecs %d cpu msecs %d",
+		            bus->rxcap_count, bus->rxcap_count + bus->rxcap_want,
+		            bus->rxreplay_frames, bus->rxreplay_ms, bus->rxreplay_cpu_ms);
+		if (bus->rxreplay_ms)
+			bcm_bprintf(strbuf, " (%d pkts/s)",
+			            bus->rxreplay_frames * 1000 / bus->rxreplay_ms);
+		bcm_bprintf(strbuf, "\n");
+	}
 #endif /* SDTEST */
 #ifdef DHD_DEBUG
 	bcm_bprintf(strbuf, "dpc_sched %d host interrupt%spending\n",
@@ -1743,6 +1774,15 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
+/* Rx glomming counters, for the host side to judge whether glom pays off */
+void
+dhd_bus_rxglom_stats(struct dhd_bus *bus, uint *frames, uint *pkts, uint *fails)
+{
+	*frames = bus->rxglomframes;
+	*pkts = bus->rxglompkts;
+	*fails = bus->rxglomfail;
+}
+
 #ifdef SDTEST
 static int
 dhdsdio_pktgen_get(dhd_bus_t *bus, uint8 *arg)
@@ -1799,6 +1839,104 @@ dhdsdio_pktgen_set(dhd_bus_t *bus, uint8 *arg)
 
 	return 0;
 }
+
+/* Keep a copy of the next data frames read off the bus, BDC header and all */
+static void
+dhdsdio_rxcap(dhd_bus_t *bus, void *pkt)
+{
+	uint len = PKTLEN(bus->dhd->osh, pkt);
+
+	if (len == 0 || len > MAX_RX_DATASZ || !bus->rxcap_buf)
+		return;
+
+	bcopy(PKTDATA(bus->dhd->osh, pkt), bus->rxcap_buf + bus->rxcap_count * MAX_RX_DATASZ,
+	      len);
+	bus->rxcap_len[bus->rxcap_count++] = (uint16)len;
+	bus->rxcap_want--;
+}
+
+static int
+dhdsdio_rxcap_set(dhd_bus_t *bus, uint count)
+{
+	if (count > DHD_RXCAP_MAX)
+		return BCME_RANGE;
+
+	if (!bus->rxcap_buf && count) {
+		bus->rxcap_buf = MALLOC(bus->dhd->osh, DHD_RXCAP_MAX * MAX_RX_DATASZ);
+		if (!bus->rxcap_buf)
+			return BCME_NOMEM;
+	}
+
+	/* Start over; frames are taken by the dpc as they arrive */
+	bus->rxcap_count = 0;
+	bus->rxcap_want = count;
+	bus->rxreplay_frames = bus->rxreplay_ms = bus->rxreplay_cpu_ms = 0;
+	return 0;
+}
+
+/* Push the captured frames through the receive path 'rounds' times, with
+ * the SDIO reads taken out: per-frame host cost is what remains.  Frames
+ * reach the stack as if the dongle had sent them again.  Called without
+ * the bus lock, as the frames go up from the dpc.
+ */
+static int
+dhdsdio_rxreplay(dhd_bus_t *bus, uint rounds)
+{
+	osl_t *osh = bus->dhd->osh;
+	uint32 start, cpu, cpu_pps = 0;
+	uint i, n, frames = 0;
+	int ifidx;
+	void *pkt;
+
+	if (rounds == 0 || rounds > 0xffff)
+		return BCME_RANGE;
+	if (!bus->rxcap_count || bus->rxcap_want)
+		return BCME_NOTREADY;
+	if (!bus->dhd->up)
+		return BCME_NOTUP;
+
+	start = OSL_SYSUPTIME();
+	cpu = dhd_os_cpu_busy_ms();
+
+	for (n = 0; n < rounds; n++) {
+		for (i = 0; i < bus->rxcap_count; i++) {
+			if (!(pkt = PKTGET(osh, bus->rxcap_len[i], FALSE))) {
+				bus->dhd->rx_dropped++;
+				continue;
+			}
+			bcopy(bus->rxcap_buf + i * MAX_RX_DATASZ, PKTDATA(osh, pkt),
+			      bus->rxcap_len[i]);
+			if (dhd_prot_hdrpull(bus->dhd, &ifidx, pkt) != 0) {
+				PKTFREE(osh, pkt, FALSE);
+				continue;
+			}
+			dhd_rx_frame(bus->dhd, ifidx, pkt, 1, SDPCM_DATA_CHANNEL);
+
+			/* Same batching as dhdsdio_readframes() */
+			if (++frames % dhd_rxbound == 0) {
+				dhd_os_rx_flush(bus->dhd);
+				PKTPOOL_REFILL(osh);
+			}
+		}
+	}
+	dhd_os_rx_flush(bus->dhd);
+
+	bus->rxreplay_ms = MAX(OSL_SYSUPTIME() - start, 1);
+	bus->rxreplay_cpu_ms = dhd_os_cpu_busy_ms() - cpu;
+	bus->rxreplay_frames = frames;
+
+	/* Packets per second of cpu time, in 32 bits */
+	if (bus->rxreplay_cpu_ms)
+		cpu_pps = frames / bus->rxreplay_cpu_ms * 1000 +
+		        frames % bus->rxreplay_cpu_ms * 1000 / bus->rxreplay_cpu_ms;
+
+	DHD_ERROR(("%s: %d frames in %d ms (%d pkts/s), cpu %d ms (%d pkts per cpu-second,"
+	           " %d ns/pkt)\n", __FUNCTION__, frames, bus->rxreplay_ms,
+	           frames / bus->rxreplay_ms * 1000 +
+	           frames % bus->rxreplay_ms * 1000 / bus->rxreplay_ms,
+	           bus->rxreplay_cpu_ms, cpu_pps, cpu_pps ? 1000000000 / cpu_pps : 0));
+	return 0;
+}
 #endif /* SDTEST */
 
 static int
@@ -2632,6 +2770,26 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 	case IOV_SVAL(IOV_PKTGEN):
 		bcmerror = dhdsdio_pktgen_set(bus, arg);
 		break;
+
+	case IOV_GVAL(IOV_RXCAP):
+		int_val = (int32)bus->rxcap_count;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_RXCAP):
+		bcmerror = dhdsdio_rxcap_set(bus, (uint)int_val);
+		break;
+
+	case IOV_GVAL(IOV_RXREPLAY):
+		int_val = (int32)bus->rxreplay_frames;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_RXREPLAY):
+		dhd_os_sdunlock(bus->dhd);
+		bcmerror = dhdsdio_rxreplay(bus, (uint)int_val);
+		dhd_os_sdlock(bus->dhd);
+		break;
 #endif /* SDTEST */
 
 
@@ -2937,6 +3095,12 @@ dhd_bus_iovar_op(dhd_pub_t *dhdp, const char *name,
 	/* Set does NOT take qualifiers */
 	ASSERT(!set || (!params && !plen));
 
+#ifdef SDTEST
+	/* The rx bus stub has no SDIO device to ask or to clock */
+	if (!bus->sdh)
+		return BCME_NOTUP;
+#endif /* SDTEST */
+
 	/* Look up var locally; if not found pass to host driver */
 	if ((vi = bcm_iovar_lookup(dhdsdio_iovars, name)) == NULL) {
 		dhd_os_sdlock(bus->dhd);
@@ -3035,6 +3199,14 @@ dhd_bus_stop(struct dhd_bus *bus, bool enforce_mutex)
 	osh = bus->dhd->osh;
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef SDTEST
+	/* The rx bus stub has no device to stop */
+	if (!bus->sdh) {
+		bus->dhd->busstate = DHD_BUS_DOWN;
+		return;
+	}
+#endif /* SDTEST */
+
 	bcmsdh_waitlockfree(NULL);
 
 	if (enforce_mutex)
@@ -3705,6 +3877,11 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 			PKTSETLEN(osh, pfirst, sublen);
 			PKTPULL(osh, pfirst, doff);
 
+#ifdef SDTEST
+			if (bus->rxcap_want)
+				dhdsdio_rxcap(bus, pfirst);
+#endif /* SDTEST */
+
 			if (PKTLEN(osh, pfirst) == 0) {
 				PKTFREE(bus->dhd->osh, pfirst, FALSE);
 				if (plast) {
@@ -4298,6 +4475,8 @@ deliver:
 			dhdsdio_testrcv(bus, pkt, seq);
 			continue;
 		}
+		if (bus->rxcap_want && chan == SDPCM_DATA_CHANNEL)
+			dhdsdio_rxcap(bus, pkt);
 #endif /* SDTEST */
 
 		if (PKTLEN(osh, pkt) == 0) {
@@ -4321,6 +4500,14 @@ deliver:
 		dhd_os_sdlock(bus->dhd);
 	}
 	rxcount = maxframes - rxleft;
+
+	/* Hand the frames of this pass to the stack together */
+	if (rxcount) {
+		dhd_os_sdunlock(bus->dhd);
+		dhd_os_rx_flush(bus->dhd);
+		dhd_os_sdlock(bus->dhd);
+	}
+	PKTPOOL_REFILL(osh);
 #ifdef DHD_DEBUG
 	/* Message if we hit the limit */
 	if (!rxleft && !sdtest)
@@ -5763,6 +5950,14 @@ dhdsdio_release_malloc(dhd_bus_t *bus, osl_t *osh)
 		bus->databuf = NULL;
 	}
 
+#ifdef SDTEST
+	if (bus->rxcap_buf) {
+		MFREE(osh, bus->rxcap_buf, DHD_RXCAP_MAX * MAX_RX_DATASZ);
+		bus->rxcap_buf = NULL;
+		bus->rxcap_count = bus->rxcap_want = 0;
+	}
+#endif /* SDTEST */
+
 	if (bus->vars && bus->varsz) {
 		MFREE(osh, bus->vars, bus->varsz);
 		bus->vars = NULL;
@@ -5816,6 +6011,175 @@ dhdsdio_disconnect(void *ptr)
 }
 
 
+#ifdef SDTEST
+/* Rx bus stub: when dhd_rxstub names a pcap file, dhd_bus_register()
+ * attaches a bus with no SDIO device or chip behind it instead of the
+ * SDIO driver.  The interface comes up as usual; the Ethernet frames of
+ * the file, as many as the rx replay keeps, are held as if captured off
+ * the bus, and dhd_bus_rxstub_run() replays them through hdrpull,
+ * dhd_rx_frame() and the NAPI/GRO path.  Nothing is ever sent.
+ */
+static dhd_bus_t *dhd_rxstub_bus;
+
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_HDR_LEN		24	/* file header, linktype at 20 */
+#define PCAP_REC_HDR_LEN	16	/* record header, lengths at 8 and 12 */
+#define PCAP_LINKTYPE_ETHERNET	1
+
+static uint32
+dhdsdio_pcap32(uint8 *p, bool swap)
+{
+	uint32 val;
+
+	bcopy(p, &val, sizeof(val));
+	return swap ? BCMSWAP32(val) : val;
+}
+
+/* Read the frames of a pcap file into the rx capture buffer, each behind
+ * a BDC header as the dongle would put it (with the checksum offload
+ * verdict, so GRO takes TCP), and addressed to us if unicast.
+ */
+static int
+dhdsdio_rxstub_load(dhd_bus_t *bus, char *path)
+{
+	uint8 hdr[PCAP_HDR_LEN];
+	struct bdc_header *h;
+	void *image;
+	uint8 *frame;
+	uint32 len, n;
+	bool swap;
+	int err = BCME_BADARG;
+
+	if (!(image = dhd_os_open_image(path))) {
+		DHD_ERROR(("%s: can't open %s\n", __FUNCTION__, path));
+		return BCME_NOTFOUND;
+	}
+
+	if (dhd_os_get_image_block((char *)hdr, PCAP_HDR_LEN, image) != PCAP_HDR_LEN)
+		goto done;
+	if (dhdsdio_pcap32(hdr, FALSE) == PCAP_MAGIC)
+		swap = FALSE;
+	else if (dhdsdio_pcap32(hdr, TRUE) == PCAP_MAGIC)
+		swap = TRUE;
+	else
+		goto done;
+	if (dhdsdio_pcap32(hdr + 20, swap) != PCAP_LINKTYPE_ETHERNET)
+		goto done;
+
+	bus->rxcap_buf = MALLOC(bus->dhd->osh, DHD_RXCAP_MAX * MAX_RX_DATASZ);
+	if (!bus->rxcap_buf) {
+		err = BCME_NOMEM;
+		goto done;
+	}
+
+	while (bus->rxcap_count < DHD_RXCAP_MAX) {
+		frame = bus->rxcap_buf + bus->rxcap_count * MAX_RX_DATASZ;
+		if (dhd_os_get_image_block((char *)hdr, PCAP_REC_HDR_LEN, image) !=
+		    PCAP_REC_HDR_LEN)
+			break;
+		len = dhdsdio_pcap32(hdr + 8, swap);
+
+		/* Truncated or too long for a receive buffer: skip it */
+		if (len != dhdsdio_pcap32(hdr + 12, swap) || len < ETHER_HDR_LEN ||
+		    len > MAX_RX_DATASZ - BDC_HEADER_LEN) {
+			for (; len; len -= n) {
+				n = MIN(len, MAX_RX_DATASZ);
+				if (dhd_os_get_image_block((char *)frame, n, image) != n)
+					goto loaded;
+			}
+			continue;
+		}
+
+		if (dhd_os_get_image_block((char *)frame + BDC_HEADER_LEN, len, image) != len)
+			break;
+		h = (struct bdc_header *)frame;
+		h->flags = (BDC_PROTO_VER << BDC_FLAG_VER_SHIFT) | BDC_FLAG_SUM_GOOD;
+		h->priority = 0;
+		h->flags2 = 0;
+		BDC_SET_IF_IDX(h, 0);
+		h->dataOffset = 0;
+		if (!ETHER_ISMULTI(frame + BDC_HEADER_LEN))
+			bcopy(&bus->dhd->mac, frame + BDC_HEADER_LEN, ETHER_ADDR_LEN);
+		bus->rxcap_len[bus->rxcap_count++] = (uint16)(BDC_HEADER_LEN + len);
+	}
+loaded:
+	err = bus->rxcap_count ? 0 : BCME_BADARG;
+done:
+	dhd_os_close_image(image);
+	if (err)
+		DHD_ERROR(("%s: no Ethernet frames in %s\n", __FUNCTION__, path));
+	return err;
+}
+
+static void
+dhdsdio_rxstub_release(dhd_bus_t *bus)
+{
+	osl_t *osh = bus->dhd->osh;
+
+	dhd_common_deinit(bus->dhd, NULL);
+	dhd_detach(bus->dhd);
+	dhd_free(bus->dhd);
+	bus->dhd = NULL;
+	dhdsdio_release_malloc(bus, osh);
+	MFREE(osh, bus, sizeof(dhd_bus_t));
+	dhd_osl_detach(osh);
+}
+
+static int
+dhdsdio_rxstub_attach(void)
+{
+	/* Locally administered, so it can't clash with a real adapter */
+	uint8 mac[ETHER_ADDR_LEN] = { 0x02, 0x90, 0x4c, 0x00, 0x00, 0x01 };
+	dhd_bus_t *bus;
+	dhd_cmn_t *cmn;
+	osl_t *osh;
+
+	if (!(osh = dhd_osl_attach(NULL, DHD_BUS)))
+		return -ENOMEM;
+	if (!(bus = MALLOC(osh, sizeof(dhd_bus_t)))) {
+		dhd_osl_detach(osh);
+		return -ENOMEM;
+	}
+	bzero(bus, sizeof(dhd_bus_t));
+	bus->bus = DHD_BUS;
+
+	if (!(cmn = dhd_common_init(osh))) {
+		MFREE(osh, bus, sizeof(dhd_bus_t));
+		dhd_osl_detach(osh);
+		return -ENOMEM;
+	}
+	if (!(bus->dhd = dhd_attach(osh, bus, SDPCM_RESERVE))) {
+		dhd_common_deinit(NULL, cmn);
+		MFREE(osh, bus, sizeof(dhd_bus_t));
+		dhd_osl_detach(osh);
+		return -ENOMEM;
+	}
+	bus->dhd->cmn = cmn;
+	cmn->dhd = bus->dhd;
+	bcopy(mac, &bus->dhd->mac, ETHER_ADDR_LEN);
+
+	/* The bus stays down: transmits and dongle ioctls fail, as unplugged */
+	if (dhdsdio_rxstub_load(bus, dhd_rxstub) != 0 ||
+	    dhd_net_attach(bus->dhd, 0) != 0) {
+		dhdsdio_rxstub_release(bus);
+		return -EINVAL;
+	}
+
+	DHD_ERROR(("%s: rx bus stub with %d frames from %s\n", __FUNCTION__,
+	           bus->rxcap_count, dhd_rxstub));
+	dhd_rxstub_bus = bus;
+	return 0;
+}
+
+int
+dhd_bus_rxstub_run(uint rounds)
+{
+	if (!dhd_rxstub_bus)
+		return BCME_NOTREADY;
+	return dhdsdio_rxreplay(dhd_rxstub_bus, rounds);
+}
+#endif /* SDTEST */
+
 /* Register/Unregister functions are called by the main DHD entry
  * point (e.g. module insertion) to link with the bus driver, in
  * order to look for or await the device.
@@ -5831,6 +6195,10 @@ dhd_bus_register(void)
 {
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef SDTEST
+	if (dhd_rxstub[0])
+		return dhdsdio_rxstub_attach();
+#endif /* SDTEST */
 	return bcmsdh_register(&dhd_sdio);
 }
 
@@ -5839,6 +6207,13 @@ dhd_bus_unregister(void)
 {
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef SDTEST
+	if (dhd_rxstub_bus) {
+		dhdsdio_rxstub_release(dhd_rxstub_bus);
+		dhd_rxstub_bus = NULL;
+		return;
+	}
+#endif /* SDTEST */
 	bcmsdh_unregister();
 }
 
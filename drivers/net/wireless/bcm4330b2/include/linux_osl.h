@@ -345,6 +345,26 @@ extern void osl_ctfpool_cleanup(osl_t *osh);
 extern void osl_ctfpool_stats(osl_t *osh, void *b);
 #endif 
 
+#ifdef DHD_PKTPOOL
+/* Receive packets taken from a preallocated pool; refilled in batches and
+ * from packets the driver frees itself.
+ */
+#define	PKTPOOL_INIT(osh, numobj, size)	osl_pktpool_init((osh), (numobj), (size))
+#define	PKTPOOL_DEINIT(osh)		osl_pktpool_deinit(osh)
+#define	PKTPOOL_REFILL(osh)		osl_pktpool_refill(osh)
+#define	PKTPOOL_STATS(osh, b)		osl_pktpool_stats((osh), (b))
+
+extern int osl_pktpool_init(osl_t *osh, uint numobj, uint size);
+extern void osl_pktpool_deinit(osl_t *osh);
+extern void osl_pktpool_refill(osl_t *osh);
+extern void osl_pktpool_stats(osl_t *osh, void *b);
+#else
+#define	PKTPOOL_INIT(osh, numobj, size)	0
+#define	PKTPOOL_DEINIT(osh)		do {} while (0)
+#define	PKTPOOL_REFILL(osh)		do {} while (0)
+#define	PKTPOOL_STATS(osh, b)		do {} while (0)
+#endif
+
 #ifdef HNDCTF
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 22)
 #define	SKIPCT	(1 << 6)
@@ -88,6 +88,14 @@ struct osl_info {
 	uint failed;
 	uint bustype;
 	bcm_mem_link_t *dbgmem_list;
+#ifdef DHD_PKTPOOL
+	struct sk_buff_head pktpool;
+	uint pktpool_max;
+	uint pktpool_objsz;
+	uint pktpool_hits;
+	uint pktpool_misses;
+	uint pktpool_recycled;
+#endif
 };
 
 
@@ -187,6 +195,9 @@ osl_attach(void *pdev, uint bustype, bool pkttag)
 	osh->pdev = pdev;
 	osh->pub.pkttag = pkttag;
 	osh->bustype = bustype;
+#ifdef DHD_PKTPOOL
+	skb_queue_head_init(&osh->pktpool);
+#endif
 
 	switch (bustype) {
 		case PCI_BUS:
@@ -254,6 +265,9 @@ osl_detach(osl_t *osh)
 		return;
 
 	ASSERT(osh->magic == OS_HANDLE_MAGIC);
+#ifdef DHD_PKTPOOL
+	osl_pktpool_deinit(osh);
+#endif
 	kfree(osh);
 }
 
@@ -440,6 +454,88 @@ osl_pktfastget(osl_t *osh, uint len)
 #endif 
 
 
+#ifdef DHD_PKTPOOL
+
+int
+osl_pktpool_init(osl_t *osh, uint numobj, uint size)
+{
+	osh->pktpool_max = numobj;
+	osh->pktpool_objsz = size;
+	osl_pktpool_refill(osh);
+
+	return (skb_queue_len(&osh->pktpool) == numobj) ? 0 : -1;
+}
+
+void
+osl_pktpool_deinit(osl_t *osh)
+{
+	osh->pktpool_max = 0;
+	skb_queue_purge(&osh->pktpool);
+}
+
+
+void
+osl_pktpool_refill(osl_t *osh)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&osh->pktpool) < osh->pktpool_max) {
+		if (!(skb = dev_alloc_skb(osh->pktpool_objsz)))
+			break;
+		skb_queue_tail(&osh->pktpool, skb);
+	}
+}
+
+void
+osl_pktpool_stats(osl_t *osh, void *b)
+{
+	struct bcmstrbuf *bb = b;
+
+	bcm_bprintf(bb, "pktpool: max %d objsz %d avail %d hits %d misses %d recycled %d\n",
+	            osh->pktpool_max, osh->pktpool_objsz, skb_queue_len(&osh->pktpool),
+	            osh->pktpool_hits, osh->pktpool_misses, osh->pktpool_recycled);
+}
+
+static inline struct sk_buff *
+osl_pktpool_get(osl_t *osh, uint len)
+{
+	struct sk_buff *skb;
+
+	if (len > osh->pktpool_objsz)
+		return NULL;
+
+	if ((skb = skb_dequeue(&osh->pktpool)) != NULL)
+		osh->pktpool_hits++;
+	else
+		osh->pktpool_misses++;
+
+	return skb;
+}
+
+
+static inline bool
+osl_pktpool_put(osl_t *osh, struct sk_buff *skb)
+{
+	uint size = SKB_DATA_ALIGN(osh->pktpool_objsz + NET_SKB_PAD);
+
+	if (skb_queue_len(&osh->pktpool) >= osh->pktpool_max)
+		return FALSE;
+
+
+	if (skb_end_pointer(skb) - skb->head > 2 * size)
+		return FALSE;
+
+
+	if (!skb_recycle_check(skb, osh->pktpool_objsz))
+		return FALSE;
+
+	skb_queue_tail(&osh->pktpool, skb);
+	osh->pktpool_recycled++;
+	return TRUE;
+}
+#endif
+
+
 void * BCMFASTPATH
 osl_pktget(osl_t *osh, uint len)
 {
@@ -449,6 +545,9 @@ osl_pktget(osl_t *osh, uint len)
 	
 	skb = osl_pktfastget(osh, len);
 	if ((skb != NULL) || ((skb = dev_alloc_skb(len)) != NULL)) {
+#elif defined(DHD_PKTPOOL)
+	skb = osl_pktpool_get(osh, len);
+	if ((skb != NULL) || ((skb = dev_alloc_skb(len)) != NULL)) {
 #else 
 	if ((skb = dev_alloc_skb(len))) {
 #endif 
@@ -518,6 +617,8 @@ osl_pktfree(osl_t *osh, void *p, bool send)
 		if (PKTISFAST(osh, skb))
 			osl_pktfastfree(osh, skb);
 		else {
+#elif defined(DHD_PKTPOOL)
+		if (!osl_pktpool_put(osh, skb)) {
 #else 
 		{
 #endif 
@@ -409,7 +409,8 @@ static int config_buf(struct usb_configuration *config,
 	int				status;
 	int				interfaceCount = 0;
 	u8 *dest;
-#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM))
+#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM) || \
+	defined(CONFIG_USB_ANDROID_NCM))
 	int	is_cdc = 0;
 #endif
 
@@ -456,11 +457,13 @@ static int config_buf(struct usb_configuration *config,
 		while ((descriptor = *descriptors++) != NULL) {
 			intf = (struct usb_interface_descriptor *)dest;
 			if (intf->bDescriptorType == USB_DT_INTERFACE) {
-#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM))
-				/* CDC ACM/ECM */
+#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM) || \
+	defined(CONFIG_USB_ANDROID_NCM))
+				/* CDC ACM/ECM/NCM */
 				if (intf->bInterfaceClass == USB_CLASS_COMM &&
 					(intf->bInterfaceSubClass == USB_CDC_SUBCLASS_ETHERNET ||
-					 intf->bInterfaceSubClass == USB_CDC_SUBCLASS_ACM))
+					 intf->bInterfaceSubClass == USB_CDC_SUBCLASS_ACM ||
+					 intf->bInterfaceSubClass == USB_CDC_SUBCLASS_NCM))
 					 is_cdc = 1;
 				else
 					is_cdc = 0;
@@ -477,7 +480,8 @@ static int config_buf(struct usb_configuration *config,
 				}
 
 			}
-#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM))
+#if (defined(CONFIG_USB_ANDROID_ECM) || defined(CONFIG_USB_ANDROID_ACM) || \
+	defined(CONFIG_USB_ANDROID_NCM))
 			/* set interface number dynamically for CDC interface descriptor */
 			else if (is_cdc && intf->bDescriptorType == USB_DT_CS_INTERFACE) {
 				__u8  subtype = *(dest+2);
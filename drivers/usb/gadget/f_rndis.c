@@ -98,6 +98,14 @@ struct f_rndis {
 	atomic_t			notify_count;
 };
 
+/* Ethernet frames we may pack into one IN transfer, when the host's
+ * RNDIS_MSG_INIT says it takes more than one; 1 sends them one by one.
+ */
+static unsigned int rndis_dl_max_pkt_per_xfer = 10;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		"maximum packets per transfer to the host");
+
 static char		manufacturer [10] = "HTC";
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 {
@@ -317,6 +325,49 @@ static struct sk_buff *rndis_add_header(struct gether *port,
 	return skb2;
 }
 
+/* multi-frame IN transfers: RNDIS_PACKET_MSGs back to back */
+static int rndis_add_frame(struct gether *port, struct usb_request *req,
+			   struct sk_buff *skb, unsigned max)
+{
+	struct rndis_packet_msg_type	*header;
+	unsigned			len;
+
+	/* pad so the next header is aligned; MessageLength covers it */
+	len = ALIGN(sizeof *header + skb->len, 4);
+	if (req->length + len > max)
+		return -ENOSPC;
+
+	header = req->buf + req->length;
+	memset(header, 0, sizeof *header);
+	header->MessageType = cpu_to_le32(REMOTE_NDIS_PACKET_MSG);
+	header->MessageLength = cpu_to_le32(len);
+	header->DataOffset = cpu_to_le32(36);
+	header->DataLength = cpu_to_le32(skb->len);
+	skb_copy_bits(skb, 0, header + 1, skb->len);
+	memset((void *) (header + 1) + skb->len, 0,
+			len - sizeof *header - skb->len);
+
+	req->length += len;
+	return 0;
+}
+
+/* RNDIS_MSG_INIT carries the most the host takes in one transfer */
+static void rndis_set_dl_limits(struct f_rndis *rndis)
+{
+	u32	host_max = rndis_get_host_max_xfer_size(rndis->config);
+
+	/* REVISIT like cdc_filter, this assumes u_ether reading these
+	 * on another CPU sees each write whole
+	 */
+	if (!host_max) {
+		rndis->port.dl_max_pkts_per_xfer = 1;
+		return;
+	}
+	rndis->port.dl_max_xfer_size = max_t(u32, host_max,
+			RNDIS_MAX_MSG_SIZE(ETH_FRAME_LEN));
+	rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+}
+
 static void rndis_response_available(void *_rndis)
 {
 	struct f_rndis			*rndis = _rndis;
@@ -393,6 +444,7 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	if (status < 0)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
+	rndis_set_dl_limits(rndis);
 }
 
 static int
@@ -526,10 +578,21 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		 */
 		rndis->port.cdc_filter = 0;
 
+		/* IN buffers for the most frames we'll send at once */
+		if (rndis_dl_max_pkt_per_xfer > 1)
+			rndis->port.dl_max_xfer_size =
+				rndis_dl_max_pkt_per_xfer
+				* RNDIS_MAX_MSG_SIZE(ETH_FRAME_LEN);
+		else
+			rndis->port.dl_max_xfer_size = 0;
+		rndis->port.dl_max_pkts_per_xfer = 1;
+		rndis->port.ul_max_xfer_size = rndis_get_ul_max_xfer_size();
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
 			return PTR_ERR(net);
+		rndis_set_dl_limits(rndis);
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
@@ -839,6 +902,7 @@ rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.add_frame = rndis_add_frame;
 
 	rndis->port.func.name = "ether";
 	rndis->port.func.strings = rndis_strings;
@@ -870,8 +934,9 @@ static u8 ethaddr[ETH_ALEN] = { 11, 22, 33, 44, 55, 66 };
 
 int rndis_function_bind_config(struct usb_configuration *c)
 {
+	/* NCM may have set up the link already; only one runs at a time */
 	int ret = gether_setup(c->cdev->gadget, ethaddr);
-	if (ret == 0)
+	if (ret == 0 || ret == -EBUSY)
 		ret = rndis_bind_config(c, ethaddr);
 	return ret;
 }
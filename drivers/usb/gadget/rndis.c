@@ -58,6 +58,12 @@ MODULE_PARM_DESC (rndis_debug, "enable debugging");
 #define rndis_debug		0
 #endif
 
+/* Ethernet frames the host may pack into one OUT transfer */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		"maximum packets per transfer from the host");
+
 #define RNDIS_MAX_CONFIGS	1
 
 
@@ -585,16 +591,18 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (
+			max(rndis_ul_max_pkt_per_xfer, 1U));
 	resp->MaxTransferSize = cpu_to_le32 (
-		  params->dev->mtu
-		+ sizeof (struct ethhdr)
-		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
+			max(rndis_ul_max_pkt_per_xfer, 1U)
+			* RNDIS_MAX_MSG_SIZE(params->dev->mtu));
 	resp->PacketAlignmentFactor = cpu_to_le32 (0);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
+	/* the most the host takes in one IN transfer */
+	params->host_max_xfer_size = get_unaligned_le32(&buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -781,6 +789,7 @@ void rndis_uninit (int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params [configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params [configNr].host_max_xfer_size = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -1027,30 +1036,72 @@ static rndis_resp_t *rndis_add_response (int configNr, u32 length)
 	return r;
 }
 
+u32 rndis_get_host_max_xfer_size (u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS)
+		return 0;
+	return rndis_per_dev_params [configNr].host_max_xfer_size;
+}
+
+/* what INIT_CMPLT may promise the host, whatever the MTU */
+u32 rndis_get_ul_max_xfer_size (void)
+{
+	return max(rndis_ul_max_pkt_per_xfer, 1U)
+		* RNDIS_MAX_MSG_SIZE(ETH_FRAME_LEN);
+}
+
+/*
+ * One transfer may carry several RNDIS_PACKET_MSGs back to back.  All
+ * but the last are split off as clones, sharing the transfer's buffer.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
+	struct sk_buff	*skb2;
 	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	__le32		*tmp;
+	u32		msg_len, data_offset, data_len;
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+	for (;;) {
+		tmp = (void *) skb->data;
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
-	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+		/* MessageType, MessageLength */
+		if (skb->len < 16 || cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+		if (msg_len > skb->len || data_offset > msg_len
+				|| data_len > msg_len - data_offset) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
 
-	skb_queue_tail(list, skb);
-	return 0;
+		/* the last message, or padding after it? */
+		if (skb->len - msg_len < sizeof(struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+
+		skb_pull(skb, msg_len);
+	}
 }
 
 #ifdef	CONFIG_USB_GADGET_DEBUG_FILES
@@ -1067,7 +1118,8 @@ static int rndis_proc_show(struct seq_file *m, void *v)
 			 "speed     : %d\n"
 			 "cable     : %s\n"
 			 "vendor ID : 0x%08X\n"
-			 "vendor    : %s\n",
+			 "vendor    : %s\n"
+			 "host xfer : %u\n",
 			 param->confignr, (param->used) ? "y" : "n",
 			 ({ char *s = "?";
 			 switch (param->state) {
@@ -1081,7 +1133,8 @@ static int rndis_proc_show(struct seq_file *m, void *v)
 			 param->medium,
 			 (param->media_state) ? 0 : param->speed*100,
 			 (param->media_state) ? "disconnected" : "connected",
-			 param->vendorID, param->vendorDescr);
+			 param->vendorID, param->vendorDescr,
+			 param->host_max_xfer_size);
 	return 0;
 }
 
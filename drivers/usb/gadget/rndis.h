@@ -195,6 +195,10 @@ struct rndis_packet_msg_type
 	__le32	Reserved;
 } __attribute__ ((packed));
 
+/* room for one RNDIS_PACKET_MSG, as INIT_CMPLT has always promised it */
+#define RNDIS_MAX_MSG_SIZE(mtu) ((mtu) + sizeof(struct ethhdr) \
+		+ sizeof(struct rndis_packet_msg_type) + 22)
+
 struct rndis_config_parameter
 {
 	__le32	ParameterNameOffset;
@@ -236,6 +240,7 @@ typedef struct rndis_params
 
 	u32			vendorID;
 	const char		*vendorDescr;
+	u32			host_max_xfer_size;	/* from INIT */
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
@@ -253,6 +258,8 @@ int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
+u32  rndis_get_host_max_xfer_size (u8 configNr);
+u32  rndis_get_ul_max_xfer_size (void);
 u8   *rndis_get_next_response (int configNr, u32 *length);
 void rndis_free_response (int configNr, u8 *buf);
 
@@ -24,6 +24,7 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
@@ -80,6 +81,18 @@ struct eth_dev {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* multi-frame IN transfers: tx_buf_size is zero unless the
+	 * link has add_frame(); tx_agg_req is being filled, not queued
+	 */
+	unsigned		tx_buf_size;
+	unsigned		ul_max_xfer_size;
+	struct usb_request	*tx_agg_req;
+	unsigned		tx_agg_pkts;
+
+	/* transfers completed, for "ethtool -S" */
+	unsigned long		tx_xfers;
+	unsigned long		rx_xfers;
+
 	struct work_struct	work;
 
 	unsigned long		todo;
@@ -95,6 +108,9 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+/* IN transfers in flight before new frames wait to share the next one */
+#define TX_AGG_QLEN	2
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -188,6 +204,37 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
 	strlcpy(p->bus_info, dev_name(&dev->gadget->dev), sizeof p->bus_info);
 }
 
+/* frames per transfer is rx/tx_packets over these */
+static const char eth_stats_strings[][ETH_GSTRING_LEN] = {
+	"tx_xfers",
+	"rx_xfers",
+};
+
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(eth_stats_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_stats_strings, sizeof(eth_stats_strings));
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->tx_xfers;
+	data[1] = dev->rx_xfers;
+}
+
 /* REVISIT can also support:
  *   - WOL (by tracking suspends and issuing remote wakeup)
  *   - msglevel (implies updated messaging)
@@ -197,6 +244,9 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
 static void defer_kevent(struct eth_dev *dev, int flag)
@@ -245,6 +295,9 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	/* room for several frames, if the host may send them */
+	if (dev->ul_max_xfer_size > size)
+		size = dev->ul_max_xfer_size;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -291,6 +344,7 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		dev->rx_xfers++;
 
 		if (dev->unwrap) {
 			unsigned long	flags;
@@ -437,6 +491,60 @@ done:
 	return status;
 }
 
+/* give IN requests their own buffers, if the link takes several frames */
+static void tx_agg_alloc(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req;
+	unsigned		size;
+
+	dev->tx_buf_size = 0;
+	dev->tx_agg_req = NULL;
+	if (!link->add_frame || !link->dl_max_xfer_size)
+		return;
+
+	/* without ZLPs, a spare byte (see tx_agg_queue()), taken from
+	 * the buffer rather than added, which would double its slab
+	 */
+	size = link->dl_max_xfer_size;
+
+	/*
+	 * This runs in irq context, and with fragmented memory there may
+	 * be no free blocks of several pages.  Then take smaller buffers,
+	 * down to one page: fewer frames per request beat one per request.
+	 */
+	spin_lock(&dev->req_lock);
+	for (;;) {
+		list_for_each_entry(req, &dev->tx_reqs, list) {
+			req->buf = kmalloc(size, size > PAGE_SIZE
+					? GFP_ATOMIC | __GFP_NOWARN
+					: GFP_ATOMIC);
+			if (!req->buf)
+				break;
+		}
+		if (&req->list == &dev->tx_reqs)
+			break;
+
+		list_for_each_entry(req, &dev->tx_reqs, list) {
+			kfree(req->buf);
+			req->buf = NULL;
+		}
+		if (size <= PAGE_SIZE)
+			goto fail;
+		size = max_t(unsigned, size / 2, PAGE_SIZE);
+	}
+	dev->tx_buf_size = size - !dev->zlp;
+	spin_unlock(&dev->req_lock);
+	if (size < link->dl_max_xfer_size)
+		DBG(dev, "multi-frame transfers of %u bytes\n",
+				dev->tx_buf_size);
+	return;
+
+fail:
+	/* not fatal, frames just go one per request */
+	spin_unlock(&dev->req_lock);
+	DBG(dev, "no memory for multi-frame transfers\n");
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -473,10 +581,14 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*next = NULL;
 
 	switch (req->status) {
 	default:
@@ -487,20 +599,161 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* multi-frame requests were counted as they were filled */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
+	dev->tx_xfers++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	atomic_dec(&dev->tx_qlen);
+
+	/* frames held back for company go out now */
+	if (dev->tx_agg_req && req->status == 0) {
+		next = dev->tx_agg_req;
+		dev->tx_agg_req = NULL;
+	}
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
 
-	atomic_dec(&dev->tx_qlen);
+	if (next)
+		tx_agg_queue(dev, ep, next);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+/*
+ * With a link that supports it, frames are copied into IN requests big
+ * enough for several of them.  While fewer than TX_AGG_QLEN transfers
+ * are in flight each frame is sent right away, as before; otherwise it
+ * waits in dev->tx_agg_req for more frames until the request is full,
+ * or until a completion shows the link has room.  The host then sees
+ * one transfer, and we take one completion, for many frames.
+ */
+
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	unsigned long	flags;
+	int		retval;
+
+	req->context = NULL;
+	req->complete = tx_complete;
+
+	/* without ZLPs, the buffer has a spare byte for this */
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+
+	/* held frames wait for completions, don't let the UDC hide them */
+	req->no_interrupt = 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval == 0) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_errors++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs))
+		netif_start_queue(dev->net);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static netdev_tx_t tx_agg_xmit(struct eth_dev *dev, struct sk_buff *skb)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req, *ready = NULL;
+	struct gether		*port;
+	struct usb_ep		*in = NULL;
+	unsigned		max_pkts = 0, max_len = 0;
+	unsigned long		flags;
+	int			status = -ENOSPC;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	port = dev->port_usb;
+	if (port) {
+		in = port->in_ep;
+		max_pkts = port->dl_max_pkts_per_xfer;
+		max_len = min(port->dl_max_xfer_size, dev->tx_buf_size);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (!port) {
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+
+	/* While we fill it, the request is ours alone: tx_complete()
+	 * can't send it behind the back of an older one we queue here.
+	 */
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	dev->tx_agg_req = NULL;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (req) {
+		status = port->add_frame(port, req, skb, max_len);
+		if (status == -ENOSPC) {
+			tx_agg_queue(dev, in, req);
+			req = NULL;
+		}
+	}
+
+	if (!req) {
+		spin_lock_irqsave(&dev->req_lock, flags);
+		/* see eth_start_xmit() on why this can be empty */
+		if (list_empty(&dev->tx_reqs)) {
+			netif_stop_queue(net);
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			return NETDEV_TX_BUSY;
+		}
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+
+		req->length = 0;
+		dev->tx_agg_pkts = 0;
+		status = port->add_frame(port, req, skb, max_len);
+	}
+
+	if (status == 0) {
+		dev->tx_agg_pkts++;
+		net->stats.tx_packets++;
+		net->stats.tx_bytes += skb->len;
+	} else {
+		net->stats.tx_dropped++;
+	}
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!dev->tx_agg_pkts)
+		list_add(&req->list, &dev->tx_reqs);
+	else if (dev->tx_agg_pkts >= max_pkts
+			|| atomic_read(&dev->tx_qlen) < TX_AGG_QLEN)
+		ready = req;
+	else
+		dev->tx_agg_req = req;
+
+	/* temporarily stop TX queue when the freelist empties */
+	if (list_empty(&dev->tx_reqs) && !dev->tx_agg_req)
+		netif_stop_queue(net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (ready)
+		tx_agg_queue(dev, in, ready);
+	return NETDEV_TX_OK;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -561,6 +814,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		return NETDEV_TX_OK;
 #endif
 
+	if (dev->tx_buf_size)
+		return tx_agg_xmit(dev, skb);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -792,6 +1048,9 @@ static struct device_type gadget_type = {
  * gadget driver using this framework.  The link layer addresses are
  * set up using module parameters.
  *
+ * Functions in different configurations may share the link: when it
+ * is already set up, @ethaddr is still filled in and -EBUSY returned.
+ *
  * Returns negative errno, or zero on success
  */
 int gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
@@ -800,8 +1059,11 @@ int gether_setup(struct usb_gadget *g, u8 ethaddr[ETH_ALEN])
 	struct net_device	*net;
 	int			status;
 
-	if (the_dev)
+	if (the_dev) {
+		if (ethaddr)
+			memcpy(ethaddr, the_dev->host_mac, ETH_ALEN);
 		return -EBUSY;
+	}
 
 	net = alloc_etherdev(sizeof *dev);
 	if (!net)
@@ -930,6 +1192,8 @@ struct net_device *gether_connect(struct gether *link)
 		dev->header_len = link->header_len;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
+		dev->ul_max_xfer_size = link->ul_max_xfer_size;
+		tx_agg_alloc(dev, link);
 
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
@@ -991,15 +1255,22 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_buf_size)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_buf_size = 0;
 	spin_unlock(&dev->req_lock);
 #ifndef CONFIG_USB_GADGET_DYNAMIC_ENDPOINT
 	link->in_ep->driver_data = NULL;
@@ -1027,6 +1298,7 @@ void gether_disconnect(struct gether *link)
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
+	dev->ul_max_xfer_size = 0;
 
 	spin_lock(&dev->lock);
 	dev->port_usb = NULL;
@@ -68,6 +68,24 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* Multi-frame transfers, for framings that allow them (RNDIS,
+	 * NCM).  With add_frame set, IN requests get buffers of
+	 * dl_max_xfer_size bytes (as set at gether_connect() time, or
+	 * down to a page if memory is short) and frames are copied
+	 * into them with add_frame(), which returns
+	 * -ENOSPC once the frame won't fit in max bytes.  A request
+	 * carries up to dl_max_pkts_per_xfer frames; both limits may be
+	 * lowered while connected, e.g. after negotiating with the host.
+	 * OUT requests are sized for ul_max_xfer_size bytes, if nonzero.
+	 */
+	unsigned			dl_max_pkts_per_xfer;
+	unsigned			dl_max_xfer_size;
+	unsigned			ul_max_xfer_size;
+	int				(*add_frame)(struct gether *port,
+						struct usb_request *req,
+						struct sk_buff *skb,
+						unsigned max);
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -104,6 +122,7 @@ static inline bool can_support_ecm(struct usb_gadget *gadget)
 int geth_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 int ecm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 int eem_bind_config(struct usb_configuration *c);
+int ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN]);
 
 #if defined(USB_ETH_RNDIS) || defined(CONFIG_USB_ANDROID_RNDIS)
 
@@ -644,6 +644,20 @@ struct move_extent {
 	<= (EXT4_GOOD_OLD_INODE_SIZE +			\
 	    (einode)->i_extra_isize))			\
 
+/*
+ * Fast commit record: a raw on-disk inode of fc_len bytes follows.
+ */
+struct ext4_fc_inode {
+	__le16	fc_tag;		/* EXT4_FC_TAG_* */
+	__le16	fc_len;		/* Size of the inode that follows */
+	__le32	fc_ino;		/* Inode number */
+};
+
+#define EXT4_FC_TAG_INODE	1
+
+/* Journal blocks set aside for fast commits with -o fast_commit */
+#define EXT4_FC_BLOCKS		256
+
 static inline __le32 ext4_encode_extra_time(struct timespec *time)
 {
        return cpu_to_le32((sizeof(time->tv_sec) > 4 ?
@@ -838,6 +852,12 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/*
+	 * Last transaction that changed something about this inode a fast
+	 * commit cannot describe: block mappings, links, ownership, xattrs.
+	 */
+	tid_t i_fc_ineligible_tid;
 };
 
 /*
@@ -883,10 +903,12 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_FAST_COMMIT		0x4000000 /* Log fsync'd inodes only */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
+#define EXT4_MOUNT_META_PREFETCH	0x80000000 /* Record boot metadata reads */
 
 #define clear_opt(o, opt)		o &= ~EXT4_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT4_MOUNT_##opt
@@ -1143,6 +1165,9 @@ struct ext4_sb_info {
 	unsigned int s_log_groups_per_flex;
 	struct flex_groups *s_flex_groups;
 
+	/* boot-time metadata prefetch, see prefetch.c */
+	struct ext4_prefetch *s_prefetch;
+
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
 
@@ -1525,6 +1550,7 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
+extern int ext4_fc_replay(journal_t *, void *, unsigned int);
 
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
@@ -1620,6 +1646,12 @@ extern int ext4_group_extend(struct super_block *sb,
 				struct ext4_super_block *es,
 				ext4_fsblk_t n_blocks_count);
 
+/* prefetch.c */
+extern void ext4_prefetch_record(struct super_block *, ext4_fsblk_t);
+extern void ext4_prefetch_record_cold(struct super_block *, ext4_fsblk_t);
+extern int ext4_prefetch_init(struct super_block *);
+extern void ext4_prefetch_release(struct super_block *);
+
 /* super.c */
 extern void __ext4_error(struct super_block *, const char *, const char *, ...)
 	__attribute__ ((format (printf, 3, 4)));
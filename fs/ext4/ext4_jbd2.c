@@ -120,6 +120,8 @@ int __ext4_handle_dirty_metadata(const char *where, handle_t *handle,
 	int err = 0;
 
 	if (ext4_handle_valid(handle)) {
+		if (inode)
+			ext4_fc_mark_ineligible(handle, inode);
 		err = jbd2_journal_dirty_metadata(handle, bh);
 		if (err)
 			ext4_journal_abort_handle(where, __func__, bh,
@@ -257,11 +257,25 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 
 	if (ext4_handle_valid(handle)) {
 		ei->i_sync_tid = handle->h_transaction->t_tid;
-		if (datasync)
+		if (datasync) {
 			ei->i_datasync_tid = handle->h_transaction->t_tid;
+			ei->i_fc_ineligible_tid = handle->h_transaction->t_tid;
+		}
 	}
 }
 
+/*
+ * The running transaction changes @inode in a way a fast commit of the
+ * raw inode cannot capture; fsync has to commit the transaction.
+ */
+static inline void ext4_fc_mark_ineligible(handle_t *handle,
+					   struct inode *inode)
+{
+	if (ext4_handle_valid(handle))
+		EXT4_I(inode)->i_fc_ineligible_tid =
+			handle->h_transaction->t_tid;
+}
+
 /* super.c */
 int ext4_force_commit(struct super_block *sb);
 
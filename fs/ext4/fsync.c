@@ -28,6 +28,7 @@
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/slab.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -57,6 +58,111 @@ static void ext4_sync_parent(struct inode *inode)
 	}
 }
 
+/*
+ * A fast commit is possible when everything the running transaction did
+ * to the inode is contained in the raw inode itself: no blocks were
+ * allocated or freed, no links or xattrs changed.  The data was written
+ * in place by the caller and the barrier on the fast commit block makes
+ * it stable, so logging the inode alone is enough.
+ */
+static int ext4_fc_eligible(struct inode *inode, tid_t commit_tid)
+{
+	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
+	int ret;
+
+	if (!test_opt(inode->i_sb, FAST_COMMIT) || !S_ISREG(inode->i_mode) ||
+	    EXT4_I(inode)->i_fc_ineligible_tid == commit_tid)
+		return 0;
+
+	read_lock(&journal->j_state_lock);
+	ret = journal->j_running_transaction &&
+	      journal->j_running_transaction->t_tid == commit_tid;
+	read_unlock(&journal->j_state_lock);
+	return ret;
+}
+
+static int ext4_fc_commit(struct inode *inode, tid_t commit_tid)
+{
+	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
+	int isize = EXT4_INODE_SIZE(inode->i_sb);
+	struct ext4_fc_inode *rec;
+	struct ext4_iloc iloc;
+	int ret;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+	rec = kmalloc(sizeof(*rec) + isize, GFP_NOFS);
+	if (!rec) {
+		brelse(iloc.bh);
+		return -ENOMEM;
+	}
+	rec->fc_tag = cpu_to_le16(EXT4_FC_TAG_INODE);
+	rec->fc_len = cpu_to_le16(isize);
+	rec->fc_ino = cpu_to_le32(inode->i_ino);
+
+	/*
+	 * Writeback may allocate blocks behind our back; it marks the inode
+	 * under i_data_sem before it touches the block map.
+	 */
+	down_read(&EXT4_I(inode)->i_data_sem);
+	memcpy(rec + 1, ext4_raw_inode(&iloc), isize);
+	if (EXT4_I(inode)->i_fc_ineligible_tid == commit_tid)
+		ret = -EAGAIN;
+	up_read(&EXT4_I(inode)->i_data_sem);
+	brelse(iloc.bh);
+
+	if (!ret)
+		ret = jbd2_fc_commit(journal, commit_tid, rec,
+				     sizeof(*rec) + isize);
+	kfree(rec);
+	return ret;
+}
+
+/*
+ * Called by jbd2 recovery for each fast commit record of the transaction
+ * that did not make it to the log: write the logged inode back into the
+ * inode table.
+ */
+int ext4_fc_replay(journal_t *journal, void *data, unsigned int len)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_inode *rec = data;
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long ino, offset;
+	ext4_fsblk_t block;
+	ext4_group_t group;
+	int isize = EXT4_INODE_SIZE(sb);
+
+	ino = le32_to_cpu(rec->fc_ino);
+	if (len != sizeof(*rec) + isize ||
+	    le16_to_cpu(rec->fc_tag) != EXT4_FC_TAG_INODE ||
+	    le16_to_cpu(rec->fc_len) != isize || !ext4_valid_inum(sb, ino)) {
+		ext4_msg(sb, KERN_ERR, "bad fast commit record for inode %lu",
+			 ino);
+		return -EIO;
+	}
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * isize;
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EIO;
+	block = ext4_inode_table(sb, gdp) + (offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	offset &= EXT4_BLOCK_SIZE(sb) - 1;
+
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	lock_buffer(bh);
+	memcpy(bh->b_data + offset, rec + 1, isize);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
 /*
  * akpm: A new design for ext4_sync_file().
  *
@@ -115,6 +221,10 @@ int ext4_sync_file(struct file *file, int datasync)
 		return ext4_force_commit(inode->i_sb);
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
+	if (ext4_fc_eligible(inode, commit_tid) &&
+	    !ext4_fc_commit(inode, commit_tid))
+		return 0;
+
 	if (jbd2_log_start_commit(journal, commit_tid)) {
 		/*
 		 * When the journal is on a different device than the
@@ -126,12 +236,16 @@ int ext4_sync_file(struct file *file, int datasync)
 		 */
 		if (ext4_should_writeback_data(inode) &&
 		    (journal->j_fs_dev != journal->j_dev) &&
-		    (journal->j_flags & JBD2_BARRIER))
+		    (journal->j_flags & JBD2_BARRIER)) {
 			blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
 					NULL, BLKDEV_IFL_WAIT);
+			jbd2_journal_count_flush(journal);
+		}
 		ret = jbd2_log_wait_commit(journal, commit_tid);
-	} else if (journal->j_flags & JBD2_BARRIER)
+	} else if (journal->j_flags & JBD2_BARRIER) {
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
+		jbd2_journal_count_flush(journal);
+	}
 	return ret;
 }
@@ -1451,6 +1451,8 @@ struct buffer_head *ext4_bread(handle_t *handle, struct inode *inode,
 		return bh;
 	if (buffer_uptodate(bh))
 		return bh;
+	if (S_ISDIR(inode->i_mode))
+		ext4_prefetch_record(inode->i_sb, bh->b_blocknr);
 	ll_rw_block(READ_META, 1, &bh);
 	wait_on_buffer(bh);
 	if (buffer_uptodate(bh))
@@ -4871,6 +4873,7 @@ static int __ext4_get_inode_loc(struct inode *inode,
 		}
 
 make_io:
+		ext4_prefetch_record(sb, block);
 		/*
 		 * If we need to do any I/O, try to pre-readahead extra
 		 * blocks from the inode table.
@@ -5086,6 +5089,7 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		ei->i_fc_ineligible_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
@@ -5471,6 +5475,7 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 			ext4_journal_stop(handle);
 			return error;
 		}
+		ext4_fc_mark_ineligible(handle, inode);
 		/* Update corresponding info in inode so that everything is in
 		 * one transaction */
 		if (attr->ia_valid & ATTR_UID)
@@ -4269,6 +4269,7 @@ ext4_fsblk_t ext4_mb_new_blocks(handle_t *handle,
 	sbi = EXT4_SB(sb);
 
 	trace_ext4_request_blocks(ar);
+	ext4_fc_mark_ineligible(handle, ar->inode);
 
 	/*
 	 * For delayed allocation, we could skip the ENOSPC and
@@ -4523,6 +4524,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 
 	ext4_debug("freeing block %llu\n", block);
 	trace_ext4_free_blocks(inode, block, count, flags);
+	ext4_fc_mark_ineligible(handle, inode);
 
 	if (flags & EXT4_FREE_BLOCKS_FORGET) {
 		struct buffer_head *tbh = bh;
@@ -0,0 +1,307 @@
+/*
+ *  linux/fs/ext4/prefetch.c
+ *
+ * Record the metadata blocks read from disk while the system boots and
+ * read them back in one sorted, asynchronous pass on the next boot.
+ *
+ * With the meta_prefetch mount option, every inode table block and
+ * directory block that has to be read from disk is noted until the list
+ * is collected through /proc/fs/ext4/<dev>/prefetch, normally once boot
+ * has completed.  The list is saved by userspace and written back to the
+ * same file right after the next mount: the blocks are then sorted and
+ * read from a work item, with short gaps between them filled in so that
+ * the block layer can merge them into a few large requests instead of
+ * the many small synchronous reads the first walks of /data would issue.
+ */
+
+#include <linux/fs.h>
+#include <linux/buffer_head.h>
+#include <linux/pagemap.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/ctype.h>
+#include "ext4.h"
+
+/* Upper bound on the blocks recorded, and accepted for prefetch */
+#define EXT4_PREFETCH_MAX_BLOCKS	8192
+
+/*
+ * Holes of up to this many blocks between two listed blocks are read as
+ * well: on flash, a few extra blocks cost less than another request.
+ */
+#define EXT4_PREFETCH_MAX_GAP		8
+
+struct ext4_prefetch {
+	struct super_block	*sb;
+
+	/* Blocks read from disk since mount */
+	spinlock_t		lock;
+	int			recording;
+	unsigned int		nr;
+	ext4_fsblk_t		*blocks;
+
+	/* Blocks written to the proc file, to be read by the work item */
+	struct mutex		replay_mutex;
+	unsigned int		nr_replay;
+	ext4_fsblk_t		*replay;
+	ext4_fsblk_t		cur;		/* number split across writes */
+	int			in_num;
+	struct work_struct	work;
+};
+
+void ext4_prefetch_record(struct super_block *sb, ext4_fsblk_t block)
+{
+	struct ext4_prefetch *pf = EXT4_SB(sb)->s_prefetch;
+
+	if (!pf || !pf->recording)
+		return;
+	spin_lock(&pf->lock);
+	if (pf->recording && pf->nr < EXT4_PREFETCH_MAX_BLOCKS)
+		pf->blocks[pf->nr++] = block;
+	spin_unlock(&pf->lock);
+}
+
+/*
+ * Directory blocks reached through readdir are read with page cache
+ * readahead on the block device, so there is no buffer to test: record
+ * the block unless its page is already cached.
+ */
+void ext4_prefetch_record_cold(struct super_block *sb, ext4_fsblk_t block)
+{
+	struct ext4_prefetch *pf = EXT4_SB(sb)->s_prefetch;
+	struct page *page;
+
+	if (!pf || !pf->recording)
+		return;
+	page = find_get_page(sb->s_bdev->bd_inode->i_mapping,
+			     block >> (PAGE_CACHE_SHIFT - sb->s_blocksize_bits));
+	if (page) {
+		int cached = PageUptodate(page);
+
+		page_cache_release(page);
+		if (cached)
+			return;
+	}
+	ext4_prefetch_record(sb, block);
+}
+
+static int ext4_prefetch_cmp(const void *a, const void *b)
+{
+	ext4_fsblk_t x = *(const ext4_fsblk_t *)a;
+	ext4_fsblk_t y = *(const ext4_fsblk_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Sort the list and drop duplicates, returning the new length */
+static unsigned int ext4_prefetch_sort(ext4_fsblk_t *blocks, unsigned int nr)
+{
+	unsigned int i, n = 0;
+
+	sort(blocks, nr, sizeof(*blocks), ext4_prefetch_cmp, NULL);
+	for (i = 0; i < nr; i++)
+		if (!n || blocks[i] != blocks[n - 1])
+			blocks[n++] = blocks[i];
+	return n;
+}
+
+static void ext4_prefetch_read(struct ext4_prefetch *pf, ext4_fsblk_t block)
+{
+	struct buffer_head *bh = sb_getblk(pf->sb, block);
+
+	if (!bh)
+		return;
+	if (!buffer_uptodate(bh))
+		ll_rw_block(READ, 1, &bh);
+	brelse(bh);
+}
+
+static void ext4_prefetch_work(struct work_struct *work)
+{
+	struct ext4_prefetch *pf = container_of(work, struct ext4_prefetch,
+						work);
+	ext4_fsblk_t *blocks = pf->replay, next = 0;
+	unsigned int i, nr, runs = 0, issued = 0;
+
+	nr = ext4_prefetch_sort(blocks, pf->nr_replay);
+	for (i = 0; i < nr; i++) {
+		ext4_fsblk_t block = blocks[i];
+
+		if (runs && block - next <= EXT4_PREFETCH_MAX_GAP)
+			block = next;
+		else
+			runs++;
+		for (; block <= blocks[i]; block++, issued++)
+			ext4_prefetch_read(pf, block);
+		next = block;
+	}
+	ext4_msg(pf->sb, KERN_INFO, "prefetched %u metadata blocks "
+		 "(%u listed) in %u runs", issued, nr, runs);
+
+	mutex_lock(&pf->replay_mutex);
+	pf->replay = NULL;
+	pf->nr_replay = 0;
+	mutex_unlock(&pf->replay_mutex);
+	vfree(blocks);
+}
+
+static void ext4_prefetch_add(struct ext4_prefetch *pf, ext4_fsblk_t block)
+{
+	struct ext4_super_block *es = EXT4_SB(pf->sb)->s_es;
+
+	if (block < le32_to_cpu(es->s_first_data_block) ||
+	    block >= ext4_blocks_count(es) ||
+	    pf->nr_replay >= EXT4_PREFETCH_MAX_BLOCKS)
+		return;
+	pf->replay[pf->nr_replay++] = block;
+}
+
+static int ext4_prefetch_seq_show(struct seq_file *seq, void *v)
+{
+	struct ext4_prefetch *pf = seq->private;
+	unsigned int i;
+
+	for (i = 0; i < pf->nr; i++)
+		seq_printf(seq, "%llu\n", pf->blocks[i]);
+	return 0;
+}
+
+static int ext4_prefetch_open(struct inode *inode, struct file *file)
+{
+	struct ext4_prefetch *pf = PDE(inode)->data;
+	int err = 0;
+
+	if (file->f_mode & FMODE_WRITE) {
+		mutex_lock(&pf->replay_mutex);
+		if (pf->replay)
+			err = -EBUSY;
+		else
+			pf->replay = vmalloc(EXT4_PREFETCH_MAX_BLOCKS *
+					     sizeof(ext4_fsblk_t));
+		if (!err && !pf->replay)
+			err = -ENOMEM;
+		pf->nr_replay = 0;
+		pf->in_num = 0;
+		mutex_unlock(&pf->replay_mutex);
+		if (err)
+			return err;
+	}
+	if (file->f_mode & FMODE_READ) {
+		/* Collecting the list ends the recording for this mount */
+		spin_lock(&pf->lock);
+		pf->recording = 0;
+		spin_unlock(&pf->lock);
+		mutex_lock(&pf->replay_mutex);
+		pf->nr = ext4_prefetch_sort(pf->blocks, pf->nr);
+		mutex_unlock(&pf->replay_mutex);
+	}
+	return single_open(file, ext4_prefetch_seq_show, pf);
+}
+
+static ssize_t ext4_prefetch_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct ext4_prefetch *pf = seq->private;
+	char page[256];
+	size_t done = 0, i, len;
+
+	while (done < count) {
+		len = min(count - done, sizeof(page));
+		if (copy_from_user(page, buf + done, len))
+			return -EFAULT;
+		/* a block number may be split across two writes */
+		for (i = 0; i < len; i++) {
+			if (isdigit(page[i])) {
+				pf->cur = pf->cur * 10 + page[i] - '0';
+				pf->in_num = 1;
+			} else if (pf->in_num) {
+				ext4_prefetch_add(pf, pf->cur);
+				pf->cur = 0;
+				pf->in_num = 0;
+			}
+		}
+		done += len;
+	}
+	return count;
+}
+
+static int ext4_prefetch_proc_release(struct inode *inode, struct file *file)
+{
+	struct ext4_prefetch *pf = PDE(inode)->data;
+
+	if (file->f_mode & FMODE_WRITE) {
+		if (pf->in_num)
+			ext4_prefetch_add(pf, pf->cur);
+		pf->cur = 0;
+		pf->in_num = 0;
+		if (pf->nr_replay) {
+			schedule_work(&pf->work);
+		} else {
+			mutex_lock(&pf->replay_mutex);
+			vfree(pf->replay);
+			pf->replay = NULL;
+			mutex_unlock(&pf->replay_mutex);
+		}
+	}
+	return single_release(inode, file);
+}
+
+static const struct file_operations ext4_prefetch_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_prefetch_open,
+	.read		= seq_read,
+	.write		= ext4_prefetch_write,
+	.llseek		= seq_lseek,
+	.release	= ext4_prefetch_proc_release,
+};
+
+int ext4_prefetch_init(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_prefetch *pf;
+
+	if (!sbi->s_proc)
+		return -ENOENT;
+	pf = kzalloc(sizeof(*pf), GFP_KERNEL);
+	if (!pf)
+		return -ENOMEM;
+	pf->blocks = vmalloc(EXT4_PREFETCH_MAX_BLOCKS * sizeof(ext4_fsblk_t));
+	if (!pf->blocks) {
+		kfree(pf);
+		return -ENOMEM;
+	}
+	pf->sb = sb;
+	spin_lock_init(&pf->lock);
+	mutex_init(&pf->replay_mutex);
+	INIT_WORK(&pf->work, ext4_prefetch_work);
+	pf->recording = 1;
+
+	if (!proc_create_data("prefetch", S_IRUSR | S_IWUSR, sbi->s_proc,
+			      &ext4_prefetch_fops, pf)) {
+		vfree(pf->blocks);
+		kfree(pf);
+		return -ENOMEM;
+	}
+	sbi->s_prefetch = pf;
+	return 0;
+}
+
+void ext4_prefetch_release(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_prefetch *pf = sbi->s_prefetch;
+
+	if (!pf)
+		return;
+	remove_proc_entry("prefetch", sbi->s_proc);
+	flush_work(&pf->work);
+	sbi->s_prefetch = NULL;
+	vfree(pf->replay);
+	vfree(pf->blocks);
+	kfree(pf);
+}
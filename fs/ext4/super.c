@@ -678,6 +678,7 @@ static void ext4_put_super(struct super_block *sb)
 		es->s_state = cpu_to_le16(sbi->s_mount_state);
 		ext4_commit_super(sb, 1);
 	}
+	ext4_prefetch_release(sb);
 	if (sbi->s_proc) {
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
@@ -770,6 +771,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	ei->cur_aio_dio = NULL;
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_fc_ineligible_tid = 0;
 
 	return &ei->vfs_inode;
 }
@@ -984,6 +986,12 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt(sb, FAST_COMMIT))
+		seq_puts(seq, ",fast_commit");
+
+	if (test_opt(sb, META_PREFETCH))
+		seq_puts(seq, ",meta_prefetch");
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1164,7 +1172,8 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
-	Opt_discard, Opt_nodiscard,
+	Opt_discard, Opt_nodiscard, Opt_fast_commit, Opt_nofast_commit,
+	Opt_meta_prefetch, Opt_nometa_prefetch,
 };
 
 static const match_table_t tokens = {
@@ -1235,6 +1244,10 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_fast_commit, "fast_commit"},
+	{Opt_nofast_commit, "nofast_commit"},
+	{Opt_meta_prefetch, "meta_prefetch"},
+	{Opt_nometa_prefetch, "nometa_prefetch"},
 	{Opt_err, NULL},
 };
 
@@ -1697,6 +1710,18 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sbi->s_mount_opt, DISCARD);
 			break;
+		case Opt_fast_commit:
+			set_opt(sbi->s_mount_opt, FAST_COMMIT);
+			break;
+		case Opt_nofast_commit:
+			clear_opt(sbi->s_mount_opt, FAST_COMMIT);
+			break;
+		case Opt_meta_prefetch:
+			set_opt(sbi->s_mount_opt, META_PREFETCH);
+			break;
+		case Opt_nometa_prefetch:
+			clear_opt(sbi->s_mount_opt, META_PREFETCH);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
@@ -2811,6 +2836,9 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 
 	bgl_lock_init(sbi->s_blockgroup_lock);
 
+	/* Start all the descriptor reads before waiting on the first */
+	for (i = 0; i < db_count; i++)
+		sb_breadahead(sb, descriptor_loc(sb, logical_sb_block, i));
 	for (i = 0; i < db_count; i++) {
 		block = descriptor_loc(sb, logical_sb_block, i);
 		sbi->s_group_desc[i] = sb_bread(sb, block);
@@ -2925,6 +2953,13 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT);
 	}
 
+	if (!(sb->s_flags & MS_RDONLY) &&
+	    jbd2_journal_set_fc_blocks(sbi->s_journal,
+			test_opt(sb, FAST_COMMIT) ? EXT4_FC_BLOCKS : 0)) {
+		ext4_msg(sb, KERN_WARNING, "fast commits disabled");
+		clear_opt(sbi->s_mount_opt, FAST_COMMIT);
+	}
+
 	/* We have now updated the journal if required, so we can
 	 * validate the data journaling mode. */
 	switch (test_opt(sb, DATA_FLAGS)) {
@@ -3079,6 +3114,15 @@ no_journal:
 		goto failed_mount4;
 	};
 
+	if (test_opt(sb, META_PREFETCH)) {
+		err = ext4_prefetch_init(sb);
+		if (err) {
+			ext4_msg(sb, KERN_WARNING, "Ignoring meta_prefetch "
+				 "option (%d)", err);
+			clear_opt(sbi->s_mount_opt, META_PREFETCH);
+		}
+	}
+
 	EXT4_SB(sb)->s_mount_state |= EXT4_ORPHAN_FS;
 	ext4_orphan_cleanup(sb, es);
 	EXT4_SB(sb)->s_mount_state &= ~EXT4_ORPHAN_FS;
@@ -3370,6 +3414,8 @@ static int ext4_load_journal(struct super_block *sb,
 	if (!(journal->j_flags & JBD2_BARRIER))
 		ext4_msg(sb, KERN_INFO, "barriers disabled");
 
+	journal->j_fc_replay_callback = ext4_fc_replay;
+
 	if (!really_read_only && test_opt(sb, UPDATE_JOURNAL)) {
 		err = jbd2_journal_update_format(journal);
 		if (err)  {
@@ -3672,6 +3718,12 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		goto restore_opts;
 	}
 
+	/* meta_prefetch only takes effect at mount time */
+	if (sbi->s_prefetch)
+		set_opt(sbi->s_mount_opt, META_PREFETCH);
+	else
+		clear_opt(sbi->s_mount_opt, META_PREFETCH);
+
 	if (sbi->s_mount_flags & EXT4_MF_FS_ABORTED)
 		ext4_abort(sb, __func__, "Abort forced by user");
 
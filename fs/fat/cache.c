@@ -15,6 +15,9 @@
 
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
+/* upper limit for large files, see fat_max_cache() */
+#define FAT_MAX_CACHE_LARGE	128
+#define FAT_CACHE_SCALE_SHIFT	6
 
 struct fat_cache {
 	struct list_head cache_list;
@@ -30,9 +33,20 @@ struct fat_cache_id {
 	int dcluster;
 };
 
+/*
+ * Small files keep the old limit.  Large files get one more slot for
+ * every 64 clusters, so that seeking around in a fragmented video does
+ * not walk the FAT chain from the start again.
+ */
 static inline int fat_max_cache(struct inode *inode)
 {
-	return FAT_MAX_CACHE;
+	unsigned int cluster_bits = MSDOS_SB(inode->i_sb)->cluster_bits;
+	loff_t clusters = i_size_read(inode) >> cluster_bits;
+
+	if (clusters >= (loff_t)(FAT_MAX_CACHE_LARGE - FAT_MAX_CACHE)
+	    << FAT_CACHE_SCALE_SHIFT)
+		return FAT_MAX_CACHE_LARGE;
+	return FAT_MAX_CACHE + (int)(clusters >> FAT_CACHE_SCALE_SHIFT);
 }
 
 static struct kmem_cache *fat_cache_cachep;
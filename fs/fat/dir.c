@@ -18,6 +18,8 @@
 #include <linux/time.h>
 #include <linux/buffer_head.h>
 #include <linux/compat.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 #include <linux/kernel.h>
 #include "fat.h"
@@ -333,11 +335,21 @@ parse_long:
 }
 
 /*
- * Return values: negative -> error, 0 -> not found, positive -> found,
- * value is the total amount of slots, including the shortname entry.
+ * Called for the shortname and the longname of every entry, slot_off is
+ * the position of the first slot of the entry.  A non-zero return stops
+ * the scan at this entry.
  */
-int fat_search_long(struct inode *inode, const unsigned char *name,
-		    int name_len, struct fat_slot_info *sinfo)
+typedef int (*fat_name_actor_t)(void *data, const unsigned char *name,
+				int len, loff_t slot_off);
+
+/*
+ * Walk the entries starting in [cpos, end) and pass their names to @actor.
+ * Returns 0 and fills @sinfo for the entry @actor stopped at, -ENOENT if
+ * it never did, or another negative error.
+ */
+static int fat_scan_names(struct inode *inode, loff_t cpos, loff_t end,
+			  fat_name_actor_t actor, void *data,
+			  struct fat_slot_info *sinfo)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -350,11 +362,15 @@ int fat_search_long(struct inode *inode, const unsigned char *name,
 	unsigned char work[MSDOS_NAME];
 	unsigned char bufname[FAT_MAX_SHORT_SIZE];
 	unsigned short opt_shortname = sbi->options.shortname;
-	loff_t cpos = 0;
+	loff_t slot_off;
 	int chl, i, j, last_u, err, len;
 
 	err = -ENOENT;
 	while (1) {
+		if (cpos >= end) {
+			brelse(bh);
+			goto end_of_dir;
+		}
 		if (fat_get_entry(inode, &cpos, &bh, &de) == -1)
 			goto end_of_dir;
 parse_record:
@@ -418,9 +434,10 @@ parse_record:
 			continue;
 
 		/* Compare shortname */
+		slot_off = cpos - (nr_slots + 1) * sizeof(*de);
 		bufuname[last_u] = 0x0000;
 		len = fat_uni_to_x8(sbi, bufuname, bufname, sizeof(bufname));
-		if (fat_name_match(sbi, name, name_len, bufname, len))
+		if (actor(data, bufname, len, slot_off))
 			goto found;
 
 		if (nr_slots) {
@@ -429,7 +446,7 @@ parse_record:
 
 			/* Compare longname */
 			len = fat_uni_to_x8(sbi, unicode, longname, size);
-			if (fat_name_match(sbi, name, name_len, longname, len))
+			if (actor(data, longname, len, slot_off))
 				goto found;
 		}
 	}
@@ -449,6 +466,221 @@ end_of_dir:
 	return err;
 }
 
+struct fat_name_query {
+	struct msdos_sb_info *sbi;
+	const unsigned char *name;
+	int len;
+};
+
+static int fat_match_actor(void *data, const unsigned char *name, int len,
+			   loff_t slot_off)
+{
+	struct fat_name_query *q = data;
+
+	return fat_name_match(q->sbi, q->name, q->len, name, len);
+}
+
+/*
+ * Name index of large directories.
+ *
+ * A lookup of a name that is not in the dcache has to walk the whole
+ * directory, which gets very slow for camera and music folders with
+ * thousands of files.  On the first lookup in such a directory we walk it
+ * once and record a hash of every shortname and longname along with the
+ * position of its entry, sorted by hash.  Later lookups only check the
+ * entries with a matching hash, and a miss needs no I/O at all.
+ *
+ * The index is dropped whenever entries are added or removed and rebuilt
+ * on the next lookup.  Like the rest of the directory operations it is
+ * protected by the superblock lock.
+ */
+#define FAT_DINDEX_MIN_SIZE	(8 * 1024)	/* 256 slots */
+#define FAT_DINDEX_MAX_ENTS	(2 * FAT_MAX_DIR_ENTRIES)
+
+struct fat_dindex_ent {
+	u32 hash;
+	u32 slot;	/* slot_off >> MSDOS_DIR_BITS */
+};
+
+struct fat_dindex {
+	unsigned int nr;
+	unsigned int size;
+	struct msdos_sb_info *sbi;
+	struct fat_dindex_ent *ent;
+};
+
+/* Must agree with fat_name_match() */
+static u32 fat_dindex_hash(struct msdos_sb_info *sbi,
+			   const unsigned char *name, int len)
+{
+	unsigned long hash = init_name_hash();
+
+	if (sbi->options.name_check != 's') {
+		while (len--)
+			hash = partial_name_hash(nls_tolower(sbi->nls_io,
+							     *name++), hash);
+	} else {
+		while (len--)
+			hash = partial_name_hash(*name++, hash);
+	}
+	return end_name_hash(hash);
+}
+
+static void *fat_dindex_alloc(size_t size)
+{
+	if (size <= PAGE_SIZE)
+		return kmalloc(size, GFP_NOFS);
+	return __vmalloc(size, GFP_NOFS | __GFP_HIGHMEM, PAGE_KERNEL);
+}
+
+static void fat_dindex_free_ents(void *ent)
+{
+	if (is_vmalloc_addr(ent))
+		vfree(ent);
+	else
+		kfree(ent);
+}
+
+static int fat_dindex_actor(void *data, const unsigned char *name, int len,
+			    loff_t slot_off)
+{
+	struct fat_dindex *di = data;
+
+	if (di->nr == di->size) {
+		struct fat_dindex_ent *ent;
+
+		if (di->size >= FAT_DINDEX_MAX_ENTS)
+			return 1;
+		ent = fat_dindex_alloc(2 * di->size * sizeof(*ent));
+		if (!ent)
+			return 1;
+		memcpy(ent, di->ent, di->nr * sizeof(*ent));
+		fat_dindex_free_ents(di->ent);
+		di->ent = ent;
+		di->size *= 2;
+	}
+	di->ent[di->nr].hash = fat_dindex_hash(di->sbi, name, len);
+	di->ent[di->nr].slot = slot_off >> MSDOS_DIR_BITS;
+	di->nr++;
+	return 0;
+}
+
+static int fat_dindex_cmp(const void *a, const void *b)
+{
+	const struct fat_dindex_ent *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return 0;
+}
+
+static struct fat_dindex *fat_dindex_build(struct inode *dir)
+{
+	struct fat_slot_info sinfo;
+	struct fat_dindex *di;
+	int err;
+
+	di = kmalloc(sizeof(*di), GFP_NOFS);
+	if (!di)
+		return NULL;
+	di->nr = 0;
+	di->size = PAGE_SIZE / sizeof(*di->ent);
+	di->sbi = MSDOS_SB(dir->i_sb);
+	di->ent = fat_dindex_alloc(di->size * sizeof(*di->ent));
+	if (!di->ent)
+		goto out_free;
+
+	err = fat_scan_names(dir, 0, LLONG_MAX, fat_dindex_actor, di, &sinfo);
+	if (err != -ENOENT) {
+		/* I/O error, or the actor ran out of room */
+		if (!err)
+			brelse(sinfo.bh);
+		goto out_free_ents;
+	}
+
+	sort(di->ent, di->nr, sizeof(*di->ent), fat_dindex_cmp, NULL);
+	MSDOS_I(dir)->i_dindex = di;
+	return di;
+
+out_free_ents:
+	fat_dindex_free_ents(di->ent);
+out_free:
+	kfree(di);
+	return NULL;
+}
+
+void fat_dindex_inval(struct inode *dir)
+{
+	struct fat_dindex *di = MSDOS_I(dir)->i_dindex;
+
+	if (di) {
+		MSDOS_I(dir)->i_dindex = NULL;
+		fat_dindex_free_ents(di->ent);
+		kfree(di);
+	}
+}
+
+/*
+ * Returns -EAGAIN if the directory has no index and the caller has to
+ * walk it.
+ */
+static int fat_dindex_search(struct inode *dir, struct fat_name_query *q,
+			     struct fat_slot_info *sinfo)
+{
+	struct fat_dindex *di = MSDOS_I(dir)->i_dindex;
+	unsigned int lo, hi, mid;
+	u32 hash;
+	int err;
+
+	if (!di) {
+		if (dir->i_size < FAT_DINDEX_MIN_SIZE)
+			return -EAGAIN;
+		di = fat_dindex_build(dir);
+		if (!di)
+			return -EAGAIN;
+	}
+
+	hash = fat_dindex_hash(q->sbi, q->name, q->len);
+	lo = 0;
+	hi = di->nr;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (di->ent[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < di->nr && di->ent[lo].hash == hash; lo++) {
+		loff_t pos = (loff_t)di->ent[lo].slot << MSDOS_DIR_BITS;
+
+		err = fat_scan_names(dir, pos, pos + 1, fat_match_actor, q,
+				     sinfo);
+		if (err != -ENOENT)
+			return err;
+	}
+	return -ENOENT;
+}
+
+/*
+ * Return values: negative -> error, 0 -> found, sinfo is filled in.
+ */
+int fat_search_long(struct inode *inode, const unsigned char *name,
+		    int name_len, struct fat_slot_info *sinfo)
+{
+	struct fat_name_query q = {
+		.sbi	= MSDOS_SB(inode->i_sb),
+		.name	= name,
+		.len	= name_len,
+	};
+	int err;
+
+	err = fat_dindex_search(inode, &q, sinfo);
+	if (err != -EAGAIN)
+		return err;
+
+	return fat_scan_names(inode, 0, LLONG_MAX, fat_match_actor, &q, sinfo);
+}
+
 EXPORT_SYMBOL_GPL(fat_search_long);
 
 struct fat_ioctl_filldir_callback {
@@ -992,6 +1224,8 @@ int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo)
 	struct buffer_head *bh;
 	int err = 0, nr_slots;
 
+	fat_dindex_inval(dir);
+
 	/*
 	 * First stage: Remove the shortname. By this, the directory
 	 * entry is removed.
@@ -1243,6 +1477,7 @@ int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 	int err, free_slots, i, nr_bhs;
 	loff_t pos, i_pos;
 
+	fat_dindex_inval(dir);
 	sinfo->nr_slots = nr_slots;
 
 	/* First stage: search free direcotry entries */
@@ -109,6 +109,7 @@ struct msdos_inode_info {
 	int i_logstart;		/* logical first cluster */
 	int i_attrs;		/* unused attribute bits */
 	loff_t i_pos;		/* on-disk position of directory entry or 0 */
+	struct fat_dindex *i_dindex;	/* name index of a large directory */
 	struct hlist_node i_fat_hash;	/* hash by i_location */
 	struct inode vfs_inode;
 };
@@ -251,6 +252,7 @@ extern int fat_alloc_new_dir(struct inode *dir, struct timespec *ts);
 extern int fat_add_entries(struct inode *dir, void *slots, int nr_slots,
 			   struct fat_slot_info *sinfo);
 extern int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo);
+extern void fat_dindex_inval(struct inode *dir);
 
 /* fat/fatent.c */
 struct fat_entry {
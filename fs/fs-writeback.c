@@ -567,14 +567,25 @@ static void __writeback_inodes_sb(struct super_block *sb,
 	spin_unlock(&inode_lock);
 }
 
-static inline bool over_bground_thresh(void)
+static inline bool over_bground_thresh(struct backing_dev_info *bdi)
 {
-	unsigned long background_thresh, dirty_thresh;
+	unsigned long background_thresh, dirty_thresh, bdi_thresh;
 
 	get_dirty_limits(&background_thresh, &dirty_thresh, NULL, NULL);
 
-	return (global_page_state(NR_FILE_DIRTY) +
-		global_page_state(NR_UNSTABLE_NFS) >= background_thresh);
+	if (global_page_state(NR_FILE_DIRTY) +
+	    global_page_state(NR_UNSTABLE_NFS) >= background_thresh)
+		return true;
+
+	/*
+	 * Also keep going while this bdi is over the same fraction of
+	 * its own, bandwidth limited, share.
+	 */
+	bdi_thresh = bdi_dirty_limit(bdi, dirty_thresh);
+
+	return bdi_stat(bdi, BDI_RECLAIMABLE) >
+		div_u64((u64)bdi_thresh * background_thresh,
+			max(dirty_thresh, 1UL));
 }
 
 /*
@@ -603,6 +614,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		.range_cyclic		= work->range_cyclic,
 	};
 	unsigned long oldest_jif;
+	unsigned long wb_start = jiffies;
 	long wrote = 0;
 	struct inode *inode;
 
@@ -631,7 +643,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		 * For background writeout, stop when we are below the
 		 * background dirty threshold
 		 */
-		if (work->for_background && !over_bground_thresh())
+		if (work->for_background && !over_bground_thresh(wb->bdi))
 			break;
 
 		wbc.more_io = 0;
@@ -644,6 +656,8 @@ static long wb_writeback(struct bdi_writeback *wb,
 		work->nr_pages -= max_writeback_pages - wbc.nr_to_write;
 		wrote += max_writeback_pages - wbc.nr_to_write;
 
+		bdi_update_bandwidth(wb->bdi, wb_start);
+
 		/*
 		 * If we consumed everything, see if we have more
 		 */
@@ -16,6 +16,7 @@
 #include <linux/writeback.h>
 #include <linux/buffer_head.h>
 #include <linux/falloc.h>
+#include <linux/ra_history.h>
 
 #include <asm/ioctls.h>
 
@@ -464,6 +465,10 @@ static int file_ioctl(struct file *filp, unsigned int cmd,
 	case FS_IOC_RESVSP:
 	case FS_IOC_RESVSP64:
 		return ioctl_preallocate(filp, p);
+	case FS_IOC_GET_RA_HISTORY:
+		return ra_history_get(filp, p);
+	case FS_IOC_SET_RA_HISTORY:
+		return ra_history_set(filp, p);
 	}
 
 	return vfs_ioctl(filp, cmd, arg);
@@ -531,9 +531,11 @@ int jbd2_cleanup_journal_tail(journal_t *journal)
 	 * doesn't get called all that often.
 	 */
 	if ((journal->j_fs_dev != journal->j_dev) &&
-	    (journal->j_flags & JBD2_BARRIER))
+	    (journal->j_flags & JBD2_BARRIER)) {
 		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
+		jbd2_journal_count_flush(journal);
+	}
 	if (!(journal->j_flags & JBD2_ABORT))
 		jbd2_journal_update_superblock(journal, 1);
 	return 0;
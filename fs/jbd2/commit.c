@@ -135,6 +135,7 @@ static int journal_submit_commit_record(journal_t *journal,
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
+		jbd2_journal_count_flush(journal);
 		ret = submit_bh(WRITE_SYNC_PLUG | WRITE_BARRIER, bh);
 		if (ret == -EOPNOTSUPP) {
 			printk(KERN_WARNING
@@ -198,6 +199,142 @@ retry:
 	return ret;
 }
 
+/**
+ * int jbd2_fc_commit() - write a fast commit record
+ * @journal: Journal to write to.
+ * @tid: Transaction the record belongs to; must be the running one.
+ * @data: Filesystem-defined record.
+ * @len: Length of @data, at most a block less the fast commit header.
+ *
+ * Instead of committing the whole running transaction, log one record in
+ * the fast commit area and make it durable with a single barrier write.
+ * If the system crashes before @tid commits, recovery hands the records
+ * of @tid back to the filesystem through j_fc_replay_callback.  The
+ * caller is responsible for making sure that the record does not depend
+ * on anything else in @tid.
+ *
+ * Returns 0 on success.  -EAGAIN means @tid is no longer running,
+ * -ENOSPC that the fast commit area is full; on any error the caller
+ * should fall back to a full commit.
+ */
+int jbd2_fc_commit(journal_t *journal, tid_t tid, const void *data,
+		   unsigned int len)
+{
+	jbd2_fc_header_t *fc;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	tid_t committing;
+	int ret;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FC_AREA) ||
+	    len > journal->j_blocksize - sizeof(*fc))
+		return -EINVAL;
+	if (is_journal_aborted(journal))
+		return -EROFS;
+
+	mutex_lock(&journal->j_fc_mutex);
+	/*
+	 * Recovery replays only the records of the transaction following
+	 * the last one committed, so a transaction still being committed
+	 * has to reach the log before our record is of any use.
+	 */
+	for (;;) {
+		read_lock(&journal->j_state_lock);
+		if (!journal->j_running_transaction ||
+		    journal->j_running_transaction->t_tid != tid) {
+			read_unlock(&journal->j_state_lock);
+			ret = -EAGAIN;
+			goto out;
+		}
+		if (!journal->j_committing_transaction) {
+			read_unlock(&journal->j_state_lock);
+			break;
+		}
+		committing = journal->j_committing_transaction->t_tid;
+		read_unlock(&journal->j_state_lock);
+		ret = jbd2_log_wait_commit(journal, committing);
+		if (ret)
+			goto out;
+	}
+
+	/*
+	 * Recovery doesn't look past a log marked empty (s_start == 0), as
+	 * it is after mount or jbd2_journal_flush().  Record the start of
+	 * the log, as the first full commit would, before a record goes out.
+	 */
+	if (journal->j_flags & JBD2_FLUSHED)
+		jbd2_journal_update_superblock(journal, 1);
+
+	if (journal->j_fc_tid != tid) {
+		journal->j_fc_tid = tid;
+		journal->j_fc_off = journal->j_fc_first;
+	}
+	if (journal->j_fc_off >= journal->j_fc_last) {
+		ret = -ENOSPC;
+		goto out;
+	}
+	ret = jbd2_journal_bmap(journal, journal->j_fc_off, &blocknr);
+	if (ret)
+		goto out;
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * The data the record refers to sits on the filesystem device; the
+	 * barrier below only covers it when that is also the journal device.
+	 */
+	if ((journal->j_fs_dev != journal->j_dev) &&
+	    (journal->j_flags & JBD2_BARRIER)) {
+		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
+			BLKDEV_IFL_WAIT);
+		jbd2_journal_count_flush(journal);
+	}
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	fc = (jbd2_fc_header_t *)bh->b_data;
+	fc->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	fc->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	fc->fc_header.h_sequence = cpu_to_be32(tid);
+	fc->fc_len = cpu_to_be32(len);
+	memcpy(fc + 1, data, len);
+	fc->fc_chksum = cpu_to_be32(crc32_be(~0, (void *)(fc + 1), len));
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	bh->b_end_io = journal_end_buffer_io_sync;
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		ret = submit_bh(WRITE_SYNC_PLUG | WRITE_BARRIER, bh);
+		jbd2_journal_count_flush(journal);
+	} else
+		ret = submit_bh(WRITE_SYNC_PLUG, bh);
+	if (!ret) {
+		wait_on_buffer(bh);
+		if (buffer_eopnotsupp(bh))
+			ret = -EOPNOTSUPP;
+		else if (!buffer_uptodate(bh))
+			ret = -EIO;
+	}
+	/* A barrier the device refuses is dealt with by the full commit. */
+	if (!ret)
+		journal->j_fc_off++;
+	put_bh(bh);
+out:
+	spin_lock(&journal->j_history_lock);
+	if (ret)
+		journal->j_stats.ts_fc_failed++;
+	else
+		journal->j_stats.ts_fc++;
+	spin_unlock(&journal->j_history_lock);
+	mutex_unlock(&journal->j_fc_mutex);
+	return ret;
+}
+EXPORT_SYMBOL(jbd2_fc_commit);
+
 /*
  * write the filemap data using writepage() address_space_operations.
  * We don't do block allocation here even for delalloc. We don't
@@ -708,9 +845,11 @@ start_journal_io:
 	 */
 	if (commit_transaction->t_flushed_data_blocks &&
 	    (journal->j_fs_dev != journal->j_dev) &&
-	    (journal->j_flags & JBD2_BARRIER))
+	    (journal->j_flags & JBD2_BARRIER)) {
 		blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
+		jbd2_journal_count_flush(journal);
+	}
 
 	/* Done it all: now write the commit record asynchronously. */
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
@@ -719,9 +858,11 @@ start_journal_io:
 						 &cbh, crc32_sum);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
-		if (journal->j_flags & JBD2_BARRIER)
+		if (journal->j_flags & JBD2_BARRIER) {
 			blkdev_issue_flush(journal->j_dev, GFP_KERNEL, NULL,
 				BLKDEV_IFL_WAIT);
+			jbd2_journal_count_flush(journal);
+		}
 	}
 
 	err = journal_finish_inode_data_buffers(journal, commit_transaction);
@@ -83,6 +83,7 @@ EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
+EXPORT_SYMBOL(jbd2_journal_set_fc_blocks);
 EXPORT_SYMBOL(jbd2_journal_blocks_per_page);
 EXPORT_SYMBOL(jbd2_journal_invalidatepage);
 EXPORT_SYMBOL(jbd2_journal_try_to_free_buffers);
@@ -717,6 +718,9 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "%lu transaction, each up to %u blocks\n",
 			s->stats->ts_tid,
 			s->journal->j_max_transaction_buffers);
+	seq_printf(seq, "%lu fast commits, %lu fell back to full commit\n",
+			s->stats->ts_fc, s->stats->ts_fc_failed);
+	seq_printf(seq, "%lu cache flushes\n", s->stats->ts_flushes);
 	if (s->stats->ts_tid == 0)
 		return 0;
 	seq_printf(seq, "average: \n  %ums waiting for transaction\n",
@@ -843,6 +847,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_updates);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	mutex_init(&journal->j_fc_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1027,6 +1032,32 @@ static void journal_fail_superblock (journal_t *journal)
 	journal->j_sb_buffer = NULL;
 }
 
+/*
+ * jbd2_journal_update_superblock() leaves the superblock of an empty log
+ * alone.  Write it anyway after changing the fast commit feature, which
+ * recovery and e2fsck have to see.
+ */
+static void journal_sync_fc_feature(journal_t *journal)
+{
+	struct buffer_head *bh = journal->j_sb_buffer;
+
+	if (!(journal->j_flags & JBD2_FLUSHED))
+		return;
+	mark_buffer_dirty(bh);
+	sync_dirty_buffer(bh);
+}
+
+/*
+ * Number of blocks at the end of the journal set aside for fast commits.
+ */
+static unsigned long journal_fc_blocks(journal_t *journal)
+{
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FC_AREA))
+		return 0;
+	return be32_to_cpu(journal->j_superblock->s_num_fc_blks);
+}
+
 /*
  * Given a journal_t structure, initialise the various fields for
  * startup of a new journaling session.  We use this both when creating
@@ -1040,7 +1071,7 @@ static int journal_reset(journal_t *journal)
 	unsigned long long first, last;
 
 	first = be32_to_cpu(sb->s_first);
-	last = be32_to_cpu(sb->s_maxlen);
+	last = be32_to_cpu(sb->s_maxlen) - journal_fc_blocks(journal);
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1050,6 +1081,10 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	journal->j_fc_first = last;
+	journal->j_fc_last = be32_to_cpu(sb->s_maxlen);
+	journal->j_fc_off = last;
+	journal->j_fc_tid = journal->j_transaction_sequence - 1;
 
 	journal->j_head = first;
 	journal->j_tail = first;
@@ -1226,7 +1261,9 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail_sequence = be32_to_cpu(sb->s_sequence);
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
-	journal->j_last = be32_to_cpu(sb->s_maxlen);
+	journal->j_last = be32_to_cpu(sb->s_maxlen) - journal_fc_blocks(journal);
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
 	return 0;
@@ -1337,11 +1374,19 @@ int jbd2_journal_destroy(journal_t *journal)
 
 	if (journal->j_sb_buffer) {
 		if (!is_journal_aborted(journal)) {
-			/* We can now mark the journal as empty. */
+			/*
+			 * We can now mark the journal as empty.  Nothing
+			 * is left to replay from the fast commit area, so
+			 * let tools that do not know about it at the log.
+			 */
 			journal->j_tail = 0;
 			journal->j_tail_sequence =
 				++journal->j_transaction_sequence;
+			jbd2_journal_clear_features(journal, 0, 0,
+					JBD2_FEATURE_INCOMPAT_FC_AREA);
+			journal->j_superblock->s_num_fc_blks = 0;
 			jbd2_journal_update_superblock(journal, 1);
+			journal_sync_fc_feature(journal);
 		} else {
 			err = -EIO;
 		}
@@ -1361,6 +1406,59 @@ int jbd2_journal_destroy(journal_t *journal)
 }
 
 
+/**
+ * int jbd2_journal_set_fc_blocks() - Size the fast commit area
+ * @journal: Journal to act on.
+ * @nblocks: Blocks to reserve at the end of the journal, 0 to disable.
+ *
+ * Carve @nblocks off the end of the log for jbd2_fc_commit() records and
+ * mark the journal with the fast commit feature, or give the blocks back
+ * and clear the feature.  The log must be empty, as it is right after
+ * jbd2_journal_load().
+ */
+int jbd2_journal_set_fc_blocks(journal_t *journal, unsigned int nblocks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long maxlen = be32_to_cpu(sb->s_maxlen);
+	int err = 0;
+
+	if (nblocks && (journal->j_format_version != 2 ||
+			nblocks > maxlen / 8))
+		return -EINVAL;
+
+	mutex_lock(&journal->j_fc_mutex);
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_head != journal->j_tail) {
+		err = -EBUSY;
+		goto out;
+	}
+	if (nblocks) {
+		jbd2_journal_set_features(journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_FC_AREA);
+		sb->s_num_fc_blks = cpu_to_be32(nblocks);
+	} else {
+		jbd2_journal_clear_features(journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_FC_AREA);
+		sb->s_num_fc_blks = 0;
+	}
+	journal->j_last = maxlen - nblocks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_last = maxlen;
+	journal->j_fc_off = journal->j_last;
+	journal->j_head = journal->j_tail = journal->j_first;
+	journal->j_free = journal->j_last - journal->j_first;
+out:
+	write_unlock(&journal->j_state_lock);
+	mutex_unlock(&journal->j_fc_mutex);
+	if (!err) {
+		jbd2_journal_update_superblock(journal, 1);
+		journal_sync_fc_feature(journal);
+	}
+	return err;
+}
+
 /**
  *int jbd2_journal_check_used_features () - Check if features specified are used.
  * @journal: Journal to check.
@@ -42,6 +42,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int fc_do_replay(journal_t *journal, tid_t tid);
 
 #ifdef __KERNEL__
 
@@ -261,6 +262,10 @@ int jbd2_journal_recover(journal_t *journal)
 	 * any existing commit records in the log. */
 	journal->j_transaction_sequence = ++info.end_transaction;
 
+	/* Fast commits made on behalf of the transaction that never made it. */
+	if (!err)
+		err = fc_do_replay(journal, info.end_transaction - 1);
+
 	jbd2_journal_clear_revoke(journal);
 	err2 = sync_blockdev(journal->j_fs_dev);
 	if (!err)
@@ -736,3 +741,50 @@ static int scan_revoke_records(journal_t *journal, struct buffer_head *bh,
 	}
 	return 0;
 }
+
+/*
+ * Hand the fast commit records of transaction @tid back to the
+ * filesystem.  The records were written in order from the start of the
+ * fast commit area, so the first block that does not belong to @tid, or
+ * fails its checksum, ends the scan.
+ */
+static int fc_do_replay(journal_t *journal, tid_t tid)
+{
+	struct buffer_head *bh;
+	jbd2_fc_header_t *fc;
+	unsigned long blocknr;
+	unsigned int len;
+	int err = 0, nr = 0;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FC_AREA) ||
+	    !journal->j_fc_replay_callback)
+		return 0;
+
+	for (blocknr = journal->j_fc_first; blocknr < journal->j_fc_last;
+	     blocknr++) {
+		err = jread(&bh, journal, blocknr);
+		if (err)
+			break;
+		fc = (jbd2_fc_header_t *)bh->b_data;
+		len = be32_to_cpu(fc->fc_len);
+		if (fc->fc_header.h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    be32_to_cpu(fc->fc_header.h_blocktype) != JBD2_FC_BLOCK ||
+		    be32_to_cpu(fc->fc_header.h_sequence) != tid ||
+		    len > journal->j_blocksize - sizeof(*fc) ||
+		    be32_to_cpu(fc->fc_chksum) !=
+				crc32_be(~0, (void *)(fc + 1), len)) {
+			brelse(bh);
+			break;
+		}
+		err = journal->j_fc_replay_callback(journal, fc + 1, len);
+		brelse(bh);
+		if (err)
+			break;
+		nr++;
+	}
+
+	jbd_debug(1, "JBD: replayed %d fast commit records for %u\n",
+		  nr, tid);
+	return err;
+}
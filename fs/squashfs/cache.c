@@ -57,6 +57,7 @@
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
@@ -67,6 +68,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 {
 	int i, n;
 	struct squashfs_cache_entry *entry;
+	struct squashfs_page_actor actor;
 
 	spin_lock(&cache->lock);
 
@@ -116,9 +118,11 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			entry->error = 0;
 			spin_unlock(&cache->lock);
 
-			entry->length = squashfs_read_data(sb, entry->data,
+			squashfs_page_actor_init(&actor, entry->data,
+				cache->pages);
+			entry->length = squashfs_read_data(sb, &actor,
 				block, length, &entry->next_index,
-				cache->block_size, cache->pages);
+				cache->block_size);
 
 			spin_lock(&cache->lock);
 
@@ -398,6 +402,7 @@ int squashfs_read_table(struct super_block *sb, void *buffer, u64 block,
 	int length)
 {
 	int pages = (length + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	struct squashfs_page_actor actor;
 	int i, res;
 	void **data = kcalloc(pages, sizeof(void *), GFP_KERNEL);
 	if (data == NULL)
@@ -405,8 +410,9 @@ int squashfs_read_table(struct super_block *sb, void *buffer, u64 block,
 
 	for (i = 0; i < pages; i++, buffer += PAGE_CACHE_SIZE)
 		data[i] = buffer;
-	res = squashfs_read_data(sb, data, block, length |
-		SQUASHFS_COMPRESSED_BIT_BLOCK, NULL, length, pages);
+	squashfs_page_actor_init(&actor, data, pages);
+	res = squashfs_read_data(sb, &actor, block, length |
+		SQUASHFS_COMPRESSED_BIT_BLOCK, NULL, length);
 	kfree(data);
 	return res;
 }
@@ -23,11 +23,14 @@
  * decompressor.h
  */
 
+struct squashfs_page_actor;
+
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *);
 	void	(*free)(void *);
-	int	(*decompress)(struct squashfs_sb_info *, void **,
-		struct buffer_head **, int, int, int, int, int);
+	int	(*decompress)(struct squashfs_sb_info *, void *,
+		struct squashfs_page_actor *, struct buffer_head **, int, int,
+		int, int);
 	int	id;
 	char	*name;
 	int	supported;
@@ -45,11 +48,15 @@ static inline void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
 		msblk->decompressor->free(s);
 }
 
-static inline int squashfs_decompress(struct squashfs_sb_info *msblk,
-	void **buffer, struct buffer_head **bh, int b, int offset, int length,
-	int srclength, int pages)
-{
-	return msblk->decompressor->decompress(msblk, buffer, bh, b, offset,
-		length, srclength, pages);
-}
+/*
+ * decompressor_single.c or decompressor_multi_percpu.c
+ *
+ * These own msblk->stream.  squashfs_decompress() is called with the
+ * buffer_heads already read, and the decompressor must not sleep.
+ */
+extern void *squashfs_decompressor_create(struct squashfs_sb_info *);
+extern void squashfs_decompressor_destroy(struct squashfs_sb_info *);
+extern int squashfs_decompress(struct squashfs_sb_info *,
+	struct squashfs_page_actor *, struct buffer_head **, int, int, int,
+	int);
 #endif
@@ -38,6 +38,9 @@
  * Larger files use multiple slots, with 1.75 TiB files using all 8 slots.
  * The index cache is designed to be memory efficient, and by default uses
  * 16 KiB.
+ *
+ * Datablocks are decompressed straight into the page cache when all the
+ * pages they cover can be grabbed, otherwise through the read_page cache.
  */
 
 #include <linux/fs.h>
@@ -52,6 +55,7 @@
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * Locate cache slot in range [offset, index] for specified inode.  If
@@ -371,11 +375,96 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * rather than into the read_page cache and copying from there.  This
+ * needs every one of those pages: if one of them can't be grabbed or is
+ * already uptodate -EAGAIN is returned and the caller goes through the
+ * cache instead.  On success target_page is uptodate and unlocked.
+ *
+ * The pages are not kmapped here: the page actor maps each one
+ * atomically while it is being filled, so a block's worth of highmem
+ * pages doesn't sit in the kmap pool across the read.
+ */
+static int squashfs_readpage_block(struct page *target_page, u64 block,
+	int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, bytes, res = -ENOMEM;
+	struct squashfs_page_actor actor;
+	struct page **page;
+	void *pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	if (page == NULL)
+		return res;
+
+	res = -EAGAIN;
+	for (i = 0, n = start_index; n <= end_index; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL)
+			goto release_pages;
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			goto release_pages;
+		}
+	}
+
+	squashfs_page_actor_init_special(&actor, page, pages);
+	res = squashfs_read_data(inode->i_sb, &actor, block, bsize, NULL,
+		msblk->block_size);
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		goto release_pages;
+	}
+
+	/* Zero whatever the block did not fill (the end of the file) */
+	bytes = res & ~PAGE_CACHE_MASK;
+	for (n = res >> PAGE_CACHE_SHIFT; n < pages; n++, bytes = 0) {
+		pageaddr = kmap_atomic(page[n], KM_USER0);
+		memset(pageaddr + bytes, 0, PAGE_CACHE_SIZE - bytes);
+		kunmap_atomic(pageaddr, KM_USER0);
+	}
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+	kfree(page);
+	return 0;
+
+release_pages:
+	while (i--) {
+		if (page[i] != target_page) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+		}
+	}
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-	int bytes, i, offset = 0, sparse = 0;
+	int bytes, i, res, offset = 0, sparse = 0;
 	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
 
@@ -410,8 +499,15 @@ static int squashfs_readpage(struct file *file, struct page *page)
 			sparse = 1;
 		} else {
 			/*
-			 * Read and decompress datablock.
+			 * Read and decompress datablock, straight into the
+			 * page cache if possible.
 			 */
+			res = squashfs_readpage_block(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -EAGAIN)
+				goto error_out;
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -161,6 +161,9 @@ struct bio {
  *	Don't want driver retries for any fast fail whatever the reason.
  * bit 10 -- Tell the IO scheduler not to wait for more requests after this
 	one has been submitted, even if it is a SYNC request.
+ * bit 11 -- secure discard
+ *	Like a discard, but the device must also make sure that the data
+ *	which was in the range cannot be recovered from the medium.
  */
 enum bio_rw_flags {
 	BIO_RW,
@@ -175,6 +178,7 @@ enum bio_rw_flags {
 	BIO_RW_META,
 	BIO_RW_DISCARD,
 	BIO_RW_NOIDLE,
+	BIO_RW_SECURE,
 };
 
 /*
@@ -19,10 +19,19 @@ extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 
+extern int sysctl_compact_daemon_order;
+extern int sysctl_compact_daemon_min_blocks;
+extern int sysctl_compact_daemon_budget_ms;
+extern int sysctl_compact_daemon_sleep_ms;
+
 extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask);
 
+extern void wakeup_kcompactd(struct zone *zone);
+extern int kcompactd_run(int nid);
+extern void kcompactd_stop(int nid);
+
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -68,6 +77,19 @@ static inline bool compaction_deferred(struct zone *zone)
 	return 1;
 }
 
+static inline void wakeup_kcompactd(struct zone *zone)
+{
+}
+
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop(int nid)
+{
+}
+
 #endif /* CONFIG_COMPACTION */
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
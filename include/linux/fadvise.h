@@ -5,6 +5,7 @@
 #define POSIX_FADV_RANDOM	1 /* Expect random page references.  */
 #define POSIX_FADV_SEQUENTIAL	2 /* Expect sequential page references.  */
 #define POSIX_FADV_WILLNEED	3 /* Will need these pages.  */
+#define POSIX_FADV_RECORD_ACCESS 8 /* Record pages accessed from now on.  */
 
 /*
  * The advise values for POSIX_FADV_DONTNEED and POSIX_ADV_NOREUSE
@@ -130,6 +130,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -166,6 +167,18 @@ struct commit_header {
 	__be32		h_commit_nsec;
 };
 
+/*
+ * Fast commit block header: a fast commit block carries one opaque,
+ * filesystem-defined record of fc_len bytes for the transaction named
+ * in fc_header.h_sequence.
+ */
+typedef struct jbd2_fc_header_s
+{
+	journal_header_t fc_header;
+	__be32		fc_len;		/* Length of the record that follows */
+	__be32		fc_chksum;	/* crc32_be of the record */
+} jbd2_fc_header_t;
+
 /*
  * The block tag: used to describe a single buffer in the journal.
  * t_blocknr_high is only used if INCOMPAT_64BIT is set, so this
@@ -241,7 +254,9 @@ typedef struct journal_superblock_s
 	__be32	s_max_trans_data;	/* Limit of data blocks per trans. */
 
 /* 0x0050 */
-	__u32	s_padding[44];
+	__u32	s_padding2;
+	__be32	s_num_fc_blks;		/* Nr of fast commit blocks */
+	__u32	s_padding[42];
 
 /* 0x0100 */
 	__u8	s_users[16*48];		/* ids of all fs'es sharing the log */
@@ -263,13 +278,19 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+/*
+ * The fast commit area of this tree.  Its records are not those of the
+ * FAST_COMMIT feature (0x20) of later kernels, so it takes its own bit.
+ */
+#define JBD2_FEATURE_INCOMPAT_FC_AREA		0x00010000
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FC_AREA)
 
 #ifdef __KERNEL__
 
@@ -659,6 +680,9 @@ struct transaction_run_stats_s {
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fc;
+	unsigned long		ts_fc_failed;
+	unsigned long		ts_flushes;
 	struct transaction_run_stats_s run;
 };
 
@@ -849,6 +873,18 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area: the blocks between j_fc_first and j_fc_last sit
+	 * past the end of the log proper and hold per-inode records written
+	 * by jbd2_fc_commit() on behalf of the running transaction j_fc_tid.
+	 * j_fc_off is the next free block in the area.  [j_fc_mutex]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+	tid_t			j_fc_tid;
+	struct mutex		j_fc_mutex;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -962,6 +998,13 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Called by recovery for each valid fast commit record found after
+	 * the last committed transaction.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *, void *,
+							unsigned int);
+
 	/*
 	 * Journal statistics
 	 */
@@ -979,6 +1022,16 @@ struct journal_s
 	void *j_private;
 };
 
+/*
+ * Account a cache flush or barrier write issued on behalf of the journal.
+ */
+static inline void jbd2_journal_count_flush(journal_t *journal)
+{
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_flushes++;
+	spin_unlock(&journal->j_history_lock);
+}
+
 /*
  * Journal flag definitions
  */
@@ -1122,6 +1175,8 @@ extern int	   jbd2_journal_recover    (journal_t *journal);
 extern int	   jbd2_journal_wipe       (journal_t *, int);
 extern int	   jbd2_journal_skip_recovery	(journal_t *);
 extern void	   jbd2_journal_update_superblock	(journal_t *, int);
+extern int	   jbd2_journal_set_fc_blocks	(journal_t *, unsigned int);
+extern int	   jbd2_fc_commit(journal_t *, tid_t, const void *, unsigned int);
 extern void	   __jbd2_journal_abort_hard	(journal_t *);
 extern void	   jbd2_journal_abort      (journal_t *, int);
 extern int	   jbd2_journal_errno      (journal_t *);
@@ -1334,6 +1334,28 @@ void page_cache_async_readahead(struct address_space *mapping,
 				unsigned long size);
 
 unsigned long max_sane_readahead(unsigned long nr);
+
+#ifdef CONFIG_READAHEAD_HISTORY
+int ra_history_start(struct address_space *mapping);
+int ra_history_get(struct file *filp, void __user *argp);
+int ra_history_set(struct file *filp, void __user *argp);
+void __ra_history_record(struct address_space *mapping, pgoff_t index);
+void __ra_history_replay(struct file *filp);
+void __ra_history_free(struct address_space *mapping);
+#else
+static inline int ra_history_start(struct address_space *mapping)
+{
+	return -EINVAL;
+}
+static inline int ra_history_get(struct file *filp, void __user *argp)
+{
+	return -ENOTTY;
+}
+static inline int ra_history_set(struct file *filp, void __user *argp)
+{
+	return -ENOTTY;
+}
+#endif
 unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
@@ -266,6 +266,12 @@ struct _mmc_csd {
 #define EXT_CSD_S_A_TIMEOUT	217
 #define EXT_CSD_BOOT_SIZE_MULTI	226
 #define EXT_CSD_ERASE_GRP_DEF 175 /* R/W */
+#define EXT_CSD_ERASE_TIMEOUT_MULT	223	/* RO */
+#define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
+#define EXT_CSD_SEC_TRIM_MULT	229	/* RO */
+#define EXT_CSD_SEC_ERASE_MULT	230	/* RO */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_TRIM_MULT	232	/* RO */
 /*
  * EXT_CSD field definitions
  */
@@ -286,6 +292,9 @@ struct _mmc_csd {
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
 #define EXT_CSD_BUS_WIDTH_8	2	/* Card is in 8 bit mode */
 
+#define EXT_CSD_SEC_ER_EN	(1<<0)	/* Secure purge supported */
+#define EXT_CSD_SEC_GB_CL_EN	(1<<4)	/* Secure TRIM supported */
+
 /*
  * MMC_SWITCH access modes
  */
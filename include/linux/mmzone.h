@@ -336,6 +336,14 @@ struct zone {
 	 */
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
+
+	/*
+	 * Scanner positions saved by kcompactd between incremental passes
+	 * so that the next pass resumes where the last one ran out of budget.
+	 * A zero compact_cached_free_pfn means start from the zone edges.
+	 */
+	unsigned long		compact_cached_migrate_pfn;
+	unsigned long		compact_cached_free_pfn;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -644,6 +652,10 @@ typedef struct pglist_data {
 	wait_queue_head_t kswapd_wait;
 	struct task_struct *kswapd;
 	int kswapd_max_order;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
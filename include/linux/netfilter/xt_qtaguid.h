@@ -0,0 +1,22 @@
+#ifndef _XT_QTAGUID_MATCH_H
+#define _XT_QTAGUID_MATCH_H
+
+#include <linux/types.h>
+
+/* Same layout and meaning as the "owner" match, so rules convert as is */
+enum {
+	XT_QTAGUID_UID    = 1 << 0,
+	XT_QTAGUID_GID    = 1 << 1,
+	XT_QTAGUID_SOCKET = 1 << 2,
+};
+
+struct xt_qtaguid_match_info {
+	__u32 uid_min, uid_max;
+	__u32 gid_min, gid_max;
+	__u8 match, invert;
+};
+
+/* Counter sets a uid can be switched between, e.g. foreground/background */
+#define XT_QTAGUID_MAX_SETS	2
+
+#endif /* _XT_QTAGUID_MATCH_H */
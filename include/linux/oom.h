@@ -14,6 +14,7 @@
 
 struct zonelist;
 struct notifier_block;
+struct task_struct;
 
 /*
  * Types of limitations to the nodes from which allocations may occur
@@ -32,6 +33,14 @@ extern void out_of_memory(struct zonelist *zonelist, gfp_t gfp_mask,
 extern int register_oom_notifier(struct notifier_block *nb);
 extern int unregister_oom_notifier(struct notifier_block *nb);
 
+#ifdef CONFIG_MMU
+extern void mm_reap_task(struct task_struct *p);
+#else
+static inline void mm_reap_task(struct task_struct *p)
+{
+}
+#endif
+
 extern bool oom_killer_disabled;
 
 static inline void oom_killer_disable(void)
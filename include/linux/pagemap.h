@@ -80,6 +80,35 @@ static inline void mapping_set_gfp_mask(struct address_space *m, gfp_t mask)
 #define PAGE_CACHE_MASK		PAGE_MASK
 #define PAGE_CACHE_ALIGN(addr)	(((addr)+PAGE_CACHE_SIZE-1)&PAGE_CACHE_MASK)
 
+/*
+ * Readahead history hooks. They cost a NULL test unless the mapping has
+ * ever been asked to record or replay its accesses.
+ */
+static inline void ra_history_record(struct address_space *mapping,
+				     pgoff_t index)
+{
+#ifdef CONFIG_READAHEAD_HISTORY
+	if (unlikely(mapping->ra_history))
+		__ra_history_record(mapping, index);
+#endif
+}
+
+static inline void ra_history_replay(struct file *filp)
+{
+#ifdef CONFIG_READAHEAD_HISTORY
+	if (unlikely(filp->f_mapping->ra_history))
+		__ra_history_replay(filp);
+#endif
+}
+
+static inline void ra_history_free(struct address_space *mapping)
+{
+#ifdef CONFIG_READAHEAD_HISTORY
+	if (unlikely(mapping->ra_history))
+		__ra_history_free(mapping);
+#endif
+}
+
 #define page_cache_get(page)		get_page(page)
 #define page_cache_release(page)	put_page(page)
 void release_pages(struct page **pages, int nr, int cold);
@@ -481,4 +481,31 @@ struct tc_drr_stats {
 	__u32	deficit;
 };
 
+/* PACE */
+
+enum {
+	TCA_PACE_UNSPEC,
+	TCA_PACE_PLIMIT,		/* limit of total number of packets in queue */
+	TCA_PACE_FLOW_PLIMIT,		/* limit of packets per flow */
+	TCA_PACE_QUANTUM,		/* RR quantum */
+	TCA_PACE_INITIAL_QUANTUM,	/* RR quantum for new flow */
+	TCA_PACE_FLOW_MAX_RATE,		/* per flow max rate, bytes per second */
+	TCA_PACE_BUCKETS_LOG,		/* log2(number of buckets) */
+	__TCA_PACE_MAX
+};
+
+#define TCA_PACE_MAX	(__TCA_PACE_MAX - 1)
+
+struct tc_pace_qd_stats {
+	__u64	gc_flows;
+	__u64	highprio_packets;
+	__u64	throttled;
+	__u64	flows_plimit;
+	__u64	allocation_errors;
+	__u32	flows;
+	__u32	inactive_flows;
+	__u32	throttled_flows;
+	__u32	pad;
+};
+
 #endif
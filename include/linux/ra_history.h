@@ -0,0 +1,28 @@
+/*
+ * FS_IOC_GET_RA_HISTORY / FS_IOC_SET_RA_HISTORY ioctl definitions.
+ *
+ * A readahead history is a set of page ranges of a file, recorded after
+ * POSIX_FADV_RECORD_ACCESS and read in ahead of time on the next open of
+ * the file once it has been handed back.
+ */
+
+#ifndef _LINUX_RA_HISTORY_H
+#define _LINUX_RA_HISTORY_H
+
+#include <linux/types.h>
+
+struct ra_history_extent {
+	__u64 start;		/* first page index */
+	__u64 len;		/* number of pages */
+};
+
+struct ra_history_args {
+	__u32 nr_extents;	/* in: room in extents, out: extents in set */
+	__u32 flags;		/* RA_HISTORY_* flags */
+	__u64 extents;		/* user pointer to struct ra_history_extent[] */
+};
+
+#define RA_HISTORY_STOP		0x00000001 /* GET: stop recording */
+#define RA_HISTORY_REPLAY_NOW	0x00000002 /* SET: read in now, not on open */
+
+#endif /* _LINUX_RA_HISTORY_H */
@@ -315,6 +315,9 @@ struct tcp_sock {
 	u32	rcv_tstamp;	/* timestamp of last received ACK (for keepalives) */
 	u32	lsndtime;	/* timestamp of last sent data packet (for restart window) */
 
+	unsigned long	tsq_flags;	/* TCP small queues state, see below */
+	struct list_head tsq_node;	/* anchor in tsq_tasklet.head list */
+
 	/* Data for direct copy to user */
 	struct {
 		struct sk_buff_head	prequeue;
@@ -461,6 +464,12 @@ struct tcp_sock {
 	struct tcp_cookie_values  *cookie_values;
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,		/* hit tcp_limit_output_bytes */
+	TSQ_QUEUED,		/* on the TSQ tasklet's list */
+	TCP_TSQ_DEFERRED,	/* tcp_tasklet_func() found socket was owned */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
@@ -32,6 +32,8 @@
 
 #define USB_CDC_PROTO_EEM			7
 
+#define USB_CDC_NCM_PROTO_NTB			1
+
 /*-------------------------------------------------------------------------*/
 
 /*
@@ -278,6 +280,13 @@ struct usb_cdc_notification {
  *
  */
 
+#define USB_CDC_NCM_NTB16_SUPPORTED	(1 << 0)
+#define USB_CDC_NCM_NTB32_SUPPORTED	(1 << 1)
+
+/* SET_NTB_FORMAT wValue */
+#define USB_CDC_NCM_NTB16_FORMAT	0x00
+#define USB_CDC_NCM_NTB32_FORMAT	0x01
+
 struct usb_cdc_ncm_ntb_parameter {
 	__le16	wLength;
 	__le16	bmNtbFormatSupported;
@@ -102,6 +102,7 @@ extern unsigned long vm_dirty_bytes;
 extern unsigned int dirty_writeback_interval;
 extern unsigned int dirty_expire_interval;
 extern unsigned int max_writeback_pages;
+extern unsigned int dirty_bdi_interval;
 extern int balance_dirty_pages_rate;
 extern int vm_highmem_is_dirtyable;
 extern int block_dump;
@@ -131,6 +132,10 @@ int dirty_writeback_centisecs_handler(struct ctl_table *, int,
 
 void get_dirty_limits(unsigned long *pbackground, unsigned long *pdirty,
 		      unsigned long *pbdi_dirty, struct backing_dev_info *bdi);
+unsigned long bdi_dirty_limit(struct backing_dev_info *bdi,
+			      unsigned long dirty);
+void bdi_update_bandwidth(struct backing_dev_info *bdi,
+			  unsigned long start_time);
 
 void page_writeback_init(void);
 void balance_dirty_pages_ratelimited_nr(struct address_space *mapping,
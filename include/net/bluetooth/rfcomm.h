@@ -37,7 +37,7 @@
 #define RFCOMM_MAX_L2CAP_MTU	1013
 #define RFCOMM_MAX_CREDITS	40
 
-#define RFCOMM_SKB_HEAD_RESERVE	8
+#define RFCOMM_SKB_HEAD_RESERVE	16	/* RFCOMM, L2CAP and ACL headers */
 #define RFCOMM_SKB_TAIL_RESERVE	2
 #define RFCOMM_SKB_RESERVE  (RFCOMM_SKB_HEAD_RESERVE + RFCOMM_SKB_TAIL_RESERVE)
 
@@ -26,13 +26,24 @@ nf_ct_ecache_find(const struct nf_conn *ct)
 	return nf_ct_ext_find(ct, NF_CT_EXT_ECACHE);
 }
 
+#ifdef CONFIG_NF_CONNTRACK_EVENTS
+extern bool nf_conntrack_event_listeners(struct net *net);
+#else
+static inline bool nf_conntrack_event_listeners(struct net *net)
+{
+	return false;
+}
+#endif
+
 static inline struct nf_conntrack_ecache *
 nf_ct_ecache_ext_add(struct nf_conn *ct, u16 ctmask, u16 expmask, gfp_t gfp)
 {
 	struct net *net = nf_ct_net(ct);
 	struct nf_conntrack_ecache *e;
 
-	if (!ctmask && !expmask && net->ct.sysctl_events) {
+	/* In compact mode, only while someone listens */
+	if (!ctmask && !expmask && net->ct.sysctl_events &&
+	    (!net->ct.sysctl_compact || nf_conntrack_event_listeners(net))) {
 		ctmask = ~0;
 		expmask = ~0;
 	}
@@ -57,6 +68,8 @@ struct nf_ct_event {
 
 struct nf_ct_event_notifier {
 	int (*fcn)(unsigned int events, struct nf_ct_event *item);
+	/* optional: false if no one would get the events of net */
+	bool (*has_listeners)(struct net *net);
 };
 
 extern struct nf_ct_event_notifier *nf_conntrack_event_cb;
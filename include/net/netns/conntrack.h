@@ -3,6 +3,7 @@
 
 #include <linux/list.h>
 #include <linux/list_nulls.h>
+#include <linux/workqueue.h>
 #include <asm/atomic.h>
 
 struct ctl_table_header;
@@ -18,6 +19,9 @@ struct netns_ct {
 	struct hlist_nulls_head	unconfirmed;
 	struct hlist_nulls_head	dying;
 	struct ip_conntrack_stat __percpu *stat;
+	struct delayed_work	gc_work;
+	unsigned int		gc_bucket;
+	int			sysctl_compact;
 	int			sysctl_events;
 	unsigned int		sysctl_events_retry_timeout;
 	int			sysctl_acct;
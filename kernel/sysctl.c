@@ -267,6 +267,9 @@ static int max_sched_shares_ratelimit = NSEC_PER_SEC; /* 1 second */
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+static int max_compact_daemon_order = MAX_ORDER - 1;
+/* Keeps the (2 * min_blocks) << order watermark within an unsigned long */
+static int max_compact_daemon_min_blocks = 65536;
 #endif
 
 static struct ctl_table kern_table[] = {
@@ -1053,6 +1056,14 @@ static struct ctl_table vm_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "dirty_bdi_centisecs",
+		.data		= &dirty_bdi_interval,
+		.maxlen		= sizeof(dirty_bdi_interval),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
 	{
 		.procname	= "max_writeback_pages",
 		.data		= &max_writeback_pages,
@@ -1166,6 +1177,40 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_daemon_order",
+		.data		= &sysctl_compact_daemon_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &max_compact_daemon_order,
+	},
+	{
+		.procname	= "compact_daemon_min_blocks",
+		.data		= &sysctl_compact_daemon_min_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &max_compact_daemon_min_blocks,
+	},
+	{
+		.procname	= "compact_daemon_budget_ms",
+		.data		= &sysctl_compact_daemon_budget_ms,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
+	{
+		.procname	= "compact_daemon_sleep_ms",
+		.data		= &sysctl_compact_daemon_sleep_ms,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 /*
@@ -38,8 +40,13 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	bool kcompactd;			/* Background compaction by kcompactd */
+	unsigned long deadline;		/* jiffies at which kcompactd yields */
 };
 
+static bool kcompactd_zone_needs_work(struct zone *zone);
+
 static unsigned long release_freepages(struct list_head *freelist)
 {
 	struct page *page, *next;
@@ -353,6 +360,19 @@ static int compact_finished(struct zone *zone,
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
 
+	/*
+	 * kcompactd: stop once the free block watermark is restored or the
+	 * CPU budget for this pass is used up. The scanner positions are
+	 * saved so the next pass continues from here.
+	 */
+	if (cc->kcompactd) {
+		if (time_after(jiffies, cc->deadline))
+			return COMPACT_PARTIAL;
+		if (!kcompactd_zone_needs_work(zone))
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	if (!zone_watermark_ok(zone, cc->order, watermark, 0, 0))
 		return COMPACT_CONTINUE;
@@ -378,10 +398,24 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 
+	unsigned long start_pfn = zone->zone_start_pfn;
+	unsigned long end_pfn = start_pfn + zone->spanned_pages;
+
 	/* Setup to move all movable pages to the end of the zone */
-	cc->migrate_pfn = zone->zone_start_pfn;
-	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
-	cc->free_pfn &= ~(pageblock_nr_pages-1);
+	cc->migrate_pfn = start_pfn;
+	cc->free_pfn = end_pfn & ~(pageblock_nr_pages-1);
+
+	/* kcompactd resumes an incremental run if the zone did not change */
+	if (cc->kcompactd && zone->compact_cached_free_pfn) {
+		unsigned long migrate_pfn = zone->compact_cached_migrate_pfn;
+		unsigned long free_pfn = zone->compact_cached_free_pfn;
+
+		if (migrate_pfn >= start_pfn && free_pfn < end_pfn &&
+						migrate_pfn < free_pfn) {
+			cc->migrate_pfn = migrate_pfn;
+			cc->free_pfn = free_pfn;
+		}
+	}
 
 	migrate_prep_local();
 
@@ -414,6 +448,16 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->kcompactd) {
+		if (ret == COMPACT_COMPLETE) {
+			zone->compact_cached_migrate_pfn = 0;
+			zone->compact_cached_free_pfn = 0;
+		} else {
+			zone->compact_cached_migrate_pfn = cc->migrate_pfn;
+			zone->compact_cached_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -582,6 +626,207 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Background compaction. When the number of free blocks of at least
+ * compact_daemon_order pages in a zone drops below compact_daemon_min_blocks,
+ * the node's kcompactd is woken to compact in increments of at most
+ * compact_daemon_budget_ms, sleeping compact_daemon_sleep_ms in between.
+ * An order of 0 disables it.
+ */
+int sysctl_compact_daemon_order = 2;
+int sysctl_compact_daemon_min_blocks = 64;
+int sysctl_compact_daemon_budget_ms = 10;
+int sysctl_compact_daemon_sleep_ms = 100;
+
+/* Sleep this many times longer after a full pass that did not help */
+#define KCOMPACTD_BACKOFF_SHIFT	5
+
+/* Number of free blocks of at least the given order, counted in that order */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long nr_blocks = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		nr_blocks += zone->free_area[o].nr_free << (o - order);
+
+	return nr_blocks;
+}
+
+/* Returns true if kcompactd should compact the zone */
+static bool kcompactd_zone_needs_work(struct zone *zone)
+{
+	int order = sysctl_compact_daemon_order;
+	unsigned long min_blocks = sysctl_compact_daemon_min_blocks;
+	unsigned long watermark;
+
+	if (!order || !populated_zone(zone))
+		return false;
+
+	if (zone_free_blocks(zone, order) >= min_blocks)
+		return false;
+
+	/*
+	 * If there is not enough free memory to build the blocks from, this
+	 * is a job for reclaim and compacting would only burn CPU. As with
+	 * direct compaction, leave room for the migration copies.
+	 */
+	watermark = low_wmark_pages(zone) + ((2UL * min_blocks) << order);
+	return zone_watermark_ok(zone, 0, watermark, 0, 0);
+}
+
+static bool kcompactd_node_needs_work(pg_data_t *pgdat)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++)
+		if (kcompactd_zone_needs_work(&pgdat->node_zones[zoneid]))
+			return true;
+
+	return false;
+}
+
+/*
+ * Compact the zones of a node that are short of free blocks. Returns true
+ * if some zone was scanned completely and is still short, in which case
+ * kcompactd backs off for a while.
+ */
+static bool kcompactd_do_work(pg_data_t *pgdat)
+{
+	unsigned long deadline;
+	bool backoff = false;
+	int zoneid;
+
+	deadline = jiffies + msecs_to_jiffies(sysctl_compact_daemon_budget_ms);
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = sysctl_compact_daemon_order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.kcompactd = true,
+			.deadline = deadline,
+		};
+		int ret;
+
+		if (!kcompactd_zone_needs_work(zone))
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		ret = compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (!kcompactd_zone_needs_work(zone)) {
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			count_vm_event(KCOMPACTD_STALL);
+			if (ret == COMPACT_COMPLETE)
+				backoff = true;
+		}
+
+		if (time_after(jiffies, deadline))
+			break;
+	}
+
+	return backoff;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned long timeout;
+
+		wait_event_freezable(pgdat->kcompactd_wait,
+				kcompactd_node_needs_work(pgdat) ||
+				kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		count_vm_event(KCOMPACTD_WAKE);
+		timeout = msecs_to_jiffies(sysctl_compact_daemon_sleep_ms);
+		if (kcompactd_do_work(pgdat))
+			timeout <<= KCOMPACTD_BACKOFF_SHIFT;
+
+		/* Give the CPU back between increments */
+		schedule_timeout_interruptible(timeout);
+	}
+
+	return 0;
+}
+
+/*
+ * Called from the page allocator when a zone fails its watermark check.
+ * Wakes the node's kcompactd if the zone is short of free blocks.
+ */
+void wakeup_kcompactd(struct zone *zone)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	if (!kcompactd_zone_needs_work(zone))
+		return;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * Started by init and node-hot-add, like kswapd.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
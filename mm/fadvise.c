@@ -115,6 +115,13 @@ SYSCALL_DEFINE(fadvise64_64)(int fd, loff_t offset, loff_t len, int advice)
 		break;
 	case POSIX_FADV_NOREUSE:
 		break;
+	case POSIX_FADV_RECORD_ACCESS:
+		if (!is_owner_or_cap(mapping->host)) {
+			ret = -EPERM;
+			break;
+		}
+		ret = ra_history_start(mapping);
+		break;
 	case POSIX_FADV_DONTNEED:
 		if (!bdi_write_congested(mapping->backing_dev_info))
 			filemap_flush(mapping);
@@ -989,6 +989,7 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 		unsigned long nr, ret;
 
 		cond_resched();
+		ra_history_record(mapping, index);
 find_page:
 		page = find_get_page(mapping, index);
 		if (!page) {
@@ -1526,6 +1527,8 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (offset >= size)
 		return VM_FAULT_SIGBUS;
 
+	ra_history_record(mapping, offset);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
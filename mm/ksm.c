@@ -26,6 +26,8 @@
 #include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
+#include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <linux/wait.h>
 #include <linux/slab.h>
 #include <linux/rbtree.h>
@@ -83,12 +85,16 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @pass: value of ksm_scan.passes when this mm was last scanned
+ * @inherited: VM_MERGEABLE was inherited across fork (e.g. from zygote)
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned long pass;
+	int inherited;
 };
 
 /**
@@ -97,6 +103,8 @@ struct mm_slot {
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
  * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @passes: count of passes over the mm list, also those which skipped every mm
+ * @pass_scanned: some mm has been scanned in the current pass
  *
  * There is only the one ksm_scan instance of this cursor structure.
  */
@@ -105,6 +113,8 @@ struct ksm_scan {
 	unsigned long address;
 	struct rmap_item **rmap_list;
 	unsigned long seqnr;
+	unsigned long passes;
+	int pass_scanned;
 };
 
 /**
@@ -112,11 +122,13 @@ struct ksm_scan {
  * @node: rb node of this ksm page in the stable tree
  * @hlist: hlist head of rmap_items using this ksm page
  * @kpfn: page frame number of this ksm page
+ * @checksum: checksum of the ksm page, primary key of the stable tree
  */
 struct stable_node {
 	struct rb_node node;
 	struct hlist_head hlist;
 	unsigned long kpfn;
+	unsigned int checksum;
 };
 
 /**
@@ -185,6 +197,24 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Percentage of cpu time which must have been idle for ksmd to scan */
+static unsigned int ksm_thread_idle_percent = 80;
+
+/* Scan mms which did not inherit MADV_MERGEABLE once in this many passes */
+static unsigned int ksm_uninherited_scan_ratio = 4;
+
+/*
+ * Upper bound for uninherited_scan_ratio: a skipped mm keeps unstable
+ * rmap_items whose seqnr age must still fit in SEQNR_MASK.
+ */
+#define KSM_MAX_SCAN_RATIO	16
+
+/* ksmd doubles its sleep, up to this shift, while the cpus are busy */
+#define KSM_MAX_BACKOFF_SHIFT	6
+
+/* The number of batches ksmd skipped because the cpus were busy */
+static unsigned long ksm_scans_deferred;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -571,7 +601,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		 * than left over from before.
 		 */
 		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
-		BUG_ON(age > 1);
+		BUG_ON(age > KSM_MAX_SCAN_RATIO);
 		if (!age)
 			rb_erase(&rmap_item->node, &root_unstable_tree);
 
@@ -965,7 +995,8 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
  * This function returns the stable tree node of identical content if found,
  * NULL otherwise.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page,
+				       unsigned int checksum)
 {
 	struct rb_node *node = root_stable_tree.rb_node;
 	struct stable_node *stable_node;
@@ -982,6 +1013,12 @@ static struct page *stable_tree_search(struct page *page)
 
 		cond_resched();
 		stable_node = rb_entry(node, struct stable_node, node);
+		if (checksum != stable_node->checksum) {
+			node = checksum < stable_node->checksum ?
+					node->rb_left : node->rb_right;
+			continue;
+		}
+
 		tree_page = get_ksm_page(stable_node);
 		if (!tree_page)
 			return NULL;
@@ -1013,6 +1050,10 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 	struct rb_node **new = &root_stable_tree.rb_node;
 	struct rb_node *parent = NULL;
 	struct stable_node *stable_node;
+	unsigned int checksum;
+
+	/* kpage is write-protected now, so its checksum will hold */
+	checksum = calc_checksum(kpage);
 
 	while (*new) {
 		struct page *tree_page;
@@ -1020,6 +1061,13 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 
 		cond_resched();
 		stable_node = rb_entry(*new, struct stable_node, node);
+		if (checksum != stable_node->checksum) {
+			parent = *new;
+			new = checksum < stable_node->checksum ?
+					&parent->rb_left : &parent->rb_right;
+			continue;
+		}
+
 		tree_page = get_ksm_page(stable_node);
 		if (!tree_page)
 			return NULL;
@@ -1052,6 +1100,7 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 	INIT_HLIST_HEAD(&stable_node->hlist);
 
 	stable_node->kpfn = page_to_pfn(kpage);
+	stable_node->checksum = checksum;
 	set_page_stable_node(kpage, stable_node);
 
 	return stable_node;
@@ -1069,7 +1118,9 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
  * to the currently scanned page, NULL otherwise.
  *
  * This function does both searching and inserting, because they share
- * the same walking algorithm in an rbtree.
+ * the same walking algorithm in an rbtree.  The tree is ordered first by
+ * the checksum each rmap_item had when inserted, so the page contents are
+ * only compared against nodes which could possibly be identical.
  */
 static
 struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
@@ -1087,6 +1138,14 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 
 		cond_resched();
 		tree_rmap_item = rb_entry(*new, struct rmap_item, node);
+		if (rmap_item->oldchecksum != tree_rmap_item->oldchecksum) {
+			parent = *new;
+			new = rmap_item->oldchecksum <
+					tree_rmap_item->oldchecksum ?
+					&parent->rb_left : &parent->rb_right;
+			continue;
+		}
+
 		tree_page = get_mergeable_page(tree_rmap_item);
 		if (IS_ERR_OR_NULL(tree_page))
 			return NULL;
@@ -1161,8 +1220,14 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 
 	remove_rmap_item_from_tree(rmap_item);
 
+	/*
+	 * The checksum orders both trees, so that a full memcmp_pages()
+	 * is only needed against nodes whose checksum matches this page.
+	 */
+	checksum = calc_checksum(page);
+
 	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	kpage = stable_tree_search(page, checksum);
 	if (kpage) {
 		err = try_to_merge_with_ksm_page(rmap_item, page, kpage);
 		if (!err) {
@@ -1184,7 +1249,6 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -1254,6 +1318,34 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Mms which inherited MADV_MERGEABLE across fork - on Android, the apps
+ * forked from zygote sharing its Dalvik heap - are where merging pays off,
+ * so only visit the others once in ksm_uninherited_scan_ratio full scans.
+ * A newly entered mm, or one which is exiting, is never passed over.
+ */
+static int ksm_skip_mm_slot(struct mm_slot *slot)
+{
+	if (slot->inherited || ksm_uninherited_scan_ratio <= 1)
+		return 0;
+	if (!slot->rmap_list || ksm_test_exit(slot->mm))
+		return 0;
+	return ksm_scan.passes - slot->pass < ksm_uninherited_scan_ratio;
+}
+
+/*
+ * The cursor is back at ksm_mm_head.  That completes a full scan unless
+ * every mm was passed over, which only counts towards the next visit of
+ * the uninherited mms.
+ */
+static void ksm_end_pass(void)
+{
+	if (ksm_scan.pass_scanned)
+		ksm_scan.seqnr++;
+	ksm_scan.pass_scanned = 0;
+	ksm_scan.passes++;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1273,6 +1365,19 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		ksm_scan.mm_slot = slot;
 		spin_unlock(&ksm_mmlist_lock);
 next_mm:
+		if (ksm_skip_mm_slot(slot)) {
+			spin_lock(&ksm_mmlist_lock);
+			slot = list_entry(slot->mm_list.next,
+						struct mm_slot, mm_list);
+			ksm_scan.mm_slot = slot;
+			spin_unlock(&ksm_mmlist_lock);
+			if (slot != &ksm_mm_head)
+				goto next_mm;
+			ksm_end_pass();
+			return NULL;
+		}
+		slot->pass = ksm_scan.passes;
+		ksm_scan.pass_scanned = 1;
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
 	}
@@ -1358,7 +1463,7 @@ next_mm:
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
-	ksm_scan.seqnr++;
+	ksm_end_pass();
 	return NULL;
 }
 
@@ -1387,19 +1492,91 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+static u64 ksm_cpu_idle_time(int cpu, u64 *wall)
+{
+	u64 idle = get_cpu_idle_time_us(cpu, wall);
+	cputime64_t busy;
+	u64 now;
+
+	if (idle != -1ULL)
+		return idle;
+
+	/* No NO_HZ idle accounting: fall back to the tick based stats */
+	busy = cputime64_add(kstat_cpu(cpu).cpustat.user,
+			     kstat_cpu(cpu).cpustat.nice);
+	busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.system);
+	busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.irq);
+	busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.softirq);
+	busy = cputime64_add(busy, kstat_cpu(cpu).cpustat.steal);
+	now = get_jiffies_64();
+	idle = now - cputime64_to_jiffies64(busy);
+	*wall = now * (USEC_PER_SEC / HZ);
+	return idle * (USEC_PER_SEC / HZ);
+}
+
+/*
+ * ksm_cpus_idle - have the cpus been idle enough since the last call
+ * for ksmd to scan without getting in the way of interactive tasks?
+ * ksmd's own run time is counted as idle, or it would only defer itself.
+ * Only called from ksmd.
+ */
+static int ksm_cpus_idle(void)
+{
+	static u64 prev_idle, prev_wall, prev_self;
+	u64 idle = 0, wall = 0, self;
+	u64 delta_idle, delta_wall;
+	int cpu, ret;
+
+	if (!ksm_thread_idle_percent)
+		return 1;
+
+	for_each_online_cpu(cpu) {
+		u64 cpu_wall;
+
+		idle += ksm_cpu_idle_time(cpu, &cpu_wall);
+		wall += cpu_wall;
+	}
+	self = current->se.sum_exec_runtime;
+	do_div(self, NSEC_PER_USEC);
+
+	/* Nothing to go on yet, or a cpu went offline: wait for more */
+	if (wall <= prev_wall || idle < prev_idle)
+		ret = 0;
+	else {
+		delta_wall = wall - prev_wall;
+		delta_idle = idle - prev_idle + (self - prev_self);
+		ret = delta_idle * 100 >= delta_wall * ksm_thread_idle_percent;
+	}
+
+	prev_idle = idle;
+	prev_wall = wall;
+	prev_self = self;
+	return ret;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
+	unsigned int backoff = 0;
+
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			if (ksm_cpus_idle()) {
+				ksm_do_scan(ksm_thread_pages_to_scan);
+				backoff = 0;
+			} else {
+				ksm_scans_deferred++;
+				if (backoff < KSM_MAX_BACKOFF_SHIFT)
+					backoff++;
+			}
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(msecs_to_jiffies(
+				ksm_thread_sleep_millisecs << backoff));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1426,7 +1603,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
-			err = __ksm_enter(mm);
+			err = __ksm_enter(mm, 0);
 			if (err)
 				return err;
 		}
@@ -1451,7 +1628,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
-int __ksm_enter(struct mm_struct *mm)
+int __ksm_enter(struct mm_struct *mm, int inherited)
 {
 	struct mm_slot *mm_slot;
 	int needs_wakeup;
@@ -1459,6 +1636,7 @@ int __ksm_enter(struct mm_struct *mm)
 	mm_slot = alloc_mm_slot();
 	if (!mm_slot)
 		return -ENOMEM;
+	mm_slot->inherited = inherited;
 
 	/* Check ksm_run too?  Would need tighter locking */
 	needs_wakeup = list_empty(&ksm_mm_head.mm_list);
@@ -1823,6 +2001,53 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t idle_percent_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_idle_percent);
+}
+
+static ssize_t idle_percent_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	unsigned long percent;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent > 100)
+		return -EINVAL;
+
+	ksm_thread_idle_percent = percent;
+
+	return count;
+}
+KSM_ATTR(idle_percent);
+
+static ssize_t uninherited_scan_ratio_show(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_uninherited_scan_ratio);
+}
+
+static ssize_t uninherited_scan_ratio_store(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    const char *buf, size_t count)
+{
+	int err;
+	unsigned long ratio;
+
+	err = strict_strtoul(buf, 10, &ratio);
+	if (err || !ratio || ratio > KSM_MAX_SCAN_RATIO)
+		return -EINVAL;
+
+	ksm_uninherited_scan_ratio = ratio;
+
+	return count;
+}
+KSM_ATTR(uninherited_scan_ratio);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1915,15 +2140,25 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t scans_deferred_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_scans_deferred);
+}
+KSM_ATTR_RO(scans_deferred);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&idle_percent_attr.attr,
+	&uninherited_scan_ratio_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&scans_deferred_attr.attr,
 	NULL,
 };
 
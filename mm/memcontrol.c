@@ -47,6 +47,7 @@
 #include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
+#include <linux/hrtimer.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -87,6 +88,10 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
 	MEM_CGROUP_STAT_SWAPOUT, /* # of pages, swapped out */
 	MEM_CGROUP_EVENTS,	/* incremented at every  pagein/pageout */
+	MEM_CGROUP_STAT_RECLAIM_RUNS,	/* # of reclaim passes on this group */
+	MEM_CGROUP_STAT_RECLAIM_SCANNED, /* # of pages scanned by them */
+	MEM_CGROUP_STAT_RECLAIM_RECLAIMED, /* # of pages reclaimed by them */
+	MEM_CGROUP_STAT_RECLAIM_TIME,	/* time spent in them, in usecs */
 
 	MEM_CGROUP_STAT_NSTATS,
 };
@@ -547,6 +552,22 @@ static s64 mem_cgroup_local_usage(struct mem_cgroup *mem)
 	return ret;
 }
 
+static void mem_cgroup_reclaim_statistics(struct mem_cgroup *mem,
+					 unsigned long nr_scanned,
+					 unsigned long nr_reclaimed,
+					 ktime_t elapsed)
+{
+	preempt_disable();
+	__this_cpu_inc(mem->stat->count[MEM_CGROUP_STAT_RECLAIM_RUNS]);
+	__this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_RECLAIM_SCANNED],
+			nr_scanned);
+	__this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_RECLAIM_RECLAIMED],
+			nr_reclaimed);
+	__this_cpu_add(mem->stat->count[MEM_CGROUP_STAT_RECLAIM_TIME],
+			ktime_to_us(elapsed));
+	preempt_enable();
+}
+
 static void mem_cgroup_swap_statistics(struct mem_cgroup *mem,
 					 bool charge)
 {
@@ -1220,6 +1241,8 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 	bool shrink = reclaim_options & MEM_CGROUP_RECLAIM_SHRINK;
 	bool check_soft = reclaim_options & MEM_CGROUP_RECLAIM_SOFT;
 	unsigned long excess = mem_cgroup_get_excess(root_mem);
+	unsigned long nr_scanned;
+	ktime_t start;
 
 	/* If memsw_is_minimum==1, swap-out is of-no-use. */
 	if (root_mem->memsw_is_minimum)
@@ -1260,13 +1283,17 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 			continue;
 		}
 		/* we use swappiness of local cgroup */
+		start = ktime_get();
 		if (check_soft)
 			ret = mem_cgroup_shrink_node_zone(victim, gfp_mask,
 				noswap, get_swappiness(victim), zone,
-				zone->zone_pgdat->node_id);
+				zone->zone_pgdat->node_id, &nr_scanned);
 		else
 			ret = try_to_free_mem_cgroup_pages(victim, gfp_mask,
-						noswap, get_swappiness(victim));
+						noswap, get_swappiness(victim),
+						&nr_scanned);
+		mem_cgroup_reclaim_statistics(victim, nr_scanned, ret,
+					ktime_sub(ktime_get(), start));
 		css_put(&victim->css);
 		/*
 		 * At shrinking usage, we can't check we should stop here or
@@ -2801,7 +2828,7 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	struct mem_cgroup_tree_per_zone *mctz;
 	unsigned long long excess;
 
-	if (order > 0)
+	if (order > 0 || mem_cgroup_disabled())
 		return 0;
 
 	mctz = soft_limit_tree_node_zone(nid, zid);
@@ -3000,6 +3027,7 @@ try_to_free:
 	/* try to free all pages in this cgroup */
 	shrink = 1;
 	while (nr_retries && mem->res.usage > 0) {
+		unsigned long nr_scanned;
 		int progress;
 
 		if (signal_pending(current)) {
@@ -3007,7 +3035,8 @@ try_to_free:
 			goto out;
 		}
 		progress = try_to_free_mem_cgroup_pages(mem, GFP_KERNEL,
-						false, get_swappiness(mem));
+						false, get_swappiness(mem),
+						&nr_scanned);
 		if (!progress) {
 			nr_retries--;
 			/* maybe some writeback is necessary */
@@ -3291,6 +3320,10 @@ enum {
 	MCS_INACTIVE_FILE,
 	MCS_ACTIVE_FILE,
 	MCS_UNEVICTABLE,
+	MCS_RECLAIM_RUNS,
+	MCS_RECLAIM_SCANNED,
+	MCS_RECLAIM_RECLAIMED,
+	MCS_RECLAIM_TIME,
 	NR_MCS_STAT,
 };
 
@@ -3312,7 +3345,11 @@ struct {
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
 	{"active_file", "total_active_file"},
-	{"unevictable", "total_unevictable"}
+	{"unevictable", "total_unevictable"},
+	{"reclaim_runs", "total_reclaim_runs"},
+	{"reclaim_scanned", "total_reclaim_scanned"},
+	{"reclaim_reclaimed", "total_reclaim_reclaimed"},
+	{"reclaim_time_us", "total_reclaim_time_us"}
 };
 
 
@@ -3348,6 +3385,16 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 	s->stat[MCS_ACTIVE_FILE] += val * PAGE_SIZE;
 	val = mem_cgroup_get_local_zonestat(mem, LRU_UNEVICTABLE);
 	s->stat[MCS_UNEVICTABLE] += val * PAGE_SIZE;
+
+	/* reclaim performed on this group */
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RECLAIM_RUNS);
+	s->stat[MCS_RECLAIM_RUNS] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RECLAIM_SCANNED);
+	s->stat[MCS_RECLAIM_SCANNED] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RECLAIM_RECLAIMED);
+	s->stat[MCS_RECLAIM_RECLAIMED] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RECLAIM_TIME);
+	s->stat[MCS_RECLAIM_TIME] += val;
 	return 0;
 }
 
@@ -28,6 +28,8 @@
 #include <linux/notifier.h>
 #include <linux/memcontrol.h>
 #include <linux/security.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 
 int sysctl_panic_on_oom;
 int sysctl_oom_kill_allocating_task;
@@ -415,8 +417,176 @@ static void __oom_kill_task(struct task_struct *p, int verbose)
 	set_tsk_thread_flag(p, TIF_MEMDIE);
 
 	force_sig(SIGKILL, p);
+	mm_reap_task(p);
 }
 
+#ifdef CONFIG_MMU
+/*
+ * A killed task only gives its memory back once exit_mmap() has torn
+ * down every vma, which may be long after the kill while the allocation
+ * which asked for the kill keeps stalling.  The mm reaper frees the
+ * anonymous memory of such an mm ahead of that, in the way that
+ * madvise(MADV_DONTNEED) would, leaving the vmas themselves to exit.
+ */
+static DEFINE_SPINLOCK(mm_reap_lock);
+static struct mm_struct *mm_reap_list;
+static DECLARE_WAIT_QUEUE_HEAD(mm_reap_wait);
+static struct task_struct *mm_reaper_thread;
+
+#define MM_REAP_RETRIES	10
+
+/*
+ * Is mm used by a task which is not dying with the owner, such as the
+ * parent of a vfork?  Then its memory must be left alone.
+ */
+static bool mm_has_live_users(struct mm_struct *mm)
+{
+	struct task_struct *g, *p;
+	bool ret = false;
+
+	rcu_read_lock();
+	do_each_thread(g, p) {
+		if (p->mm == mm && !fatal_signal_pending(p) &&
+		    !(p->flags & PF_EXITING)) {
+			ret = true;
+			goto out;
+		}
+	} while_each_thread(g, p);
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
+/*
+ * Zap the private anonymous vmas of mm, a vma at a time, each through
+ * one mmu_gather batch.  Returns false if mmap_sem was not available.
+ */
+static bool mm_reap_anon(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return false;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB |
+				     VM_PFNMAP | VM_NONLINEAR))
+			continue;
+		if (!vma->anon_vma)
+			continue;
+		zap_page_range(vma, vma->vm_start,
+			       vma->vm_end - vma->vm_start, NULL);
+		cond_resched();
+	}
+
+	up_read(&mm->mmap_sem);
+	return true;
+}
+
+static void mm_reap(struct mm_struct *mm)
+{
+	unsigned long anon;
+	int retries = 0;
+
+	/* Already gone through exit_mmap(): nothing left to do */
+	if (!atomic_inc_not_zero(&mm->mm_users))
+		return;
+
+	if (mm->core_state || mm_has_live_users(mm))
+		goto skip;
+
+	anon = get_mm_counter(mm, MM_ANONPAGES);
+	while (!mm_reap_anon(mm)) {
+		if (++retries > MM_REAP_RETRIES)
+			goto skip;
+		schedule_timeout_uninterruptible(msecs_to_jiffies(10));
+	}
+
+	anon -= min(anon, (unsigned long)get_mm_counter(mm, MM_ANONPAGES));
+	count_vm_event(MM_REAP);
+	count_vm_events(MM_REAP_PAGES, anon);
+	count_vm_events(MM_REAP_USECS, ktime_to_us(ktime_sub(ktime_get(),
+						mm->reap_queued)));
+	mmput(mm);
+	return;
+
+skip:
+	/* Not reaped: let a later kill queue it again */
+	count_vm_event(MM_REAP_SKIP);
+	clear_bit(MMF_REAP_QUEUED, &mm->flags);
+	mmput(mm);
+}
+
+static int mm_reaper(void *unused)
+{
+	struct mm_struct *mm;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(mm_reap_wait,
+			mm_reap_list || kthread_should_stop());
+
+		spin_lock(&mm_reap_lock);
+		mm = mm_reap_list;
+		if (mm)
+			mm_reap_list = mm->reap_next;
+		spin_unlock(&mm_reap_lock);
+		if (!mm)
+			continue;
+
+		mm_reap(mm);
+		mmdrop(mm);
+	}
+	return 0;
+}
+
+/**
+ * mm_reap_task - free the anonymous memory of a killed task early
+ * @p: task which has just been sent SIGKILL
+ *
+ * Queue the mm of @p for the mm reaper.  May be called with
+ * tasklist_lock held; takes task_lock(p).
+ */
+void mm_reap_task(struct task_struct *p)
+{
+	struct mm_struct *mm;
+
+	if (!mm_reaper_thread)
+		return;
+
+	task_lock(p);
+	mm = p->mm;
+	if (!mm || (p->flags & PF_KTHREAD) ||
+	    test_and_set_bit(MMF_REAP_QUEUED, &mm->flags)) {
+		task_unlock(p);
+		return;
+	}
+	atomic_inc(&mm->mm_count);
+	task_unlock(p);
+
+	mm->reap_queued = ktime_get();
+	spin_lock(&mm_reap_lock);
+	mm->reap_next = mm_reap_list;
+	mm_reap_list = mm;
+	spin_unlock(&mm_reap_lock);
+
+	wake_up(&mm_reap_wait);
+}
+
+static int __init mm_reaper_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(mm_reaper, NULL, "mm_reaper");
+	if (IS_ERR(tsk)) {
+		printk(KERN_ERR "mm_reaper: creating kthread failed\n");
+		return PTR_ERR(tsk);
+	}
+	mm_reaper_thread = tsk;
+	return 0;
+}
+subsys_initcall(mm_reaper_init);
+#endif /* CONFIG_MMU */
+
 static int oom_kill_task(struct task_struct *p)
 {
 	/* WARNING: mm may not be dereferenced since we did not obtain its
@@ -102,6 +102,12 @@ unsigned int dirty_expire_interval = 30 * 100; /* centiseconds */
  */
 unsigned int max_writeback_pages = 1024;
 
+/*
+ * A backing device may hold at most this much of its measured write
+ * bandwidth in dirty and writeback pages. 0 disables the limit.
+ */
+unsigned int dirty_bdi_interval = 3 * 100; /* centiseconds */
+
 /*
  * Flag that makes the call to balance_dirty_pages function or rely on writeback
  * to write dirty pages back only.
@@ -247,6 +253,7 @@ void handle_dirty_ctrl_dev(const char *dev)
  */
 static inline void __bdi_writeout_inc(struct backing_dev_info *bdi)
 {
+	__inc_bdi_stat(bdi, BDI_WRITTEN);
 	__prop_inc_percpu_max(&vm_completions, &bdi->completions,
 			      bdi->max_prop_frac);
 }
@@ -484,25 +491,154 @@ get_dirty_limits(unsigned long *pbackground, unsigned long *pdirty,
 	*pdirty = dirty;
 
 	if (bdi) {
-		u64 bdi_dirty;
-		long numerator, denominator;
+		*pbdi_dirty = bdi_dirty_limit(bdi, dirty);
+		clip_bdi_dirty_limit(bdi, dirty, pbdi_dirty);
+		task_dirty_limit(current, pbdi_dirty);
+	}
+}
 
-		/*
-		 * Calculate this BDI's share of the dirty ratio.
-		 */
-		bdi_writeout_fraction(bdi, &numerator, &denominator);
+/*
+ * The number of dirty and writeback pages @bdi can get through in
+ * dirty_bdi_interval at its estimated write bandwidth, or ULONG_MAX if
+ * there is no such limit. The result never drops below 1/16 of @dirty,
+ * so that the device is kept busy enough for the estimate to recover
+ * from a quiet period.
+ */
+static unsigned long bdi_bandwidth_limit(struct backing_dev_info *bdi,
+					 unsigned long dirty)
+{
+	u64 limit;
 
-		bdi_dirty = (dirty * (100 - bdi_min_ratio)) / 100;
-		bdi_dirty *= numerator;
-		do_div(bdi_dirty, denominator);
-		bdi_dirty += (dirty * bdi->min_ratio) / 100;
-		if (bdi_dirty > (dirty * bdi->max_ratio) / 100)
-			bdi_dirty = dirty * bdi->max_ratio / 100;
+	if (!dirty_bdi_interval || !bdi_cap_writeback_dirty(bdi))
+		return ULONG_MAX;
 
-		*pbdi_dirty = bdi_dirty;
-		clip_bdi_dirty_limit(bdi, dirty, pbdi_dirty);
-		task_dirty_limit(current, pbdi_dirty);
+	limit = (u64)bdi->avg_write_bandwidth * dirty_bdi_interval;
+	do_div(limit, 100);
+
+	return max_t(u64, limit, dirty / 16);
+}
+
+/**
+ * bdi_dirty_limit - @bdi's share of dirty throttling threshold
+ * @bdi: the backing_dev_info to query
+ * @dirty: global dirty limit in pages
+ *
+ * The share is proportional to the bdi's recent writeout completions,
+ * adjusted by its min_ratio/max_ratio, and capped to what the bdi can
+ * write out in dirty_bdi_interval. So a slow SD card does not get to
+ * sit on hundreds of MB just because it is the only device writing.
+ */
+unsigned long bdi_dirty_limit(struct backing_dev_info *bdi,
+			      unsigned long dirty)
+{
+	u64 bdi_dirty;
+	long numerator, denominator;
+
+	/*
+	 * Calculate this BDI's share of the dirty ratio.
+	 */
+	bdi_writeout_fraction(bdi, &numerator, &denominator);
+
+	bdi_dirty = (dirty * (100 - bdi_min_ratio)) / 100;
+	bdi_dirty *= numerator;
+	do_div(bdi_dirty, denominator);
+	bdi_dirty += (dirty * bdi->min_ratio) / 100;
+	if (bdi_dirty > (dirty * bdi->max_ratio) / 100)
+		bdi_dirty = dirty * bdi->max_ratio / 100;
+
+	return min_t(u64, bdi_dirty, bdi_bandwidth_limit(bdi, dirty));
+}
+
+/*
+ * Write bandwidth estimation. Both balance_dirty_pages() and the flusher
+ * sample the number of pages the bdi has completed, at most once every
+ * BANDWIDTH_INTERVAL, and fold it into a running average over ~3s.
+ */
+#define BANDWIDTH_INTERVAL	max(HZ/5, 1)
+
+/*
+ * Longest single pause of a task that is below its bdi limit.
+ */
+#define MAX_PAUSE		max(HZ/5, 1)
+
+static DEFINE_SPINLOCK(bdi_bandwidth_lock);
+
+static void bdi_update_write_bandwidth(struct backing_dev_info *bdi,
+				       unsigned long elapsed,
+				       unsigned long written)
+{
+	const unsigned long period = roundup_pow_of_two(3 * HZ);
+	unsigned long avg = bdi->avg_write_bandwidth;
+	unsigned long old = bdi->write_bandwidth;
+	u64 bw;
+
+	/*
+	 * bw = written * HZ / elapsed
+	 *
+	 *                   bw * elapsed + write_bandwidth * (period - elapsed)
+	 * write_bandwidth = ---------------------------------------------------
+	 *                                          period
+	 */
+	bw = written - bdi->written_stamp;
+	bw *= HZ;
+	if (unlikely(elapsed > period)) {
+		do_div(bw, elapsed);
+		avg = bw;
+		goto out;
 	}
+	bw += (u64)bdi->write_bandwidth * (period - elapsed);
+	bw >>= ilog2(period);
+
+	/*
+	 * one more level of smoothing, for filtering out sudden spikes
+	 */
+	if (avg > old && old >= (unsigned long)bw)
+		avg -= (avg - old) >> 3;
+
+	if (avg < old && old <= (unsigned long)bw)
+		avg += (old - avg) >> 3;
+
+out:
+	bdi->write_bandwidth = bw;
+	bdi->avg_write_bandwidth = avg;
+}
+
+/**
+ * bdi_update_bandwidth - refresh the write bandwidth estimate of @bdi
+ * @bdi: the backing_dev_info that is being written to
+ * @start_time: when the caller started writing or waiting on @bdi
+ *
+ * Quiet periods, with more than a second since the last sample and that
+ * sample older than @start_time, are skipped rather than being counted as
+ * a slow device.
+ */
+void bdi_update_bandwidth(struct backing_dev_info *bdi,
+			  unsigned long start_time)
+{
+	unsigned long now = jiffies;
+	unsigned long elapsed = now - bdi->bw_time_stamp;
+	unsigned long written;
+
+	if (elapsed < BANDWIDTH_INTERVAL)
+		return;
+
+	spin_lock(&bdi_bandwidth_lock);
+	elapsed = now - bdi->bw_time_stamp;
+	if (elapsed < BANDWIDTH_INTERVAL)
+		goto unlock;
+
+	written = percpu_counter_read(&bdi->bdi_stat[BDI_WRITTEN]);
+
+	if (elapsed > HZ && time_before(bdi->bw_time_stamp, start_time))
+		goto snapshot;
+
+	bdi_update_write_bandwidth(bdi, elapsed, written);
+
+snapshot:
+	bdi->written_stamp = written;
+	bdi->bw_time_stamp = now;
+unlock:
+	spin_unlock(&bdi_bandwidth_lock);
 }
 
 /*
@@ -511,16 +647,26 @@ get_dirty_limits(unsigned long *pbackground, unsigned long *pdirty,
  * the caller to perform writeback if the system is over `vm_dirty_ratio'.
  * If we're over `background_thresh' then the writeback threads are woken to
  * perform some writeout.
+ *
+ * Short of the bdi limit, the caller is paused in proportion to what it has
+ * dirtied rather than stopped: within the last 1/8 below the limit it may
+ * dirty at the bdi's write bandwidth, scaled down to nothing at the limit.
+ * So writers slow down smoothly as the bdi fills, instead of running freely
+ * and then stalling on the limit.
  */
 static void balance_dirty_pages(struct address_space *mapping,
-				unsigned long write_chunk)
+				unsigned long pages_dirtied)
 {
 	long nr_reclaimable, bdi_nr_reclaimable;
 	long nr_writeback, bdi_nr_writeback;
 	unsigned long background_thresh;
 	unsigned long dirty_thresh;
 	unsigned long bdi_thresh;
+	unsigned long bdi_dirty;
+	unsigned long limit, span;
+	unsigned long write_chunk = sync_writeback_pages(pages_dirtied);
 	unsigned long pages_written = 0;
+	unsigned long start_time = jiffies;
 	unsigned long pause = 1;
 
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
@@ -540,21 +686,70 @@ static void balance_dirty_pages(struct address_space *mapping,
 					global_page_state(NR_UNSTABLE_NFS);
 		nr_writeback = global_page_state(NR_WRITEBACK);
 
-		bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
-		bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
-
-		if (bdi_nr_reclaimable + bdi_nr_writeback <= bdi_thresh)
-			break;
+		/*
+		 * In order to avoid the stacked BDI deadlock we need
+		 * to ensure we accurately count the 'dirty' pages when
+		 * the threshold is low.
+		 *
+		 * Otherwise it would be possible to get thresh+n pages
+		 * reported dirty, even though there are thresh-m pages
+		 * actually dirty; with m+n sitting in the percpu
+		 * deltas.
+		 */
+		if (bdi_thresh < 2*bdi_stat_error(bdi)) {
+			bdi_nr_reclaimable = bdi_stat_sum(bdi, BDI_RECLAIMABLE);
+			bdi_nr_writeback = bdi_stat_sum(bdi, BDI_WRITEBACK);
+		} else {
+			bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
+			bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
+		}
+		bdi_dirty = bdi_nr_reclaimable + bdi_nr_writeback;
 
 		/*
-		 * Throttle it only when the background writeback cannot
-		 * catch-up. This avoids (excessively) small writeouts
-		 * when the bdi limits are ramping up.
+		 * Throttle against the bdi share only when the background
+		 * writeback cannot catch-up. This avoids (excessively)
+		 * small writeouts when the bdi limits are ramping up.
+		 * The bandwidth limit applies regardless, so that a slow
+		 * device cannot soak up the whole of the dirty budget.
 		 */
 		if (nr_reclaimable + nr_writeback <
 				(background_thresh + dirty_thresh) / 2)
+			limit = bdi_bandwidth_limit(bdi, dirty_thresh);
+		else
+			limit = bdi_thresh;
+
+		span = limit / 8 + 1;
+		if (bdi_dirty + span <= limit)
 			break;
 
+		bdi_update_bandwidth(bdi, start_time);
+
+		if (bdi_dirty < limit) {
+			u64 ratelimit;
+			u64 delay;
+
+			if (!writeback_in_progress(bdi))
+				bdi_start_background_writeback(bdi);
+
+			/*
+			 * pages per second this task may dirty: the write
+			 * bandwidth at limit - span, down to 0 at limit
+			 */
+			ratelimit = (u64)bdi->avg_write_bandwidth *
+					(limit - bdi_dirty);
+			do_div(ratelimit, span);
+			ratelimit++;
+
+			delay = (u64)pages_dirtied * HZ + ratelimit / 2;
+			delay = div64_u64(delay, ratelimit);
+			pause = min_t(u64, delay, MAX_PAUSE);
+			if (pause) {
+				__set_current_state(TASK_INTERRUPTIBLE);
+				io_schedule_timeout(pause);
+			}
+			break;
+		}
+
 		if (!bdi->dirty_exceeded)
 			bdi->dirty_exceeded = 1;
 
@@ -567,33 +762,11 @@ static void balance_dirty_pages(struct address_space *mapping,
 		 * threshold otherwise wait until the disk writes catch
 		 * up.
 		 */
-		if (bdi_nr_reclaimable > bdi_thresh) {
+		if (bdi_nr_reclaimable > limit) {
 			writeback_inodes_wb(&bdi->wb, &wbc);
 			pages_written += write_chunk - wbc.nr_to_write;
-			get_dirty_limits(&background_thresh, &dirty_thresh,
-				       &bdi_thresh, bdi);
 		}
 
-		/*
-		 * In order to avoid the stacked BDI deadlock we need
-		 * to ensure we accurately count the 'dirty' pages when
-		 * the threshold is low.
-		 *
-		 * Otherwise it would be possible to get thresh+n pages
-		 * reported dirty, even though there are thresh-m pages
-		 * actually dirty; with m+n sitting in the percpu
-		 * deltas.
-		 */
-		if (bdi_thresh < 2*bdi_stat_error(bdi)) {
-			bdi_nr_reclaimable = bdi_stat_sum(bdi, BDI_RECLAIMABLE);
-			bdi_nr_writeback = bdi_stat_sum(bdi, BDI_WRITEBACK);
-		} else if (bdi_nr_reclaimable) {
-			bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
-			bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
-		}
-
-		if (bdi_nr_reclaimable + bdi_nr_writeback <= bdi_thresh)
-			break;
 		if (pages_written >= write_chunk)
 			break;		/* We've done our duty */
 
@@ -609,8 +782,7 @@ static void balance_dirty_pages(struct address_space *mapping,
 			pause = HZ / 10;
 	}
 
-	if (bdi_nr_reclaimable + bdi_nr_writeback < bdi_thresh &&
-			bdi->dirty_exceeded)
+	if (bdi_dirty < limit && bdi->dirty_exceeded)
 		bdi->dirty_exceeded = 0;
 
 	if (writeback_in_progress(bdi))
@@ -675,7 +847,7 @@ void balance_dirty_pages_ratelimited_nr(struct address_space *mapping,
 	p =  &__get_cpu_var(bdp_ratelimits);
 	*p += nr_pages_dirtied;
 	if (unlikely(*p >= ratelimit)) {
-		ratelimit = sync_writeback_pages(*p);
+		ratelimit = *p;
 		*p = 0;
 		preempt_enable();
 		balance_dirty_pages(mapping, ratelimit);
@@ -17,6 +17,12 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/file.h>
+#include <linux/workqueue.h>
+#include <linux/ra_history.h>
+#include <asm/uaccess.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -568,3 +574,328 @@ page_cache_async_readahead(struct address_space *mapping,
 #endif
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_HISTORY
+/*
+ * Readahead history: the set of pages of a file that was read while it was
+ * being recorded (typically during an application launch). Userspace saves
+ * it and hands it back later, and the next open of the file then reads
+ * those pages in with a few large sorted requests, instead of faulting them
+ * in one small synchronous read at a time.
+ */
+
+/* Files larger than this only have their head recorded (128MB of 4K pages) */
+#define RA_HISTORY_MAX_PAGES	32768
+/* Most extents accepted by FS_IOC_SET_RA_HISTORY */
+#define RA_HISTORY_MAX_EXTENTS	1024
+/* Holes up to this many pages are read as well to keep requests large */
+#define RA_HISTORY_MERGE_GAP	8
+
+struct ra_history {
+	spinlock_t lock;			/* protects replay, nr_replay */
+	struct ra_history_extent *replay;	/* read in on next open */
+	unsigned int nr_replay;
+	int recording;
+	unsigned long nr_pages;			/* bits in accessed */
+	unsigned long accessed[0];
+};
+
+/*
+ * The history stays attached to the mapping until the inode is destroyed,
+ * so the record and replay hooks can use it without taking a reference.
+ */
+static struct ra_history *ra_history_attach(struct address_space *mapping)
+{
+	struct ra_history *h = mapping->ra_history;
+	unsigned long nr_pages;
+
+	if (h)
+		return h;
+
+	nr_pages = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+							PAGE_CACHE_SHIFT;
+	nr_pages = clamp_t(unsigned long, nr_pages, 1, RA_HISTORY_MAX_PAGES);
+
+	h = kzalloc(sizeof(*h) + BITS_TO_LONGS(nr_pages) * sizeof(long),
+								GFP_KERNEL);
+	if (!h)
+		return NULL;
+	spin_lock_init(&h->lock);
+	h->nr_pages = nr_pages;
+
+	if (cmpxchg(&mapping->ra_history, NULL, h) != NULL) {
+		kfree(h);
+		h = mapping->ra_history;
+	}
+	return h;
+}
+
+void __ra_history_record(struct address_space *mapping, pgoff_t index)
+{
+	struct ra_history *h = mapping->ra_history;
+
+	if (h->recording && index < h->nr_pages &&
+	    !test_bit(index, h->accessed))
+		set_bit(index, h->accessed);
+}
+
+/*
+ * POSIX_FADV_RECORD_ACCESS: forget what was recorded so far and record the
+ * pages read from now on.
+ */
+int ra_history_start(struct address_space *mapping)
+{
+	struct ra_history *h;
+
+	if (!mapping->a_ops->readpage)
+		return -EINVAL;
+
+	h = ra_history_attach(mapping);
+	if (!h)
+		return -ENOMEM;
+
+	bitmap_zero(h->accessed, h->nr_pages);
+	h->recording = 1;
+	return 0;
+}
+
+/*
+ * FS_IOC_GET_RA_HISTORY: copy out the recorded pages as extents. The total
+ * number of extents is returned even when they did not all fit.
+ */
+int ra_history_get(struct file *filp, void __user *argp)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct ra_history_extent __user *uext;
+	struct ra_history_extent ext;
+	struct ra_history_args args;
+	struct ra_history *h;
+	unsigned long start, end;
+	__u32 nr = 0;
+
+	if (!is_owner_or_cap(mapping->host))
+		return -EPERM;
+	if (copy_from_user(&args, argp, sizeof(args)))
+		return -EFAULT;
+	if (args.flags & ~RA_HISTORY_STOP)
+		return -EINVAL;
+
+	h = mapping->ra_history;
+	if (!h)
+		return -ENODATA;
+	if (args.flags & RA_HISTORY_STOP)
+		h->recording = 0;
+
+	uext = (struct ra_history_extent __user *)(unsigned long)args.extents;
+	start = find_first_bit(h->accessed, h->nr_pages);
+	while (start < h->nr_pages) {
+		end = find_next_zero_bit(h->accessed, h->nr_pages, start);
+		if (nr < args.nr_extents) {
+			ext.start = start;
+			ext.len = end - start;
+			if (copy_to_user(&uext[nr], &ext, sizeof(ext)))
+				return -EFAULT;
+		}
+		nr++;
+		start = find_next_bit(h->accessed, h->nr_pages, end);
+	}
+
+	args.nr_extents = nr;
+	if (copy_to_user(argp, &args, sizeof(args)))
+		return -EFAULT;
+	return 0;
+}
+
+static int ra_extent_cmp(const void *a, const void *b)
+{
+	const struct ra_history_extent *x = a, *y = b;
+
+	if (x->start < y->start)
+		return -1;
+	return x->start > y->start;
+}
+
+/*
+ * Sort the extents and merge those that overlap or are separated by a small
+ * hole. Returns the number of extents left.
+ */
+static unsigned int ra_history_merge(struct ra_history_extent *ext,
+				     unsigned int nr_extents)
+{
+	unsigned int i, nr = 0;
+
+	sort(ext, nr_extents, sizeof(*ext), ra_extent_cmp, NULL);
+
+	for (i = 0; i < nr_extents; i++) {
+		struct ra_history_extent *prev = nr ? &ext[nr - 1] : NULL;
+		__u64 end = ext[i].start + ext[i].len;
+
+		if (!ext[i].len || end < ext[i].start)
+			continue;
+
+		if (prev && ext[i].start <=
+				prev->start + prev->len + RA_HISTORY_MERGE_GAP) {
+			prev->len = max(prev->start + prev->len, end) -
+								prev->start;
+			continue;
+		}
+		ext[nr++] = ext[i];
+	}
+
+	return nr;
+}
+
+/* Start asynchronous reads of the sorted extents that lie within the file */
+static void ra_history_readahead(struct address_space *mapping,
+				 struct file *filp,
+				 struct ra_history_extent *ext,
+				 unsigned int nr)
+{
+	pgoff_t end_index;
+	unsigned int i;
+
+	end_index = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+							PAGE_CACHE_SHIFT;
+
+	for (i = 0; i < nr && ext[i].start < end_index; i++)
+		force_page_cache_readahead(mapping, filp, ext[i].start,
+				min_t(__u64, ext[i].len,
+				      end_index - ext[i].start));
+}
+
+/*
+ * FS_IOC_SET_RA_HISTORY: install a set previously obtained with
+ * FS_IOC_GET_RA_HISTORY, to be read in on the next open of the file or
+ * right away with RA_HISTORY_REPLAY_NOW.
+ */
+int ra_history_set(struct file *filp, void __user *argp)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct ra_history_extent *ext, *old;
+	struct ra_history_args args;
+	struct ra_history *h;
+	unsigned int nr;
+	size_t size;
+
+	if (!is_owner_or_cap(mapping->host))
+		return -EPERM;
+	if (!mapping->a_ops->readpage)
+		return -EINVAL;
+	if (copy_from_user(&args, argp, sizeof(args)))
+		return -EFAULT;
+	if (args.flags & ~RA_HISTORY_REPLAY_NOW)
+		return -EINVAL;
+	if (!args.nr_extents || args.nr_extents > RA_HISTORY_MAX_EXTENTS)
+		return -EINVAL;
+
+	size = args.nr_extents * sizeof(*ext);
+	ext = kmalloc(size, GFP_KERNEL);
+	if (!ext)
+		return -ENOMEM;
+	if (copy_from_user(ext, (void __user *)(unsigned long)args.extents,
+								size)) {
+		kfree(ext);
+		return -EFAULT;
+	}
+
+	nr = ra_history_merge(ext, args.nr_extents);
+	if (!nr || (args.flags & RA_HISTORY_REPLAY_NOW)) {
+		ra_history_readahead(mapping, filp, ext, nr);
+		kfree(ext);
+		return 0;
+	}
+
+	h = ra_history_attach(mapping);
+	if (!h) {
+		kfree(ext);
+		return -ENOMEM;
+	}
+
+	spin_lock(&h->lock);
+	old = h->replay;
+	h->replay = ext;
+	h->nr_replay = nr;
+	spin_unlock(&h->lock);
+
+	kfree(old);
+	return 0;
+}
+
+/*
+ * Submitting the reads of a history can block on the request queue for a
+ * while, so open() leaves that to a worker, which holds the file.
+ */
+static struct workqueue_struct *ra_history_wq;
+
+struct ra_history_work {
+	struct work_struct work;
+	struct file *filp;
+	struct ra_history_extent *ext;
+	unsigned int nr;
+};
+
+static void ra_history_replay_fn(struct work_struct *work)
+{
+	struct ra_history_work *w =
+		container_of(work, struct ra_history_work, work);
+
+	ra_history_readahead(w->filp->f_mapping, w->filp, w->ext, w->nr);
+	fput(w->filp);
+	kfree(w->ext);
+	kfree(w);
+}
+
+/* Called on open: read in a pending history, once */
+void __ra_history_replay(struct file *filp)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct ra_history *h = mapping->ra_history;
+	struct ra_history_extent *ext;
+	struct ra_history_work *w;
+	unsigned int nr;
+
+	if (!h->replay || !(filp->f_mode & FMODE_READ) ||
+	    (filp->f_flags & O_DIRECT))
+		return;
+
+	spin_lock(&h->lock);
+	ext = h->replay;
+	nr = h->nr_replay;
+	h->replay = NULL;
+	h->nr_replay = 0;
+	spin_unlock(&h->lock);
+
+	if (!ext)
+		return;
+
+	w = kmalloc(sizeof(*w), GFP_KERNEL);
+	if (!w || !ra_history_wq) {
+		kfree(w);
+		ra_history_readahead(mapping, filp, ext, nr);
+		kfree(ext);
+		return;
+	}
+	INIT_WORK(&w->work, ra_history_replay_fn);
+	get_file(filp);
+	w->filp = filp;
+	w->ext = ext;
+	w->nr = nr;
+	queue_work(ra_history_wq, &w->work);
+}
+
+void __ra_history_free(struct address_space *mapping)
+{
+	struct ra_history *h = mapping->ra_history;
+
+	mapping->ra_history = NULL;
+	kfree(h->replay);
+	kfree(h);
+}
+
+static int __init ra_history_init(void)
+{
+	ra_history_wq = create_singlethread_workqueue("ra_history");
+	return ra_history_wq ? 0 : -ENOMEM;
+}
+module_init(ra_history_init);
+#endif /* CONFIG_READAHEAD_HISTORY */
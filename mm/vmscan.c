@@ -84,6 +84,12 @@ struct scan_control {
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
+	/*
+	 * Pages isolated from an LRU list per zone->lru_lock round trip.
+	 * Zero means SWAP_CLUSTER_MAX.
+	 */
+	unsigned long reclaim_batch;
+
 	/*
 	 * Nodemask of nodes allowed by the caller. If NULL, all nodes
 	 * are scanned.
@@ -93,6 +99,18 @@ struct scan_control {
 
 #define lru_to_page(_head) (list_entry((_head)->prev, struct page, lru))
 
+/*
+ * Soft limit reclaim works on groups the user has marked as expendable
+ * (background applications), so take bigger bites out of them per lock
+ * round trip.
+ */
+#define SOFT_RECLAIM_BATCH	(SWAP_CLUSTER_MAX * 4)
+
+static inline unsigned long reclaim_batch(struct scan_control *sc)
+{
+	return sc->reclaim_batch ? sc->reclaim_batch : SWAP_CLUSTER_MAX;
+}
+
 #ifdef ARCH_HAS_PREFETCH
 #define prefetch_prev_lru_page(_page, _base, _field)			\
 	do {								\
@@ -1191,7 +1209,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		unsigned long nr_file;
 
 		if (scanning_global_lru(sc)) {
-			nr_taken = isolate_pages_global(SWAP_CLUSTER_MAX,
+			nr_taken = isolate_pages_global(reclaim_batch(sc),
 							&page_list, &nr_scan,
 							sc->order, mode,
 							zone, 0, file);
@@ -1203,7 +1221,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 				__count_zone_vm_events(PGSCAN_DIRECT, zone,
 						       nr_scan);
 		} else {
-			nr_taken = mem_cgroup_isolate_pages(SWAP_CLUSTER_MAX,
+			nr_taken = mem_cgroup_isolate_pages(reclaim_batch(sc),
 							&page_list, &nr_scan,
 							sc->order, mode,
 							zone, sc->mem_cgroup,
@@ -1714,7 +1732,7 @@ static void shrink_zone(int priority, struct zone *zone,
 		for_each_evictable_lru(l) {
 			if (nr[l]) {
 				nr_to_scan = min_t(unsigned long,
-						   nr[l], SWAP_CLUSTER_MAX);
+						   nr[l], reclaim_batch(sc));
 				nr[l] -= nr_to_scan;
 
 				nr_reclaimed += shrink_list(l, nr_to_scan,
@@ -1783,6 +1801,17 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 
 			if (zone->all_unreclaimable && priority != DEF_PRIORITY)
 				continue;	/* Let kswapd poll it */
+
+			/*
+			 * Take from groups over their soft limit (background
+			 * applications) before the global LRU, so that a
+			 * stalled foreground allocation does not have to evict
+			 * foreground pages while background ones are around.
+			 */
+			sc->nr_reclaimed += mem_cgroup_soft_limit_reclaim(zone,
+						sc->order, sc->gfp_mask,
+						zone_to_nid(zone),
+						zone_idx(zone));
 		} else {
 			/*
 			 * Ignore cpuset limitation here. We just want to reduce
@@ -1938,6 +1967,9 @@ out:
 	delayacct_freepages_end();
 	put_mems_allowed();
 
+	/* Report the pages scanned at all priorities to the caller */
+	sc->nr_scanned = total_scanned;
+
 	if (sc->nr_reclaimed)
 		return sc->nr_reclaimed;
 
@@ -1971,15 +2003,18 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
 						gfp_t gfp_mask, bool noswap,
 						unsigned int swappiness,
-						struct zone *zone, int nid)
+						struct zone *zone, int nid,
+						unsigned long *nr_scanned)
 {
 	struct scan_control sc = {
 		.may_writepage = !laptop_mode,
 		.may_unmap = 1,
 		.may_swap = !noswap,
+		.nr_to_reclaim = SOFT_RECLAIM_BATCH,
 		.swappiness = swappiness,
 		.order = 0,
 		.mem_cgroup = mem,
+		.reclaim_batch = SOFT_RECLAIM_BATCH,
 	};
 	nodemask_t nm  = nodemask_of_node(nid);
 
@@ -1996,14 +2031,17 @@ unsigned long mem_cgroup_shrink_node_zone(struct mem_cgroup *mem,
 	 * the priority and make it zero.
 	 */
 	shrink_zone(0, zone, &sc);
+	*nr_scanned = sc.nr_scanned;
 	return sc.nr_reclaimed;
 }
 
 unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 					   gfp_t gfp_mask,
 					   bool noswap,
-					   unsigned int swappiness)
+					   unsigned int swappiness,
+					   unsigned long *nr_scanned)
 {
+	unsigned long nr_reclaimed;
 	struct zonelist *zonelist;
 	struct scan_control sc = {
 		.may_writepage = !laptop_mode,
@@ -2019,7 +2057,9 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 	sc.gfp_mask = (gfp_mask & GFP_RECLAIM_MASK) |
 			(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK);
 	zonelist = NODE_DATA(numa_node_id())->node_zonelists;
-	return do_try_to_free_pages(zonelist, &sc);
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	*nr_scanned = sc.nr_scanned;
+	return nr_reclaimed;
 }
 #endif
 
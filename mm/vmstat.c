@@ -856,6 +856,13 @@ static const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+#ifdef CONFIG_MMU
+	"mm_reap",
+	"mm_reap_pages",
+	"mm_reap_usecs",
+	"mm_reap_skip",
+#endif
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -863,6 +870,9 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_success",
+	"compact_daemon_stall",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
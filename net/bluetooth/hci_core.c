@@ -1407,7 +1407,9 @@ static inline void hci_acl_tx_to(struct hci_dev *hdev)
 static inline void hci_sched_acl(struct hci_dev *hdev)
 {
 	struct hci_conn *conn;
+	struct sk_buff_head batch;
 	struct sk_buff *skb;
+	unsigned long flags;
 	int quote;
 
 	BT_DBG("%s", hdev->name);
@@ -1419,18 +1421,27 @@ static inline void hci_sched_acl(struct hci_dev *hdev)
 			hci_acl_tx_to(hdev);
 	}
 
+	__skb_queue_head_init(&batch);
+
 	while (hdev->acl_cnt && (conn = hci_low_sent(hdev, ACL_LINK, &quote))) {
-		while (quote-- && (skb = skb_dequeue(&conn->data_q))) {
-			BT_DBG("skb %p len %d", skb, skb->len);
+		/* Take the connection's share of the controller buffers
+		 * off its queue in one go */
+		spin_lock_irqsave(&conn->data_q.lock, flags);
+		while (quote-- && (skb = __skb_dequeue(&conn->data_q)))
+			__skb_queue_tail(&batch, skb);
+		spin_unlock_irqrestore(&conn->data_q.lock, flags);
 
-			hci_conn_enter_active_mode(conn);
+		hci_conn_enter_active_mode(conn);
+
+		while ((skb = __skb_dequeue(&batch))) {
+			BT_DBG("skb %p len %d", skb, skb->len);
 
 			hci_send_frame(skb);
-			hdev->acl_last_tx = jiffies;
 
 			hdev->acl_cnt--;
 			conn->sent++;
 		}
+		hdev->acl_last_tx = jiffies;
 	}
 }
 
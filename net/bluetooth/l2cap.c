@@ -826,7 +826,8 @@ static void l2cap_sock_init(struct sock *sk, struct sock *parent)
 			pi->mode = L2CAP_MODE_BASIC;
 		pi->max_tx = max_transmit;
 		pi->fcs  = L2CAP_FCS_CRC16;
-		pi->tx_win = tx_window;
+		pi->tx_win = min_t(unsigned int, tx_window,
+						L2CAP_MAX_TX_WINDOW);
 		pi->sec_level = BT_SECURITY_LOW;
 		pi->role_switch = 0;
 		pi->force_reliable = 0;
@@ -1843,6 +1844,50 @@ done:
 	return err;
 }
 
+/* Send skb, holding one SDU, on the basic mode channel sk without
+ * copying it.  The caller must leave L2CAP_HDR_SIZE + BT_SKB_RESERVE
+ * bytes of headroom for the L2CAP and ACL headers.  Returns -EMSGSIZE
+ * if the SDU can't go out as a single ACL packet this way; the caller
+ * then sends it with sendmsg().  skb is only consumed on success.
+ */
+int l2cap_send_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct l2cap_pinfo *pi = l2cap_pi(sk);
+	struct l2cap_hdr *lh;
+	int len = skb->len;
+	int err;
+
+	BT_DBG("sk %p skb %p len %d", sk, skb, len);
+
+	lock_sock(sk);
+
+	if (sk->sk_state != BT_CONNECTED) {
+		err = -ENOTCONN;
+		goto done;
+	}
+
+	if (sk->sk_type == SOCK_DGRAM || pi->mode != L2CAP_MODE_BASIC ||
+			len > pi->omtu ||
+			len + L2CAP_HDR_SIZE > pi->conn->mtu ||
+			skb_headroom(skb) < L2CAP_HDR_SIZE + BT_SKB_RESERVE ||
+			skb_cloned(skb) || skb_shinfo(skb)->frag_list) {
+		err = -EMSGSIZE;
+		goto done;
+	}
+
+	lh = (struct l2cap_hdr *) skb_push(skb, L2CAP_HDR_SIZE);
+	lh->cid = cpu_to_le16(pi->dcid);
+	lh->len = cpu_to_le16(len);
+
+	l2cap_do_send(sk, skb);
+	err = len;
+
+done:
+	release_sock(sk);
+	return err;
+}
+EXPORT_SYMBOL(l2cap_send_skb);
+
 static int l2cap_sock_recvmsg(struct kiocb *iocb, struct socket *sock, struct msghdr *msg, size_t len, int flags)
 {
 	struct sock *sk = sock->sk;
@@ -1911,6 +1956,11 @@ static int l2cap_sock_setsockopt_old(struct socket *sock, int optname, char __us
 			break;
 		}
 
+		if (opts.txwin_size > L2CAP_MAX_TX_WINDOW) {
+			err = -EINVAL;
+			break;
+		}
+
 		l2cap_pi(sk)->imtu = opts.imtu;
 		l2cap_pi(sk)->omtu = opts.omtu;
 		l2cap_pi(sk)->fcs  = opts.fcs;
@@ -2620,8 +2670,8 @@ done:
 		case L2CAP_MODE_ERTM:
 			pi->remote_tx_win = rfc.txwin_size;
 			pi->remote_max_tx = rfc.max_transmit;
-			if (rfc.max_pdu_size > pi->conn->mtu - 10)
-				rfc.max_pdu_size = le16_to_cpu(pi->conn->mtu - 10);
+			if (le16_to_cpu(rfc.max_pdu_size) > pi->conn->mtu - 10)
+				rfc.max_pdu_size = cpu_to_le16(pi->conn->mtu - 10);
 
 			pi->remote_mps = le16_to_cpu(rfc.max_pdu_size);
 
@@ -2638,8 +2688,8 @@ done:
 			break;
 
 		case L2CAP_MODE_STREAMING:
-			if (rfc.max_pdu_size > pi->conn->mtu - 10)
-				rfc.max_pdu_size = le16_to_cpu(pi->conn->mtu - 10);
+			if (le16_to_cpu(rfc.max_pdu_size) > pi->conn->mtu - 10)
+				rfc.max_pdu_size = cpu_to_le16(pi->conn->mtu - 10);
 
 			pi->remote_mps = le16_to_cpu(rfc.max_pdu_size);
 
@@ -4724,7 +4774,7 @@ module_param(max_transmit, uint, 0644);
 MODULE_PARM_DESC(max_transmit, "Max transmit value (default = 3)");
 
 module_param(tx_window, uint, 0644);
-MODULE_PARM_DESC(tx_window, "Transmission window size value (default = 63)");
+MODULE_PARM_DESC(tx_window, "Transmission window size value (default = 63, max = 63)");
 
 MODULE_AUTHOR("Marcel Holtmann <marcel@holtmann.org>");
 MODULE_DESCRIPTION("Bluetooth L2CAP ver " VERSION);
@@ -756,6 +756,29 @@ static int rfcomm_send_frame(struct rfcomm_session *s, u8 *data, int len)
 	return kernel_sendmsg(sock, &msg, &iv, 1, len);
 }
 
+/* Send a data frame built in skb.  When it fits in one ACL packet, L2CAP
+ * takes the skb itself; otherwise it is copied as the other frames are.
+ * Consumes skb on success. */
+static int rfcomm_send_skb(struct rfcomm_session *s, struct sk_buff *skb)
+{
+	int err;
+
+	BT_DBG("session %p len %d", s, skb->len);
+
+	/* Uncharge it now, from this thread, as freeing it after the copy
+	 * would have done */
+	skb_orphan(skb);
+
+	err = l2cap_send_skb(s->sock->sk, skb);
+	if (err != -EMSGSIZE)
+		return err;
+
+	err = rfcomm_send_frame(s, skb->data, skb->len);
+	if (err >= 0)
+		kfree_skb(skb);
+	return err;
+}
+
 static int rfcomm_send_sabm(struct rfcomm_session *s, u8 dlci)
 {
 	struct rfcomm_cmd cmd;
@@ -1761,12 +1784,11 @@ static inline int rfcomm_process_tx(struct rfcomm_dlc *d)
 		return skb_queue_len(&d->tx_queue);
 
 	while (d->tx_credits && (skb = skb_dequeue(&d->tx_queue))) {
-		err = rfcomm_send_frame(d->session, skb->data, skb->len);
+		err = rfcomm_send_skb(d->session, skb);
 		if (err < 0) {
 			skb_queue_head(&d->tx_queue, skb);
 			break;
 		}
-		kfree_skb(skb);
 		d->tx_credits--;
 	}
 
@@ -3164,10 +3164,12 @@ __napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 	struct sk_buff *p;
 
 	for (p = napi->gro_list; p; p = p->next) {
+		/* raw IP devices have no link header to compare */
 		NAPI_GRO_CB(p)->same_flow =
 			(p->dev == skb->dev) &&
-			!compare_ether_header(skb_mac_header(p),
-					      skb_gro_mac_header(skb));
+			(!skb->dev->hard_header_len ||
+			 !compare_ether_header(skb_mac_header(p),
+					       skb_gro_mac_header(skb)));
 		NAPI_GRO_CB(p)->flush = 0;
 	}
 
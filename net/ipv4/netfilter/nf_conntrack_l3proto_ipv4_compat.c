@@ -34,6 +34,8 @@ static struct hlist_nulls_node *ct_get_first(struct seq_file *seq)
 	for (st->bucket = 0;
 	     st->bucket < net->ct.htable_size;
 	     st->bucket++) {
+		/* a grown table is published before its size */
+		smp_rmb();
 		n = rcu_dereference(net->ct.hash[st->bucket].first);
 		if (!is_a_nulls(n))
 			return n;
@@ -53,6 +55,7 @@ static struct hlist_nulls_node *ct_get_next(struct seq_file *seq,
 			if (++st->bucket >= net->ct.htable_size)
 				return NULL;
 		}
+		smp_rmb();
 		head = rcu_dereference(net->ct.hash[st->bucket].first);
 	}
 	return head;
@@ -114,8 +117,8 @@ static int ct_seq_show(struct seq_file *s, void *v)
 	ret = -ENOSPC;
 	if (seq_printf(s, "%-8s %u %ld ",
 		      l4proto->name, nf_ct_protonum(ct),
-		      timer_pending(&ct->timeout)
-		      ? (long)(ct->timeout.expires - jiffies)/HZ : 0) != 0)
+		      nf_ct_is_confirmed(ct)
+		      ? (long)(nf_ct_expires(ct) / HZ) : 0) != 0)
 		goto release;
 
 	if (l4proto->print_conntrack && l4proto->print_conntrack(s, ct))
@@ -3609,6 +3609,31 @@ static int tcp_process_frto(struct sock *sk, int flag)
 	return 0;
 }
 
+/* Set sk_pacing_rate for the packet scheduler to spread our segments:
+ * the current delivery rate, cwnd * mss / srtt, scaled up so that the
+ * flow can keep growing: 200 % in slow start, 120 % in congestion
+ * avoidance.  Without an RTT sample there is nothing to pace by.
+ */
+static void tcp_update_pacing_rate(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u64 rate;
+
+	if (!tp->srtt) {
+		sk->sk_pacing_rate = ~0U;
+		return;
+	}
+
+	/* srtt is in jiffies << 3 */
+	rate = (u64)tp->mss_cache * (HZ << 3);
+	rate *= max(tp->snd_cwnd, tp->packets_out);
+	rate *= tp->snd_cwnd < tp->snd_ssthresh ? 200 : 120;
+	do_div(rate, 100);
+	do_div(rate, tp->srtt);
+
+	sk->sk_pacing_rate = min_t(u64, rate, ~0U);
+}
+
 /* This routine deals with incoming acks, but not outgoing ones. */
 static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 {
@@ -3619,6 +3644,8 @@ static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 	u32 ack = TCP_SKB_CB(skb)->ack_seq;
 	u32 prior_in_flight;
 	u32 prior_fackets;
+	u32 prior_srtt = tp->srtt;
+	u32 prior_cwnd = tp->snd_cwnd;
 	int prior_packets;
 	int frto_cwnd = 0;
 
@@ -3709,6 +3736,9 @@ static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 			tcp_cong_avoid(sk, ack, prior_in_flight);
 	}
 
+	if (tp->srtt != prior_srtt || tp->snd_cwnd != prior_cwnd)
+		tcp_update_pacing_rate(sk);
+
 	if ((flag & FLAG_FORWARD_PROGRESS) || !(flag & FLAG_NOT_DUP))
 		dst_confirm(__sk_dst_get(sk));
 
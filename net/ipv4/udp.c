@@ -769,6 +769,119 @@ out:
 	return err;
 }
 
+/*
+ * Route cache for the datagrams of one sendmmsg() call: an unconnected
+ * socket normally looks its route up for every datagram.  While more
+ * datagrams of the batch follow (MSG_BATCH), the last route is kept
+ * here and reused by the next datagram of exactly the same flow.  Only
+ * datagrams sent with MSG_BATCH use it; the last one, or the first that
+ * fails, drops it, and __sys_sendmmsg() drops it too when it stops early
+ * on an error outside the protocol, so it doesn't outlive the call.
+ */
+static inline int udp_batch_flow_equal(const struct flowi *a,
+				       const struct flowi *b)
+{
+	return a->oif == b->oif && a->mark == b->mark &&
+	       a->fl4_dst == b->fl4_dst && a->fl4_src == b->fl4_src &&
+	       a->fl4_tos == b->fl4_tos && a->flags == b->flags &&
+	       a->fl_ip_sport == b->fl_ip_sport &&
+	       a->fl_ip_dport == b->fl_ip_dport && a->secid == b->secid;
+}
+
+static struct rtable *udp_batch_route_get(struct sock *sk,
+					  const struct flowi *fl)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct dst_entry *dst;
+
+	spin_lock(&sk->sk_dst_lock);
+	dst = up->batch_dst;
+	if (dst && udp_batch_flow_equal(fl, &up->batch_fl) &&
+	    (!dst->obsolete || dst->ops->check(dst, 0)))
+		dst_hold(dst);
+	else
+		dst = NULL;
+	spin_unlock(&sk->sk_dst_lock);
+	return (struct rtable *)dst;
+}
+
+static void udp_batch_route_set(struct sock *sk, struct dst_entry *dst,
+				const struct flowi *fl)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct dst_entry *old;
+
+	spin_lock(&sk->sk_dst_lock);
+	old = up->batch_dst;
+	up->batch_dst = dst;
+	if (dst)
+		up->batch_fl = *fl;
+	spin_unlock(&sk->sk_dst_lock);
+	dst_release(old);
+}
+
+void udp_batch_route_reset(struct sock *sk)
+{
+	if (udp_sk(sk)->batch_dst)
+		udp_batch_route_set(sk, NULL, NULL);
+}
+EXPORT_SYMBOL(udp_batch_route_reset);
+
+/*
+ * UDP_SEGMENT: one send of more than gso_size bytes goes out as a train
+ * of datagrams of gso_size bytes (the last one may be shorter).  They
+ * share the route and are built under one hold of the socket lock.
+ */
+struct udp_seg_frag {
+	struct iovec	*iov;
+	int		offset;
+	int		(*getfrag)(void *, char *, int, int, int,
+				   struct sk_buff *);
+};
+
+static int udp_seg_getfrag(void *from, char *to, int offset, int len,
+			   int odd, struct sk_buff *skb)
+{
+	struct udp_seg_frag *seg = from;
+
+	return seg->getfrag(seg->iov, to, seg->offset + offset, len, odd, skb);
+}
+
+/* Called with the socket locked and the cork addresses set up. */
+static int udp_send_segments(struct sock *sk, struct msghdr *msg, int len,
+			     struct ipcm_cookie *ipc, struct rtable *rt)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct udp_seg_frag seg = {
+		.iov	 = msg->msg_iov,
+		.getfrag = IS_UDPLITE(sk) ? udplite_getfrag :
+					    ip_generic_getfrag,
+	};
+	int err = 0;
+
+	while (seg.offset < len) {
+		int size = min_t(int, len - seg.offset, up->gso_size);
+		struct rtable *srt = (struct rtable *)dst_clone(&rt->u.dst);
+
+		up->pending = AF_INET;
+		up->len = size + sizeof(struct udphdr);
+		err = ip_append_data(sk, udp_seg_getfrag, &seg, up->len,
+				     sizeof(struct udphdr), ipc, &srt,
+				     msg->msg_flags);
+		ip_rt_put(srt);
+		if (err) {
+			udp_flush_pending_frames(sk);
+			break;
+		}
+		err = udp_push_pending_frames(sk);
+		if (err)
+			break;
+		seg.offset += size;
+	}
+	/* A partial train reports what went out, like a short write */
+	return seg.offset ? seg.offset : err;
+}
+
 int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		size_t len)
 {
@@ -779,6 +892,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	struct rtable *rt = NULL;
 	int free = 0;
 	int connected = 0;
+	int segs = 0;
 	__be32 daddr, faddr, saddr;
 	__be16 dport;
 	u8  tos;
@@ -814,6 +928,11 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		}
 		release_sock(sk);
 	}
+	if (up->gso_size && len > up->gso_size && !corkreq) {
+		segs = DIV_ROUND_UP(len, up->gso_size);
+		if (segs > UDP_MAX_SEGMENTS)
+			return -EINVAL;
+	}
 	ulen += sizeof(struct udphdr);
 
 	/*
@@ -902,11 +1021,18 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		struct net *net = sock_net(sk);
 
 		security_sk_classify_flow(sk, &fl);
-		err = ip_route_output_flow(net, &rt, &fl, sk, 1);
-		if (err) {
-			if (err == -ENETUNREACH)
-				IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
-			goto out;
+		if ((msg->msg_flags & MSG_BATCH) && up->batch_dst)
+			rt = udp_batch_route_get(sk, &fl);
+		if (rt == NULL) {
+			err = ip_route_output_flow(net, &rt, &fl, sk, 1);
+			if (err) {
+				if (err == -ENETUNREACH)
+					IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
+				goto out;
+			}
+			if (!connected && (msg->msg_flags & MSG_BATCH))
+				udp_batch_route_set(sk, dst_clone(&rt->u.dst),
+						    &fl);
 		}
 
 		err = -EACCES;
@@ -942,6 +1068,15 @@ back_from_confirm:
 	inet->cork.fl.fl_ip_dport = dport;
 	inet->cork.fl.fl4_src = saddr;
 	inet->cork.fl.fl_ip_sport = inet->inet_sport;
+	if (segs) {
+		err = udp_send_segments(sk, msg, len, &ipc, rt);
+		release_sock(sk);
+		if (err > 0) {
+			len = err;
+			err = 0;
+		}
+		goto out;
+	}
 	up->pending = AF_INET;
 
 do_append_data:
@@ -962,6 +1097,8 @@ out:
 	ip_rt_put(rt);
 	if (free)
 		kfree(ipc.opt);
+	if (!(msg->msg_flags & MSG_BATCH) || err)
+		udp_batch_route_reset(sk);
 	if (!err)
 		return len;
 	/*
@@ -1673,6 +1810,7 @@ void udp_destroy_sock(struct sock *sk)
 	bool slow = lock_sock_fast(sk);
 	udp_flush_pending_frames(sk);
 	unlock_sock_fast(sk, slow);
+	udp_batch_route_reset(sk);
 }
 
 /*
@@ -1705,6 +1843,15 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		}
 		break;
 
+	case UDP_SEGMENT:
+		/* Only udp_sendmsg() splits, udpv6_sendmsg() would ignore it */
+		if (sk->sk_family != AF_INET)
+			return -EOPNOTSUPP;
+		if (val < 0 || val > 0xFFFF - sizeof(struct udphdr))
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
 	case UDP_ENCAP:
 		switch (val) {
 		case 0:
@@ -1803,6 +1950,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->encap_type;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
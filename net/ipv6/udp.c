@@ -1232,6 +1232,7 @@ void udpv6_destroy_sock(struct sock *sk)
 	lock_sock(sk);
 	udp_v6_flush_pending_frames(sk);
 	release_sock(sk);
+	udp_batch_route_reset(sk);
 
 	inet6_destroy_sock(sk);
 }
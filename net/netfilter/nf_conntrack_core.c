@@ -68,6 +68,29 @@ EXPORT_SYMBOL_GPL(nf_conntrack_untracked);
 static int nf_conntrack_hash_rnd_initted;
 static unsigned int nf_conntrack_hash_rnd;
 
+/* The tables start small and double, up to nf_conntrack_htable_size, as
+ * they fill; unless the size was given by the hashsize parameter. */
+static bool nf_conntrack_hash_auto __read_mostly;
+static DEFINE_MUTEX(nf_conntrack_hash_mutex);
+
+#ifdef CONFIG_NF_CONNTRACK_COMPACT
+#define NF_CT_COMPACT_DEFAULT 1
+#else
+#define NF_CT_COMPACT_DEFAULT 0
+#endif
+
+static int nf_ct_compact __read_mostly = NF_CT_COMPACT_DEFAULT;
+
+module_param_named(compact, nf_ct_compact, bool, 0644);
+MODULE_PARM_DESC(compact, "Allocate conntrack extensions only when used.");
+
+/* The garbage collector visits 1/GC_SCAN_DIV of the buckets every
+ * GC_INTERVAL, and comes back at once when it had to stop at
+ * GC_MAX_EVICTS. */
+#define GC_INTERVAL	HZ
+#define GC_SCAN_DIV	16u
+#define GC_MAX_EVICTS	256u
+
 static u_int32_t __hash_conntrack(const struct nf_conntrack_tuple *tuple,
 				  u16 zone, unsigned int size, unsigned int rnd)
 {
@@ -89,8 +112,11 @@ static u_int32_t __hash_conntrack(const struct nf_conntrack_tuple *tuple,
 static inline u_int32_t hash_conntrack(const struct net *net, u16 zone,
 				       const struct nf_conntrack_tuple *tuple)
 {
-	return __hash_conntrack(tuple, zone, net->ct.htable_size,
-				nf_conntrack_hash_rnd);
+	unsigned int size = net->ct.htable_size;
+
+	/* A grown table is published before its size */
+	smp_rmb();
+	return __hash_conntrack(tuple, zone, size, nf_conntrack_hash_rnd);
 }
 
 bool
@@ -168,7 +194,8 @@ clean_from_lists(struct nf_conn *ct)
 {
 	pr_debug("clean_from_lists(%p)\n", ct);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
-	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode);
+	/* nf_ct_delete() tells an entry already removed by this one */
+	hlist_nulls_del_init_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode);
 
 	/* Destroy all pending expectations */
 	nf_ct_remove_expectations(ct);
@@ -183,7 +210,6 @@ destroy_conntrack(struct nf_conntrack *nfct)
 
 	pr_debug("destroy_conntrack(%p)\n", ct);
 	NF_CT_ASSERT(atomic_read(&nfct->use) == 0);
-	NF_CT_ASSERT(!timer_pending(&ct->timeout));
 
 	/* To make sure we don't get any weird locking issues here:
 	 * destroy_conntrack() MUST NOT be called with a write lock
@@ -218,70 +244,65 @@ destroy_conntrack(struct nf_conntrack *nfct)
 	nf_conntrack_free(ct);
 }
 
-void nf_ct_delete_from_lists(struct nf_conn *ct)
+static void nf_ct_insert_dying_list(struct nf_conn *ct)
 {
 	struct net *net = nf_ct_net(ct);
 
-	nf_ct_helper_destroy(ct);
+	/* retry the event delivery from the garbage collector */
+	ct->timeout = nfct_time_stamp +
+		(random32() % net->ct.sysctl_events_retry_timeout);
+
 	spin_lock_bh(&nf_conntrack_lock);
+	hlist_nulls_add_head(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
+			     &net->ct.dying);
+	spin_unlock_bh(&nf_conntrack_lock);
+}
+
+/* Take ct out of the table and report its destruction.  The reference of
+ * the table is dropped once the event is delivered; until then ct waits
+ * on the dying list.  Returns false if ct wasn't in the table, e.g.
+ * because someone else deleted it first.
+ */
+bool nf_ct_delete(struct nf_conn *ct, u32 pid, int report)
+{
+	struct net *net = nf_ct_net(ct);
+
+	spin_lock_bh(&nf_conntrack_lock);
+	if (!nf_ct_is_confirmed(ct) ||
+	    hlist_nulls_unhashed(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode)) {
+		spin_unlock_bh(&nf_conntrack_lock);
+		return false;
+	}
 	/* Inside lock so preempt is disabled on module removal path.
 	 * Otherwise we can get spurious warnings. */
 	NF_CT_STAT_INC(net, delete_list);
 	clean_from_lists(ct);
 	spin_unlock_bh(&nf_conntrack_lock);
-}
-EXPORT_SYMBOL_GPL(nf_ct_delete_from_lists);
 
-static void death_by_event(unsigned long ul_conntrack)
-{
-	struct nf_conn *ct = (void *)ul_conntrack;
-	struct net *net = nf_ct_net(ct);
+	nf_ct_helper_destroy(ct);
 
-	if (nf_conntrack_event(IPCT_DESTROY, ct) < 0) {
-		/* bad luck, let's retry again */
-		ct->timeout.expires = jiffies +
-			(random32() % net->ct.sysctl_events_retry_timeout);
-		add_timer(&ct->timeout);
-		return;
+	if (unlikely(nf_conntrack_event_report(IPCT_DESTROY, ct,
+					       pid, report) < 0)) {
+		/* destroy event was not delivered */
+		nf_ct_insert_dying_list(ct);
+		return true;
 	}
-	/* we've got the event delivered, now it's dying */
 	set_bit(IPS_DYING_BIT, &ct->status);
-	spin_lock(&nf_conntrack_lock);
-	hlist_nulls_del(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
-	spin_unlock(&nf_conntrack_lock);
 	nf_ct_put(ct);
+	return true;
 }
+EXPORT_SYMBOL_GPL(nf_ct_delete);
 
-void nf_ct_insert_dying_list(struct nf_conn *ct)
+/* Delete an expired entry found by a lookup; needs no reference. */
+static void nf_ct_gc_expired(struct nf_conn *ct)
 {
-	struct net *net = nf_ct_net(ct);
-
-	/* add this conntrack to the dying list */
-	spin_lock_bh(&nf_conntrack_lock);
-	hlist_nulls_add_head(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode,
-			     &net->ct.dying);
-	spin_unlock_bh(&nf_conntrack_lock);
-	/* set a new timer to retry event delivery */
-	setup_timer(&ct->timeout, death_by_event, (unsigned long)ct);
-	ct->timeout.expires = jiffies +
-		(random32() % net->ct.sysctl_events_retry_timeout);
-	add_timer(&ct->timeout);
-}
-EXPORT_SYMBOL_GPL(nf_ct_insert_dying_list);
+	if (!atomic_inc_not_zero(&ct->ct_general.use))
+		return;
 
-static void death_by_timeout(unsigned long ul_conntrack)
-{
-	struct nf_conn *ct = (void *)ul_conntrack;
+	/* the slab may have reused it since the caller looked */
+	if (nf_ct_should_gc(ct))
+		nf_ct_kill(ct);
 
-	if (!test_bit(IPS_DYING_BIT, &ct->status) &&
-	    unlikely(nf_conntrack_event(IPCT_DESTROY, ct) < 0)) {
-		/* destroy event was not delivered */
-		nf_ct_delete_from_lists(ct);
-		nf_ct_insert_dying_list(ct);
-		return;
-	}
-	set_bit(IPS_DYING_BIT, &ct->status);
-	nf_ct_delete_from_lists(ct);
 	nf_ct_put(ct);
 }
 
@@ -351,6 +372,12 @@ begin:
 				nf_ct_put(ct);
 				goto begin;
 			}
+			/* Past its time: the collector hasn't got to it */
+			if (unlikely(nf_ct_should_gc(ct))) {
+				nf_ct_kill(ct);
+				nf_ct_put(ct);
+				h = NULL;
+			}
 		}
 	}
 	rcu_read_unlock();
@@ -371,6 +398,7 @@ static void __nf_conntrack_hash_insert(struct nf_conn *ct,
 			   &net->ct.hash[repl_hash]);
 }
 
+/* Called with nf_conntrack_lock held, which keeps the table size. */
 void nf_conntrack_hash_insert(struct nf_conn *ct)
 {
 	struct net *net = nf_ct_net(ct);
@@ -409,8 +437,6 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 		return NF_ACCEPT;
 
 	zone = nf_ct_zone(ct);
-	hash = hash_conntrack(net, zone, &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
-	repl_hash = hash_conntrack(net, zone, &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
 
 	/* We're not in hash table, and we refuse to set up related
 	   connections for unconfirmed conns.  But packet copies and
@@ -424,6 +450,11 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 
 	spin_lock_bh(&nf_conntrack_lock);
 
+	/* The table may have been resized since we looked: hash under the
+	 * lock the resize holds. */
+	hash = hash_conntrack(net, zone, &ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple);
+	repl_hash = hash_conntrack(net, zone, &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+
 	/* We have to check the DYING flag inside the lock to prevent
 	   a race against nf_ct_get_next_corpse() possibly called from
 	   user context, else we insert an already 'dead' hash, blocking
@@ -451,16 +482,15 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	/* Remove from unconfirmed list */
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
 
-	/* Timer relative to confirmation time, not original
+	/* Timeout relative to confirmation time, not original
 	   setting time, otherwise we'd get timer wrap in
 	   weird delay cases. */
-	ct->timeout.expires += jiffies;
-	add_timer(&ct->timeout);
+	ct->timeout += nfct_time_stamp;
 	atomic_inc(&ct->ct_general.use);
 	set_bit(IPS_CONFIRMED_BIT, &ct->status);
 
 	/* Since the lookup is lockless, hash insertion must be done after
-	 * starting the timer and setting the CONFIRMED bit. The RCU barriers
+	 * setting the timeout and the CONFIRMED bit. The RCU barriers
 	 * guarantee that no other CPU can find the conntrack before the above
 	 * stores are visible.
 	 */
@@ -502,6 +532,10 @@ nf_conntrack_tuple_taken(const struct nf_conntrack_tuple *tuple,
 	rcu_read_lock_bh();
 	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash], hnnode) {
 		ct = nf_ct_tuplehash_to_ctrack(h);
+		if (nf_ct_is_expired(ct)) {
+			nf_ct_gc_expired(ct);
+			continue;
+		}
 		if (ct != ignored_conntrack &&
 		    nf_ct_tuple_equal(tuple, &h->tuple) &&
 		    nf_ct_zone(ct) == zone) {
@@ -535,7 +569,8 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash],
 					 hnnode) {
 			tmp = nf_ct_tuplehash_to_ctrack(h);
-			if (!test_bit(IPS_ASSURED_BIT, &tmp->status))
+			if (!test_bit(IPS_ASSURED_BIT, &tmp->status) ||
+			    nf_ct_is_expired(tmp))
 				ct = tmp;
 			cnt++;
 		}
@@ -558,8 +593,7 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 	if (!ct)
 		return dropped;
 
-	if (del_timer(&ct->timeout)) {
-		death_by_timeout((unsigned long)ct);
+	if (nf_ct_delete(ct, 0, 0)) {
 		dropped = 1;
 		NF_CT_STAT_INC_ATOMIC(net, early_drop);
 	}
@@ -617,8 +651,6 @@ struct nf_conn *nf_conntrack_alloc(struct net *net, u16 zone,
 	ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode.pprev = NULL;
 	ct->tuplehash[IP_CT_DIR_REPLY].tuple = *repl;
 	ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev = NULL;
-	/* Don't set timer yet: wait for confirmation */
-	setup_timer(&ct->timeout, death_by_timeout, (unsigned long)ct);
 #ifdef CONFIG_NET_NS
 	ct->ct_net = net;
 #endif
@@ -940,24 +972,23 @@ void __nf_ct_refresh_acct(struct nf_conn *ct,
 			  unsigned long extra_jiffies,
 			  int do_acct)
 {
-	NF_CT_ASSERT(ct->timeout.data == (unsigned long)ct);
 	NF_CT_ASSERT(skb);
 
 	/* Only update if this is not a fixed timeout */
 	if (test_bit(IPS_FIXED_TIMEOUT_BIT, &ct->status))
 		goto acct;
 
-	/* If not in hash table, timer will not be active yet */
+	/* If not in hash table, the timeout is relative to confirmation */
 	if (!nf_ct_is_confirmed(ct)) {
-		ct->timeout.expires = extra_jiffies;
+		ct->timeout = extra_jiffies;
 	} else {
-		unsigned long newtime = jiffies + extra_jiffies;
+		u32 newtime = nfct_time_stamp + extra_jiffies;
 
 		/* Only update the timeout if the new timeout is at least
-		   HZ jiffies from the old timeout. Need del_timer for race
-		   avoidance (may already be dying). */
-		if (newtime - ct->timeout.expires >= HZ)
-			mod_timer_pending(&ct->timeout, newtime);
+		   HZ jiffies from the old timeout, to keep the cache line
+		   clean on every packet. */
+		if (newtime - ct->timeout >= HZ)
+			ct->timeout = newtime;
 	}
 
 acct:
@@ -994,11 +1025,7 @@ bool __nf_ct_kill_acct(struct nf_conn *ct,
 		}
 	}
 
-	if (del_timer(&ct->timeout)) {
-		ct->timeout.function((unsigned long)ct);
-		return true;
-	}
-	return false;
+	return nf_ct_delete(ct, 0, 0);
 }
 EXPORT_SYMBOL_GPL(__nf_ct_kill_acct);
 
@@ -1106,42 +1133,27 @@ found:
 	return ct;
 }
 
-void nf_ct_iterate_cleanup(struct net *net,
-			   int (*iter)(struct nf_conn *i, void *data),
-			   void *data)
+static void __nf_ct_iterate_cleanup(struct net *net,
+				    int (*iter)(struct nf_conn *i, void *data),
+				    void *data, u32 pid, int report)
 {
 	struct nf_conn *ct;
 	unsigned int bucket = 0;
 
 	while ((ct = get_next_corpse(net, iter, data, &bucket)) != NULL) {
 		/* Time to push up daises... */
-		if (del_timer(&ct->timeout))
-			death_by_timeout((unsigned long)ct);
-		/* ... else the timer will get him soon. */
-
+		nf_ct_delete(ct, pid, report);
 		nf_ct_put(ct);
 	}
 }
-EXPORT_SYMBOL_GPL(nf_ct_iterate_cleanup);
 
-struct __nf_ct_flush_report {
-	u32 pid;
-	int report;
-};
-
-static int kill_report(struct nf_conn *i, void *data)
+void nf_ct_iterate_cleanup(struct net *net,
+			   int (*iter)(struct nf_conn *i, void *data),
+			   void *data)
 {
-	struct __nf_ct_flush_report *fr = (struct __nf_ct_flush_report *)data;
-
-	/* If we fail to deliver the event, death_by_timeout() will retry */
-	if (nf_conntrack_event_report(IPCT_DESTROY, i,
-				      fr->pid, fr->report) < 0)
-		return 1;
-
-	/* Avoid the delivery of the destroy event in death_by_timeout(). */
-	set_bit(IPS_DYING_BIT, &i->status);
-	return 1;
+	__nf_ct_iterate_cleanup(net, iter, data, 0, 0);
 }
+EXPORT_SYMBOL_GPL(nf_ct_iterate_cleanup);
 
 static int kill_all(struct nf_conn *i, void *data)
 {
@@ -1160,27 +1172,158 @@ EXPORT_SYMBOL_GPL(nf_ct_free_hashtable);
 
 void nf_conntrack_flush_report(struct net *net, u32 pid, int report)
 {
-	struct __nf_ct_flush_report fr = {
-		.pid 	= pid,
-		.report = report,
-	};
-	nf_ct_iterate_cleanup(net, kill_report, &fr);
+	__nf_ct_iterate_cleanup(net, kill_all, NULL, pid, report);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_flush_report);
 
-static void nf_ct_release_dying_list(struct net *net)
+/* Take the first entry of the dying list that is due for another try at
+ * its destroy event, or any entry if all is set. */
+static struct nf_conn *nf_ct_dying_next(struct net *net, bool all)
 {
 	struct nf_conntrack_tuple_hash *h;
-	struct nf_conn *ct;
 	struct hlist_nulls_node *n;
+	struct nf_conn *ct;
 
 	spin_lock_bh(&nf_conntrack_lock);
 	hlist_nulls_for_each_entry(h, n, &net->ct.dying, hnnode) {
 		ct = nf_ct_tuplehash_to_ctrack(h);
-		/* never fails to remove them, no listeners at this point */
-		nf_ct_kill(ct);
+		if (all || nf_ct_is_expired(ct)) {
+			hlist_nulls_del(&h->hnnode);
+			spin_unlock_bh(&nf_conntrack_lock);
+			return ct;
+		}
+	}
+	spin_unlock_bh(&nf_conntrack_lock);
+	return NULL;
+}
+
+static void nf_ct_retry_dying_list(struct net *net)
+{
+	unsigned int budget = GC_MAX_EVICTS;
+	struct nf_conn *ct;
+
+	while (budget-- && (ct = nf_ct_dying_next(net, false)) != NULL) {
+		if (nf_conntrack_event(IPCT_DESTROY, ct) < 0) {
+			/* bad luck, let's retry again */
+			nf_ct_insert_dying_list(ct);
+			continue;
+		}
+		/* we've got the event delivered, now it's dying */
+		set_bit(IPS_DYING_BIT, &ct->status);
+		nf_ct_put(ct);
+	}
+}
+
+static void nf_ct_release_dying_list(struct net *net)
+{
+	struct nf_conn *ct;
+
+	/* no listeners at this point, drop the events */
+	while ((ct = nf_ct_dying_next(net, true)) != NULL) {
+		set_bit(IPS_DYING_BIT, &ct->status);
+		nf_ct_put(ct);
+	}
+}
+
+static int nf_conntrack_hash_resize(struct net *net, unsigned int hashsize)
+{
+	int i, bucket, vmalloced, old_vmalloced;
+	unsigned int old_size;
+	struct hlist_nulls_head *hash, *old_hash;
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_conn *ct;
+
+	hash = nf_ct_alloc_hashtable(&hashsize, &vmalloced, 1);
+	if (!hash)
+		return -ENOMEM;
+
+	/* Lookups in the old hash might happen in parallel, which means we
+	 * might get false negatives during connection lookup. New connections
+	 * created because of a false negative won't make it into the hash
+	 * though since that required taking the lock.
+	 */
+	spin_lock_bh(&nf_conntrack_lock);
+	for (i = 0; i < net->ct.htable_size; i++) {
+		while (!hlist_nulls_empty(&net->ct.hash[i])) {
+			h = hlist_nulls_entry(net->ct.hash[i].first,
+					struct nf_conntrack_tuple_hash, hnnode);
+			ct = nf_ct_tuplehash_to_ctrack(h);
+			hlist_nulls_del_rcu(&h->hnnode);
+			bucket = __hash_conntrack(&h->tuple, nf_ct_zone(ct),
+						  hashsize,
+						  nf_conntrack_hash_rnd);
+			hlist_nulls_add_head_rcu(&h->hnnode, &hash[bucket]);
+		}
+	}
+	old_size = net->ct.htable_size;
+	old_vmalloced = net->ct.hash_vmalloc;
+	old_hash = net->ct.hash;
+
+	/* Lockless lookups read the size first: never let them index a
+	 * table with the size of a larger one. */
+	if (hashsize > old_size) {
+		net->ct.hash = hash;
+		smp_wmb();
+		net->ct.htable_size = hashsize;
+	} else {
+		net->ct.htable_size = hashsize;
+		smp_wmb();
+		net->ct.hash = hash;
 	}
+	net->ct.hash_vmalloc = vmalloced;
 	spin_unlock_bh(&nf_conntrack_lock);
+
+	synchronize_net();
+	nf_ct_free_hashtable(old_hash, old_vmalloced, old_size);
+	return 0;
+}
+
+static void gc_worker(struct work_struct *work)
+{
+	struct net *net = container_of(to_delayed_work(work), struct net,
+				       ct.gc_work);
+	unsigned int i, goal, buckets = 0, expired = 0;
+	unsigned long next_run = GC_INTERVAL;
+
+	goal = max(net->ct.htable_size / GC_SCAN_DIV, 1u);
+	i = net->ct.gc_bucket;
+
+	do {
+		struct nf_conntrack_tuple_hash *h;
+		struct hlist_nulls_node *n;
+		struct nf_conn *ct;
+
+		rcu_read_lock();
+		if (i >= net->ct.htable_size)
+			i = 0;
+		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[i], hnnode) {
+			ct = nf_ct_tuplehash_to_ctrack(h);
+			if (nf_ct_is_expired(ct)) {
+				nf_ct_gc_expired(ct);
+				expired++;
+			}
+		}
+		rcu_read_unlock();
+		i++;
+		cond_resched();
+	} while (++buckets < goal && expired < GC_MAX_EVICTS);
+
+	net->ct.gc_bucket = i;
+	if (expired >= GC_MAX_EVICTS)
+		next_run = 0;
+
+	nf_ct_retry_dying_list(net);
+
+	/* Keep the chains at two entries on average */
+	mutex_lock(&nf_conntrack_hash_mutex);
+	if (nf_conntrack_hash_auto &&
+	    net->ct.htable_size < nf_conntrack_htable_size &&
+	    atomic_read(&net->ct.count) > net->ct.htable_size)
+		nf_conntrack_hash_resize(net, min(net->ct.htable_size * 2,
+						  nf_conntrack_htable_size));
+	mutex_unlock(&nf_conntrack_hash_mutex);
+
+	schedule_delayed_work(&net->ct.gc_work, next_run);
 }
 
 static void nf_conntrack_cleanup_init_net(void)
@@ -1198,6 +1341,7 @@ static void nf_conntrack_cleanup_init_net(void)
 
 static void nf_conntrack_cleanup_net(struct net *net)
 {
+	cancel_delayed_work_sync(&net->ct.gc_work);
  i_see_dead_people:
 	nf_ct_iterate_cleanup(net, kill_all, NULL);
 	nf_ct_release_dying_list(net);
@@ -1266,11 +1410,8 @@ EXPORT_SYMBOL_GPL(nf_ct_alloc_hashtable);
 
 int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 {
-	int i, bucket, vmalloced, old_vmalloced;
-	unsigned int hashsize, old_size;
-	struct hlist_nulls_head *hash, *old_hash;
-	struct nf_conntrack_tuple_hash *h;
-	struct nf_conn *ct;
+	unsigned int hashsize;
+	int ret;
 
 	if (current->nsproxy->net_ns != &init_net)
 		return -EOPNOTSUPP;
@@ -1283,39 +1424,14 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 	if (!hashsize)
 		return -EINVAL;
 
-	hash = nf_ct_alloc_hashtable(&hashsize, &vmalloced, 1);
-	if (!hash)
-		return -ENOMEM;
-
-	/* Lookups in the old hash might happen in parallel, which means we
-	 * might get false negatives during connection lookup. New connections
-	 * created because of a false negative won't make it into the hash
-	 * though since that required taking the lock.
-	 */
-	spin_lock_bh(&nf_conntrack_lock);
-	for (i = 0; i < init_net.ct.htable_size; i++) {
-		while (!hlist_nulls_empty(&init_net.ct.hash[i])) {
-			h = hlist_nulls_entry(init_net.ct.hash[i].first,
-					struct nf_conntrack_tuple_hash, hnnode);
-			ct = nf_ct_tuplehash_to_ctrack(h);
-			hlist_nulls_del_rcu(&h->hnnode);
-			bucket = __hash_conntrack(&h->tuple, nf_ct_zone(ct),
-						  hashsize,
-						  nf_conntrack_hash_rnd);
-			hlist_nulls_add_head_rcu(&h->hnnode, &hash[bucket]);
-		}
+	mutex_lock(&nf_conntrack_hash_mutex);
+	ret = nf_conntrack_hash_resize(&init_net, hashsize);
+	if (!ret) {
+		nf_conntrack_htable_size = init_net.ct.htable_size;
+		nf_conntrack_hash_auto = false;
 	}
-	old_size = init_net.ct.htable_size;
-	old_vmalloced = init_net.ct.hash_vmalloc;
-	old_hash = init_net.ct.hash;
-
-	init_net.ct.htable_size = nf_conntrack_htable_size = hashsize;
-	init_net.ct.hash_vmalloc = vmalloced;
-	init_net.ct.hash = hash;
-	spin_unlock_bh(&nf_conntrack_lock);
-
-	nf_ct_free_hashtable(old_hash, old_vmalloced, old_size);
-	return 0;
+	mutex_unlock(&nf_conntrack_hash_mutex);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_set_hashsize);
 
@@ -1343,6 +1459,10 @@ static int nf_conntrack_init_init_net(void)
 		 * we use the old value of 8 to avoid reducing the max.
 		 * entries. */
 		max_factor = 4;
+
+		/* Most devices never track that many: start the tables at a
+		 * quarter of this and let them grow. */
+		nf_conntrack_hash_auto = true;
 	}
 	nf_conntrack_max = max_factor * nf_conntrack_htable_size;
 
@@ -1418,6 +1538,8 @@ static int nf_conntrack_init_net(struct net *net)
 	}
 
 	net->ct.htable_size = nf_conntrack_htable_size;
+	if (nf_conntrack_hash_auto)
+		net->ct.htable_size /= 4;
 	net->ct.hash = nf_ct_alloc_hashtable(&net->ct.htable_size,
 					     &net->ct.hash_vmalloc, 1);
 	if (!net->ct.hash) {
@@ -1435,6 +1557,10 @@ static int nf_conntrack_init_net(struct net *net)
 	if (ret < 0)
 		goto err_ecache;
 
+	net->ct.sysctl_compact = nf_ct_compact;
+	net->ct.gc_bucket = 0;
+	INIT_DELAYED_WORK_DEFERRABLE(&net->ct.gc_work, gc_worker);
+	schedule_delayed_work(&net->ct.gc_work, GC_INTERVAL);
 	return 0;
 
 err_ecache:
@@ -79,6 +79,21 @@ out_unlock:
 }
 EXPORT_SYMBOL_GPL(nf_ct_deliver_cached_events);
 
+/* Would events of a new conntrack reach anyone? */
+bool nf_conntrack_event_listeners(struct net *net)
+{
+	struct nf_ct_event_notifier *notify;
+	bool ret = false;
+
+	rcu_read_lock();
+	notify = rcu_dereference(nf_conntrack_event_cb);
+	if (notify != NULL)
+		ret = !notify->has_listeners || notify->has_listeners(net);
+	rcu_read_unlock();
+	return ret;
+}
+EXPORT_SYMBOL_GPL(nf_conntrack_event_listeners);
+
 int nf_conntrack_register_notifier(struct nf_ct_event_notifier *new)
 {
 	int ret = 0;
@@ -14,6 +14,7 @@
 #include <linux/rcupdate.h>
 #include <linux/slab.h>
 #include <linux/skbuff.h>
+#include <net/net_namespace.h>
 #include <net/netfilter/nf_conntrack_extend.h>
 
 static struct nf_ct_ext_type *nf_ct_ext_types[NF_CT_EXT_NUM];
@@ -43,9 +44,10 @@ void __nf_ct_ext_destroy(struct nf_conn *ct)
 EXPORT_SYMBOL(__nf_ct_ext_destroy);
 
 static void *
-nf_ct_ext_create(struct nf_ct_ext **ext, enum nf_ct_ext_id id, gfp_t gfp)
+nf_ct_ext_create(struct nf_ct_ext **ext, enum nf_ct_ext_id id, bool exact,
+		 gfp_t gfp)
 {
-	unsigned int off, len;
+	unsigned int off, len, size;
 	struct nf_ct_ext_type *t;
 
 	rcu_read_lock();
@@ -53,9 +55,11 @@ nf_ct_ext_create(struct nf_ct_ext **ext, enum nf_ct_ext_id id, gfp_t gfp)
 	BUG_ON(t == NULL);
 	off = ALIGN(sizeof(struct nf_ct_ext), t->align);
 	len = off + t->len;
+	/* Without exact, leave room for the NF_CT_EXT_F_PREALLOC types */
+	size = exact ? len : t->alloc_size;
 	rcu_read_unlock();
 
-	*ext = kzalloc(t->alloc_size, gfp);
+	*ext = kzalloc(size, gfp);
 	if (!*ext)
 		return NULL;
 
@@ -81,7 +85,8 @@ void *__nf_ct_ext_add(struct nf_conn *ct, enum nf_ct_ext_id id, gfp_t gfp)
 	NF_CT_ASSERT(!nf_ct_is_confirmed(ct));
 
 	if (!ct->ext)
-		return nf_ct_ext_create(&ct->ext, id, gfp);
+		return nf_ct_ext_create(&ct->ext, id,
+					nf_ct_net(ct)->ct.sysctl_compact, gfp);
 
 	if (nf_ct_ext_exist(ct, id))
 		return NULL;
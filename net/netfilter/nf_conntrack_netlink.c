@@ -133,10 +133,7 @@ nla_put_failure:
 static inline int
 ctnetlink_dump_timeout(struct sk_buff *skb, const struct nf_conn *ct)
 {
-	long timeout = (ct->timeout.expires - jiffies) / HZ;
-
-	if (timeout < 0)
-		timeout = 0;
+	long timeout = nf_ct_expires(ct) / HZ;
 
 	NLA_PUT_BE32(skb, CTA_TIMEOUT, htonl(timeout));
 	return 0;
@@ -617,6 +614,8 @@ ctnetlink_dump_table(struct sk_buff *skb, struct netlink_callback *cb)
 	rcu_read_lock();
 	last = (struct nf_conn *)cb->args[1];
 	for (; cb->args[0] < net->ct.htable_size; cb->args[0]++) {
+		/* a grown table is published before its size */
+		smp_rmb();
 restart:
 		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[cb->args[0]],
 					 hnnode) {
@@ -863,20 +862,7 @@ ctnetlink_del_conntrack(struct sock *ctnl, struct sk_buff *skb,
 		}
 	}
 
-	if (nf_conntrack_event_report(IPCT_DESTROY, ct,
-				      NETLINK_CB(skb).pid,
-				      nlmsg_report(nlh)) < 0) {
-		nf_ct_delete_from_lists(ct);
-		/* we failed to report the event, try later */
-		nf_ct_insert_dying_list(ct);
-		nf_ct_put(ct);
-		return 0;
-	}
-
-	/* death_by_timeout would report the event again */
-	set_bit(IPS_DYING_BIT, &ct->status);
-
-	nf_ct_kill(ct);
+	nf_ct_delete(ct, NETLINK_CB(skb).pid, nlmsg_report(nlh));
 	nf_ct_put(ct);
 
 	return 0;
@@ -1101,11 +1087,11 @@ ctnetlink_change_timeout(struct nf_conn *ct, const struct nlattr * const cda[])
 {
 	u_int32_t timeout = ntohl(nla_get_be32(cda[CTA_TIMEOUT]));
 
-	if (!del_timer(&ct->timeout))
+	/* too late, it is being deleted */
+	if (hlist_nulls_unhashed(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode))
 		return -ETIME;
 
-	ct->timeout.expires = jiffies + timeout * HZ;
-	add_timer(&ct->timeout);
+	ct->timeout = nfct_time_stamp + timeout * HZ;
 
 	return 0;
 }
@@ -1269,9 +1255,8 @@ ctnetlink_create_conntrack(struct net *net, u16 zone,
 
 	if (!cda[CTA_TIMEOUT])
 		goto err1;
-	ct->timeout.expires = ntohl(nla_get_be32(cda[CTA_TIMEOUT]));
-
-	ct->timeout.expires = jiffies + ct->timeout.expires * HZ;
+	ct->timeout = nfct_time_stamp +
+		      ntohl(nla_get_be32(cda[CTA_TIMEOUT])) * HZ;
 
 	rcu_read_lock();
  	if (cda[CTA_HELP]) {
@@ -1378,7 +1363,6 @@ ctnetlink_create_conntrack(struct net *net, u16 zone,
 		ct->master = master_ct;
 	}
 
-	add_timer(&ct->timeout);
 	nf_conntrack_hash_insert(ct);
 	rcu_read_unlock();
 
@@ -1999,8 +1983,19 @@ ctnetlink_new_expect(struct sock *ctnl, struct sk_buff *skb,
 }
 
 #ifdef CONFIG_NF_CONNTRACK_EVENTS
+static bool ctnetlink_has_listeners(struct net *net)
+{
+	return nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_NEW) ||
+	       nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_UPDATE) ||
+	       nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_DESTROY) ||
+	       nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_EXP_NEW) ||
+	       nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_EXP_UPDATE) ||
+	       nfnetlink_has_listeners(net, NFNLGRP_CONNTRACK_EXP_DESTROY);
+}
+
 static struct nf_ct_event_notifier ctnl_notifier = {
-	.fcn = ctnetlink_conntrack_event,
+	.fcn		= ctnetlink_conntrack_event,
+	.has_listeners	= ctnetlink_has_listeners,
 };
 
 static struct nf_exp_event_notifier ctnl_notifier_exp = {
@@ -0,0 +1,874 @@
+/*
+ * Xtables: per-uid traffic accounting and socket owner matching
+ *
+ * Every packet that goes through a "qtaguid" match in the INPUT or OUTPUT
+ * chain is counted against the socket it belongs to: its owner's uid, an
+ * optional accounting tag the application put on the socket, the uid's
+ * current counter set and the interface.  Counters live in one hash table,
+ * with a slot per CPU in each entry, so the cost per packet is a few hash
+ * lookups however many uids are tracked, and no lock is shared between
+ * CPUs once an entry exists.
+ *
+ * /proc/net/xt_qtaguid/ctrl tags sockets and switches counter sets,
+ * /proc/net/xt_qtaguid/stats dumps all counters.  See
+ * Documentation/networking/xt_qtaguid.txt.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/file.h>
+#include <linux/net.h>
+#include <linux/netdevice.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
+#include <linux/seqlock.h>
+#include <linux/uaccess.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <net/sock.h>
+#include <net/tcp.h>
+#include <net/udp.h>
+#include <net/inet_hashtables.h>
+#include <net/inet_timewait_sock.h>
+#include <net/net_namespace.h>
+#include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_qtaguid.h>
+
+/*
+ * A tag is the uid in the low 32 bits and the application's accounting
+ * tag in the high 32 bits.  Traffic of a tagged socket counts both for
+ * the full tag and for the plain uid, so per-uid totals stay complete.
+ */
+typedef u64 tag_t;
+
+static inline tag_t make_tag(u32 acct_tag, uid_t uid)
+{
+	return ((tag_t)acct_tag << 32) | uid;
+}
+
+static inline u32 get_acct_tag(tag_t tag)
+{
+	return tag >> 32;
+}
+
+static inline uid_t get_uid_from_tag(tag_t tag)
+{
+	return tag & 0xffffffffULL;
+}
+
+enum { QTAGUID_RX, QTAGUID_TX };
+
+struct tag_stat_counters {
+#if BITS_PER_LONG == 32
+	seqcount_t seq;		/* so readers see whole 64 bit values */
+#endif
+	u64 bytes[2];
+	u64 packets[2];
+} ____cacheline_aligned_in_smp;
+
+struct tag_stat {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	tag_t tag;
+	int set;
+	int ifindex;
+	char ifname[IFNAMSIZ];
+	struct tag_stat_counters cpu[0];	/* nr_cpu_ids of them */
+};
+
+struct sock_tag {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	struct sock *sk;	/* holds a reference */
+	tag_t tag;
+	pid_t pid;
+};
+
+struct uid_set {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	uid_t uid;
+	int set;
+};
+
+#define TAG_STAT_HASH_BITS	10
+#define SOCK_TAG_HASH_BITS	8
+#define UID_SET_HASH_BITS	6
+
+static struct hlist_head tag_stats[1 << TAG_STAT_HASH_BITS];
+static struct hlist_head sock_tags[1 << SOCK_TAG_HASH_BITS];
+static struct hlist_head uid_sets[1 << UID_SET_HASH_BITS];
+
+/* Writers only; the packet path looks entries up under RCU */
+static DEFINE_SPINLOCK(tag_stat_lock);
+static DEFINE_SPINLOCK(sock_tag_lock);
+static DEFINE_SPINLOCK(uid_set_lock);
+
+static unsigned int tag_stat_count, sock_tag_count;
+static unsigned long unaccounted;	/* packets we had no entry for */
+
+static unsigned int max_tag_stats = 4096;
+module_param(max_tag_stats, uint, 0644);
+MODULE_PARM_DESC(max_tag_stats, "most (iface, tag, set) counters kept");
+
+static unsigned int max_sock_tags = 2048;
+module_param(max_sock_tags, uint, 0644);
+MODULE_PARM_DESC(max_sock_tags, "most sockets tagged at one time");
+
+static struct proc_dir_entry *qtaguid_procdir;
+
+static inline unsigned int tag_stat_hash(tag_t tag, int set, int ifindex)
+{
+	return jhash_3words((u32)tag, get_acct_tag(tag),
+			    ifindex ^ (set << 24), 0) &
+	       ((1 << TAG_STAT_HASH_BITS) - 1);
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct tag_stat, rcu));
+}
+
+static void sock_tag_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct sock_tag, rcu));
+}
+
+static void uid_set_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct uid_set, rcu));
+}
+
+static struct tag_stat *
+tag_stat_find(unsigned int h, tag_t tag, int set, const struct net_device *dev)
+{
+	struct tag_stat *ts;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(ts, pos, &tag_stats[h], node)
+		if (ts->tag == tag && ts->set == set && ts->ifindex == dev->ifindex &&
+		    !strncmp(ts->ifname, dev->name, IFNAMSIZ))
+			return ts;
+	return NULL;
+}
+
+/* Called with BHs off, from the packet path */
+static struct tag_stat *
+tag_stat_get(tag_t tag, int set, const struct net_device *dev)
+{
+	unsigned int h = tag_stat_hash(tag, set, dev->ifindex);
+	struct tag_stat *ts;
+
+	ts = tag_stat_find(h, tag, set, dev);
+	if (likely(ts))
+		return ts;
+
+	spin_lock(&tag_stat_lock);
+	ts = tag_stat_find(h, tag, set, dev);
+	if (ts || tag_stat_count >= max_tag_stats)
+		goto out;
+
+	ts = kzalloc(sizeof(*ts) + nr_cpu_ids * sizeof(ts->cpu[0]), GFP_ATOMIC);
+	if (!ts)
+		goto out;
+	ts->tag = tag;
+	ts->set = set;
+	ts->ifindex = dev->ifindex;
+	strlcpy(ts->ifname, dev->name, IFNAMSIZ);
+#if BITS_PER_LONG == 32
+	{
+		int cpu;
+
+		for (cpu = 0; cpu < nr_cpu_ids; cpu++)
+			seqcount_init(&ts->cpu[cpu].seq);
+	}
+#endif
+	hlist_add_head_rcu(&ts->node, &tag_stats[h]);
+	tag_stat_count++;
+out:
+	spin_unlock(&tag_stat_lock);
+	return ts;
+}
+
+static void tag_stat_add(struct tag_stat *ts, int dir, unsigned int len)
+{
+	struct tag_stat_counters *c = &ts->cpu[smp_processor_id()];
+
+#if BITS_PER_LONG == 32
+	write_seqcount_begin(&c->seq);
+#endif
+	c->bytes[dir] += len;
+	c->packets[dir]++;
+#if BITS_PER_LONG == 32
+	write_seqcount_end(&c->seq);
+#endif
+}
+
+static void tag_stat_sum(const struct tag_stat *ts,
+			 struct tag_stat_counters *sum)
+{
+	const struct tag_stat_counters *c;
+	u64 bytes[2], packets[2];
+	int cpu, dir;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		c = &ts->cpu[cpu];
+#if BITS_PER_LONG == 32
+		{
+			unsigned int seq;
+
+			do {
+				seq = read_seqcount_begin(&c->seq);
+				memcpy(bytes, c->bytes, sizeof(bytes));
+				memcpy(packets, c->packets, sizeof(packets));
+			} while (read_seqcount_retry(&c->seq, seq));
+		}
+#else
+		memcpy(bytes, c->bytes, sizeof(bytes));
+		memcpy(packets, c->packets, sizeof(packets));
+#endif
+		for (dir = QTAGUID_RX; dir <= QTAGUID_TX; dir++) {
+			sum->bytes[dir] += bytes[dir];
+			sum->packets[dir] += packets[dir];
+		}
+	}
+}
+
+static struct sock_tag *sock_tag_find(const struct sock *sk)
+{
+	struct sock_tag *st;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(st, pos,
+				 &sock_tags[hash_ptr((void *)sk, SOCK_TAG_HASH_BITS)],
+				 node)
+		if (st->sk == sk)
+			return st;
+	return NULL;
+}
+
+static int uid_get_set(uid_t uid)
+{
+	struct uid_set *us;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(us, pos, &uid_sets[hash_32(uid, UID_SET_HASH_BITS)],
+				 node)
+		if (us->uid == uid)
+			return us->set;
+	return 0;
+}
+
+/* Uid owning a full socket, 0 when it has no file (kernel, orphaned) */
+static bool sk_get_owner(struct sock *sk, uid_t *uid, gid_t *gid)
+{
+	const struct file *filp;
+	bool found = false;
+
+	read_lock_bh(&sk->sk_callback_lock);
+	if (sk->sk_socket && (filp = sk->sk_socket->file) != NULL) {
+		*uid = filp->f_cred->fsuid;
+		*gid = filp->f_cred->fsgid;
+		found = true;
+	}
+	read_unlock_bh(&sk->sk_callback_lock);
+	return found;
+}
+
+/*
+ * Received packets are not linked to their socket before they reach the
+ * transport layer, so find it the way the transport will.  IPv4 TCP and
+ * UDP only; anything else counts for uid 0.
+ */
+static struct sock *
+qtaguid_find_sk(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	struct udphdr _hdr, *hp;
+	struct sock *sk = NULL;
+
+	if (par->family != NFPROTO_IPV4 || par->fragoff != 0 || !par->in)
+		return NULL;
+	if (iph->protocol != IPPROTO_TCP && iph->protocol != IPPROTO_UDP)
+		return NULL;
+
+	/* Ports are at the same offset in TCP and UDP headers */
+	hp = skb_header_pointer(skb, par->thoff, sizeof(_hdr), &_hdr);
+	if (hp == NULL)
+		return NULL;
+
+	if (iph->protocol == IPPROTO_TCP)
+		sk = __inet_lookup(dev_net(par->in), &tcp_hashinfo,
+				   iph->saddr, hp->source, iph->daddr, hp->dest,
+				   par->in->ifindex);
+	else
+		sk = udp4_lib_lookup(dev_net(par->in), iph->saddr, hp->source,
+				     iph->daddr, hp->dest, par->in->ifindex);
+
+	if (sk && sk->sk_state == TCP_TIME_WAIT) {
+		inet_twsk_put(inet_twsk(sk));
+		sk = NULL;
+	}
+	return sk;
+}
+
+static void
+qtaguid_account(const struct sk_buff *skb, struct sock *sk, uid_t uid,
+		const struct net_device *dev, int dir)
+{
+	struct sock_tag *st;
+	struct tag_stat *ts;
+	tag_t tag = make_tag(0, uid);
+	int set;
+
+	if (sk) {
+		st = sock_tag_find(sk);
+		if (st)
+			tag = st->tag;
+	}
+	set = uid_get_set(get_uid_from_tag(tag));
+
+	ts = tag_stat_get(make_tag(0, get_uid_from_tag(tag)), set, dev);
+	if (unlikely(!ts)) {
+		unaccounted++;
+		return;
+	}
+	tag_stat_add(ts, dir, skb->len);
+
+	if (get_acct_tag(tag)) {
+		ts = tag_stat_get(tag, set, dev);
+		if (likely(ts))
+			tag_stat_add(ts, dir, skb->len);
+		else
+			unaccounted++;
+	}
+}
+
+static bool
+qtaguid_mt(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	const struct xt_qtaguid_match_info *info = par->matchinfo;
+	struct sock *sk = skb->sk;
+	bool put_sk = false, res = true, owned = false;
+	uid_t uid = 0;
+	gid_t gid = 0;
+
+	if (sk == NULL && (par->hooknum == NF_INET_PRE_ROUTING ||
+			   par->hooknum == NF_INET_LOCAL_IN)) {
+		sk = qtaguid_find_sk(skb, par);
+		put_sk = (sk != NULL);
+	}
+	if (sk && sk->sk_state != TCP_TIME_WAIT)
+		owned = sk_get_owner(sk, &uid, &gid);
+
+	rcu_read_lock();
+	if (par->hooknum == NF_INET_LOCAL_IN)
+		qtaguid_account(skb, sk, uid, par->in, QTAGUID_RX);
+	else if (par->hooknum == NF_INET_LOCAL_OUT)
+		qtaguid_account(skb, sk, uid, par->out, QTAGUID_TX);
+	rcu_read_unlock();
+
+	/* From here on, the same tests as the "owner" match */
+	if (sk == NULL || sk->sk_socket == NULL) {
+		res = (info->match ^ info->invert) == 0;
+		goto out;
+	} else if (info->match & info->invert & XT_QTAGUID_SOCKET) {
+		res = false;
+		goto out;
+	}
+
+	if (!owned) {
+		res = ((info->match ^ info->invert) &
+		       (XT_QTAGUID_UID | XT_QTAGUID_GID)) == 0;
+		goto out;
+	}
+
+	if (info->match & XT_QTAGUID_UID)
+		if ((uid >= info->uid_min && uid <= info->uid_max) ^
+		    !(info->invert & XT_QTAGUID_UID))
+			res = false;
+
+	if (info->match & XT_QTAGUID_GID)
+		if ((gid >= info->gid_min && gid <= info->gid_max) ^
+		    !(info->invert & XT_QTAGUID_GID))
+			res = false;
+out:
+	if (put_sk)
+		sock_put(sk);
+	return res;
+}
+
+static int qtaguid_mt_check(const struct xt_mtchk_param *par)
+{
+	const struct xt_qtaguid_match_info *info = par->matchinfo;
+
+	if ((info->match | info->invert) &
+	    ~(XT_QTAGUID_UID | XT_QTAGUID_GID | XT_QTAGUID_SOCKET))
+		return -EINVAL;
+	return 0;
+}
+
+/* Drop the tags of sockets that have been closed; caller holds sock_tag_lock */
+static void sock_tag_prune(void)
+{
+	struct sock_tag *st;
+	struct hlist_node *pos, *n;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sock_tags); i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tags[i], node) {
+			if (st->sk->sk_socket && !sock_flag(st->sk, SOCK_DEAD))
+				continue;
+			hlist_del_rcu(&st->node);
+			sock_put(st->sk);
+			call_rcu(&st->rcu, sock_tag_free_rcu);
+			sock_tag_count--;
+		}
+}
+
+/* "t <fd> [<acct_tag> [<uid>]]": tag one of our sockets */
+static int qtaguid_ctrl_tag(const char *input)
+{
+	struct sock_tag *st, *old;
+	struct socket *sock;
+	unsigned int acct_tag = 0;
+	uid_t uid = current_fsuid();
+	int fd, err;
+	char cmd;
+
+	if (sscanf(input, "%c %d %u %u", &cmd, &fd, &acct_tag, &uid) < 2)
+		return -EINVAL;
+	if (uid != current_fsuid() && !capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	sock = sockfd_lookup(fd, &err);
+	if (!sock)
+		return err;
+	if (!sock->sk) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st) {
+		err = -ENOMEM;
+		goto out;
+	}
+	st->sk = sock->sk;
+	st->tag = make_tag(acct_tag, uid);
+	st->pid = task_tgid_vnr(current);
+
+	err = 0;
+	spin_lock_bh(&sock_tag_lock);
+	sock_tag_prune();
+	old = sock_tag_find(sock->sk);
+	if (old) {
+		/* Retag: the new entry takes over the socket reference */
+		hlist_replace_rcu(&old->node, &st->node);
+		call_rcu(&old->rcu, sock_tag_free_rcu);
+	} else if (sock_tag_count >= max_sock_tags) {
+		kfree(st);
+		err = -ENOSPC;
+	} else {
+		sock_hold(st->sk);
+		hlist_add_head_rcu(&st->node,
+				   &sock_tags[hash_ptr(st->sk, SOCK_TAG_HASH_BITS)]);
+		sock_tag_count++;
+	}
+	spin_unlock_bh(&sock_tag_lock);
+out:
+	sockfd_put(sock);
+	return err;
+}
+
+/* "u <fd>": remove a socket's tag */
+static int qtaguid_ctrl_untag(const char *input)
+{
+	struct sock_tag *st;
+	struct socket *sock;
+	int fd, err;
+	char cmd;
+
+	if (sscanf(input, "%c %d", &cmd, &fd) != 2)
+		return -EINVAL;
+
+	sock = sockfd_lookup(fd, &err);
+	if (!sock)
+		return err;
+
+	err = -ENOENT;
+	spin_lock_bh(&sock_tag_lock);
+	st = sock_tag_find(sock->sk);
+	if (st) {
+		hlist_del_rcu(&st->node);
+		sock_put(st->sk);
+		call_rcu(&st->rcu, sock_tag_free_rcu);
+		sock_tag_count--;
+		err = 0;
+	}
+	spin_unlock_bh(&sock_tag_lock);
+
+	sockfd_put(sock);
+	return err;
+}
+
+/* "s <set> <uid>": count the uid's traffic in another counter set */
+static int qtaguid_ctrl_counter_set(const char *input)
+{
+	struct uid_set *us, *old = NULL;
+	struct hlist_node *pos;
+	struct hlist_head *head;
+	int set;
+	uid_t uid;
+	char cmd;
+
+	if (sscanf(input, "%c %d %u", &cmd, &set, &uid) != 3)
+		return -EINVAL;
+	if (set < 0 || set >= XT_QTAGUID_MAX_SETS)
+		return -EINVAL;
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	us = kzalloc(sizeof(*us), GFP_KERNEL);
+	if (!us)
+		return -ENOMEM;
+	us->uid = uid;
+	us->set = set;
+
+	head = &uid_sets[hash_32(uid, UID_SET_HASH_BITS)];
+	spin_lock_bh(&uid_set_lock);
+	hlist_for_each_entry(old, pos, head, node)
+		if (old->uid == uid)
+			break;
+	if (!pos)
+		old = NULL;
+
+	if (set == 0) {
+		/* Set 0 is the default, no entry needed */
+		if (old)
+			hlist_del_rcu(&old->node);
+		kfree(us);
+	} else if (old) {
+		hlist_replace_rcu(&old->node, &us->node);
+	} else {
+		hlist_add_head_rcu(&us->node, head);
+	}
+	spin_unlock_bh(&uid_set_lock);
+
+	if (old)
+		call_rcu(&old->rcu, uid_set_free_rcu);
+	return 0;
+}
+
+/*
+ * "d <acct_tag> [<uid>]": forget counters and socket tags; 0 means all tags.
+ * Apps may clear their own tags, but the uid totals (acct_tag 0) are what
+ * usage is billed on, so only CAP_NET_ADMIN may drop those.
+ */
+static int qtaguid_ctrl_delete(const char *input)
+{
+	struct tag_stat *ts;
+	struct sock_tag *st;
+	struct hlist_node *pos, *n;
+	unsigned int acct_tag;
+	uid_t uid = current_fsuid();
+	char cmd;
+	int i;
+
+	if (sscanf(input, "%c %u %u", &cmd, &acct_tag, &uid) < 2)
+		return -EINVAL;
+	if ((uid != current_fsuid() || !acct_tag) && !capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	spin_lock_bh(&sock_tag_lock);
+	for (i = 0; i < ARRAY_SIZE(sock_tags); i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tags[i], node) {
+			if (get_uid_from_tag(st->tag) != uid ||
+			    (acct_tag && get_acct_tag(st->tag) != acct_tag))
+				continue;
+			hlist_del_rcu(&st->node);
+			sock_put(st->sk);
+			call_rcu(&st->rcu, sock_tag_free_rcu);
+			sock_tag_count--;
+		}
+	spin_unlock_bh(&sock_tag_lock);
+
+	spin_lock_bh(&tag_stat_lock);
+	for (i = 0; i < ARRAY_SIZE(tag_stats); i++)
+		hlist_for_each_entry_safe(ts, pos, n, &tag_stats[i], node) {
+			if (get_uid_from_tag(ts->tag) != uid ||
+			    (acct_tag && get_acct_tag(ts->tag) != acct_tag))
+				continue;
+			hlist_del_rcu(&ts->node);
+			call_rcu(&ts->rcu, tag_stat_free_rcu);
+			tag_stat_count--;
+		}
+	spin_unlock_bh(&tag_stat_lock);
+	return 0;
+}
+
+static ssize_t qtaguid_ctrl_write(struct file *file, const char __user *buffer,
+				  size_t count, loff_t *ppos)
+{
+	char input[64];
+	int err;
+
+	if (count == 0 || count >= sizeof(input))
+		return -EINVAL;
+	if (copy_from_user(input, buffer, count))
+		return -EFAULT;
+	input[count] = '\0';
+
+	switch (input[0]) {
+	case 't':
+		err = qtaguid_ctrl_tag(input);
+		break;
+	case 'u':
+		err = qtaguid_ctrl_untag(input);
+		break;
+	case 's':
+		err = qtaguid_ctrl_counter_set(input);
+		break;
+	case 'd':
+		err = qtaguid_ctrl_delete(input);
+		break;
+	default:
+		err = -EINVAL;
+	}
+	return err ? err : count;
+}
+
+static int qtaguid_ctrl_show(struct seq_file *s, void *v)
+{
+	struct sock_tag *st;
+	struct uid_set *us;
+	struct hlist_node *pos;
+	int i;
+
+	spin_lock_bh(&sock_tag_lock);
+	sock_tag_prune();
+	spin_unlock_bh(&sock_tag_lock);
+
+	rcu_read_lock();
+	for (i = 0; i < ARRAY_SIZE(sock_tags); i++)
+		hlist_for_each_entry_rcu(st, pos, &sock_tags[i], node)
+			seq_printf(s, "sock=%p tag=0x%x uid=%u pid=%u\n", st->sk,
+				   get_acct_tag(st->tag), get_uid_from_tag(st->tag),
+				   st->pid);
+	for (i = 0; i < ARRAY_SIZE(uid_sets); i++)
+		hlist_for_each_entry_rcu(us, pos, &uid_sets[i], node)
+			seq_printf(s, "uid=%u set=%d\n", us->uid, us->set);
+	rcu_read_unlock();
+
+	seq_printf(s, "sockets %u/%u counters %u/%u unaccounted %lu\n",
+		   sock_tag_count, max_sock_tags, tag_stat_count, max_tag_stats,
+		   unaccounted);
+	return 0;
+}
+
+static int qtaguid_ctrl_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qtaguid_ctrl_show, NULL);
+}
+
+static const struct file_operations qtaguid_ctrl_fops = {
+	.owner		= THIS_MODULE,
+	.open		= qtaguid_ctrl_open,
+	.read		= seq_read,
+	.write		= qtaguid_ctrl_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+struct qtaguid_stats_iter {
+	unsigned int bucket;
+};
+
+static struct tag_stat *qtaguid_stats_first(struct qtaguid_stats_iter *it)
+{
+	struct hlist_node *n;
+
+	for (; it->bucket < ARRAY_SIZE(tag_stats); it->bucket++) {
+		n = rcu_dereference(tag_stats[it->bucket].first);
+		if (n)
+			return hlist_entry(n, struct tag_stat, node);
+	}
+	return NULL;
+}
+
+static struct tag_stat *
+qtaguid_stats_next_entry(struct qtaguid_stats_iter *it, struct tag_stat *ts)
+{
+	struct hlist_node *n = rcu_dereference(ts->node.next);
+
+	if (n)
+		return hlist_entry(n, struct tag_stat, node);
+	it->bucket++;
+	return qtaguid_stats_first(it);
+}
+
+static void *qtaguid_stats_start(struct seq_file *s, loff_t *pos)
+	__acquires(RCU)
+{
+	struct qtaguid_stats_iter *it = s->private;
+	struct tag_stat *ts;
+	loff_t n = *pos;
+
+	rcu_read_lock();
+	if (n == 0)
+		return SEQ_START_TOKEN;
+
+	it->bucket = 0;
+	ts = qtaguid_stats_first(it);
+	while (ts && --n)
+		ts = qtaguid_stats_next_entry(it, ts);
+	return ts;
+}
+
+static void *qtaguid_stats_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	struct qtaguid_stats_iter *it = s->private;
+
+	++*pos;
+	if (v == SEQ_START_TOKEN) {
+		it->bucket = 0;
+		return qtaguid_stats_first(it);
+	}
+	return qtaguid_stats_next_entry(it, v);
+}
+
+static void qtaguid_stats_stop(struct seq_file *s, void *v)
+	__releases(RCU)
+{
+	rcu_read_unlock();
+}
+
+static int qtaguid_stats_show(struct seq_file *s, void *v)
+{
+	struct tag_stat_counters sum;
+	struct tag_stat *ts = v;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_puts(s, "iface acct_tag uid cnt_set rx_bytes rx_packets "
+			 "tx_bytes tx_packets\n");
+		return 0;
+	}
+
+	tag_stat_sum(ts, &sum);
+	seq_printf(s, "%s 0x%x %u %d %llu %llu %llu %llu\n", ts->ifname,
+		   get_acct_tag(ts->tag), get_uid_from_tag(ts->tag), ts->set,
+		   sum.bytes[QTAGUID_RX], sum.packets[QTAGUID_RX],
+		   sum.bytes[QTAGUID_TX], sum.packets[QTAGUID_TX]);
+	return 0;
+}
+
+static const struct seq_operations qtaguid_stats_seq_ops = {
+	.start	= qtaguid_stats_start,
+	.next	= qtaguid_stats_next,
+	.stop	= qtaguid_stats_stop,
+	.show	= qtaguid_stats_show,
+};
+
+static int qtaguid_stats_open(struct inode *inode, struct file *file)
+{
+	return seq_open_private(file, &qtaguid_stats_seq_ops,
+				sizeof(struct qtaguid_stats_iter));
+}
+
+static const struct file_operations qtaguid_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= qtaguid_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release_private,
+};
+
+static struct xt_match qtaguid_mt_reg __read_mostly = {
+	.name       = "qtaguid",
+	.revision   = 0,
+	.family     = NFPROTO_UNSPEC,
+	.match      = qtaguid_mt,
+	.checkentry = qtaguid_mt_check,
+	.matchsize  = sizeof(struct xt_qtaguid_match_info),
+	.hooks      = (1 << NF_INET_PRE_ROUTING) |
+	              (1 << NF_INET_LOCAL_IN) |
+	              (1 << NF_INET_LOCAL_OUT) |
+	              (1 << NF_INET_POST_ROUTING),
+	.me         = THIS_MODULE,
+};
+
+static void qtaguid_free_all(void)
+{
+	struct tag_stat *ts;
+	struct sock_tag *st;
+	struct uid_set *us;
+	struct hlist_node *pos, *n;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tag_stats); i++)
+		hlist_for_each_entry_safe(ts, pos, n, &tag_stats[i], node)
+			kfree(ts);
+	for (i = 0; i < ARRAY_SIZE(sock_tags); i++)
+		hlist_for_each_entry_safe(st, pos, n, &sock_tags[i], node) {
+			sock_put(st->sk);
+			kfree(st);
+		}
+	for (i = 0; i < ARRAY_SIZE(uid_sets); i++)
+		hlist_for_each_entry_safe(us, pos, n, &uid_sets[i], node)
+			kfree(us);
+}
+
+static int __init qtaguid_mt_init(void)
+{
+	int err;
+
+	qtaguid_procdir = proc_mkdir("xt_qtaguid", init_net.proc_net);
+	if (!qtaguid_procdir)
+		return -ENOMEM;
+	/* Applications tag their own sockets; the writes check permissions */
+	err = -ENOMEM;
+	if (!proc_create("ctrl", 0666, qtaguid_procdir, &qtaguid_ctrl_fops))
+		goto err_dir;
+	if (!proc_create("stats", 0444, qtaguid_procdir, &qtaguid_stats_fops))
+		goto err_ctrl;
+
+	err = xt_register_match(&qtaguid_mt_reg);
+	if (err)
+		goto err_stats;
+	return 0;
+
+err_stats:
+	remove_proc_entry("stats", qtaguid_procdir);
+err_ctrl:
+	remove_proc_entry("ctrl", qtaguid_procdir);
+err_dir:
+	remove_proc_entry("xt_qtaguid", init_net.proc_net);
+	return err;
+}
+
+static void __exit qtaguid_mt_exit(void)
+{
+	xt_unregister_match(&qtaguid_mt_reg);
+	remove_proc_entry("stats", qtaguid_procdir);
+	remove_proc_entry("ctrl", qtaguid_procdir);
+	remove_proc_entry("xt_qtaguid", init_net.proc_net);
+
+	rcu_barrier();
+	qtaguid_free_all();
+}
+
+module_init(qtaguid_mt_init);
+module_exit(qtaguid_mt_exit);
+MODULE_DESCRIPTION("Xtables: per-uid traffic accounting and socket owner matching");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ipt_qtaguid");
+MODULE_ALIAS("ip6t_qtaguid");
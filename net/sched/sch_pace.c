@@ -0,0 +1,607 @@
+/*
+ * net/sched/sch_pace.c		Flow queueing with per-flow pacing
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * Packets are queued per socket, or per address hash for packets that
+ * have no local socket, and the flows are served round robin with a
+ * quantum of bytes per round.  Flows that just became active are served
+ * before the others, so short exchanges don't wait behind bulk ones.
+ *
+ * A flow whose socket has a pacing rate (sk->sk_pacing_rate, which TCP
+ * derives from cwnd and srtt) doesn't send a packet before the previous
+ * one had time to leave at that rate: it is parked in a tree ordered by
+ * the time of its next packet, and the qdisc watchdog restarts the
+ * device queue when the earliest one is due.  A rate cap for all flows
+ * can be configured as well.
+ *
+ * Packets of priority TC_PRIO_CONTROL bypass the flows and the pacing.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/jiffies.h>
+#include <linux/skbuff.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/pkt_sched.h>
+#include <net/sock.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+
+struct pace_flow {
+	struct sk_buff	*head;		/* list of skbs for this flow */
+	struct sk_buff	*tail;
+	unsigned long	key;		/* socket pointer, or orphan hash */
+	u32		socket_hash;	/* sk_hash of the socket, to detect reuse */
+	int		qlen;
+	int		credit;
+	int		throttled;
+	unsigned long	age;		/* jiffies when the flow went idle */
+	u64		time_next_packet;
+	struct hlist_node hash_node;
+	struct list_head flowchain;	/* new_flows or old_flows when active */
+	struct rb_node	rate_node;	/* in the delayed tree when throttled */
+};
+
+struct pace_sched_data {
+	struct pace_flow internal;	/* for TC_PRIO_CONTROL packets */
+	struct list_head new_flows;
+	struct list_head old_flows;
+	struct rb_root	delayed;	/* throttled flows by time_next_packet */
+	u64		time_next_delayed_flow;
+
+	u32		limit;		/* packets in the qdisc */
+	u32		flow_plimit;
+	u32		quantum;
+	u32		initial_quantum;
+	u32		flow_max_rate;	/* bytes per second, ~0U for no cap */
+	u32		buckets_log;
+	struct hlist_head *hash;
+
+	u32		flows;
+	u32		inactive_flows;
+	u32		throttled_flows;
+
+	u64		stat_gc_flows;
+	u64		stat_internal_packets;
+	u64		stat_throttled;
+	u64		stat_flows_plimit;
+	u64		stat_allocation_errors;
+
+	struct qdisc_watchdog watchdog;
+};
+
+/* Flows idle for this long are freed when their bucket is searched */
+#define PACE_GC_AGE		(3 * HZ)
+/* A flow idle for this long gets at least a full quantum back */
+#define PACE_REFILL_DELAY	(HZ / 25)
+/* The socket's rate may drop after the delay is computed: bound it */
+#define PACE_MAX_DELAY		(125 * NSEC_PER_MSEC)
+
+static struct kmem_cache *pace_flow_cachep __read_mostly;
+
+static inline int pace_flow_is_detached(const struct pace_flow *f)
+{
+	return list_empty(&f->flowchain) && !f->throttled;
+}
+
+static void pace_flow_set_throttled(struct pace_sched_data *q,
+				    struct pace_flow *f)
+{
+	struct rb_node **p = &q->delayed.rb_node, *parent = NULL;
+
+	while (*p) {
+		struct pace_flow *aux;
+
+		parent = *p;
+		aux = rb_entry(parent, struct pace_flow, rate_node);
+		if (f->time_next_packet >= aux->time_next_packet)
+			p = &parent->rb_right;
+		else
+			p = &parent->rb_left;
+	}
+	rb_link_node(&f->rate_node, parent, p);
+	rb_insert_color(&f->rate_node, &q->delayed);
+	q->throttled_flows++;
+	q->stat_throttled++;
+	f->throttled = 1;
+	if (q->time_next_delayed_flow > f->time_next_packet)
+		q->time_next_delayed_flow = f->time_next_packet;
+}
+
+static void pace_flow_unset_throttled(struct pace_sched_data *q,
+				      struct pace_flow *f)
+{
+	rb_erase(&f->rate_node, &q->delayed);
+	q->throttled_flows--;
+	f->throttled = 0;
+	list_add_tail(&f->flowchain, &q->old_flows);
+}
+
+static void pace_check_throttled(struct pace_sched_data *q, u64 now)
+{
+	struct rb_node *p;
+
+	if (q->time_next_delayed_flow > now)
+		return;
+
+	q->time_next_delayed_flow = ~0ULL;
+	while ((p = rb_first(&q->delayed)) != NULL) {
+		struct pace_flow *f = rb_entry(p, struct pace_flow, rate_node);
+
+		if (f->time_next_packet > now) {
+			q->time_next_delayed_flow = f->time_next_packet;
+			break;
+		}
+		pace_flow_unset_throttled(q, f);
+	}
+}
+
+static unsigned long pace_orphan_key(const struct sk_buff *skb)
+{
+	u32 h = skb->rxhash;
+
+	if (!h) {
+		switch (skb->protocol) {
+		case htons(ETH_P_IP): {
+			const struct iphdr *iph = ip_hdr(skb);
+
+			h = jhash_3words((__force u32)iph->saddr,
+					 (__force u32)iph->daddr,
+					 iph->protocol, 0);
+			break;
+		}
+		case htons(ETH_P_IPV6): {
+			const struct ipv6hdr *iph = ipv6_hdr(skb);
+
+			h = jhash_3words((__force u32)iph->saddr.s6_addr32[3],
+					 (__force u32)iph->daddr.s6_addr32[3],
+					 iph->nexthdr, 0);
+			break;
+		}
+		}
+	}
+	/* Socket pointers are aligned: an odd key can't be mistaken for one */
+	return ((unsigned long)h << 1) | 1UL;
+}
+
+static struct pace_flow *pace_classify(struct sk_buff *skb,
+				       struct pace_sched_data *q)
+{
+	struct sock *sk = skb->sk;
+	struct hlist_node *node, *tmp;
+	struct hlist_head *head;
+	struct pace_flow *f;
+	unsigned long key;
+
+	if (unlikely((skb->priority & TC_PRIO_MAX) == TC_PRIO_CONTROL))
+		return &q->internal;
+
+	key = sk ? (unsigned long)sk : pace_orphan_key(skb);
+	head = &q->hash[hash_long(key, q->buckets_log)];
+
+	hlist_for_each_entry_safe(f, node, tmp, head, hash_node) {
+		if (f->key == key) {
+			/* The socket was freed and its memory reused */
+			if (sk && unlikely(f->socket_hash != sk->sk_hash)) {
+				f->socket_hash = sk->sk_hash;
+				f->credit = q->initial_quantum;
+				if (!f->throttled)
+					f->time_next_packet = 0;
+			}
+			return f;
+		}
+		if (pace_flow_is_detached(f) &&
+		    time_after(jiffies, f->age + PACE_GC_AGE)) {
+			hlist_del(&f->hash_node);
+			kmem_cache_free(pace_flow_cachep, f);
+			q->flows--;
+			q->inactive_flows--;
+			q->stat_gc_flows++;
+		}
+	}
+
+	f = kmem_cache_zalloc(pace_flow_cachep, GFP_ATOMIC);
+	if (unlikely(!f)) {
+		q->stat_allocation_errors++;
+		return &q->internal;
+	}
+	f->key = key;
+	if (sk)
+		f->socket_hash = sk->sk_hash;
+	f->credit = q->initial_quantum;
+	f->age = jiffies;
+	INIT_LIST_HEAD(&f->flowchain);
+	hlist_add_head(&f->hash_node, head);
+	q->flows++;
+	q->inactive_flows++;
+	return f;
+}
+
+static struct sk_buff *pace_flow_dequeue_head(struct pace_flow *f)
+{
+	struct sk_buff *skb = f->head;
+
+	if (skb) {
+		f->head = skb->next;
+		skb->next = NULL;
+		f->qlen--;
+	}
+	return skb;
+}
+
+static void pace_flow_queue_add(struct pace_flow *f, struct sk_buff *skb)
+{
+	if (f->head == NULL)
+		f->head = skb;
+	else
+		f->tail->next = skb;
+	f->tail = skb;
+	skb->next = NULL;
+	f->qlen++;
+}
+
+static int pace_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct pace_flow *f;
+
+	if (unlikely(sch->q.qlen >= q->limit))
+		return qdisc_drop(skb, sch);
+
+	f = pace_classify(skb, q);
+	if (f == &q->internal) {
+		q->stat_internal_packets++;
+	} else {
+		if (unlikely(f->qlen >= q->flow_plimit)) {
+			q->stat_flows_plimit++;
+			return qdisc_drop(skb, sch);
+		}
+		if (pace_flow_is_detached(f)) {
+			list_add_tail(&f->flowchain, &q->new_flows);
+			if (time_after(jiffies, f->age + PACE_REFILL_DELAY))
+				f->credit = max_t(int, f->credit, q->quantum);
+			q->inactive_flows--;
+		}
+	}
+
+	pace_flow_queue_add(f, skb);
+	sch->qstats.backlog += qdisc_pkt_len(skb);
+	sch->bstats.bytes += qdisc_pkt_len(skb);
+	sch->bstats.packets++;
+	sch->q.qlen++;
+	return NET_XMIT_SUCCESS;
+}
+
+static struct sk_buff *pace_dequeue(struct Qdisc *sch)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct list_head *head;
+	struct pace_flow *f;
+	struct sk_buff *skb;
+	u64 now;
+	u32 rate;
+
+	if (!sch->q.qlen)
+		return NULL;
+
+	skb = pace_flow_dequeue_head(&q->internal);
+	if (skb)
+		goto out;
+
+	now = ktime_to_ns(ktime_get());
+	pace_check_throttled(q, now);
+begin:
+	head = &q->new_flows;
+	if (list_empty(head)) {
+		head = &q->old_flows;
+		if (list_empty(head)) {
+			if (q->time_next_delayed_flow != ~0ULL)
+				qdisc_watchdog_schedule(&q->watchdog,
+					PSCHED_NS2TICKS(q->time_next_delayed_flow));
+			return NULL;
+		}
+	}
+	f = list_first_entry(head, struct pace_flow, flowchain);
+
+	if (f->credit <= 0) {
+		f->credit += q->quantum;
+		list_move_tail(&f->flowchain, &q->old_flows);
+		goto begin;
+	}
+
+	if (f->head && now < f->time_next_packet) {
+		list_del_init(&f->flowchain);
+		pace_flow_set_throttled(q, f);
+		goto begin;
+	}
+
+	skb = pace_flow_dequeue_head(f);
+	if (!skb) {
+		/* Give an emptied new flow one round among the old ones */
+		if (head == &q->new_flows && !list_empty(&q->old_flows)) {
+			list_move_tail(&f->flowchain, &q->old_flows);
+		} else {
+			list_del_init(&f->flowchain);
+			f->age = jiffies;
+			q->inactive_flows++;
+		}
+		goto begin;
+	}
+	f->credit -= qdisc_pkt_len(skb);
+
+	rate = q->flow_max_rate;
+	if (skb->sk)
+		rate = min(skb->sk->sk_pacing_rate, rate);
+	if (rate != ~0U) {
+		u64 len = (u64)qdisc_pkt_len(skb) * NSEC_PER_SEC;
+
+		if (likely(rate))
+			do_div(len, rate);
+		else
+			len = PACE_MAX_DELAY;
+		if (unlikely(len > PACE_MAX_DELAY))
+			len = PACE_MAX_DELAY;
+		f->time_next_packet = now + len;
+	}
+out:
+	sch->q.qlen--;
+	sch->qstats.backlog -= qdisc_pkt_len(skb);
+	sch->flags &= ~TCQ_F_THROTTLED;
+	return skb;
+}
+
+static void pace_reset(struct Qdisc *sch)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct hlist_node *node, *tmp;
+	struct pace_flow *f;
+	struct sk_buff *skb;
+	unsigned int idx;
+
+	while ((skb = pace_flow_dequeue_head(&q->internal)) != NULL)
+		kfree_skb(skb);
+
+	if (q->hash) {
+		for (idx = 0; idx < (1U << q->buckets_log); idx++) {
+			hlist_for_each_entry_safe(f, node, tmp, &q->hash[idx],
+						  hash_node) {
+				while ((skb = pace_flow_dequeue_head(f)) != NULL)
+					kfree_skb(skb);
+				hlist_del(&f->hash_node);
+				kmem_cache_free(pace_flow_cachep, f);
+			}
+		}
+	}
+	INIT_LIST_HEAD(&q->new_flows);
+	INIT_LIST_HEAD(&q->old_flows);
+	q->delayed = RB_ROOT;
+	q->time_next_delayed_flow = ~0ULL;
+	q->flows = 0;
+	q->inactive_flows = 0;
+	q->throttled_flows = 0;
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+	qdisc_watchdog_cancel(&q->watchdog);
+}
+
+static int pace_resize(struct Qdisc *sch, u32 log)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct hlist_head *array, *old;
+	struct hlist_node *node, *tmp;
+	struct pace_flow *f;
+	unsigned int idx;
+
+	array = kmalloc(sizeof(struct hlist_head) << log, GFP_KERNEL);
+	if (!array)
+		return -ENOMEM;
+	for (idx = 0; idx < (1U << log); idx++)
+		INIT_HLIST_HEAD(&array[idx]);
+
+	sch_tree_lock(sch);
+	old = q->hash;
+	if (old) {
+		for (idx = 0; idx < (1U << q->buckets_log); idx++) {
+			hlist_for_each_entry_safe(f, node, tmp, &old[idx],
+						  hash_node) {
+				hlist_del(&f->hash_node);
+				hlist_add_head(&f->hash_node,
+					       &array[hash_long(f->key, log)]);
+			}
+		}
+	}
+	q->hash = array;
+	q->buckets_log = log;
+	sch_tree_unlock(sch);
+
+	kfree(old);
+	return 0;
+}
+
+static const struct nla_policy pace_policy[TCA_PACE_MAX + 1] = {
+	[TCA_PACE_PLIMIT]		= { .type = NLA_U32 },
+	[TCA_PACE_FLOW_PLIMIT]		= { .type = NLA_U32 },
+	[TCA_PACE_QUANTUM]		= { .type = NLA_U32 },
+	[TCA_PACE_INITIAL_QUANTUM]	= { .type = NLA_U32 },
+	[TCA_PACE_FLOW_MAX_RATE]	= { .type = NLA_U32 },
+	[TCA_PACE_BUCKETS_LOG]		= { .type = NLA_U32 },
+};
+
+static int pace_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct nlattr *tb[TCA_PACE_MAX + 1];
+	unsigned int drop_count = 0;
+	struct sk_buff *skb;
+	int err;
+
+	if (!opt)
+		return -EINVAL;
+
+	err = nla_parse_nested(tb, TCA_PACE_MAX, opt, pace_policy);
+	if (err < 0)
+		return err;
+
+	if (tb[TCA_PACE_QUANTUM] && !nla_get_u32(tb[TCA_PACE_QUANTUM]))
+		return -EINVAL;
+
+	if (tb[TCA_PACE_BUCKETS_LOG]) {
+		u32 log = nla_get_u32(tb[TCA_PACE_BUCKETS_LOG]);
+
+		if (log < 1 || log > 16)
+			return -EINVAL;
+		if (log != q->buckets_log) {
+			err = pace_resize(sch, log);
+			if (err)
+				return err;
+		}
+	}
+
+	sch_tree_lock(sch);
+	if (tb[TCA_PACE_PLIMIT])
+		q->limit = nla_get_u32(tb[TCA_PACE_PLIMIT]);
+	if (tb[TCA_PACE_FLOW_PLIMIT])
+		q->flow_plimit = nla_get_u32(tb[TCA_PACE_FLOW_PLIMIT]);
+	if (tb[TCA_PACE_QUANTUM])
+		q->quantum = nla_get_u32(tb[TCA_PACE_QUANTUM]);
+	if (tb[TCA_PACE_INITIAL_QUANTUM])
+		q->initial_quantum = nla_get_u32(tb[TCA_PACE_INITIAL_QUANTUM]);
+	if (tb[TCA_PACE_FLOW_MAX_RATE])
+		q->flow_max_rate = nla_get_u32(tb[TCA_PACE_FLOW_MAX_RATE]);
+
+	while (sch->q.qlen > q->limit) {
+		skb = pace_dequeue(sch);
+		if (!skb)
+			break;
+		kfree_skb(skb);
+		drop_count++;
+	}
+	qdisc_tree_decrease_qlen(sch, drop_count);
+	sch_tree_unlock(sch);
+	return 0;
+}
+
+static int pace_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	int err = 0;
+
+	q->limit		= 10000;
+	q->flow_plimit		= 100;
+	q->quantum		= 2 * psched_mtu(qdisc_dev(sch));
+	q->initial_quantum	= 10 * psched_mtu(qdisc_dev(sch));
+	q->flow_max_rate	= ~0U;
+	INIT_LIST_HEAD(&q->internal.flowchain);
+	INIT_LIST_HEAD(&q->new_flows);
+	INIT_LIST_HEAD(&q->old_flows);
+	q->delayed		= RB_ROOT;
+	q->time_next_delayed_flow = ~0ULL;
+	qdisc_watchdog_init(&q->watchdog, sch);
+
+	if (opt)
+		err = pace_change(sch, opt);
+	if (!err && !q->hash)
+		err = pace_resize(sch, 10);
+	return err;
+}
+
+static void pace_destroy(struct Qdisc *sch)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+
+	pace_reset(sch);
+	kfree(q->hash);
+	q->hash = NULL;
+}
+
+static int pace_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct nlattr *opts;
+
+	opts = nla_nest_start(skb, TCA_OPTIONS);
+	if (opts == NULL)
+		goto nla_put_failure;
+
+	NLA_PUT_U32(skb, TCA_PACE_PLIMIT, q->limit);
+	NLA_PUT_U32(skb, TCA_PACE_FLOW_PLIMIT, q->flow_plimit);
+	NLA_PUT_U32(skb, TCA_PACE_QUANTUM, q->quantum);
+	NLA_PUT_U32(skb, TCA_PACE_INITIAL_QUANTUM, q->initial_quantum);
+	NLA_PUT_U32(skb, TCA_PACE_FLOW_MAX_RATE, q->flow_max_rate);
+	NLA_PUT_U32(skb, TCA_PACE_BUCKETS_LOG, q->buckets_log);
+
+	nla_nest_end(skb, opts);
+	return skb->len;
+
+nla_put_failure:
+	nla_nest_cancel(skb, opts);
+	return -1;
+}
+
+static int pace_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
+{
+	struct pace_sched_data *q = qdisc_priv(sch);
+	struct tc_pace_qd_stats st = {
+		.gc_flows		= q->stat_gc_flows,
+		.highprio_packets	= q->stat_internal_packets,
+		.throttled		= q->stat_throttled,
+		.flows_plimit		= q->stat_flows_plimit,
+		.allocation_errors	= q->stat_allocation_errors,
+		.flows			= q->flows,
+		.inactive_flows		= q->inactive_flows,
+		.throttled_flows	= q->throttled_flows,
+	};
+
+	return gnet_stats_copy_app(d, &st, sizeof(st));
+}
+
+static struct Qdisc_ops pace_qdisc_ops __read_mostly = {
+	.id		=	"pace",
+	.priv_size	=	sizeof(struct pace_sched_data),
+	.enqueue	=	pace_enqueue,
+	.dequeue	=	pace_dequeue,
+	.peek		=	qdisc_peek_dequeued,
+	.init		=	pace_init,
+	.reset		=	pace_reset,
+	.destroy	=	pace_destroy,
+	.change		=	pace_change,
+	.dump		=	pace_dump,
+	.dump_stats	=	pace_dump_stats,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init pace_module_init(void)
+{
+	int ret;
+
+	pace_flow_cachep = kmem_cache_create("pace_flow_cache",
+					     sizeof(struct pace_flow),
+					     0, 0, NULL);
+	if (!pace_flow_cachep)
+		return -ENOMEM;
+
+	ret = register_qdisc(&pace_qdisc_ops);
+	if (ret)
+		kmem_cache_destroy(pace_flow_cachep);
+	return ret;
+}
+
+static void __exit pace_module_exit(void)
+{
+	unregister_qdisc(&pace_qdisc_ops);
+	kmem_cache_destroy(pace_flow_cachep);
+}
+
+module_init(pace_module_init)
+module_exit(pace_module_exit)
+MODULE_LICENSE("GPL");